@@ -526,6 +526,8 @@ bool AddonsManager::install(const Addon &addon)
     file_manager->checkAndCreateDirForAddons(to);
 
     bool success = extract_zip(from, to, true/*recursive*/);
+    // The addon directory might be (or replace) a search directory
+    file_manager->clearSearchPathCache();
     if (!success)
     {
         // TODO: show a message in the interface
@@ -1026,6 +1026,25 @@ namespace UserConfigParams
     PARAM_PREFIX BoolUserConfigParam        m_cache_overworld
             PARAM_DEFAULT(  BoolUserConfigParam(true, "cache-overworld") );
 
+    PARAM_PREFIX BoolUserConfigParam        m_cache_arena_graph
+            PARAM_DEFAULT(  BoolUserConfigParam(true, "cache-arena-graph",
+                            "Cache the shortest paths of arenas on disk.") );
+
+    PARAM_PREFIX BoolUserConfigParam        m_arena_graph_half_float
+            PARAM_DEFAULT(  BoolUserConfigParam(false, "arena-graph-half-float",
+                            "Store the shortest path distances of arenas as "
+                            "16 bit floats to save memory.") );
+
+    PARAM_PREFIX BoolUserConfigParam        m_cache_collision_bvh
+            PARAM_DEFAULT(  BoolUserConfigParam(true, "cache-collision-bvh",
+                            "Cache the collision trees of track meshes on "
+                            "disk.") );
+
+    PARAM_PREFIX BoolUserConfigParam        m_save_text_replays
+            PARAM_DEFAULT(  BoolUserConfigParam(false, "save-text-replays",
+                            "Save replays in the old text format instead of "
+                            "the smaller binary format.") );
+
     // TODO : is this used with new code? does it still work?
     PARAM_PREFIX BoolUserConfigParam        m_crashed
             PARAM_DEFAULT(  BoolUserConfigParam(false, "crashed") );
@@ -67,6 +67,8 @@ MaterialManager::~MaterialManager()
         delete m_materials[i];
     }
     m_materials.clear();
+    m_name_index.clear();
+    m_full_path_index.clear();
 
     for (std::map<std::string, Material*> ::iterator it =
          m_default_sp_materials.begin(); it != m_default_sp_materials.end();
@@ -77,6 +79,67 @@ MaterialManager::~MaterialManager()
     m_default_sp_materials.clear();
 }   // ~MaterialManager
 
+//-----------------------------------------------------------------------------
+/** Returns the key of a texture name in m_name_index. Material::install
+ *  changes the name of a material to its lower case basename, which does
+ *  not change the key.
+ */
+std::string MaterialManager::getNameKey(const std::string& name)
+{
+    core::stringc key(StringUtils::getBasename(name).c_str());
+    key.make_lower();
+    return key.c_str();
+}   // getNameKey
+
+//-----------------------------------------------------------------------------
+/** Appends a material to m_materials and adds it to the indices. */
+void MaterialManager::addMaterial(Material* m)
+{
+    const int index = (int)m_materials.size();
+    m_materials.push_back(m);
+    m_name_index[getNameKey(m->getTexFname())].push_back(index);
+    m_full_path_index[m->getTexFullPath()].push_back(index);
+}   // addMaterial
+
+//-----------------------------------------------------------------------------
+/** Deletes the last material and removes it from the indices. */
+void MaterialManager::removeLastMaterial()
+{
+    const int index = (int)m_materials.size() - 1;
+    Material* m = m_materials[index];
+    for (MaterialIndex* mi : { &m_name_index, &m_full_path_index })
+    {
+        MaterialIndex::iterator it = mi == &m_name_index ?
+            mi->find(getNameKey(m->getTexFname())) :
+            mi->find(m->getTexFullPath());
+        assert(it != mi->end() && it->second.back() == index);
+        it->second.pop_back();
+        if (it->second.empty())
+            mi->erase(it);
+    }
+    delete m;
+    m_materials.pop_back();
+}   // removeLastMaterial
+
+//-----------------------------------------------------------------------------
+/** Returns the indices of all materials which might have the given texture
+ *  name (the name of each still has to be compared), or NULL.
+ */
+const std::vector<int>* MaterialManager::findByName(const std::string& name) const
+{
+    MaterialIndex::const_iterator it = m_name_index.find(getNameKey(name));
+    return it == m_name_index.end() ? NULL : &it->second;
+}   // findByName
+
+//-----------------------------------------------------------------------------
+/** Returns the indices of all materials with the given full path, or NULL.
+ */
+const std::vector<int>* MaterialManager::findByFullPath(const std::string& path) const
+{
+    MaterialIndex::const_iterator it = m_full_path_index.find(path);
+    return it == m_full_path_index.end() ? NULL : &it->second;
+}   // findByFullPath
+
 //-----------------------------------------------------------------------------
 
 Material* MaterialManager::getMaterialFor(video::ITexture* t,
@@ -100,49 +163,29 @@ Material* MaterialManager::getMaterialSPM(std::string lay_one_tex_lc,
     const bool is_full_path = !lay_one_tex_lc.empty() &&
         (lay_one_tex_lc.find('/') != std::string::npos ||
         lay_one_tex_lc.find('\\') != std::string::npos);
-    if (is_full_path)
+    // Materials with the same full path, or with the same basename (which
+    // still has to be compared)
+    const std::vector<int>* candidates = lay_one_tex_lc.empty() ? NULL :
+        is_full_path ? findByFullPath(lay_one_tex_lc) : findByName(lay_one_tex_lc);
+    // Search backward so that temporary (track) textures are found first
+    for (int j = candidates ? (int)candidates->size() - 1 : -1; j >= 0; j--)
     {
-        // Search backward so that temporary (track) textures are found first
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
+        Material* m = m_materials[(*candidates)[j]];
+        if (!is_full_path && m->getTexFname() != lay_one_tex_lc)
+            continue;
+        const std::string& mat_lay_two = m->getUVTwoTexture();
+        if (mat_lay_two.empty() && lay_two_tex_lc.empty())
         {
-            if (m_materials[i]->getTexFullPath() == lay_one_tex_lc)
-            {
-                const std::string& mat_lay_two = m_materials[i]->getUVTwoTexture();
-                if (mat_lay_two.empty() && lay_two_tex_lc.empty())
-                {
-                    return m_materials[i];
-                }
-                else if (!mat_lay_two.empty() && !lay_two_tex_lc.empty())
-                {
-                    if (mat_lay_two == lay_two_tex_lc)
-                    {
-                        return m_materials[i];
-                    }
-                }
-            }
+            return m;
         }
-    }
-    else if (!lay_one_tex_lc.empty())
-    {
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
+        else if (!mat_lay_two.empty() && !lay_two_tex_lc.empty())
         {
-            if (m_materials[i]->getTexFname() == lay_one_tex_lc)
+            if (mat_lay_two == lay_two_tex_lc)
             {
-                const std::string& mat_lay_two = m_materials[i]->getUVTwoTexture();
-                if (mat_lay_two.empty() && lay_two_tex_lc.empty())
-                {
-                    return m_materials[i];
-                }
-                else if (!mat_lay_two.empty() && !lay_two_tex_lc.empty())
-                {
-                    if (mat_lay_two == lay_two_tex_lc)
-                    {
-                        return m_materials[i];
-                    }
-                }
+                return m;
             }
-        }   // for i
-    }
+        }
+    }   // for j
     if (def_shader_name.empty())
         return NULL;
     Log::debug("MaterialManager", "Couldn't find cached SP material! Opening default %s!", original_layer_one.c_str());
@@ -159,27 +202,27 @@ Material* MaterialManager::getMaterialFor(video::ITexture* t)
 
     if (!img_path.empty() && (img_path.findFirst('/') != -1 || img_path.findFirst('\\') != -1))
     {
-        // Search backward so that temporary (track) textures are found first
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
-        {
-            if (m_materials[i]->getTexFullPath() == img_path.c_str())
-            {
-                return m_materials[i];
-            }
-        }
+        // The last one is a temporary (track) texture if there is one
+        const std::vector<int>* candidates = findByFullPath(img_path.c_str());
+        if (candidates)
+            return m_materials[candidates->back()];
     }
     else
     {
         core::stringc image(StringUtils::getBasename(img_path.c_str()).c_str());
         image.make_lower();
 
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
+        const std::vector<int>* candidates = findByName(image.c_str());
+        if (!candidates)
+            return NULL;
+        for (int j = (int)candidates->size() - 1; j >= 0; j--)
         {
-            if (m_materials[i]->getTexFname() == image.c_str())
+            Material* m = m_materials[(*candidates)[j]];
+            if (m->getTexFname() == image.c_str())
             {
-                return m_materials[i];
+                return m;
             }
-        }   // for i
+        }   // for j
     }
     return NULL;
 }
@@ -257,7 +300,7 @@ void MaterialManager::setAllUntexturedMaterialFlags(scene::IMeshBuffer *mb)
 //-----------------------------------------------------------------------------
 int MaterialManager::addEntity(Material *m)
 {
-    m_materials.push_back(m);
+    addMaterial(m);
     return (int)m_materials.size()-1;
 }
 
@@ -328,7 +371,7 @@ bool MaterialManager::pushTempMaterial(const XMLNode *root,
         }
         try
         {
-            m_materials.push_back(new Material(node, deprecated));
+            addMaterial(new Material(node, deprecated));
         }
         catch(std::exception& e)
         {
@@ -345,8 +388,7 @@ void MaterialManager::popTempMaterial()
 {
     for(int i=(int)m_materials.size()-1; i>=this->m_shared_material_index; i--)
     {
-        delete m_materials[i];
-        m_materials.pop_back();
+        removeLastMaterial();
     }   // for i6
 }   // popTempMaterial
 
@@ -393,17 +435,19 @@ Material *MaterialManager::getMaterial(const std::string& fname,
     basename_lower.make_lower();
 
     // Search backward so that temporary (track) textures are found first
-    for (int i = (int)m_materials.size()-1; i>=0; i-- )
+    const std::vector<int>* candidates = findByName(basename_lower.c_str());
+    for (int j = candidates ? (int)candidates->size()-1 : -1; j>=0; j-- )
     {
-        if (m_materials[i]->getTexFname() == basename_lower.c_str())
-            return m_materials[i];
+        Material* m = m_materials[(*candidates)[j]];
+        if (m->getTexFname() == basename_lower.c_str())
+            return m;
     }
 
     if (!create_if_not_found)
         return NULL;
     // Add the new material
     Material* m = new Material(fname, is_full_path, complain_if_not_found, install);
-    m_materials.push_back(m);
+    addMaterial(m);
     if(make_permanent)
     {
         assert(m_shared_material_index==(int)m_materials.size()-1);
@@ -450,8 +494,10 @@ bool MaterialManager::hasMaterial(const std::string& fname)
 {
     std::string basename=StringUtils::getBasename(fname);
 
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
+    const std::vector<int>* candidates = findByName(basename);
+    if (!candidates)
+        return false;
+    for (int i : *candidates)
     {
         if(m_materials[i]->getTexFname()==basename) return true;
     }
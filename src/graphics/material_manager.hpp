@@ -32,6 +32,7 @@ using namespace irr;
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <EMaterialTypes.h>
 
 class Material;
@@ -50,8 +51,22 @@ private:
 
     std::vector<Material*> m_materials;
 
+    /** Indices in m_materials of all materials with a certain lower case
+     *  texture basename, and with a certain full path. The indices are in
+     *  increasing order, so the last one is the one a backward search of
+     *  m_materials finds first (i.e. temporary track materials before
+     *  shared ones). */
+    typedef std::unordered_map<std::string, std::vector<int> > MaterialIndex;
+    MaterialIndex m_name_index, m_full_path_index;
+
     std::map<std::string, Material*> m_default_sp_materials;
 
+    static std::string getNameKey(const std::string& name);
+    void    addMaterial(Material* m);
+    void    removeLastMaterial();
+    const std::vector<int>* findByName(const std::string& name) const;
+    const std::vector<int>* findByFullPath(const std::string& path) const;
+
 public:
               MaterialManager();
              ~MaterialManager();
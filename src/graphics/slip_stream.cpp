@@ -39,6 +39,8 @@
 #include "utils/constants.hpp"
 #include "mini_glm.hpp"
 
+#include <algorithm>
+
 #include <IMeshCache.h>
 #include <ISceneManager.h>
 #include <SMeshBuffer.h>
@@ -920,15 +922,37 @@ void SlipStream::update(int ticks)
     bool is_inner_sstreaming = false;
     bool is_outer_sstreaming = false;
     m_target_kart            = NULL;
-    std::vector<float> target_value;
+    std::vector<float> target_value(num_karts, 0.0f);
 
     // Note that this loop can not be simply replaced with a shorter loop
     // using only the karts with a better position - since a kart might
-    // be a lap behind
-    for(unsigned int i=0; i<num_karts; i++)
+    // be a lap behind. Only karts close enough to give slipstream are
+    // tested, plus the previous target (which must be reset if it is not
+    // valid anymore). The debug colors are set for all karts.
+    if (UserConfigParams::m_slipstream_debug)
+    {
+        m_nearby_karts.resize(num_karts);
+        for (unsigned int i = 0; i < num_karts; i++)
+            m_nearby_karts[i] = i;
+    }
+    else
+    {
+        world->getProximityIndex().getKartsInRange(m_kart->getXYZ(),
+                      world->getProximityIndex().getMaxSlipstreamReach() +
+                      0.5f*m_kart->getKartLength(), &m_nearby_karts);
+        if (m_previous_target_id >= 0)
+        {
+            auto it = std::lower_bound(m_nearby_karts.begin(),
+                                       m_nearby_karts.end(),
+                                       (unsigned int)m_previous_target_id);
+            if (it == m_nearby_karts.end() ||
+                *it != (unsigned int)m_previous_target_id)
+                m_nearby_karts.insert(it, m_previous_target_id);
+        }
+    }
+    for (unsigned int i : m_nearby_karts)
     {
         m_target_kart= world->getKart(i);
-        target_value.push_back(0);
 
         // Don't test for slipstream with itself, a kart that is being
         // rescued or exploding, a ghost kart or an eliminated kart
@@ -1024,7 +1048,7 @@ void SlipStream::update(int ticks)
             is_outer_sstreaming     = true;
             continue;
         }
-    }   // for i < num_karts
+    }   // for i in m_nearby_karts
 
     int best_target=-1;
     float best_target_value=0.0f;
@@ -1043,6 +1067,12 @@ void SlipStream::update(int ticks)
     {
         m_target_kart = world->getKart(best_target);
     }
+    else if (num_karts > 0)
+    {
+        // Without a target the loop over all karts used to leave the last
+        // kart as target, which the AI and the debug colors still use
+        m_target_kart = world->getKart(num_karts - 1);
+    }
 
     //When changing slipstream target (including no good target)
     if (best_target!=m_current_target_id)
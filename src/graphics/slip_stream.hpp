@@ -36,6 +36,7 @@ namespace SP
 #include "graphics/moving_texture.hpp"
 #include "utils/no_copy.hpp"
 #include <memory>
+#include <vector>
 
 class AbstractKart;
 class Quad;
@@ -97,6 +98,10 @@ private:
     int          m_speed_increase_ticks;
     int          m_speed_increase_duration;
 
+    /** The karts which are tested for slipstream in update(), kept to
+     *  avoid allocations. */
+    std::vector<unsigned int> m_nearby_karts;
+
     /** Slipstream mode: either nothing happening, or the kart is collecting
      *  'slipstream credits'. Credits can be accumulated while the bonus is used */
     enum         {SS_NONE, SS_COLLECT} m_slipstream_mode;
@@ -31,6 +31,8 @@
 #include "graphics/rtts.hpp"
 #include "graphics/shaders.hpp"
 #include "graphics/skybox.hpp"
+#include "graphics/sp/sp_culling.hpp"
+#include "graphics/sp/sp_draw_list.hpp"
 #include "graphics/sp/sp_dynamic_draw_call.hpp"
 #include "graphics/sp/sp_instanced_data.hpp"
 #include "graphics/sp/sp_per_object_uniform.hpp"
@@ -53,8 +55,6 @@
 #include <cassert>
 #include <functional>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include <ge_main.hpp>
@@ -84,20 +84,64 @@ SPShader* g_normal_visualizer = NULL;
 // ----------------------------------------------------------------------------
 SPShader* g_glow_shader = NULL;
 // ----------------------------------------------------------------------------
-// std::string is layer_1 and layer_2 texture name combined
-typedef std::unordered_map<SPShader*, std::unordered_map<std::string,
-    std::unordered_set<SPMeshBuffer*> > > DrawCall;
-
-DrawCall g_draw_calls[DCT_FOR_VAO];
+// Number of the current frame for SPDrawIndex, 0 is never used
+unsigned g_draw_frame = 0;
 // ----------------------------------------------------------------------------
-std::vector<std::pair<SPShader*, std::vector<std::pair<std::array<GLuint, 6>,
-    std::vector<std::pair<SPMeshBuffer*, int/*material_id*/> > > > > >
-    g_final_draw_calls[DCT_FOR_VAO];
+// All shaders and mesh buffers (which need their instance data uploaded)
+// used in this frame, indexed by their SPDrawIndex
+std::vector<SPShader*> g_draw_shaders;
+std::vector<SPMeshBuffer*> g_draw_mesh_buffers;
 // ----------------------------------------------------------------------------
-std::unordered_map<unsigned, std::pair<core::vector3df,
-    std::unordered_set<SPMeshBuffer*> > > g_glow_meshes;
+SPDrawList g_draw_calls[DCT_FOR_VAO];
 // ----------------------------------------------------------------------------
-std::unordered_set<SPMeshBuffer*> g_instances;
+/** The sorted draw calls of one draw call type in flat arrays: each shader
+ *  has a range of texture sets, and each texture set a range of mesh
+ *  buffers, given by the index of their first element. */
+struct FinalDrawCalls
+{
+    std::vector<std::pair<SPShader*, unsigned/*first_texture*/> > m_shaders;
+    std::vector<std::pair<std::array<GLuint, 6>,
+        unsigned/*first_mesh_buffer*/> > m_textures;
+    std::vector<std::pair<SPMeshBuffer*, int/*material_id*/> >
+        m_mesh_buffers;
+    // ------------------------------------------------------------------------
+    void clear()
+    {
+        m_shaders.clear();
+        m_textures.clear();
+        m_mesh_buffers.clear();
+    }
+    // ------------------------------------------------------------------------
+    unsigned getTextureEnd(unsigned shader) const
+    {
+        return shader + 1 < m_shaders.size() ?
+            m_shaders[shader + 1].second : (unsigned)m_textures.size();
+    }
+    // ------------------------------------------------------------------------
+    unsigned getMeshBufferEnd(unsigned texture) const
+    {
+        return texture + 1 < m_textures.size() ?
+            m_textures[texture + 1].second : (unsigned)m_mesh_buffers.size();
+    }
+};
+
+FinalDrawCalls g_final_draw_calls[DCT_FOR_VAO];
+// ----------------------------------------------------------------------------
+// The glow color in the upper 32 bits and the mesh buffer index
+SPDrawList g_glow_meshes;
+// ----------------------------------------------------------------------------
+/** A mesh buffer of a node added in this frame, its bounding box has the
+ *  same index in g_culling. */
+struct CullingEntry
+{
+    SPMeshNode* m_node;
+    SPMeshBuffer* m_mesh_buffer;
+    SPShader* m_shader;
+    unsigned m_mesh_buffer_id;
+    bool m_handle_shadow;
+};
+std::vector<CullingEntry> g_culling_entries;
+SPCulling g_culling;
 // ----------------------------------------------------------------------------
 std::array<GLuint, ST_COUNT> g_samplers = {{ }};
 // ----------------------------------------------------------------------------
@@ -762,6 +806,12 @@ void prepareDrawCalls()
             g_stk_sbr->getShadowMatrices()->getSunOrthoMatrices()[3]);
     }
 
+    if (++g_draw_frame == 0)
+    {
+        g_draw_frame = 1;
+    }
+    g_draw_shaders.clear();
+    g_draw_mesh_buffers.clear();
     for (auto& p : g_draw_calls)
     {
         p.clear();
@@ -771,9 +821,38 @@ void prepareDrawCalls()
         p.clear();
     }
     g_glow_meshes.clear();
-    g_instances.clear();
+    g_culling_entries.clear();
+    g_culling.clear();
 }
 
+// ----------------------------------------------------------------------------
+/** Adds a mesh buffer to the draw calls of a draw call type, once for each
+ *  of its texture sets (or only once if the shader doesn't use mesh
+ *  samplers).
+ *  \return The index of the mesh buffer in this frame.
+ */
+unsigned addDrawCall(DrawCallType dct, SPShader* shader, SPMeshBuffer* mb,
+                     bool sampler_less)
+{
+    const unsigned shader_index =
+        shader->getDrawIndex().get(g_draw_frame, shader, &g_draw_shaders);
+    const unsigned mb_index =
+        mb->getDrawIndex().get(g_draw_frame, mb, &g_draw_mesh_buffers);
+    const int priority = shader->getDrawingPriority();
+    if (sampler_less)
+    {
+        g_draw_calls[dct].add(SPDrawList::makeKey(priority, shader_index,
+            SPDrawList::getTextureSetID(""), mb_index));
+        return mb_index;
+    }
+    for (auto& p : mb->getTextureSets())
+    {
+        g_draw_calls[dct].add(SPDrawList::makeKey(priority, shader_index,
+            p.first, mb_index));
+    }
+    return mb_index;
+}   // addDrawCall
+
 // ----------------------------------------------------------------------------
 void addObject(SPMeshNode* node)
 {
@@ -788,7 +867,6 @@ void addObject(SPMeshNode* node)
     }
 
     const core::matrix4& model_matrix = node->getAbsoluteTransformation();
-    bool added_for_skinning = false;
     for (unsigned m = 0; m < node->getSPM()->getMeshBufferCount(); m++)
     {
         SPMeshBuffer* mb = node->getSPM()->getSPMeshBuffer(m);
@@ -799,45 +877,58 @@ void addObject(SPMeshNode* node)
         }
         core::aabbox3df bb = mb->getBoundingBox();
         model_matrix.transformBoxEx(bb);
-        std::vector<bool> discard;
-        const bool handle_shadow = node->isInShadowPass() &&
-            g_handle_shadow && shader->hasShader(RP_SHADOW);
-        discard.resize((handle_shadow ? 5 : 1), false);
+        CullingEntry entry;
+        entry.m_node = node;
+        entry.m_mesh_buffer = mb;
+        entry.m_shader = shader;
+        entry.m_mesh_buffer_id = m;
+        entry.m_handle_shadow = node->isInShadowPass() && g_handle_shadow &&
+            shader->hasShader(RP_SHADOW);
+        g_culling_entries.push_back(entry);
+        g_culling.add(bb);
+    }
+}   // addObject
 
-        for (int dc_type = 0; dc_type < (handle_shadow ? 5 : 1); dc_type++)
+// ----------------------------------------------------------------------------
+/** Culls the mesh buffers of all nodes added in this frame against the
+ *  camera and the shadow cascades (done in parallel, see SPCulling), and
+ *  adds the draw calls of the visible ones in the order of addObject.
+ */
+void cullObjects()
+{
+    if (!sp_culling)
+    {
+        return;
+    }
+
+    g_culling.cull(g_frustums, g_handle_shadow ? 5 : 1);
+    SPMeshNode* skinning_node = NULL;
+    SPMeshNode* skip_node = NULL;
+    for (unsigned i = 0; i < g_culling_entries.size(); i++)
+    {
+        const CullingEntry& entry = g_culling_entries[i];
+        SPMeshNode* node = entry.m_node;
+        if (node == skip_node)
         {
-            for (int i = 0; i < 24; i += 4)
-            {
-                bool outside = true;
-                for (int j = 0; j < 8; j++)
-                {
-                    const float dist =
-                        getCorner(bb, j).X * g_frustums[dc_type][i] +
-                        getCorner(bb, j).Y * g_frustums[dc_type][i + 1] +
-                        getCorner(bb, j).Z * g_frustums[dc_type][i + 2] +
-                        g_frustums[dc_type][i + 3];
-                    outside = outside && dist < 0.0f;
-                    if (!outside)
-                    {
-                        break;
-                    }
-                }
-                if (outside)
-                {
-                    discard[dc_type] = true;
-                    break;
-                }
-            }
+            continue;
         }
-        if (handle_shadow ?
-            (discard[0] && discard[1] && discard[2] && discard[3] &&
-            discard[4]) : discard[0])
+        SPMeshBuffer* mb = entry.m_mesh_buffer;
+        SPShader* shader = entry.m_shader;
+        const unsigned m = entry.m_mesh_buffer_id;
+        const int dc_count = entry.m_handle_shadow ? 5 : 1;
+        bool visible = false;
+        for (int dc_type = 0; dc_type < dc_count; dc_type++)
+        {
+            visible = visible || g_culling.isVisible(i, dc_type);
+        }
+        if (!visible)
         {
             continue;
         }
 
         if (irr_driver->getBoundingBoxesViz())
         {
+            const core::aabbox3df bb = g_culling.getBox(i);
             addEdgeForViz(getCorner(bb, 0), getCorner(bb, 1));
             addEdgeForViz(getCorner(bb, 1), getCorner(bb, 5));
             addEdgeForViz(getCorner(bb, 5), getCorner(bb, 4));
@@ -854,16 +945,17 @@ void addObject(SPMeshNode* node)
 
         mb->uploadGLMesh();
         // For first frame only need the vbo to be initialized
-        if (!added_for_skinning && node->getAnimationState())
+        if (skinning_node != node && node->getAnimationState())
         {
-            added_for_skinning = true;
+            skinning_node = node;
             int skinning_offset = g_skinning_offset + node->getTotalJoints();
             if (skinning_offset > int(stk_config->m_max_skinning_bones))
             {
                 Log::error("SPBase", "No enough space to render skinned"
                     " mesh %s! Max joints can hold: %d",
                     node->getName(), stk_config->m_max_skinning_bones);
-                return;
+                skip_node = node;
+                continue;
             }
             node->setSkinningOffset(g_skinning_offset);
             g_skinning_mesh.push_back(node);
@@ -877,9 +969,9 @@ void addObject(SPMeshNode* node)
             node->getTextureMatrix(m)[1], hue,
             (short)node->getSkinningOffset());
 
-        for (int dc_type = 0; dc_type < (handle_shadow ? 5 : 1); dc_type++)
+        for (int dc_type = 0; dc_type < dc_count; dc_type++)
         {
-            if (discard[dc_type])
+            if (!g_culling.isVisible(i, dc_type))
             {
                 continue;
             }
@@ -897,11 +989,8 @@ void addObject(SPMeshNode* node)
                 // All transparent draw calls go DCT_TRANSPARENT
                 if (dc_type == 0)
                 {
-                    auto& ret = g_draw_calls[DCT_TRANSPARENT][shader];
-                    for (auto& p : mb->getTextureCompare())
-                    {
-                        ret[p.first].insert(mb);
-                    }
+                    addDrawCall(DCT_TRANSPARENT, shader, mb,
+                        false/*sampler_less*/);
                     mb->addInstanceData(id, DCT_TRANSPARENT);
                 }
                 else
@@ -914,39 +1003,19 @@ void addObject(SPMeshNode* node)
                 // Check if shader for render pass uses mesh samplers
                 const RenderPass check_pass =
                     dc_type == DCT_NORMAL ? RP_1ST : RP_SHADOW;
-                const bool sampler_less = shader->samplerLess(check_pass);
-                auto& ret = g_draw_calls[dc_type][shader];
-                if (sampler_less)
-                {
-                    ret[""].insert(mb);
-                }
-                else
-                {
-                    for (auto& p : mb->getTextureCompare())
-                    {
-                        ret[p.first].insert(mb);
-                    }
-                }
+                const unsigned mb_index = addDrawCall((DrawCallType)dc_type,
+                    shader, mb, shader->samplerLess(check_pass));
                 mb->addInstanceData(id, (DrawCallType)dc_type);
                 if (UserConfigParams::m_glow && node->hasGlowColor() &&
                     CVS->isDeferredEnabled() && dc_type == DCT_NORMAL)
                 {
-                    video::SColorf gc = node->getGlowColor();
-                    unsigned key = gc.toSColor().color;
-                    auto ret = g_glow_meshes.find(key);
-                    if (ret == g_glow_meshes.end())
-                    {
-                        g_glow_meshes[key] = std::make_pair(
-                            core::vector3df(gc.r, gc.g, gc.b),
-                            std::unordered_set<SPMeshBuffer*>());
-                    }
-                    g_glow_meshes.at(key).second.insert(mb);
+                    uint64_t key = node->getGlowColor().toSColor().color;
+                    g_glow_meshes.add(key << 32 | mb_index);
                 }
             }
-            g_instances.insert(mb);
         }
     }
-}
+}   // cullObjects
 
 // ----------------------------------------------------------------------------
 void handleDynamicDrawCall()
@@ -958,7 +1027,8 @@ void handleDynamicDrawCall()
         {
             // They need to be updated independent of culling result
             // otherwise some data will be missed if offset update is used
-            g_instances.insert(dydc);
+            dydc->getDrawIndex().get<SPMeshBuffer>(g_draw_frame, dydc,
+                &g_draw_mesh_buffers);
         }
         if (!dydc->isVisible() || dydc->notReadyFromDrawing() ||
             dydc->isRemoving() || !sp_culling)
@@ -975,28 +1045,7 @@ void handleDynamicDrawCall()
         discard.resize((handle_shadow ? 5 : 1), false);
         for (int dc_type = 0; dc_type < (handle_shadow ? 5 : 1); dc_type++)
         {
-            for (int i = 0; i < 24; i += 4)
-            {
-                bool outside = true;
-                for (int j = 0; j < 8; j++)
-                {
-                    const float dist =
-                        getCorner(bb, j).X * g_frustums[dc_type][i] +
-                        getCorner(bb, j).Y * g_frustums[dc_type][i + 1] +
-                        getCorner(bb, j).Z * g_frustums[dc_type][i + 2] +
-                        g_frustums[dc_type][i + 3];
-                    outside = outside && dist < 0.0f;
-                    if (!outside)
-                    {
-                        break;
-                    }
-                }
-                if (outside)
-                {
-                    discard[dc_type] = true;
-                    break;
-                }
-            }
+            discard[dc_type] = isOutsideFrustum(bb, g_frustums[dc_type]);
         }
         if (handle_shadow ?
             (discard[0] && discard[1] && discard[2] && discard[3] &&
@@ -1041,11 +1090,8 @@ void handleDynamicDrawCall()
                 // All transparent draw calls go DCT_TRANSPARENT
                 if (dc_type == 0)
                 {
-                    auto& ret = g_draw_calls[DCT_TRANSPARENT][shader];
-                    for (auto& p : dydc->getTextureCompare())
-                    {
-                        ret[p.first].insert(dydc);
-                    }
+                    addDrawCall(DCT_TRANSPARENT, shader, dydc,
+                        false/*sampler_less*/);
                 }
                 else
                 {
@@ -1057,19 +1103,8 @@ void handleDynamicDrawCall()
                 // Check if shader for render pass uses mesh samplers
                 const RenderPass check_pass =
                     dc_type == DCT_NORMAL ? RP_1ST : RP_SHADOW;
-                const bool sampler_less = shader->samplerLess(check_pass);
-                auto& ret = g_draw_calls[dc_type][shader];
-                if (sampler_less)
-                {
-                    ret[""].insert(dydc);
-                }
-                else
-                {
-                    for (auto& p : dydc->getTextureCompare())
-                    {
-                        ret[p.first].insert(dydc);
-                    }
-                }
+                addDrawCall((DrawCallType)dc_type, shader, dydc,
+                    shader->samplerLess(check_pass));
             }
         }
     }
@@ -1088,47 +1123,35 @@ void updateModelMatrix()
 
     for (unsigned i = 0; i < DCT_FOR_VAO; i++)
     {
-        DrawCall* dc = &g_draw_calls[(DrawCallType)i];
-        // Sort dc based on the drawing priority of shaders
-        // The larger the drawing priority int, the last it will be drawn
-        using DrawCallPair = std::pair<SPShader*,
-            std::unordered_map<std::string,
-            std::unordered_set<SPMeshBuffer*> > >;
-        std::vector<DrawCallPair> sorted_dc;
-        for (auto& p : *dc)
-        {
-            sorted_dc.push_back(p);
-        }
-        std::sort(sorted_dc.begin(), sorted_dc.end(),
-            [](const DrawCallPair& a, const DrawCallPair& b)->bool
-            {
-                return a.first->getDrawingPriority() <
-                    b.first->getDrawingPriority();
-            });
-        for (unsigned dc = 0; dc < sorted_dc.size(); dc++)
+        // After sorting the draw calls are ordered by the drawing priority
+        // of shaders (the larger the drawing priority int, the last it will
+        // be drawn), and grouped by shader and texture set
+        SPDrawList& dc = g_draw_calls[i];
+        dc.sort();
+        FinalDrawCalls& fdc = g_final_draw_calls[i];
+        const std::vector<uint64_t>& keys = dc.getKeys();
+        int material_id = -1;
+        for (unsigned k = 0; k < keys.size(); k++)
         {
-            auto& p = sorted_dc[dc];
-            g_final_draw_calls[i].emplace_back(p.first,
-            std::vector<std::pair<std::array<GLuint, 6>,
-                std::vector<std::pair<SPMeshBuffer*, int> > > >());
-
-            unsigned texture = 0;
-            for (auto& q : p.second)
+            const uint64_t key = keys[k];
+            SPMeshBuffer* spmb =
+                g_draw_mesh_buffers[SPDrawList::getMeshBuffer(key)];
+            const unsigned texture_set = SPDrawList::getTextureSet(key);
+            if (k == 0 || !SPDrawList::sameBatch(keys[k - 1], key))
             {
-                if (q.second.empty())
+                const unsigned shader = SPDrawList::getShader(key);
+                if (k == 0 || SPDrawList::getShader(keys[k - 1]) != shader)
                 {
-                    continue;
+                    fdc.m_shaders.emplace_back(g_draw_shaders[shader],
+                        (unsigned)fdc.m_textures.size());
                 }
                 std::array<GLuint, 6> texture_names =
                     {{ 0, 0, 0, 0, 0, 0 }};
-                int material_id =
-                    (*(q.second.begin()))->getMaterialID(q.first);
-
+                material_id = spmb->getMaterialID(texture_set);
                 if (material_id != -1)
                 {
                     const std::array<std::shared_ptr<SPTexture>, 6>& textures =
-                        (*(q.second.begin()))->getSPTexturesByMaterialID
-                        (material_id);
+                        spmb->getSPTexturesByMaterialID(material_id);
                     texture_names =
                         {{
                             textures[0]->getTextureHandler(),
@@ -1139,19 +1162,14 @@ void updateModelMatrix()
                             textures[5]->getTextureHandler()
                         }};
                 }
-                g_final_draw_calls[i][dc].second.emplace_back
-                    (texture_names,
-                    std::vector<std::pair<SPMeshBuffer*, int> >());
-                for (SPMeshBuffer* spmb : q.second)
-                {
-                    g_final_draw_calls[i][dc].second[texture].second.push_back
-                        (std::make_pair(spmb, material_id == -1 ?
-                        -1 : spmb->getMaterialID(q.first)));
-                }
-                texture++;
+                fdc.m_textures.emplace_back(texture_names,
+                    (unsigned)fdc.m_mesh_buffers.size());
             }
+            fdc.m_mesh_buffers.emplace_back(spmb, material_id == -1 ?
+                -1 : spmb->getMaterialID(texture_set));
         }
     }
+    g_glow_meshes.sort();
 }
 
 // ----------------------------------------------------------------------------
@@ -1220,7 +1238,7 @@ void uploadAll()
         g_stk_sbr->getShadowMatrices()->getMatricesData());
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    for (SPMeshBuffer* spmb : g_instances)
+    for (SPMeshBuffer* spmb : g_draw_mesh_buffers)
     {
         spmb->uploadInstanceData();
     }
@@ -1241,37 +1259,21 @@ void drawSPDebugView()
     }
     g_normal_visualizer->use();
     g_normal_visualizer->bindPrefilledTextures();
-    for (unsigned i = 0; i < g_final_draw_calls[0].size(); i++)
+    for (auto& p : g_final_draw_calls[DCT_NORMAL].m_mesh_buffers)
     {
-        auto& p = g_final_draw_calls[0][i];
-        for (unsigned j = 0; j < p.second.size(); j++)
-        {
-            for (unsigned k = 0; k < p.second[j].second.size(); k++)
-            {
-                // Make sure tangents and joints are not drawn undefined
-                glVertexAttrib4f(5, 0.0f, 0.0f, 0.0f, 0.0f);
-                glVertexAttribI4i(6, 0, 0, 0, 0);
-                glVertexAttrib4f(7, 0.0f, 0.0f, 0.0f, 0.0f);
-                p.second[j].second[k].first->draw(DCT_NORMAL,
-                    -1/*material_id*/);
-            }
-        }
+        // Make sure tangents and joints are not drawn undefined
+        glVertexAttrib4f(5, 0.0f, 0.0f, 0.0f, 0.0f);
+        glVertexAttribI4i(6, 0, 0, 0, 0);
+        glVertexAttrib4f(7, 0.0f, 0.0f, 0.0f, 0.0f);
+        p.first->draw(DCT_NORMAL, -1/*material_id*/);
     }
-    for (unsigned i = 0; i < g_final_draw_calls[5].size(); i++)
+    for (auto& p : g_final_draw_calls[DCT_TRANSPARENT].m_mesh_buffers)
     {
-        auto& p = g_final_draw_calls[5][i];
-        for (unsigned j = 0; j < p.second.size(); j++)
-        {
-            for (unsigned k = 0; k < p.second[j].second.size(); k++)
-            {
-                // Make sure tangents and joints are not drawn undefined
-                glVertexAttrib4f(5, 0.0f, 0.0f, 0.0f, 0.0f);
-                glVertexAttribI4i(6, 0, 0, 0, 0);
-                glVertexAttrib4f(7, 0.0f, 0.0f, 0.0f, 0.0f);
-                p.second[j].second[k].first->draw(DCT_TRANSPARENT,
-                    -1/*material_id*/);
-            }
-        }
+        // Make sure tangents and joints are not drawn undefined
+        glVertexAttrib4f(5, 0.0f, 0.0f, 0.0f, 0.0f);
+        glVertexAttribI4i(6, 0, 0, 0, 0);
+        glVertexAttrib4f(7, 0.0f, 0.0f, 0.0f, 0.0f);
+        p.first->draw(DCT_TRANSPARENT, -1/*material_id*/);
     }
     g_normal_visualizer->unuse();
 }
@@ -1287,13 +1289,17 @@ void drawGlow()
     SPUniformAssigner* glow_color_assigner =
         g_glow_shader->getUniformAssigner("col");
     assert(glow_color_assigner != NULL);
-    for (auto& p : g_glow_meshes)
+    const std::vector<uint64_t>& keys = g_glow_meshes.getKeys();
+    for (unsigned i = 0; i < keys.size(); i++)
     {
-        glow_color_assigner->setValue(p.second.first);
-        for (SPMeshBuffer* spmb : p.second.second)
+        const uint32_t color = (uint32_t)(keys[i] >> 32);
+        if (i == 0 || (uint32_t)(keys[i - 1] >> 32) != color)
         {
-            spmb->draw(DCT_NORMAL, -1/*material_id*/);
+            const video::SColorf gc = video::SColor(color);
+            glow_color_assigner->setValue(core::vector3df(gc.r, gc.g, gc.b));
         }
+        g_draw_mesh_buffers[(uint32_t)keys[i]]->draw(DCT_NORMAL,
+            -1/*material_id*/);
     }
     g_glow_shader->unuse();
 }
@@ -1309,38 +1315,40 @@ void draw(RenderPass rp, DrawCallType dct)
         (uint8_t)(float(rp + 1) / (float)RP_COUNT * 255.0f));
 
     assert(dct < DCT_FOR_VAO);
-    for (unsigned i = 0; i < g_final_draw_calls[dct].size(); i++)
+    const FinalDrawCalls& fdc = g_final_draw_calls[dct];
+    for (unsigned i = 0; i < fdc.m_shaders.size(); i++)
     {
-        auto& p = g_final_draw_calls[dct][i];
-        if (!p.first->hasShader(rp))
+        SPShader* shader = fdc.m_shaders[i].first;
+        if (!shader->hasShader(rp))
         {
             continue;
         }
-        p.first->use(rp);
+        shader->use(rp);
         static std::vector<SPUniformAssigner*> shader_uniforms;
-        p.first->setUniformsPerObject(static_cast<SPPerObjectUniform*>
-            (p.first), &shader_uniforms, rp);
-        p.first->bindPrefilledTextures(rp);
-        for (unsigned j = 0; j < p.second.size(); j++)
+        shader->setUniformsPerObject(static_cast<SPPerObjectUniform*>
+            (shader), &shader_uniforms, rp);
+        shader->bindPrefilledTextures(rp);
+        for (unsigned j = fdc.m_shaders[i].second; j < fdc.getTextureEnd(i);
+             j++)
         {
-            p.first->bindTextures(p.second[j].first, rp);
-            for (unsigned k = 0; k < p.second[j].second.size(); k++)
+            shader->bindTextures(fdc.m_textures[j].first, rp);
+            for (unsigned k = fdc.m_textures[j].second;
+                 k < fdc.getMeshBufferEnd(j); k++)
             {
+                const auto& mb = fdc.m_mesh_buffers[k];
                 static std::vector<SPUniformAssigner*> draw_call_uniforms;
-                p.first->setUniformsPerObject(static_cast<SPPerObjectUniform*>
-                    (p.second[j].second[k].first), &draw_call_uniforms, rp);
-                p.second[j].second[k].first->draw(dct,
-                    p.second[j].second[k].second/*material_id*/);
-                if (p.first->getName().rfind("ghost", 0) == 0)
+                shader->setUniformsPerObject(static_cast<SPPerObjectUniform*>
+                    (mb.first), &draw_call_uniforms, rp);
+                mb.first->draw(dct, mb.second/*material_id*/);
+                if (shader->getName().rfind("ghost", 0) == 0)
                 {
                     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
                     glEnable(GL_BLEND);
                     glBlendEquation(GL_FUNC_ADD);
                     glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
                     glDepthMask(GL_FALSE);
-                    p.second[j].second[k].first->draw(dct,
-                        p.second[j].second[k].second/*material_id*/);
-                    p.first->use(rp);
+                    mb.first->draw(dct, mb.second/*material_id*/);
+                    shader->use(rp);
                 }
                 for (SPUniformAssigner* ua : draw_call_uniforms)
                 {
@@ -1354,7 +1362,7 @@ void draw(RenderPass rp, DrawCallType dct)
             ua->reset();
         }
         shader_uniforms.clear();
-        p.first->unuse(rp);
+        shader->unuse(rp);
     }
     PROFILER_POP_CPU_MARKER();
 }   // draw
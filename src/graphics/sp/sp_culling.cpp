@@ -0,0 +1,285 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/sp/sp_culling.hpp"
+#include "utils/log.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#if __SSE2__ || _M_X64 || _M_IX86_FP >= 2
+ #include <emmintrin.h>
+ #define SIMD_SSE2_SUPPORT (1)
+#endif
+
+namespace SP
+{
+
+// ----------------------------------------------------------------------------
+/** Returns true if the box is completely outside of one of the 6 planes of
+ *  the frustum (24 floats, the normal and distance of each plane pointing
+ *  into the frustum).
+ */
+bool isOutsideFrustum(const irr::core::aabbox3df& bb, const float* frustum)
+{
+    for (int i = 0; i < 24; i += 4)
+    {
+        bool outside = true;
+        for (int j = 0; j < 8; j++)
+        {
+            const float dist =
+                ((j & 1) ? bb.MaxEdge.X : bb.MinEdge.X) * frustum[i] +
+                ((j & 2) ? bb.MaxEdge.Y : bb.MinEdge.Y) * frustum[i + 1] +
+                ((j & 4) ? bb.MaxEdge.Z : bb.MinEdge.Z) * frustum[i + 2] +
+                frustum[i + 3];
+            outside = outside && dist < 0.0f;
+            if (!outside)
+            {
+                break;
+            }
+        }
+        if (outside)
+        {
+            return true;
+        }
+    }
+    return false;
+}   // isOutsideFrustum
+
+// ----------------------------------------------------------------------------
+/** Adds a box to be culled, and returns its index. The arrays only grow, so
+ *  no memory is allocated once the number of boxes per frame is stable.
+ */
+unsigned SPCulling::add(const irr::core::aabbox3df& bb)
+{
+    if (m_num_boxes >= m_min_x.size())
+    {
+        // Keep a multiple of 4 boxes, so SIMD can always load 4 boxes
+        const size_t size = ((m_num_boxes + 1) * 2 + 3) & ~(size_t)3;
+        m_min_x.resize(size, 0.0f);
+        m_min_y.resize(size, 0.0f);
+        m_min_z.resize(size, 0.0f);
+        m_max_x.resize(size, 0.0f);
+        m_max_y.resize(size, 0.0f);
+        m_max_z.resize(size, 0.0f);
+        for (unsigned i = 0; i < MAX_FRUSTUMS; i++)
+            m_visible[i].resize((size + 31) / 32, 0);
+    }
+    m_min_x[m_num_boxes] = bb.MinEdge.X;
+    m_min_y[m_num_boxes] = bb.MinEdge.Y;
+    m_min_z[m_num_boxes] = bb.MinEdge.Z;
+    m_max_x[m_num_boxes] = bb.MaxEdge.X;
+    m_max_y[m_num_boxes] = bb.MaxEdge.Y;
+    m_max_z[m_num_boxes] = bb.MaxEdge.Z;
+    return m_num_boxes++;
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Culls the boxes of one block against all frustums. For each plane only
+ *  the corner which is furthest in the direction of the plane normal is
+ *  tested (if it is behind the plane all corners are), which is selected
+ *  with the sign of the normal, so it is the same for all boxes. The
+ *  distance is computed in the same order as in isOutsideFrustum, so the
+ *  result is exactly the same.
+ */
+void SPCulling::cullBlock(unsigned block, const float (*frustums)[24],
+                          unsigned num_frustums)
+{
+    const unsigned start = block * BLOCK_SIZE;
+    const unsigned end = std::min(start + BLOCK_SIZE, m_num_boxes);
+    for (unsigned f = 0; f < num_frustums; f++)
+    {
+        const float* frustum = frustums[f];
+        const float* x[6];
+        const float* y[6];
+        const float* z[6];
+        for (unsigned p = 0; p < 6; p++)
+        {
+            x[p] = frustum[p * 4] >= 0.0f ? &m_max_x[0] : &m_min_x[0];
+            y[p] = frustum[p * 4 + 1] >= 0.0f ? &m_max_y[0] : &m_min_y[0];
+            z[p] = frustum[p * 4 + 2] >= 0.0f ? &m_max_z[0] : &m_min_z[0];
+        }
+        for (unsigned word_start = start; word_start < end; word_start += 32)
+        {
+            const unsigned word_end = std::min(word_start + 32, end);
+            uint32_t visible = 0;
+#ifdef SIMD_SSE2_SUPPORT
+            for (unsigned i = word_start; i < word_end; i += 4)
+            {
+                __m128 outside = _mm_setzero_ps();
+                for (unsigned p = 0; p < 6; p++)
+                {
+                    __m128 dist = _mm_add_ps(
+                        _mm_mul_ps(_mm_loadu_ps(x[p] + i),
+                        _mm_set1_ps(frustum[p * 4])),
+                        _mm_mul_ps(_mm_loadu_ps(y[p] + i),
+                        _mm_set1_ps(frustum[p * 4 + 1])));
+                    dist = _mm_add_ps(dist,
+                        _mm_mul_ps(_mm_loadu_ps(z[p] + i),
+                        _mm_set1_ps(frustum[p * 4 + 2])));
+                    dist = _mm_add_ps(dist, _mm_set1_ps(frustum[p * 4 + 3]));
+                    outside = _mm_or_ps(outside,
+                        _mm_cmplt_ps(dist, _mm_setzero_ps()));
+                }
+                visible |= (uint32_t)(~_mm_movemask_ps(outside) & 15) <<
+                    (i - word_start);
+            }
+#else
+            for (unsigned i = word_start; i < word_end; i++)
+            {
+                bool outside = false;
+                for (unsigned p = 0; p < 6 && !outside; p++)
+                {
+                    const float dist = x[p][i] * frustum[p * 4] +
+                        y[p][i] * frustum[p * 4 + 1] +
+                        z[p][i] * frustum[p * 4 + 2] + frustum[p * 4 + 3];
+                    outside = dist < 0.0f;
+                }
+                if (!outside)
+                    visible |= 1u << (i - word_start);
+            }
+#endif
+            // Clear the bits of the padding boxes
+            if (word_end - word_start < 32)
+                visible &= (1u << (word_end - word_start)) - 1;
+            m_visible[f][word_start / 32] = visible;
+        }
+    }
+}   // cullBlock
+
+// ----------------------------------------------------------------------------
+/** Culls all boxes against the first num_frustums frustums. The blocks of
+ *  boxes are shared by the WorkerPool threads and the calling thread.
+ */
+void SPCulling::cull(const float (*frustums)[24], unsigned num_frustums)
+{
+    assert(num_frustums <= MAX_FRUSTUMS);
+    const unsigned num_blocks = (m_num_boxes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (num_blocks < 2)
+    {
+        if (num_blocks == 1)
+            cullBlock(0, frustums, num_frustums);
+        return;
+    }
+    WorkerPool::get()->parallelFor(num_blocks,
+        [this, frustums, num_frustums](unsigned block)
+        {
+            cullBlock(block, frustums, num_frustums);
+        });
+}   // cull
+
+// ----------------------------------------------------------------------------
+/** Culls all boxes one by one with isOutsideFrustum on the calling thread.
+ *  Used to check the results of cull().
+ */
+void SPCulling::cullScalar(const float (*frustums)[24], unsigned num_frustums)
+{
+    assert(num_frustums <= MAX_FRUSTUMS);
+    for (unsigned f = 0; f < num_frustums; f++)
+    {
+        for (unsigned i = 0; i < m_num_boxes; i += 32)
+            m_visible[f][i / 32] = 0;
+        for (unsigned i = 0; i < m_num_boxes; i++)
+        {
+            irr::core::aabbox3df bb(m_min_x[i], m_min_y[i], m_min_z[i],
+                                    m_max_x[i], m_max_y[i], m_max_z[i]);
+            if (!isOutsideFrustum(bb, frustums[f]))
+                m_visible[f][i / 32] |= 1u << (i % 32);
+        }
+    }
+}   // cullScalar
+
+// ----------------------------------------------------------------------------
+void SPCulling::unitTesting()
+{
+    std::mt19937 g(11);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.0f, 20.0f);
+    std::uniform_real_distribution<float> normal(-1.0f, 1.0f);
+
+    SPCulling culling;
+    std::vector<bool> expected;
+    for (unsigned num = 0; num < 2000; num = num * 3 + 7)
+    {
+        float frustums[MAX_FRUSTUMS][24];
+        for (unsigned f = 0; f < MAX_FRUSTUMS; f++)
+        {
+            for (unsigned p = 0; p < 6; p++)
+            {
+                float* plane = &frustums[f][p * 4];
+                for (unsigned i = 0; i < 3; i++)
+                {
+                    // Some planes along the axes, to test zero components
+                    plane[i] = g() % 4 == 0 ? 0.0f : normal(g);
+                }
+                const float length = sqrtf(plane[0] * plane[0] +
+                    plane[1] * plane[1] + plane[2] * plane[2]);
+                if (length > 0.0f)
+                {
+                    for (unsigned i = 0; i < 3; i++)
+                        plane[i] /= length;
+                }
+                plane[3] = pos(g);
+            }
+        }
+
+        culling.clear();
+        for (unsigned i = 0; i < num; i++)
+        {
+            irr::core::vector3df min(pos(g), pos(g), pos(g));
+            irr::core::vector3df max = min +
+                irr::core::vector3df(size(g), size(g), size(g));
+            // Some boxes touching a plane of the first frustum
+            if (i % 5 == 0 && frustums[0][0] != 0.0f)
+            {
+                min.X = max.X = -(frustums[0][1] * min.Y +
+                    frustums[0][2] * min.Z + frustums[0][3]) /
+                    frustums[0][0];
+            }
+            if (culling.add(irr::core::aabbox3df(min, max)) != i)
+                Log::fatal("SPCulling", "Invalid box index.");
+        }
+        if (culling.size() != num)
+            Log::fatal("SPCulling", "Invalid number of boxes.");
+
+        culling.cullScalar(frustums, MAX_FRUSTUMS);
+        expected.clear();
+        for (unsigned f = 0; f < MAX_FRUSTUMS; f++)
+        {
+            for (unsigned i = 0; i < num; i++)
+                expected.push_back(culling.isVisible(i, f));
+        }
+        culling.cull(frustums, MAX_FRUSTUMS);
+        for (unsigned f = 0; f < MAX_FRUSTUMS; f++)
+        {
+            for (unsigned i = 0; i < num; i++)
+            {
+                if (culling.isVisible(i, f) != expected[f * num + i])
+                {
+                    Log::fatal("SPCulling", "Box %u of %u is %s in frustum "
+                               "%u with the scalar culling.", i, num,
+                               expected[f * num + i] ? "visible" : "culled",
+                               f);
+                }
+            }
+        }
+    }
+}   // unitTesting
+
+}
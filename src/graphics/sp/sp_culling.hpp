@@ -0,0 +1,98 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_SP_CULLING_HPP
+#define HEADER_SP_CULLING_HPP
+
+#include "aabbox3d.h"
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace SP
+{
+
+bool isOutsideFrustum(const irr::core::aabbox3df& bb, const float* frustum);
+
+// ============================================================================
+/** Culls the bounding boxes of all mesh buffers of a frame against up to
+ *  5 frustums (the camera and the 4 shadow cascades, see g_frustums). The
+ *  boxes are stored as structure of arrays, so 4 boxes are tested against
+ *  a plane with one SSE instruction per value. The boxes are split in
+ *  blocks which are culled by the WorkerPool, and each block writes its
+ *  own words of one visibility bitmask per frustum, so the threads don't
+ *  need any synchronisation. The draw calls are then built in the original
+ *  order of the boxes, using the bitmasks.
+ */
+class SPCulling
+{
+public:
+    static const unsigned MAX_FRUSTUMS = 5;
+
+private:
+    /** Number of boxes culled by one work item, a multiple of 32 so
+     *  each block has its own words in the bitmasks. */
+    static const unsigned BLOCK_SIZE = 256;
+
+    std::vector<float> m_min_x, m_min_y, m_min_z;
+    std::vector<float> m_max_x, m_max_y, m_max_z;
+
+    /** One bit for each box, set if the box is (at least partially) inside
+     *  the frustum. */
+    std::vector<uint32_t> m_visible[MAX_FRUSTUMS];
+
+    unsigned m_num_boxes;
+
+    // ------------------------------------------------------------------------
+    void cullBlock(unsigned block, const float (*frustums)[24],
+                   unsigned num_frustums);
+
+public:
+    SPCulling() : m_num_boxes(0) {}
+    // ------------------------------------------------------------------------
+    void clear()                                         { m_num_boxes = 0; }
+    // ------------------------------------------------------------------------
+    unsigned add(const irr::core::aabbox3df& bb);
+    // ------------------------------------------------------------------------
+    void cull(const float (*frustums)[24], unsigned num_frustums);
+    // ------------------------------------------------------------------------
+    void cullScalar(const float (*frustums)[24], unsigned num_frustums);
+    // ------------------------------------------------------------------------
+    /** Returns the number of boxes added in this frame. */
+    unsigned size() const                               { return m_num_boxes; }
+    // ------------------------------------------------------------------------
+    irr::core::aabbox3df getBox(unsigned box) const
+    {
+        assert(box < m_num_boxes);
+        return irr::core::aabbox3df(m_min_x[box], m_min_y[box], m_min_z[box],
+                                    m_max_x[box], m_max_y[box], m_max_z[box]);
+    }   // getBox
+    // ------------------------------------------------------------------------
+    /** Returns if a box is visible in a frustum, after cull(). */
+    bool isVisible(unsigned box, unsigned frustum) const
+    {
+        assert(box < m_num_boxes && frustum < MAX_FRUSTUMS);
+        return (m_visible[frustum][box >> 5] >> (box & 31) & 1) != 0;
+    }   // isVisible
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // SPCulling
+
+}
+
+#endif
@@ -0,0 +1,339 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/sp/sp_draw_list.hpp"
+#include "utils/log.hpp"
+
+#ifndef SERVER_ONLY
+#include "graphics/sp/sp_culling.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <ge_main.hpp>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace SP
+{
+
+// ----------------------------------------------------------------------------
+/** Returns a small id for a set of textures (the names of the texture
+ *  layer 1 and 2 combined). The ids are assigned when meshes are loaded,
+ *  so the draw calls of a frame can be grouped by textures without
+ *  comparing strings. The empty string (used by shaders without mesh
+ *  samplers) has the id 0.
+ */
+unsigned SPDrawList::getTextureSetID(const std::string& textures)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::string, unsigned> all_ids = {{ "", 0 }};
+    std::lock_guard<std::mutex> lock(mutex);
+    auto ret = all_ids.find(textures);
+    if (ret != all_ids.end())
+        return ret->second;
+    const unsigned id = (unsigned)all_ids.size();
+    if (id >= (1u << TEXTURE_SET_BITS))
+    {
+        Log::error("SPDrawList", "Too many texture sets.");
+        return 0;
+    }
+    all_ids[textures] = id;
+    return id;
+}   // getTextureSetID
+
+// ----------------------------------------------------------------------------
+/** Sorts the keys with a LSD radix sort on 8 bit digits, and removes
+ *  duplicated keys (e.g. a mesh buffer used by several nodes, which is drawn
+ *  once with instancing). The digits which are the same for all keys (often
+ *  the priority and the upper bits of the indices) are skipped.
+ */
+void SPDrawList::sort()
+{
+    const size_t n = m_keys.size();
+    if (n < 64)
+    {
+        std::sort(m_keys.begin(), m_keys.end());
+    }
+    else
+    {
+        uint32_t count[8][256] = {};
+        for (uint64_t key : m_keys)
+        {
+            for (unsigned d = 0; d < 8; d++)
+                count[d][(key >> (d * 8)) & 0xff]++;
+        }
+        m_sort_buffer.resize(n);
+        uint64_t* src = m_keys.data();
+        uint64_t* dst = m_sort_buffer.data();
+        for (unsigned d = 0; d < 8; d++)
+        {
+            const unsigned shift = d * 8;
+            if (count[d][(src[0] >> shift) & 0xff] == n)
+                continue;
+            uint32_t offset[256];
+            uint32_t sum = 0;
+            for (unsigned i = 0; i < 256; i++)
+            {
+                offset[i] = sum;
+                sum += count[d][i];
+            }
+            for (size_t i = 0; i < n; i++)
+                dst[offset[(src[i] >> shift) & 0xff]++] = src[i];
+            std::swap(src, dst);
+        }
+        if (src != m_keys.data())
+            m_keys.swap(m_sort_buffer);
+    }
+    m_keys.erase(std::unique(m_keys.begin(), m_keys.end()), m_keys.end());
+}   // sort
+
+#ifndef SERVER_ONLY
+// ----------------------------------------------------------------------------
+/** Compares the speed of culling synthetic nodes one by one and with
+ *  SPCulling, and of batching them with the previous hash map based draw
+ *  call code and with the sorted draw list, without any rendering (so it
+ *  can be run without a GPU).
+ */
+void SPDrawList::benchmark()
+{
+    std::mt19937 g(42);
+    const unsigned num_shaders = 40;
+    const unsigned num_texture_sets = 600;
+    const unsigned num_mesh_buffers = 3000;
+    const int rounds = 100;
+
+    struct Shader
+    {
+        int m_priority;
+        SPDrawIndex m_draw_index;
+    };
+    struct MeshBuffer
+    {
+        unsigned m_shader;
+        std::vector<std::string> m_texture_names;
+        std::vector<std::pair<unsigned, unsigned> > m_texture_sets;
+        SPDrawIndex m_draw_index;
+    };
+    std::vector<Shader> shaders(num_shaders);
+    for (Shader& s : shaders)
+        s.m_priority = std::uniform_int_distribution<int>(-2, 2)(g);
+    std::vector<MeshBuffer> mesh_buffers(num_mesh_buffers);
+    for (MeshBuffer& mb : mesh_buffers)
+    {
+        mb.m_shader = g() % num_shaders;
+        const unsigned num_materials = 1 + g() % 2;
+        for (unsigned m = 0; m < num_materials; m++)
+        {
+            const std::string name = "textures/texture" +
+                StringUtils::toString(g() % num_texture_sets) + ".png";
+            mb.m_texture_names.push_back(name);
+            mb.m_texture_sets.emplace_back(getTextureSetID(name), m);
+        }
+    }
+
+    // A camera at the origin looking along the z axis
+    irr::core::matrix4 proj, view;
+    proj.buildProjectionMatrixPerspectiveFovLH(1.4f, 16.0f / 9.0f, 1.0f,
+                                               300.0f);
+    view.buildCameraLookAtMatrixLH(irr::core::vector3df(0, 0, 0),
+                                   irr::core::vector3df(0, 0, 1),
+                                   irr::core::vector3df(0, 1, 0));
+    float frustum[24];
+    GE::mathPlaneFrustumf(frustum, proj * view);
+
+    for (unsigned num_nodes = 2500; num_nodes <= 40000; num_nodes *= 2)
+    {
+        std::vector<irr::core::aabbox3df> boxes;
+        std::vector<unsigned> node_mesh_buffer;
+        std::uniform_real_distribution<float> pos(-300.0f, 300.0f);
+        for (unsigned i = 0; i < num_nodes; i++)
+        {
+            irr::core::vector3df p(pos(g), pos(g) * 0.1f, pos(g));
+            boxes.emplace_back(p - irr::core::vector3df(2.0f),
+                               p + irr::core::vector3df(2.0f));
+            node_mesh_buffer.push_back(g() % num_mesh_buffers);
+        }
+
+        std::vector<unsigned> visible;
+        double start = StkTime::getRealTime();
+        for (int round = 0; round < rounds; round++)
+        {
+            visible.clear();
+            for (unsigned i = 0; i < num_nodes; i++)
+            {
+                if (!isOutsideFrustum(boxes[i], frustum))
+                    visible.push_back(i);
+            }
+        }
+        double culling = StkTime::getRealTime() - start;
+
+        SPCulling boxes_culling;
+        start = StkTime::getRealTime();
+        for (int round = 0; round < rounds; round++)
+        {
+            boxes_culling.clear();
+            for (unsigned i = 0; i < num_nodes; i++)
+                boxes_culling.add(boxes[i]);
+            boxes_culling.cull(&frustum, 1);
+        }
+        double simd_culling = StkTime::getRealTime() - start;
+        unsigned simd_visible = 0;
+        for (unsigned i = 0; i < num_nodes; i++)
+        {
+            if (boxes_culling.isVisible(i, 0))
+                simd_visible++;
+        }
+        if (simd_visible != visible.size())
+        {
+            Log::fatal("SPDrawList", "Found %u instead of %u visible nodes.",
+                       simd_visible, (unsigned)visible.size());
+        }
+
+        // The previous draw calls: hash maps which are copied for sorting
+        typedef std::unordered_map<std::string,
+            std::unordered_set<MeshBuffer*> > TextureMap;
+        std::unordered_map<Shader*, TextureMap> draw_calls;
+        std::vector<std::pair<Shader*, std::vector<std::pair<
+            std::array<unsigned, 6>, std::vector<std::pair<MeshBuffer*,
+            int> > > > > > final_draw_calls;
+        size_t map_count = 0;
+        start = StkTime::getRealTime();
+        for (int round = 0; round < rounds; round++)
+        {
+            draw_calls.clear();
+            final_draw_calls.clear();
+            for (unsigned i : visible)
+            {
+                MeshBuffer* mb = &mesh_buffers[node_mesh_buffer[i]];
+                auto& ret = draw_calls[&shaders[mb->m_shader]];
+                for (const std::string& name : mb->m_texture_names)
+                    ret[name].insert(mb);
+            }
+            typedef std::pair<Shader*, TextureMap> DrawCallPair;
+            std::vector<DrawCallPair> sorted_dc;
+            for (auto& p : draw_calls)
+                sorted_dc.push_back(p);
+            std::sort(sorted_dc.begin(), sorted_dc.end(),
+                [](const DrawCallPair& a, const DrawCallPair& b)->bool
+                {
+                    return a.first->m_priority < b.first->m_priority;
+                });
+            for (auto& p : sorted_dc)
+            {
+                final_draw_calls.emplace_back(p.first,
+                    std::vector<std::pair<std::array<unsigned, 6>,
+                    std::vector<std::pair<MeshBuffer*, int> > > >());
+                for (auto& q : p.second)
+                {
+                    final_draw_calls.back().second.emplace_back(
+                        std::array<unsigned, 6>(),
+                        std::vector<std::pair<MeshBuffer*, int> >());
+                    for (MeshBuffer* mb : q.second)
+                    {
+                        final_draw_calls.back().second.back().second
+                            .emplace_back(mb, 0);
+                    }
+                }
+            }
+        }
+        double maps = StkTime::getRealTime() - start;
+        for (auto& p : final_draw_calls)
+        {
+            for (auto& q : p.second)
+                map_count += q.second.size();
+        }
+
+        // The sorted draw list with flat arrays for the result
+        SPDrawList draw_list;
+        std::vector<Shader*> frame_shaders;
+        std::vector<MeshBuffer*> frame_mesh_buffers;
+        std::vector<std::pair<Shader*, unsigned> > final_shaders;
+        std::vector<std::pair<std::array<unsigned, 6>, unsigned> >
+            final_textures;
+        std::vector<std::pair<MeshBuffer*, int> > final_mesh_buffers;
+        unsigned frame = 0;
+        start = StkTime::getRealTime();
+        for (int round = 0; round < rounds; round++)
+        {
+            frame++;
+            draw_list.clear();
+            frame_shaders.clear();
+            frame_mesh_buffers.clear();
+            final_shaders.clear();
+            final_textures.clear();
+            final_mesh_buffers.clear();
+            for (unsigned i : visible)
+            {
+                MeshBuffer* mb = &mesh_buffers[node_mesh_buffer[i]];
+                Shader* shader = &shaders[mb->m_shader];
+                const unsigned shader_index = shader->m_draw_index.get(frame,
+                    shader, &frame_shaders);
+                const unsigned mb_index = mb->m_draw_index.get(frame, mb,
+                    &frame_mesh_buffers);
+                for (auto& p : mb->m_texture_sets)
+                {
+                    draw_list.add(makeKey(shader->m_priority, shader_index,
+                        p.first, mb_index));
+                }
+            }
+            draw_list.sort();
+            const std::vector<uint64_t>& keys = draw_list.getKeys();
+            for (unsigned k = 0; k < keys.size(); k++)
+            {
+                if (k == 0 || !sameBatch(keys[k - 1], keys[k]))
+                {
+                    if (k == 0 ||
+                        getShader(keys[k - 1]) != getShader(keys[k]))
+                    {
+                        final_shaders.emplace_back(
+                            frame_shaders[getShader(keys[k])],
+                            (unsigned)final_textures.size());
+                    }
+                    final_textures.emplace_back(std::array<unsigned, 6>(),
+                        (unsigned)final_mesh_buffers.size());
+                }
+                final_mesh_buffers.emplace_back(
+                    frame_mesh_buffers[getMeshBuffer(keys[k])], 0);
+            }
+        }
+        double list = StkTime::getRealTime() - start;
+
+        if (map_count != final_mesh_buffers.size())
+        {
+            Log::fatal("SPDrawList", "Found %u instead of %u draw calls.",
+                       (unsigned)final_mesh_buffers.size(),
+                       (unsigned)map_count);
+        }
+        Log::info("SPDrawList", "%5u nodes (%5u visible, %4u draw calls): "
+                  "culling %8.2lf us (SPCulling %8.2lf us), hash maps "
+                  "%8.2lf us, draw list %8.2lf us per frame.", num_nodes,
+                  (unsigned)visible.size(),
+                  (unsigned)final_mesh_buffers.size(),
+                  culling * 1.0e6 / rounds, simd_culling * 1.0e6 / rounds,
+                  maps * 1.0e6 / rounds, list * 1.0e6 / rounds);
+    }
+}   // benchmark
+#endif
+
+}
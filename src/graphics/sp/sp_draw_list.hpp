@@ -0,0 +1,147 @@
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_SP_DRAW_LIST_HPP
+#define HEADER_SP_DRAW_LIST_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SP
+{
+
+/** Index of an object (a shader or a mesh buffer) in the tables of the
+ *  draw lists of the current frame. Each object is added to the table when
+ *  it is used the first time in a frame, so the draw list keys can contain
+ *  a small index instead of a pointer, and each object is only added once.
+ */
+class SPDrawIndex
+{
+private:
+    unsigned m_frame;
+
+    unsigned m_index;
+
+public:
+    SPDrawIndex() : m_frame(0), m_index(0) {}
+    // ------------------------------------------------------------------------
+    /** Returns the index of the object in the table, and adds it to the
+     *  table if it was not used in this frame yet.
+     *  \param frame Number of the current frame, must not be 0.
+     *  \param object The object this index belongs to.
+     *  \param table The table of all objects used in this frame. */
+    template<typename T>
+    unsigned get(unsigned frame, T* object, std::vector<T*>* table)
+    {
+        if (m_frame != frame)
+        {
+            m_frame = frame;
+            m_index = (unsigned)table->size();
+            table->push_back(object);
+        }
+        return m_index;
+    }   // get
+    // ------------------------------------------------------------------------
+    /** Returns true if the object was added to the table in this frame. */
+    bool isUsed(unsigned frame) const            { return m_frame == frame; }
+};   // SPDrawIndex
+
+// ============================================================================
+/** A list of draw calls which is built and sorted each frame. Each draw call
+ *  is a 64 bit key, which contains (from the most significant bits) the
+ *  drawing priority of the shader, the shader, the set of textures and the
+ *  mesh buffer. So after sorting the keys with a radix sort the draw calls
+ *  are in drawing order and grouped by shader and textures, which replaces
+ *  the hash maps of the previous draw call code. The memory of the keys is
+ *  kept between frames, so no memory is allocated once the number of draw
+ *  calls is stable.
+ */
+class SPDrawList
+{
+private:
+    std::vector<uint64_t> m_keys;
+
+    /** Second buffer for the radix sort. */
+    std::vector<uint64_t> m_sort_buffer;
+
+public:
+    static const unsigned MESH_BUFFER_BITS = 24;
+    static const unsigned TEXTURE_SET_BITS = 20;
+    static const unsigned SHADER_BITS      = 12;
+    static const unsigned PRIORITY_BITS    = 8;
+
+    // ------------------------------------------------------------------------
+    /** Creates the key of a draw call.
+     *  \param priority Drawing priority of the shader, clamped to -128..127.
+     *  \param shader Index of the shader in this frame.
+     *  \param texture_set Id of the texture set (see getTextureSetID).
+     *  \param mesh_buffer Index of the mesh buffer in this frame. */
+    static uint64_t makeKey(int priority, unsigned shader,
+                            unsigned texture_set, unsigned mesh_buffer)
+    {
+        assert(shader < (1u << SHADER_BITS));
+        assert(texture_set < (1u << TEXTURE_SET_BITS));
+        assert(mesh_buffer < (1u << MESH_BUFFER_BITS));
+        priority = priority < -128 ? 0 : priority > 127 ? 255 : priority + 128;
+        return (uint64_t)priority << (64 - PRIORITY_BITS) |
+               (uint64_t)shader << (TEXTURE_SET_BITS + MESH_BUFFER_BITS) |
+               (uint64_t)texture_set << MESH_BUFFER_BITS |
+               mesh_buffer;
+    }   // makeKey
+    // ------------------------------------------------------------------------
+    static unsigned getShader(uint64_t key)
+    {
+        return (unsigned)(key >> (TEXTURE_SET_BITS + MESH_BUFFER_BITS)) &
+               ((1u << SHADER_BITS) - 1);
+    }   // getShader
+    // ------------------------------------------------------------------------
+    static unsigned getTextureSet(uint64_t key)
+    {
+        return (unsigned)(key >> MESH_BUFFER_BITS) &
+               ((1u << TEXTURE_SET_BITS) - 1);
+    }   // getTextureSet
+    // ------------------------------------------------------------------------
+    static unsigned getMeshBuffer(uint64_t key)
+    {
+        return (unsigned)key & ((1u << MESH_BUFFER_BITS) - 1);
+    }   // getMeshBuffer
+    // ------------------------------------------------------------------------
+    /** Returns true if two keys belong to the same shader and textures. */
+    static bool sameBatch(uint64_t a, uint64_t b)
+                           { return (a >> MESH_BUFFER_BITS) ==
+                                    (b >> MESH_BUFFER_BITS);                 }
+    // ------------------------------------------------------------------------
+    static unsigned getTextureSetID(const std::string& textures);
+    // ------------------------------------------------------------------------
+    static void benchmark();
+    // ------------------------------------------------------------------------
+    void sort();
+    // ------------------------------------------------------------------------
+    void clear()                                            { m_keys.clear(); }
+    // ------------------------------------------------------------------------
+    void add(uint64_t key)                             { m_keys.push_back(key); }
+    // ------------------------------------------------------------------------
+    bool empty() const                               { return m_keys.empty(); }
+    // ------------------------------------------------------------------------
+    const std::vector<uint64_t>& getKeys() const              { return m_keys; }
+};   // SPDrawList
+
+}
+
+#endif
@@ -138,8 +138,8 @@ void SPMeshBuffer::uploadGLMesh()
                 std::get<2>(m_stk_material[i])->getContainerId());
         }
         // Use the original spm uv texture 1 and 2 for compare in scene manager
-        m_tex_cmp[std::get<2>(m_stk_material[i])->getSamplerPath(0) +
-            std::get<2>(m_stk_material[i])->getSamplerPath(1)] = i;
+        addTextureSet(std::get<2>(m_stk_material[i])->getSamplerPath(0) +
+            std::get<2>(m_stk_material[i])->getSamplerPath(1), i);
     }
 
     bool use_2_uv = std::get<2>(m_stk_material[0])->use2UV();
@@ -466,12 +466,12 @@ void SPMeshBuffer::enableTextureMatrix(unsigned mat_id)
 void SPMeshBuffer::reloadTextureCompare()
 {
     assert(!m_textures.empty());
-    m_tex_cmp.clear();
+    m_texture_sets.clear();
     for (unsigned i = 0; i < m_stk_material.size(); i++)
     {
         const std::string name =
             m_textures[i][0]->getPath() + m_textures[i][1]->getPath();
-        m_tex_cmp[name] = i;
+        addTextureSet(name, i);
     }
 }   // reloadTextureCompare
 
@@ -20,6 +20,7 @@
 
 #include "graphics/gl_headers.hpp"
 #include "graphics/sp/sp_base.hpp"
+#include "graphics/sp/sp_draw_list.hpp"
 #include "graphics/sp/sp_instanced_data.hpp"
 #include "graphics/sp/sp_per_object_uniform.hpp"
 #include "utils/types.hpp"
@@ -54,7 +55,12 @@ protected:
 
     std::vector<std::array<std::shared_ptr<SPTexture>, 6> > m_textures;
 
-    std::unordered_map<std::string, unsigned> m_tex_cmp;
+    /** The texture sets (see SPDrawList::getTextureSetID) of the texture
+     *  layer 1 and 2 of each material, with the material id, used to group
+     *  draw calls with the same textures. */
+    std::vector<std::pair<unsigned, unsigned> > m_texture_sets;
+
+    SPDrawIndex m_draw_index;
 
     std::vector<video::S3DVertexSkinnedMesh> m_vertices;
 
@@ -64,6 +70,21 @@ protected:
 
     unsigned m_pitch;
 
+    // ------------------------------------------------------------------------
+    void addTextureSet(const std::string& textures, unsigned material_id)
+    {
+        const unsigned id = SPDrawList::getTextureSetID(textures);
+        for (auto& p : m_texture_sets)
+        {
+            if (p.first == id)
+            {
+                p.second = material_id;
+                return;
+            }
+        }
+        m_texture_sets.emplace_back(id, material_id);
+    }
+
 private:
     std::vector<uint16_t> m_indices;
 
@@ -223,19 +244,23 @@ public:
         return ret;
     }
     // ------------------------------------------------------------------------
-    const std::unordered_map<std::string, unsigned>& getTextureCompare() const
-                                                          { return m_tex_cmp; }
+    const std::vector<std::pair<unsigned, unsigned> >& getTextureSets() const
+                                                     { return m_texture_sets; }
     // ------------------------------------------------------------------------
-    int getMaterialID(const std::string& tex_cmp) const
+    int getMaterialID(unsigned texture_set) const
     {
-        auto itr = m_tex_cmp.find(tex_cmp);
-        if (itr != m_tex_cmp.end())
+        for (auto& p : m_texture_sets)
         {
-            return (int)itr->second;
+            if (p.first == texture_set)
+            {
+                return (int)p.second;
+            }
         }
         return -1;
     }
     // ------------------------------------------------------------------------
+    SPDrawIndex& getDrawIndex()                       { return m_draw_index; }
+    // ------------------------------------------------------------------------
     void addInstanceData(const SPInstancedData& id, DrawCallType dct)
     {
         if (m_uploaded_instance)
@@ -19,6 +19,7 @@
 #define HEADER_SP_SHADER_HPP
 
 #include "graphics/gl_headers.hpp"
+#include "graphics/sp/sp_draw_list.hpp"
 #include "graphics/sp/sp_per_object_uniform.hpp"
 #include "utils/log.hpp"
 #include "utils/no_copy.hpp"
@@ -110,6 +111,8 @@ private:
 
     const std::array<bool, 6> m_srgb;
 
+    SPDrawIndex m_draw_index;
+
 public:
     // ------------------------------------------------------------------------
     static bool m_sp_shader_debug;
@@ -209,6 +212,8 @@ public:
     // ------------------------------------------------------------------------
     int getDrawingPriority() const               { return m_drawing_priority; }
     // ------------------------------------------------------------------------
+    SPDrawIndex& getDrawIndex()                       { return m_draw_index; }
+    // ------------------------------------------------------------------------
     bool samplerLess(RenderPass rp = RP_1ST) const
                                              { return m_samplers[rp].empty(); }
     // ------------------------------------------------------------------------
@@ -25,6 +25,7 @@
 #include "graphics/material_manager.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/skin.hpp"
+#include "io/manifest_cache.hpp"
 #include "karts/kart_properties_manager.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/command_line.hpp"
@@ -140,6 +141,10 @@ FileManager* file_manager = 0;
 FileManager::FileManager()
 {
     m_root_dirs.clear();
+    m_manifest_cache = NULL;
+    m_num_dir_lookups = 0;
+    m_num_dir_listings = 0;
+    m_num_stats_saved = 0;
     resetSubdir();
 #ifdef __APPLE__
     // irrLicht's createDevice method has a nasty habit of messing the CWD.
@@ -266,6 +271,7 @@ FileManager::FileManager()
     checkAndCreateScreenshotDir();
     checkAndCreateReplayDir();
     checkAndCreateCachedTexturesDir();
+    checkAndCreateCachedDataDir();
     checkAndCreateGPDir();
 
     redirectOutput();
@@ -505,6 +511,7 @@ void FileManager::reinitAfterDownloadAssets()
     m_texture_search_path.clear();
     m_model_search_path.clear();
     m_music_search_path.clear();
+    clearSearchPathCache();
     discoverPaths();
     addAssetsSearchPath();
     // Add back addons search path
@@ -523,6 +530,14 @@ FileManager::~FileManager()
     popModelSearchPath();
     popTextureSearchPath();
     popTextureSearchPath();
+    if (m_num_dir_lookups > 0)
+    {
+        Log::info("FileManager", "Search path cache: %lu lookups, %lu "
+                  "directory listings, %lu stat calls saved.",
+                  (unsigned long)m_num_dir_lookups,
+                  (unsigned long)m_num_dir_listings,
+                  (unsigned long)m_num_stats_saved);
+    }
     m_file_system->drop();
     m_file_system = NULL;
 }   // ~FileManager
@@ -572,6 +587,13 @@ io::IXMLReader *FileManager::createXMLReader(const std::string &filename)
  */
 XMLNode *FileManager::createXMLTree(const std::string &filename)
 {
+    ManifestCache *cache = m_manifest_cache;
+    if (cache)
+    {
+        XMLNode *node = cache->takeTree(filename);
+        if (node)
+            return node;
+    }
     try
     {
         XMLNode* node = new XMLNode(filename);
@@ -634,6 +656,7 @@ io::path FileManager::createAbsoluteFilename(const std::string &f)
  */
 void FileManager::pushModelSearchPath(const std::string& path)
 {
+    invalidateSearchDir(path);
     m_model_search_path.push_back(path);
     std::unique_lock<std::recursive_mutex> ul = m_file_system->acquireFileArchivesMutex();
 
@@ -663,6 +686,7 @@ void FileManager::pushModelSearchPath(const std::string& path)
  */
 void FileManager::pushTextureSearchPath(const std::string& path, const std::string& container_id)
 {
+    invalidateSearchDir(path);
     m_texture_search_path.push_back(TextureSearchPath(path, container_id));
     std::unique_lock<std::recursive_mutex> ul = m_file_system->acquireFileArchivesMutex();
 
@@ -696,6 +720,7 @@ void FileManager::popTextureSearchPath()
     {
         TextureSearchPath dir = m_texture_search_path.back();
         m_texture_search_path.pop_back();
+        invalidateSearchDir(dir.m_texture_search_path);
         m_file_system->removeFileArchive(createAbsoluteFilename(dir.m_texture_search_path));
     }
 }   // popTextureSearchPath
@@ -709,6 +734,7 @@ void FileManager::popModelSearchPath()
     {
         std::string dir = m_model_search_path.back();
         m_model_search_path.pop_back();
+        invalidateSearchDir(dir);
         m_file_system->removeFileArchive(createAbsoluteFilename(dir));
     }
 }   // popModelSearchPath
@@ -720,9 +746,83 @@ void FileManager::popMusicSearchPath()
 {
     if(!m_music_search_path.empty())
     {
+        invalidateSearchDir(m_music_search_path.back());
         m_music_search_path.pop_back();
     }
-}
+}   // popMusicSearchPath
+
+//-----------------------------------------------------------------------------
+/** Removes the listing of a search directory from the cache, so that it is
+ *  listed again when it is used the next time.
+ *  \param dir The search directory.
+ */
+void FileManager::invalidateSearchDir(const std::string& dir)
+{
+    std::lock_guard<std::mutex> lock(m_directory_cache_mutex);
+    m_directory_cache.erase(dir);
+}   // invalidateSearchDir
+
+//-----------------------------------------------------------------------------
+/** Removes all directory listings from the cache. This must be called
+ *  whenever files in a search directory are added or removed while STK
+ *  is running, e.g. when an addon is installed or uninstalled.
+ */
+void FileManager::clearSearchPathCache() const
+{
+    std::lock_guard<std::mutex> lock(m_directory_cache_mutex);
+    m_directory_cache.clear();
+}   // clearSearchPathCache
+
+//-----------------------------------------------------------------------------
+/** Tests if a file exists in a search directory. The directory is listed
+ *  once and the listing is kept, so that searching a file through a long
+ *  list of search directories does not cause one stat call per directory.
+ *  \param dir The search directory (ending with a '/').
+ *  \param file_name The name of the file.
+ */
+bool FileManager::fileExistsInSearchDir(const std::string& dir,
+                                        const std::string& file_name) const
+{
+    const std::string full_path = dir + file_name;
+    // Names with a directory part are not in the listing.
+    if (file_name.find_first_of("/\\") != std::string::npos)
+        return m_file_system->existFile(full_path.c_str());
+
+    m_num_dir_lookups++;
+    {
+        std::lock_guard<std::mutex> lock(m_directory_cache_mutex);
+        auto it = m_directory_cache.find(dir);
+        if (it == m_directory_cache.end())
+        {
+            DirectoryListing &listing = m_directory_cache[dir];
+            listing.m_listed = isDirectory(dir);
+            if (listing.m_listed)
+            {
+                std::set<std::string> files;
+                listFiles(files, dir);
+                listing.m_files.insert(files.begin(), files.end());
+                m_num_dir_listings++;
+            }
+            it = m_directory_cache.find(dir);
+        }
+        if (it->second.m_listed)
+        {
+            if (it->second.m_files.count(file_name) > 0)
+            {
+                m_num_stats_saved++;
+                return true;
+            }
+#if !defined(WIN32) && !defined(__APPLE__)
+            m_num_stats_saved++;
+            return false;
+#endif
+        }
+    }
+    // Either the directory can not be listed, or the file system is not
+    // case sensitive and the name might still match with a different case.
+    return m_file_system->existFile(full_path.c_str());
+}   // fileExistsInSearchDir
+
 
 //-----------------------------------------------------------------------------
 /** Tries to find the specified file in any of the given search paths.
@@ -740,8 +840,11 @@ bool FileManager::findFile(std::string& full_path,
         i = search_path.rbegin();
         i != search_path.rend(); ++i)
     {
-        full_path = *i + file_name;
-        if(m_file_system->existFile(full_path.c_str())) return true;
+        if (fileExistsInSearchDir(*i, file_name))
+        {
+            full_path = *i + file_name;
+            return true;
+        }
     }
     full_path="";
     return false;
@@ -763,8 +866,11 @@ bool FileManager::findFile(std::string& full_path,
         i = search_path.rbegin();
         i != search_path.rend(); ++i)
     {
-        full_path = i->m_texture_search_path + file_name;
-        if (m_file_system->existFile(full_path.c_str())) return true;
+        if (fileExistsInSearchDir(i->m_texture_search_path, file_name))
+        {
+            full_path = i->m_texture_search_path + file_name;
+            return true;
+        }
     }
     full_path = "";
     return false;
@@ -841,6 +947,14 @@ std::string FileManager::getCachedTexturesDir() const
     return m_cached_textures_dir;
 }   // getCachedTexturesDir
 
+//-----------------------------------------------------------------------------
+/** Returns the directory in which data computed from assets is cached.
+*/
+std::string FileManager::getCachedDataDir() const
+{
+    return m_cached_data_dir;
+}   // getCachedDataDir
+
 //-----------------------------------------------------------------------------
 /** Returns the directory in which user-defined grand prix should be stored.
  */
@@ -1209,6 +1323,32 @@ void FileManager::checkAndCreateCachedTexturesDir()
 
 }   // checkAndCreateCachedTexturesDir
 
+// ----------------------------------------------------------------------------
+/** Creates the directory for data computed from assets, which can be
+ *  recreated at any time (e.g. arena shortest path tables). This will set
+ *  m_cached_data_dir with the appropriate path.
+ */
+void FileManager::checkAndCreateCachedDataDir()
+{
+#if defined(WIN32) || defined(__HAIKU__)
+    m_cached_data_dir = m_user_config_dir + "cached-data/";
+#elif defined(__APPLE__)
+    m_cached_data_dir = getenv("HOME");
+    m_cached_data_dir += "/Library/Application Support/SuperTuxKart/CachedData/";
+#else
+    m_cached_data_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_data_dir += "cached-data/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_data_dir))
+    {
+        Log::error("FileManager", "Can not create cached data directory '%s', "
+            "falling back to '.'.", m_cached_data_dir.c_str());
+        m_cached_data_dir = ".";
+    }
+
+}   // checkAndCreateCachedDataDir
+
 // ----------------------------------------------------------------------------
 /** Creates the directories for user-defined grand prix. This will set m_gp_dir
  *  with the appropriate path.
@@ -1541,6 +1681,7 @@ bool FileManager::removeFile(const std::string &name) const
  */
 bool FileManager::removeDirectory(const std::string &name) const
 {
+    clearSearchPathCache();
     std::set<std::string> files;
     listFiles(files, name, /*is full path*/ true);
 
@@ -1650,6 +1791,8 @@ bool FileManager::moveDirectoryInto(std::string source, std::string target)
     if (isDirectory(target))
         return false;
 
+    clearSearchPathCache();
+
 #if defined(WIN32)
     return MoveFileExW(StringUtils::utf8ToWide(source).c_str(),
         StringUtils::utf8ToWide(target).c_str(),
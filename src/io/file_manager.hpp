@@ -25,9 +25,13 @@
  * Contains generic utility classes for file I/O (especially XML handling).
  */
 
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <irrString.h>
 namespace irr
@@ -40,6 +44,8 @@ using namespace irr;
 #include "io/xml_node.hpp"
 #include "utils/no_copy.hpp"
 
+class ManifestCache;
+
 struct TextureSearchPath
 {
     std::string m_texture_search_path;
@@ -98,6 +104,10 @@ private:
     /** Directory where resized textures are cached. */
     std::string       m_cached_textures_dir;
 
+    /** Directory where data computed from assets (e.g. arena shortest
+     *  paths) is cached. */
+    std::string       m_cached_data_dir;
+
     /** Directory where user-defined grand prix are stored. */
     std::string       m_gp_dir;
 
@@ -107,6 +117,33 @@ private:
     /** Mobile stk specific to download stk-assets in the first. */
     std::string       m_stk_assets_download_dir;
 
+    /** If set, XML files which were already parsed by it are returned
+     *  from createXMLTree. */
+    std::atomic<ManifestCache*> m_manifest_cache;
+
+    /** The content of a search directory, so that searching a file in
+     *  many directories does not need one stat call per directory. */
+    struct DirectoryListing
+    {
+        /** False if the directory could not be listed (e.g. because it is
+         *  inside of an archive), in which case existFile is used. */
+        bool m_listed;
+        std::unordered_set<std::string> m_files;
+    };
+
+    /** The listings of all search directories used so far. A directory is
+     *  listed again after it is pushed or popped, or after addons were
+     *  installed or removed. */
+    mutable std::unordered_map<std::string, DirectoryListing>
+                      m_directory_cache;
+
+    mutable std::mutex m_directory_cache_mutex;
+
+    /** Statistics: number of lookups in a search directory, number of
+     *  directories listed, and number of lookups answered from a listing. */
+    mutable std::atomic<uint64_t> m_num_dir_lookups, m_num_dir_listings,
+                                  m_num_stats_saved;
+
     std::vector<TextureSearchPath> m_texture_search_path;
 
     std::vector<std::string>
@@ -120,6 +157,10 @@ private:
                                const std::string& fname,
                                const std::vector<TextureSearchPath>& search_path)
                                const;
+    bool              fileExistsInSearchDir(const std::string& dir,
+                                            const std::string& file_name)
+                                            const;
+    void              invalidateSearchDir(const std::string& dir);
     void              makePath(std::string& path, const std::string& dir,
                                const std::string& fname) const;
     io::path          createAbsoluteFilename(const std::string &f);
@@ -128,6 +169,7 @@ private:
     void              checkAndCreateScreenshotDir();
     void              checkAndCreateReplayDir();
     void              checkAndCreateCachedTexturesDir();
+    void              checkAndCreateCachedDataDir();
     void              checkAndCreateGPDir();
     void              discoverPaths();
     void              addAssetsSearchPath();
@@ -150,10 +192,15 @@ public:
     io::IXMLReader   *createXMLReader(const std::string &filename);
     XMLNode          *createXMLTree(const std::string &filename);
     XMLNode          *createXMLTreeFromString(const std::string & content);
+    // ------------------------------------------------------------------------
+    /** Sets the manifest cache whose parsed files are used by createXMLTree,
+     *  or NULL. */
+    void setManifestCache(ManifestCache *cache) { m_manifest_cache = cache; }
 
     std::string       getScreenshotDir() const;
     std::string       getReplayDir() const;
     std::string       getCachedTexturesDir() const;
+    std::string       getCachedDataDir() const;
     std::string       getGPDir() const;
     std::string       getStdoutDir() const;
     bool              checkAndCreateDirectory(const std::string &path);
@@ -205,6 +252,7 @@ public:
                                   bool make_full_path=false) const;
 
 
+    void       clearSearchPathCache() const;
     void       pushTextureSearchPath(const std::string& path, const std::string& container_id);
     void       pushModelSearchPath(const std::string& path);
     void       popTextureSearchPath();
@@ -223,6 +271,7 @@ public:
      */
     void pushMusicSearchPath(const std::string& path)
     {
+        invalidateSearchDir(path);
         m_music_search_path.push_back(path);
     }   // pushMusicSearchPath
     // ------------------------------------------------------------------------
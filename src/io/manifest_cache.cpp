@@ -0,0 +1,638 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "io/manifest_cache.hpp"
+
+#include "io/file_manager.hpp"
+#include "io/xml_node.hpp"
+#include "network/crypto.hpp"
+#include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <IFileSystem.h>
+#include <IReadFile.h>
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sys/stat.h>
+
+namespace
+{
+    const char     MANIFEST_MAGIC[4] = { 'S', 'T', 'K', 'M' };
+    const uint32_t MANIFEST_VERSION  = 2;
+
+    /** Modification times are only trusted if they are at least this much
+     *  (in ns) older than the scan which wrote the manifest: a file changed
+     *  within the same timestamp tick as the scan (e.g. 1s on ext3 or
+     *  windows, 2s on FAT) can keep the mtime and size stored in the
+     *  manifest. */
+    const int64_t  MTIME_GRANULARITY = 2000000000;
+
+    struct ManifestHeader
+    {
+        char     m_magic[4];
+        uint32_t m_version;
+        uint32_t m_num_entries;
+        uint32_t m_padding;
+        uint64_t m_size;
+        /** Time (in ns since the epoch) at which the scan started which
+         *  wrote this manifest. */
+        int64_t  m_scan_time;
+        /** sha256 of the m_size bytes following the header. */
+        uint8_t  m_hash[32];
+    };
+
+    // ------------------------------------------------------------------------
+    template<typename T> void append(std::string *s, T value)
+    {
+        s->append((const char*)&value, sizeof(T));
+    }   // append
+
+    // ------------------------------------------------------------------------
+    void appendString(std::string *s, const std::string &value)
+    {
+        append(s, (uint32_t)value.size());
+        s->append(value);
+    }   // appendString
+
+    // ------------------------------------------------------------------------
+    template<typename T> bool extract(const std::string &s, size_t *pos,
+                                      T *value)
+    {
+        if (*pos + sizeof(T) > s.size())
+            return false;
+        memcpy(value, s.data() + *pos, sizeof(T));
+        *pos += sizeof(T);
+        return true;
+    }   // extract
+
+    // ------------------------------------------------------------------------
+    bool extractString(const std::string &s, size_t *pos, std::string *value)
+    {
+        uint32_t size;
+        if (!extract(s, pos, &size) || *pos + size > s.size())
+            return false;
+        value->assign(s, *pos, size);
+        *pos += size;
+        return true;
+    }   // extractString
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Loads the manifest with the given name from the cached-data directory.
+ *  \param name Name of the manifest, e.g. "tracks".
+ */
+ManifestCache::ManifestCache(const std::string &name)
+{
+    m_filename = file_manager->getCachedDataDir() + "manifest-" + name +
+                 ".bin";
+    m_changed = false;
+    m_num_cached = 0;
+    m_num_read = 0;
+    m_num_verified = 0;
+    m_manifest_time = 0;
+    m_scan_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    load();
+    file_manager->setManifestCache(this);
+}   // ManifestCache
+
+// ----------------------------------------------------------------------------
+/** Deletes all parsed files which were not used, and saves the manifest if
+ *  anything changed.
+ */
+ManifestCache::~ManifestCache()
+{
+    file_manager->setManifestCache(NULL);
+    for (auto &tree : m_trees)
+        delete tree.second;
+
+    // Entries which were not used belong to removed tracks or karts
+    for (auto &entry : m_entries)
+    {
+        if (!entry.second.m_used)
+            m_changed = true;
+    }
+    if (m_changed)
+        save();
+    Log::info("ManifestCache", "'%s': %d files from the manifest, "
+              "%d verified, %d read.", m_filename.c_str(), m_num_cached,
+              m_num_verified, m_num_read);
+}   // ~ManifestCache
+
+// ----------------------------------------------------------------------------
+/** Returns the modification time (in ns, with the resolution the platform
+ *  provides) and size of a file or directory.
+ *  \return False if the file does not exist (on disk).
+ */
+bool ManifestCache::getFileInfo(const std::string &path, int64_t *mtime,
+                                int64_t *size)
+{
+    struct stat st;
+    if (FileUtils::statU8Path(path, &st) != 0)
+        return false;
+#if defined(WIN32)
+    *mtime = (int64_t)st.st_mtime * 1000000000;
+#elif defined(__APPLE__)
+    *mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 +
+             st.st_mtimespec.tv_nsec;
+#else
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    *size = S_ISDIR(st.st_mode) ? 0 : (int64_t)st.st_size;
+    return true;
+}   // getFileInfo
+
+// ----------------------------------------------------------------------------
+/** Reads a complete file into a string.
+ *  \return False if the file can't be read.
+ */
+bool ManifestCache::readFile(const std::string &path, std::string *content)
+{
+    FILE *f = FileUtils::fopenU8Path(path, "rb");
+    if (!f)
+        return false;
+    content->clear();
+    char buffer[16384];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        content->append(buffer, n);
+    const bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}   // readFile
+
+// ----------------------------------------------------------------------------
+/** Reads the manifest file. An invalid or outdated manifest is ignored, all
+ *  files are then read again (and the manifest rewritten).
+ */
+void ManifestCache::load()
+{
+    std::string data;
+    if (!readFile(m_filename, &data))
+        return;
+
+    ManifestHeader header;
+    if (data.size() < sizeof(header))
+    {
+        Log::warn("ManifestCache", "Ignoring invalid manifest '%s'.",
+                  m_filename.c_str());
+        m_changed = true;
+        return;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    std::string payload = data.substr(sizeof(header));
+    std::array<uint8_t, 32> hash = Crypto::sha256(payload);
+    if (memcmp(header.m_magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0 ||
+        header.m_version != MANIFEST_VERSION ||
+        header.m_size != payload.size() ||
+        memcmp(header.m_hash, hash.data(), hash.size()) != 0)
+    {
+        Log::warn("ManifestCache", "Ignoring invalid manifest '%s'.",
+                  m_filename.c_str());
+        m_changed = true;
+        return;
+    }
+
+    size_t pos = 0;
+    m_manifest_time = header.m_scan_time;
+    for (uint32_t i = 0; i < header.m_num_entries; i++)
+    {
+        std::string path;
+        Entry entry;
+        entry.m_used = false;
+        if (!extractString(payload, &pos, &path) ||
+            !extract(payload, &pos, &entry.m_mtime) ||
+            !extract(payload, &pos, &entry.m_size) ||
+            !extractString(payload, &pos, &entry.m_content))
+        {
+            Log::warn("ManifestCache", "Ignoring invalid manifest '%s'.",
+                      m_filename.c_str());
+            m_entries.clear();
+            m_changed = true;
+            return;
+        }
+        m_entries[path] = std::move(entry);
+    }
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Writes all used entries to the manifest. The data is written to a
+ *  temporary file first, so a different process never sees a partially
+ *  written manifest.
+ */
+void ManifestCache::save()
+{
+    std::string payload;
+    uint32_t num_entries = 0;
+    for (auto &entry : m_entries)
+    {
+        if (!entry.second.m_used)
+            continue;
+        appendString(&payload, entry.first);
+        append(&payload, entry.second.m_mtime);
+        append(&payload, entry.second.m_size);
+        appendString(&payload, entry.second.m_content);
+        num_entries++;
+    }
+
+    ManifestHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    header.m_version = MANIFEST_VERSION;
+    header.m_num_entries = num_entries;
+    header.m_size = payload.size();
+    header.m_scan_time = m_scan_time;
+    std::array<uint8_t, 32> hash = Crypto::sha256(payload);
+    memcpy(header.m_hash, hash.data(), hash.size());
+
+    const std::string tmp_name = m_filename + ".tmp" +
+        StringUtils::toString(StkTime::getMonoTimeMs());
+    bool ok;
+    {
+        std::ofstream f(FileUtils::getPortableWritingPath(tmp_name),
+                        std::ios::binary);
+        if (!f.is_open())
+        {
+            Log::warn("ManifestCache", "Can't write manifest '%s'.",
+                      tmp_name.c_str());
+            return;
+        }
+        f.write((const char*)&header, sizeof(header));
+        f.write(payload.data(), payload.size());
+        ok = (bool)f;
+    }
+    if (!ok)
+    {
+        file_manager->removeFile(tmp_name);
+        return;
+    }
+    // rename fails on windows if the destination exists
+    file_manager->removeFile(m_filename);
+    if (FileUtils::renameU8Path(tmp_name, m_filename) != 0)
+        file_manager->removeFile(tmp_name);
+}   // save
+
+// ----------------------------------------------------------------------------
+/** Returns true if the modification time and size of an entry can be
+ *  trusted, i.e. the file or directory has the same modification time and
+ *  size as when the manifest was written, and it was not modified within
+ *  the timestamp resolution of that scan. Otherwise the content has to be
+ *  compared.
+ */
+bool ManifestCache::isUnchanged(const Entry &entry, int64_t mtime,
+                                int64_t size) const
+{
+    return entry.m_mtime == mtime && entry.m_size == size &&
+           mtime + MTIME_GRANULARITY <= m_manifest_time;
+}   // isUnchanged
+
+// ----------------------------------------------------------------------------
+/** Returns all entries of a directory. They are taken from the manifest if
+ *  the modification time of the directory did not change (which happens
+ *  whenever an entry is added or removed), otherwise the directory is
+ *  listed again.
+ *  \param dir The directory to list.
+ */
+std::vector<std::string> ManifestCache::listDirectory(const std::string &dir)
+{
+    std::vector<std::string> result;
+    int64_t mtime, size;
+    if (!getFileInfo(dir, &mtime, &size))
+    {
+        // Not a directory on disk (e.g. in an archive), can't be cached
+        std::set<std::string> files;
+        file_manager->listFiles(files, dir);
+        result.assign(files.begin(), files.end());
+        return result;
+    }
+
+    auto it = m_entries.find(dir);
+    if (it == m_entries.end() || !isUnchanged(it->second, mtime, 0))
+    {
+        std::set<std::string> files;
+        file_manager->listFiles(files, dir);
+        Entry &entry = m_entries[dir];
+        entry.m_mtime = mtime;
+        entry.m_size = 0;
+        entry.m_content.clear();
+        for (const std::string &file : files)
+            entry.m_content += file + "\n";
+        m_changed = true;
+        it = m_entries.find(dir);
+    }
+    it->second.m_used = true;
+
+    const std::string &content = it->second.m_content;
+    size_t start = 0, end;
+    while ((end = content.find('\n', start)) != std::string::npos)
+    {
+        result.push_back(content.substr(start, end - start));
+        start = end + 1;
+    }
+    return result;
+}   // listDirectory
+
+// ----------------------------------------------------------------------------
+/** Finds all directories which contain a certain file, and parses this file
+ *  and the given extra files in these directories with the worker threads.
+ *  Like in the track and kart managers each search directory is first
+ *  tested itself, and only if it doesn't contain the file each of its
+ *  subdirectories is tested.
+ *  \param search_path The directories to search.
+ *  \param separator Appended to the search directory and subdirectory
+ *         name to get the directory name.
+ *  \param file_name Appended to the directory name to get the file name.
+ *  \param extra_files Files parsed as well if the directory contains the
+ *         file, relative to the path of the file.
+ *  \return The names of all directories containing the file, in the same
+ *          order in which the track and kart managers found them.
+ */
+std::vector<std::string> ManifestCache::findDirectories(
+                                const std::vector<std::string> &search_path,
+                                const std::string &separator,
+                                const std::string &file_name,
+                                const std::vector<std::string> &extra_files)
+{
+    // The top level directories are tested first, since their subdirectories
+    // are only used if they don't contain the file.
+    std::vector<std::string> dirs;
+    for (const std::string &dir : search_path)
+    {
+        int64_t mtime, size;
+        const std::string file = dir + file_name;
+        if (getFileInfo(file, &mtime, &size) || file_manager->fileExists(file))
+        {
+            dirs.push_back(dir);
+            continue;
+        }
+        for (const std::string &subdir : listDirectory(dir))
+        {
+            if (subdir == "." || subdir == "..")
+                continue;
+            dirs.push_back(dir + subdir + separator);
+        }
+    }
+
+    struct FileResult
+    {
+        std::string m_path;
+        int64_t     m_mtime;
+        int64_t     m_size;
+        /** Only set if the file was read, i.e. the manifest entry is
+         *  missing, outdated or its modification time can't be trusted. */
+        std::string m_content;
+        bool        m_changed;
+        /** If the file was read and has the content of the manifest. */
+        bool        m_verified;
+        XMLNode    *m_tree;
+    };
+    /** For each directory the main file followed by the extra files, or
+     *  nothing if the main file does not exist on disk. */
+    std::vector<std::vector<FileResult> > results(dirs.size());
+
+    irr::io::IFileSystem *file_system = file_manager->getFileSystem();
+    auto parse_file = [this, file_system](FileResult *r)
+    {
+        r->m_tree = NULL;
+        r->m_changed = false;
+        r->m_verified = false;
+        if (!getFileInfo(r->m_path, &r->m_mtime, &r->m_size))
+            return false;
+        // m_entries is not modified while the worker threads are running
+        auto it = m_entries.find(r->m_path);
+        const std::string *content = &r->m_content;
+        if (it != m_entries.end() &&
+            isUnchanged(it->second, r->m_mtime, r->m_size))
+        {
+            content = &it->second.m_content;
+        }
+        else
+        {
+            if (!readFile(r->m_path, &r->m_content))
+                return false;
+            if (it != m_entries.end() && it->second.m_mtime == r->m_mtime &&
+                it->second.m_size == r->m_size &&
+                it->second.m_content == r->m_content)
+            {
+                content = &it->second.m_content;
+                r->m_verified = true;
+            }
+            else
+                r->m_changed = true;
+        }
+
+        irr::io::IReadFile *file = file_system->createMemoryReadFile(
+            (void*)content->data(), (irr::s32)content->size(),
+            r->m_path.c_str(), false /*deleteMemoryWhenDropped*/);
+        irr::io::IXMLReader *reader = file_system->createXMLReader(file);
+        if (reader)
+        {
+            try
+            {
+                r->m_tree = new XMLNode(r->m_path, reader);
+            }
+            catch (std::exception &e)
+            {
+                // Parsed again when used, which reports the error
+                r->m_tree = NULL;
+            }
+            reader->drop();
+        }
+        file->drop();
+        return true;
+    };
+
+    WorkerPool::get()->parallelFor((unsigned)dirs.size(),
+        [&dirs, &results, &file_name, &extra_files, &parse_file](unsigned i)
+    {
+        std::vector<FileResult> &r = results[i];
+        r.resize(1);
+        r[0].m_path = dirs[i] + file_name;
+        if (!parse_file(&r[0]))
+        {
+            r.clear();
+            return;
+        }
+        const std::string path = StringUtils::getPath(r[0].m_path) + "/";
+        for (const std::string &extra : extra_files)
+        {
+            r.emplace_back();
+            r.back().m_path = path + extra;
+            if (!parse_file(&r.back()))
+                r.pop_back();
+        }
+    });
+
+    std::vector<std::string> found;
+    std::lock_guard<std::mutex> lock(m_trees_mutex);
+    for (unsigned int i = 0; i < dirs.size(); i++)
+    {
+        if (results[i].empty())
+        {
+            // The file might still exist outside of the file system (e.g.
+            // in an archive), it is then loaded as before.
+            if (file_manager->fileExists(dirs[i] + file_name))
+                found.push_back(dirs[i]);
+            continue;
+        }
+        found.push_back(dirs[i]);
+        for (FileResult &file : results[i])
+        {
+            Entry &entry = m_entries[file.m_path];
+            if (file.m_changed)
+            {
+                entry.m_mtime = file.m_mtime;
+                entry.m_size = file.m_size;
+                entry.m_content.swap(file.m_content);
+                m_changed = true;
+                m_num_read++;
+            }
+            else if (file.m_verified)
+            {
+                // Save the manifest with the new scan time, so the file
+                // does not have to be compared again
+                m_changed = true;
+                m_num_verified++;
+            }
+            else
+                m_num_cached++;
+            entry.m_used = true;
+            if (file.m_tree)
+            {
+                auto old = m_trees.find(file.m_path);
+                if (old != m_trees.end())
+                    delete old->second;
+                m_trees[file.m_path] = file.m_tree;
+            }
+        }
+    }
+    return found;
+}   // findDirectories
+
+// ----------------------------------------------------------------------------
+/** Returns the parsed file with the given name and removes it from this
+ *  object, so the caller has to delete it.
+ *  \return The tree, or NULL if the file was not parsed by this object.
+ */
+XMLNode* ManifestCache::takeTree(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(m_trees_mutex);
+    auto it = m_trees.find(filename);
+    if (it == m_trees.end())
+        return NULL;
+    XMLNode *tree = it->second;
+    m_trees.erase(it);
+    return tree;
+}   // takeTree
+
+// ----------------------------------------------------------------------------
+void ManifestCache::unitTesting()
+{
+    const std::string dir = file_manager->getCachedDataDir() +
+                            "manifest-test/";
+    file_manager->checkAndCreateDirectory(dir);
+    file_manager->checkAndCreateDirectory(dir + "a");
+    file_manager->checkAndCreateDirectory(dir + "b");
+    file_manager->checkAndCreateDirectory(dir + "c");
+    auto write_file = [](const std::string &name, const std::string &content)
+    {
+        std::ofstream f(name);
+        f << content;
+    };
+    write_file(dir + "a/thing.xml", "<thing name=\"a\"/>");
+    write_file(dir + "a/extra.xml", "<extra/>");
+    write_file(dir + "b/thing.xml", "<thing name=\"b\"/>");
+
+    std::vector<std::string> search_path;
+    search_path.push_back(dir);
+    std::vector<std::string> extra_files;
+    extra_files.push_back("extra.xml");
+    std::string manifest;
+    const char *names_b[] = { "b", "b", "b", "bb", "bc" };
+    for (int run = 0; run < 5; run++)
+    {
+        if (run == 3)
+            write_file(dir + "b/thing.xml", "<thing name=\"bb\"/>");
+        else if (run == 4)
+            write_file(dir + "b/thing.xml", "<thing name=\"bc\"/>");
+        ManifestCache cache("test");
+        manifest = cache.m_filename;
+        if (run == 2)
+        {
+            // As if the files were written long before the last scan
+            cache.m_manifest_time += 10 * MTIME_GRANULARITY;
+        }
+        else if (run == 4)
+        {
+            // The file has the same size as before, and is changed within
+            // the same timestamp tick as stored in the manifest
+            int64_t mtime = 0, size = 0;
+            if (!getFileInfo(dir + "b/thing.xml", &mtime, &size))
+                Log::fatal("ManifestCache", "Can't stat test file.");
+            cache.m_entries[dir + "b/thing.xml"].m_mtime = mtime;
+        }
+        std::vector<std::string> found =
+            cache.findDirectories(search_path, "/", "thing.xml", extra_files);
+        if (found.size() != 2 || found[0] != dir + "a/" ||
+            found[1] != dir + "b/")
+            Log::fatal("ManifestCache", "Run %d: wrong directories.", run);
+
+        // The first run reads all files. The second one compares them with
+        // the manifest, since they were just written, the third takes all
+        // from the manifest. The last two runs only read the changed file
+        // again (the others might still have to be compared).
+        const int expected_read = run == 0 ? 3 : run < 3 ? 0 : 1;
+        if (cache.m_num_read != expected_read ||
+            (run == 2 && cache.m_num_cached != 3) ||
+            cache.m_num_read + cache.m_num_verified +
+            cache.m_num_cached != 3)
+        {
+            Log::fatal("ManifestCache", "Run %d: %d files read, %d verified, "
+                       "%d cached.", run, cache.m_num_read,
+                       cache.m_num_verified, cache.m_num_cached);
+        }
+
+        XMLNode *a = file_manager->createXMLTree(dir + "a/thing.xml");
+        XMLNode *b = file_manager->createXMLTree(dir + "b/thing.xml");
+        std::string name_a, name_b;
+        if (!a || !a->get("name", &name_a) || name_a != "a" ||
+            !b || !b->get("name", &name_b) ||
+            name_b != names_b[run])
+            Log::fatal("ManifestCache", "Run %d: wrong content.", run);
+        // Each tree is only returned once
+        if (cache.takeTree(dir + "a/thing.xml"))
+            Log::fatal("ManifestCache", "Tree returned twice.");
+        delete a;
+        delete b;
+    }
+
+    file_manager->removeFile(manifest);
+    file_manager->removeDirectory(dir + "a");
+    file_manager->removeDirectory(dir + "b");
+    file_manager->removeDirectory(dir + "c");
+    file_manager->removeDirectory(dir);
+}   // unitTesting
@@ -0,0 +1,118 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_MANIFEST_CACHE_HPP
+#define HEADER_MANIFEST_CACHE_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class XMLNode;
+
+/** \ingroup io
+ *  Finds all tracks or karts in a list of search directories, and reads
+ *  their metadata files (e.g. track.xml, or kart.xml and materials.xml)
+ *  with the worker threads. The parsed files are then returned by
+ *  FileManager::createXMLTree while this object exists, so the tracks and
+ *  karts can be created (in the main thread) without further file access.
+ *
+ *  A manifest in the cached-data directory stores the subdirectories of
+ *  each search directory and the content of each metadata file, together
+ *  with their modification time (in ns) and size. Directories and files
+ *  which did not change are taken from the manifest, so an unchanged set of
+ *  addons is found with one stat per file instead of reading thousands of
+ *  small files. Files modified shortly before the manifest was written
+ *  could change again without a different mtime and size, so they are
+ *  read and compared with the stored content instead. The manifest is
+ *  protected by a sha256 hash, and rewritten when this object is destroyed
+ *  if anything changed.
+ */
+class ManifestCache : public NoCopy
+{
+private:
+    /** A directory or file in the manifest. */
+    struct Entry
+    {
+        int64_t     m_mtime;
+        int64_t     m_size;
+        /** The content of a file, or the names of all entries of a
+         *  directory, separated by '\n'. */
+        std::string m_content;
+        /** Entries which were not used are not saved again, so removed
+         *  addons disappear from the manifest. */
+        bool        m_used;
+    };
+
+    /** Name of the manifest file. */
+    std::string m_filename;
+
+    std::map<std::string, Entry> m_entries;
+
+    /** If the manifest has to be saved. */
+    bool m_changed;
+
+    /** The parsed files which were not taken yet, by file name. */
+    std::map<std::string, XMLNode*> m_trees;
+
+    std::mutex m_trees_mutex;
+
+    /** Statistics: number of files taken from the manifest, read and
+     *  found unchanged, and read. */
+    int m_num_cached, m_num_verified, m_num_read;
+
+    /** Time (in ns since the epoch) at which the scan started which wrote
+     *  the loaded manifest, and at which this scan started. */
+    int64_t m_manifest_time, m_scan_time;
+
+    // ------------------------------------------------------------------------
+    static bool getFileInfo(const std::string &path, int64_t *mtime,
+                            int64_t *size);
+    // ------------------------------------------------------------------------
+    static bool readFile(const std::string &path, std::string *content);
+    // ------------------------------------------------------------------------
+    void load();
+    // ------------------------------------------------------------------------
+    void save();
+    // ------------------------------------------------------------------------
+    bool isUnchanged(const Entry &entry, int64_t mtime, int64_t size) const;
+    // ------------------------------------------------------------------------
+    std::vector<std::string> listDirectory(const std::string &dir);
+
+public:
+    ManifestCache(const std::string &name);
+    // ------------------------------------------------------------------------
+    ~ManifestCache();
+    // ------------------------------------------------------------------------
+    std::vector<std::string> findDirectories(
+                          const std::vector<std::string> &search_path,
+                          const std::string &separator,
+                          const std::string &file_name,
+                          const std::vector<std::string> &extra_files =
+                                                   std::vector<std::string>());
+    // ------------------------------------------------------------------------
+    XMLNode* takeTree(const std::string &filename);
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // ManifestCache
+
+#endif
@@ -18,19 +18,169 @@
 
 #include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
+#include "utils/file_utils.hpp"
 #include "utils/interpolation_array.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 #include "utils/vec3.hpp"
 
+#include <cstring>
+#include <cwchar>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
 #include <stdexcept>
+#include <unordered_set>
 
+#include <IFileSystem.h>
+#include <IReadFile.h>
+
+/** The memory of a tree. Nodes, attributes and strings are allocated from
+ *  large blocks, and never freed individually.
+ */
+class XMLNode::Arena : public NoCopy
+{
+private:
+    static const size_t BLOCK_SIZE = 16384;
+
+    std::vector<char*> m_blocks;
+
+    /** Bytes used in the last block. */
+    size_t m_used;
+
+    size_t m_total_size;
+
+    /** All names and file names, only one copy of each. */
+    std::unordered_set<std::string> m_strings;
+
+public:
+    /** Children of all nodes which are currently being read. */
+    std::vector<XMLNode*> m_children;
+
+    /** Reused while converting names and values. */
+    std::string m_buffer;
+
+    // ------------------------------------------------------------------------
+    Arena() : m_used(BLOCK_SIZE), m_total_size(0) {}
+    // ------------------------------------------------------------------------
+    ~Arena()
+    {
+        for (char *block : m_blocks)
+            delete [] block;
+    }   // ~Arena
+    // ------------------------------------------------------------------------
+    void* allocate(size_t size, size_t align)
+    {
+        // Large allocations get their own block, before the current one
+        if (size > BLOCK_SIZE / 4)
+        {
+            char *block = new char[size];
+            m_blocks.insert(m_blocks.end() - (m_blocks.empty() ? 0 : 1),
+                            block);
+            m_total_size += size;
+            return block;
+        }
+        size_t start = (m_used + align - 1) & ~(align - 1);
+        if (start + size > BLOCK_SIZE)
+        {
+            m_blocks.push_back(new char[BLOCK_SIZE]);
+            m_total_size += BLOCK_SIZE;
+            start = 0;
+        }
+        m_used = start + size;
+        return m_blocks.back() + start;
+    }   // allocate
+    // ------------------------------------------------------------------------
+    template<typename T> T* allocateArray(size_t n)
+    {
+        return n == 0 ? NULL : (T*)allocate(n * sizeof(T), alignof(T));
+    }   // allocateArray
+    // ------------------------------------------------------------------------
+    const std::string* intern(const std::string &s)
+    {
+        return &*m_strings.insert(s).first;
+    }   // intern
+    // ------------------------------------------------------------------------
+    /** Stores a 0-terminated copy of the narrowed string (each character
+     *  is cut to 8 bits, which gives the bytes of an 8-bit file). If the
+     *  string has wider characters, a copy of it is stored as well.
+     */
+    const char* copyString(const wchar_t *s, const wchar_t **wide)
+    {
+        size_t length = wcslen(s);
+        char *copy = allocateArray<char>(length + 1);
+        bool is_wide = false;
+        for (size_t i = 0; i < length; i++)
+        {
+            copy[i] = (char)s[i];
+            is_wide |= (unsigned)s[i] > 0xff;
+        }
+        copy[length] = 0;
+        *wide = NULL;
+        if (is_wide)
+        {
+            wchar_t *wide_copy = allocateArray<wchar_t>(length + 1);
+            memcpy(wide_copy, s, (length + 1) * sizeof(wchar_t));
+            *wide = wide_copy;
+        }
+        return copy;
+    }   // copyString
+    // ------------------------------------------------------------------------
+    /** Returns the interned, narrowed copy of a name. */
+    const std::string* internName(const wchar_t *s)
+    {
+        m_buffer.clear();
+        for (; *s; s++)
+            m_buffer.push_back((char)*s);
+        return intern(m_buffer);
+    }   // internName
+    // ------------------------------------------------------------------------
+    size_t getMemoryUsage() const
+    {
+        size_t size = sizeof(*this) + m_total_size +
+                      m_blocks.capacity() * sizeof(char*);
+        for (const std::string &s : m_strings)
+            size += sizeof(s) + s.capacity() + 2 * sizeof(void*);
+        return size;
+    }   // getMemoryUsage
+};   // Arena
+
+// ----------------------------------------------------------------------------
+/** Creates an empty node, used for the nodes in the arena. */
+XMLNode::XMLNode()
+{
+    m_name           = NULL;
+    m_attributes     = NULL;
+    m_num_attributes = 0;
+    m_nodes          = NULL;
+    m_num_nodes      = 0;
+    m_file_name      = NULL;
+    m_arena          = NULL;
+}   // XMLNode
+
+// ----------------------------------------------------------------------------
+/** Sets up a root node, which owns the arena of the tree. */
+void XMLNode::init(const std::string &filename)
+{
+    m_arena          = new Arena();
+    m_file_name      = m_arena->intern(filename);
+    m_name           = m_arena->intern("");
+    m_attributes     = NULL;
+    m_num_attributes = 0;
+    m_nodes          = NULL;
+    m_num_nodes      = 0;
+}   // init
+
+// ----------------------------------------------------------------------------
 XMLNode::XMLNode(io::IXMLReader *xml)
 {
-    m_file_name = "[unknown]";
+    init("[unknown]");
 
     while(xml->getNodeType()!=io::EXN_ELEMENT && xml->read());
-    readXML(xml);
+    readXML(xml, m_arena);
 }   // XMLNode
 
 // ----------------------------------------------------------------------------
@@ -39,15 +189,35 @@ XMLNode::XMLNode(io::IXMLReader *xml)
  */
 XMLNode::XMLNode(const std::string &filename)
 {
-    m_file_name = filename;
+    init(filename);
 
     io::IXMLReader *xml = file_manager->createXMLReader(filename);
     
     if (xml == NULL)
     {
+        delete m_arena;
         throw std::runtime_error("Cannot find file "+filename);
     }
+    readDocument(xml);
+    xml->drop();
+}   // XMLNode
 
+// ----------------------------------------------------------------------------
+/** Converts a XML document which was already opened (e.g. from memory) into
+ *  a XMLNode tree.
+ *  \param filename Name of the XML file, only used in messages.
+ *  \param xml The XML reader, which is not dropped.
+ */
+XMLNode::XMLNode(const std::string &filename, io::IXMLReader *xml)
+{
+    init(filename);
+    readDocument(xml);
+}   // XMLNode
+
+// ----------------------------------------------------------------------------
+/** Reads the root element of a document. */
+void XMLNode::readDocument(io::IXMLReader *xml)
+{
     bool is_first_element = true;
     while(xml->read())
     {
@@ -59,9 +229,9 @@ XMLNode::XMLNode(const std::string &filename)
                 {
                     Log::warn("[XMLNode]",
                                 "More than one root element in '%s' - ignored.",
-                            filename.c_str());
+                            m_file_name->c_str());
                 }
-                readXML(xml);
+                readXML(xml, m_arena);
                 is_first_element = false;
                 break;
             }
@@ -72,54 +242,67 @@ XMLNode::XMLNode(const std::string &filename)
         default:                   break;
         }   // switch
     }   // while
-    xml->drop();
-}   // XMLNode
+}   // readDocument
 
 // ----------------------------------------------------------------------------
-/** Destructor. */
+/** Destructor. The nodes are in the arena of the root, so only their
+ *  destructors are called.
+ */
 XMLNode::~XMLNode()
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
-        delete m_nodes[i];
+        m_nodes[i]->~XMLNode();
     }
-    m_nodes.clear();
+    delete m_arena;
 }   // ~XMLNode
 
 // ----------------------------------------------------------------------------
 /** Stores all attributes, and reads in all children.
  *  \param xml The XML reader.
+ *  \param arena The arena of the tree.
  */
-void XMLNode::readXML(io::IXMLReader *xml)
+void XMLNode::readXML(io::IXMLReader *xml, Arena *arena)
 {
-    m_name = std::string(core::stringc(xml->getNodeName()).c_str());
+    m_name = arena->internName(xml->getNodeName());
 
-    for(unsigned int i=0; i<xml->getAttributeCount(); i++)
+    m_num_attributes = xml->getAttributeCount();
+    m_attributes = arena->allocateArray<Attribute>(m_num_attributes);
+    for(unsigned int i=0; i<m_num_attributes; i++)
     {
-        std::string   name  = core::stringc(xml->getAttributeName(i)).c_str();
-        core::stringw value = xml->getAttributeValue(i);
-        m_attributes[name] = value;
+        Attribute &a = m_attributes[i];
+        a.m_name        = arena->internName(xml->getAttributeName(i));
+        a.m_value       = arena->copyString(xml->getAttributeValue(i),
+                                            &a.m_wide_value);
+        a.m_cached_type = CT_NONE;
     }   // for i
 
     // If no children, we are done
     if(xml->isEmptyElement())
         return;
 
-    /** Read all children elements. */
-    while(xml->read())
+    /** Read all children elements. They are collected at the end of
+     *  m_children (which also holds the children of all parents), and
+     *  copied to the arena once this element is finished. */
+    const size_t first_child = arena->m_children.size();
+    bool done = false;
+    while(!done && xml->read())
     {
         switch (xml->getNodeType())
         {
         case io::EXN_ELEMENT:
             {
-                XMLNode* n = new XMLNode(xml);
+                void *memory = arena->allocate(sizeof(XMLNode),
+                                               alignof(XMLNode));
+                XMLNode* n = new (memory) XMLNode();
                 n->m_file_name = m_file_name;
-                m_nodes.push_back(n);
+                n->readXML(xml, arena);
+                arena->m_children.push_back(n);
                 break;
             }
         case io::EXN_ELEMENT_END:
             // End of this element found.
-            return;
+            done = true;
             break;
         case io::EXN_UNKNOWN:            break;
         case io::EXN_COMMENT:            break;
@@ -127,8 +310,26 @@ void XMLNode::readXML(io::IXMLReader *xml)
         default:                         break;
         }   // switch
     }   // while
+
+    m_num_nodes = (unsigned int)(arena->m_children.size() - first_child);
+    m_nodes = arena->allocateArray<XMLNode*>(m_num_nodes);
+    if (m_num_nodes > 0)
+    {
+        memcpy(m_nodes, arena->m_children.data() + first_child,
+               m_num_nodes * sizeof(XMLNode*));
+    }
+    arena->m_children.resize(first_child);
 }   // readXML
 
+// ----------------------------------------------------------------------------
+/** Returns the memory used by this tree (which is only known for the
+ *  root node).
+ */
+size_t XMLNode::getMemoryUsage() const
+{
+    return sizeof(*this) + (m_arena ? m_arena->getMemoryUsage() : 0);
+}   // getMemoryUsage
+
 // ----------------------------------------------------------------------------
 /** Returns the i.th node.
  *  \param i Number of node to return.
@@ -144,7 +345,7 @@ const XMLNode *XMLNode::getNode(unsigned int i) const
  */
 const XMLNode *XMLNode::getNode(const std::string &s) const
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
         if(m_nodes[i]->getName()==s) return m_nodes[i];
     }
@@ -158,7 +359,7 @@ const XMLNode *XMLNode::getNode(const std::string &s) const
  */
 const void XMLNode::getNodes(const std::string &s, std::vector<XMLNode*>& out) const
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
         if(m_nodes[i]->getName()==s)
         {
@@ -167,6 +368,20 @@ const void XMLNode::getNodes(const std::string &s, std::vector<XMLNode*>& out) c
     }
 }   // getNode
 
+// ----------------------------------------------------------------------------
+/** Returns the attribute with the given name, or NULL. Nodes have only a
+ *  few attributes, so they are searched linearly.
+ */
+const XMLNode::Attribute *XMLNode::getAttribute(const std::string &name) const
+{
+    for (unsigned int i = 0; i < m_num_attributes; i++)
+    {
+        if (*m_attributes[i].m_name == name)
+            return &m_attributes[i];
+    }
+    return NULL;
+}   // getAttribute
+
 // ----------------------------------------------------------------------------
 /** If 'attribute' was defined, set 'value' to the value of the
 *   attribute and return 1, otherwise return 0 and do not change value.
@@ -175,32 +390,35 @@ const void XMLNode::getNodes(const std::string &s, std::vector<XMLNode*>& out) c
 */
 int XMLNode::get(const std::string &attribute, std::string *value) const
 {
-    if(m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if(o==m_attributes.end()) return 0;
-    *value=core::stringc(o->second).c_str();
+    const Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    *value = a->m_value;
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, core::stringw *value) const
 {
-    if(m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if(o==m_attributes.end()) return 0;
-    *value = o->second;
+    const Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    if (a->m_wide_value)
+    {
+        *value = a->m_wide_value;
+        return 1;
+    }
+    // Each byte is one character, like the xml reader does for 8-bit files
+    const size_t length = strlen(a->m_value);
+    value->reserve((u32)length + 1);
+    *value = L"";
+    for (size_t i = 0; i < length; i++)
+        value->append((wchar_t)(unsigned char)a->m_value[i]);
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
 int XMLNode::getAndDecode(const std::string &attribute, core::stringw *value) const
 {
-    if (m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if (o == m_attributes.end()) return 0;
-    std::string raw_value = core::stringc(o->second).c_str();
-    *value = StringUtils::xmlDecode(raw_value);
+    const Attribute *a = getAttribute(attribute);
+    if (!a) return 0;
+    *value = StringUtils::xmlDecode(a->m_value);
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
@@ -229,14 +447,22 @@ int XMLNode::get(const std::string &attribute, core::vector3df *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, Vec3 *value) const
 {
-    std::string s = "";
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    if (a->m_cached_type == CT_VEC3)
+    {
+        value->setValue(a->m_cached.m_vec3[0], a->m_cached.m_vec3[1],
+                        a->m_cached.m_vec3[2]);
+        return 1;
+    }
+
+    std::string s = a->m_value;
 
     std::vector<std::string> v = StringUtils::split(s,' ');
     if (v.size() != 3)
     {
         Log::warn("[XMLNode]", "WARNING: Expected 3 floating-point values, but found '%s' in file %s",
-                    s.c_str(), m_file_name.c_str());
+                    s.c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -249,11 +475,15 @@ int XMLNode::get(const std::string &attribute, Vec3 *value) const
         value->setX(x);
         value->setY(y);
         value->setZ(z);
+        a->m_cached_type = CT_VEC3;
+        a->m_cached.m_vec3[0] = x;
+        a->m_cached.m_vec3[1] = y;
+        a->m_cached.m_vec3[2] = z;
     }
     else
     {
         Log::warn("[XMLNode]", "WARNING: Expected 3 floating-point values, but found '%s' in file %s",
-                    s.c_str(), m_file_name.c_str());
+                    s.c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -312,16 +542,24 @@ int XMLNode::get(const std::string &attribute, video::SColorf *color) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, int32_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    if (a->m_cached_type == CT_INT32)
+    {
+        *value = a->m_cached.m_int;
+        return 1;
+    }
 
+    std::string s = a->m_value;
     if (!StringUtils::parseString<int>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
+    a->m_cached_type = CT_INT32;
+    a->m_cached.m_int = *value;
     return 1;
 }   // get(int32_t)
 
@@ -334,7 +572,7 @@ int XMLNode::get(const std::string &attribute, int64_t *value) const
     if (!StringUtils::parseString<int64_t>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -350,7 +588,7 @@ int XMLNode::get(const std::string &attribute, uint64_t *value) const
     if (!StringUtils::parseString<uint64_t>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -366,7 +604,7 @@ int XMLNode::get(const std::string &attribute, uint16_t *value) const
     if (!StringUtils::parseString<uint16_t>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected uint but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -382,7 +620,7 @@ int XMLNode::get(const std::string &attribute, uint32_t *value) const
     if (!StringUtils::parseString<unsigned int>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected uint but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -392,16 +630,24 @@ int XMLNode::get(const std::string &attribute, uint32_t *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, float *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    const Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    if (a->m_cached_type == CT_FLOAT)
+    {
+        *value = a->m_cached.m_float;
+        return 1;
+    }
 
+    std::string s = a->m_value;
     if (!StringUtils::parseString<float>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected float but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s.c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
+    a->m_cached_type = CT_FLOAT;
+    a->m_cached.m_float = *value;
     return 1;
 }   // get(int)
 
@@ -415,7 +661,7 @@ int XMLNode::get(const std::string &attribute, double *value) const
     {
         Log::warn("[XMLNode]", "WARNING: Expected double but found '%s' for"
             " attribute '%s' of node '%s' in file %s", s.c_str(),
-            attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+            attribute.c_str(), m_name->c_str(), m_file_name->c_str());
         return 0;
     }
 
@@ -474,7 +720,7 @@ int XMLNode::get(const std::string &attribute,
         if (!StringUtils::parseString<float>(v[i], &curr))
         {
             Log::warn("[XMLNode]", "WARNING: Expected float but found '%s' for attribute '%s' of node '%s' in file %s",
-                        v[i].c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                        v[i].c_str(), attribute.c_str(), m_name->c_str(), m_file_name->c_str());
             return 0;
         }
 
@@ -505,7 +751,7 @@ int XMLNode::get(const std::string &attribute, std::vector<int> *value) const
         if (!StringUtils::parseString<int>(v[i], &val))
         {
             Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s'",
-                        v[i].c_str(), attribute.c_str(), m_name.c_str());
+                        v[i].c_str(), attribute.c_str(), m_name->c_str());
             return 0;
         }
 
@@ -658,9 +904,242 @@ int XMLNode::getHPR(Vec3 *value) const
 
 bool XMLNode::hasChildNamed(const char* name) const
 {
-    for (unsigned int i = 0; i < m_nodes.size(); i++)
+    for (unsigned int i = 0; i < m_num_nodes; i++)
     {
         if (m_nodes[i]->getName() == name) return true;
     }
     return false;
 }
+
+// ----------------------------------------------------------------------------
+void XMLNode::unitTesting()
+{
+    std::string xml = "<?xml version=\"1.0\"?>\n"
+        "<scene name=\"test\" count=\"3\" scale=\"1 2 3\">\n"
+        "  <!-- a comment -->\n"
+        "  <object id=\"a\" x=\"1.5\" y=\"-2\" z=\"3\" h=\"90\"/>\n"
+        "  <object id=\"b\" flag=\"Y\" text=\"caf\xc3\xa9\">\n"
+        "    <child bad=\"abc\"/>\n"
+        "  </object>\n"
+        "  <other/>\n";
+    // Enough nodes to use several blocks of the arena
+    for (int i = 0; i < 2000; i++)
+        xml += "  <item index=\"" + StringUtils::toString(i) + "\"/>\n";
+    xml += "</scene>\n";
+
+    XMLNode *root = file_manager->createXMLTreeFromString(xml);
+    if (!root || root->getName() != "scene" || root->getNumNodes() != 2003)
+        Log::fatal("XMLNode", "Wrong structure.");
+
+    std::string s;
+    int count;
+    Vec3 scale;
+    // Read everything twice, the second time the cached values are used
+    for (int i = 0; i < 2; i++)
+    {
+        if (!root->get("name", &s) || s != "test" ||
+            !root->get("count", &count) || count != 3 ||
+            !root->get("scale", &scale) || scale != Vec3(1, 2, 3) ||
+            root->get("missing", &s))
+            Log::fatal("XMLNode", "Wrong root attributes.");
+        const XMLNode *a = root->getNode("object");
+        core::vector3df xyz(0, 0, 0), hpr(0, 0, 0);
+        if (!a || a->getXYZ(&xyz) != 7 || xyz != core::vector3df(1.5f, -2, 3) ||
+            a->getHPR(&hpr) != 1 || hpr.X != 90.0f)
+            Log::fatal("XMLNode", "Wrong coordinates.");
+        // The same attribute can be read as a different type
+        if (!a->get("y", &count) || count != -2 || !a->get("y", &s) ||
+            s != "-2")
+            Log::fatal("XMLNode", "Wrong int.");
+    }
+
+    std::vector<XMLNode*> objects;
+    root->getNodes("object", objects);
+    bool flag = false;
+    core::stringw text;
+    if (objects.size() != 2 || !objects[1]->get("flag", &flag) || !flag ||
+        !objects[1]->get("text", &s) || s != "caf\xc3\xa9" ||
+        !objects[1]->get("text", &text) || text.size() != 5 ||
+        text[3] != 0xc3 || text[4] != 0xa9 ||
+        StringUtils::utf8ToWide(s) != L"caf\u00e9")
+        Log::fatal("XMLNode", "Wrong strings.");
+
+    float f;
+    const XMLNode *child = objects[1]->getNode(0);
+    if (!child || child->getName() != "child" || child->get("bad", &f) ||
+        !root->hasChildNamed("other") || root->hasChildNamed("x"))
+        Log::fatal("XMLNode", "Wrong child.");
+
+    for (unsigned int i = 3; i < root->getNumNodes(); i++)
+    {
+        int index = -1;
+        if (!root->getNode(i)->get("index", &index) || index != (int)i - 3)
+            Log::fatal("XMLNode", "Wrong item %u.", i);
+    }
+    delete root;
+}   // unitTesting
+
+// ----------------------------------------------------------------------------
+namespace
+{
+    /** The attributes read by XMLNode::benchmark(), as used in scene.xml
+     *  files. */
+    const char *BENCHMARK_VEC3[]  = { "xyz", "hpr", "scale" };
+    const char *BENCHMARK_FLOAT[] = { "x", "y", "z", "h", "p", "r" };
+
+    /** The tree of the previous XMLNode implementation (one allocation for
+     *  each node, attributes as wide strings in a map, parsed on each
+     *  access), only used to compare the speed in XMLNode::benchmark(). */
+    struct LegacyNode
+    {
+        std::string m_name;
+        std::map<std::string, core::stringw> m_attributes;
+        std::vector<std::unique_ptr<LegacyNode> > m_nodes;
+        // --------------------------------------------------------------------
+        void read(io::IXMLReader *xml)
+        {
+            m_name = core::stringc(xml->getNodeName()).c_str();
+            for (unsigned int i = 0; i < xml->getAttributeCount(); i++)
+            {
+                m_attributes[core::stringc(xml->getAttributeName(i)).c_str()]
+                    = xml->getAttributeValue(i);
+            }
+            if (xml->isEmptyElement())
+                return;
+            while (xml->read())
+            {
+                if (xml->getNodeType() == io::EXN_ELEMENT)
+                {
+                    m_nodes.emplace_back(new LegacyNode());
+                    m_nodes.back()->read(xml);
+                }
+                else if (xml->getNodeType() == io::EXN_ELEMENT_END)
+                    return;
+            }
+        }   // read
+        // --------------------------------------------------------------------
+        /** Reads the coordinates of each node twice, like the old getters
+         *  did. */
+        unsigned int readAll() const
+        {
+            unsigned int n = 0;
+            for (int i = 0; i < 2; i++)
+            {
+                for (const char *name : BENCHMARK_VEC3)
+                {
+                    auto it = m_attributes.find(name);
+                    if (it == m_attributes.end())
+                        continue;
+                    std::string s = core::stringc(it->second).c_str();
+                    std::vector<std::string> v = StringUtils::split(s, ' ');
+                    float f[3];
+                    if (v.size() == 3 &&
+                        StringUtils::parseString<float>(v[0], &f[0]) &&
+                        StringUtils::parseString<float>(v[1], &f[1]) &&
+                        StringUtils::parseString<float>(v[2], &f[2]))
+                        n++;
+                }
+                for (const char *name : BENCHMARK_FLOAT)
+                {
+                    auto it = m_attributes.find(name);
+                    if (it == m_attributes.end())
+                        continue;
+                    std::string s = core::stringc(it->second).c_str();
+                    float f;
+                    if (StringUtils::parseString<float>(s, &f))
+                        n++;
+                }
+            }
+            for (auto &node : m_nodes)
+                n += node->readAll();
+            return n;
+        }   // readAll
+    };   // LegacyNode
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Compares the speed of parsing each file and reading the coordinates of
+ *  all nodes (twice) with the previous implementation, and logs the
+ *  results. Started with --benchmark-xml.
+ *  \param files The XML files to use, e.g. the largest scene.xml files.
+ */
+void XMLNode::benchmark(const std::vector<std::string> &files)
+{
+    io::IFileSystem *file_system = file_manager->getFileSystem();
+    std::function<unsigned int(const XMLNode*)> read_all =
+        [&read_all](const XMLNode *node)
+    {
+        unsigned int n = 0;
+        for (int i = 0; i < 2; i++)
+        {
+            Vec3 v;
+            for (const char *name : BENCHMARK_VEC3)
+                n += node->get(name, &v);
+            float f;
+            for (const char *name : BENCHMARK_FLOAT)
+                n += node->get(name, &f);
+        }
+        for (unsigned int i = 0; i < node->getNumNodes(); i++)
+            n += read_all(node->getNode(i));
+        return n;
+    };
+
+    for (const std::string &file : files)
+    {
+        std::ifstream in(FileUtils::getPortableReadingPath(file),
+                         std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+        if (content.empty())
+        {
+            Log::error("XMLNode", "Can't read '%s'.", file.c_str());
+            continue;
+        }
+        auto create_reader = [&](io::IReadFile **f)
+        {
+            *f = file_system->createMemoryReadFile((void*)content.data(),
+                (s32)content.size(), file.c_str(), false);
+            return file_system->createXMLReader(*f);
+        };
+
+        const int iterations = 20;
+        double old_parse = 0, old_read = 0, new_parse = 0, new_read = 0;
+        unsigned int old_values = 0, new_values = 0;
+        size_t memory = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            io::IReadFile *f;
+            io::IXMLReader *xml = create_reader(&f);
+            double start = StkTime::getRealTime();
+            LegacyNode *legacy = new LegacyNode();
+            while (xml->getNodeType() != io::EXN_ELEMENT && xml->read());
+            legacy->read(xml);
+            double mid = StkTime::getRealTime();
+            old_values = legacy->readAll();
+            old_read += StkTime::getRealTime() - mid;
+            delete legacy;
+            old_parse += mid - start;
+            xml->drop();
+            f->drop();
+
+            xml = create_reader(&f);
+            start = StkTime::getRealTime();
+            XMLNode *node = new XMLNode(file, xml);
+            mid = StkTime::getRealTime();
+            new_values = read_all(node);
+            new_read += StkTime::getRealTime() - mid;
+            memory = node->getMemoryUsage();
+            delete node;
+            new_parse += mid - start;
+            xml->drop();
+            f->drop();
+        }
+        Log::info("XMLNode", "%s: old parse %.3lf ms, read %.3lf ms; new "
+                  "parse %.3lf ms, read %.3lf ms, %u KB; %u/%u values.",
+                  file.c_str(), old_parse * 1000.0 / iterations,
+                  old_read * 1000.0 / iterations,
+                  new_parse * 1000.0 / iterations,
+                  new_read * 1000.0 / iterations, (unsigned)(memory / 1024),
+                  old_values, new_values);
+    }
+}   // benchmark
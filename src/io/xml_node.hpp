@@ -42,21 +42,59 @@ class Vec3;
 
 /**
   * \brief utility class used to parse XML files
+  * All nodes of a tree, their attributes and all strings are allocated
+  * from one arena owned by the root node, so deleting the root frees the
+  * whole tree. Attribute names are interned, values are stored as UTF-8
+  * (i.e. the bytes of the file). Numbers and vectors are parsed when they
+  * are first requested, and the result is cached in the attribute, so the
+  * getters are not thread safe.
   * \ingroup io
   */
 class XMLNode : public NoCopy
 {
 private:
+    class Arena;
+
+    /** The type of value cached in an Attribute. */
+    enum CachedType { CT_NONE, CT_INT32, CT_FLOAT, CT_VEC3 };
+
+    struct Attribute
+    {
+        /** Interned name of the attribute. */
+        const std::string *m_name;
+        /** 0-terminated value. */
+        const char        *m_value;
+        /** The value as read, only set if it has characters which can't
+         *  be stored in 8 bits (e.g. in a UTF-16 file). */
+        const wchar_t     *m_wide_value;
+        mutable uint8_t    m_cached_type;
+        mutable union
+        {
+            int32_t m_int;
+            float   m_float;
+            float   m_vec3[3];
+        } m_cached;
+    };
+
     /** Name of this element. */
-    std::string                          m_name;
+    const std::string                   *m_name;
     /** List of all attributes. */
-    std::map<std::string, core::stringw> m_attributes;
+    Attribute                           *m_attributes;
+    unsigned int                         m_num_attributes;
     /** List of all sub nodes. */
-    std::vector<XMLNode *>               m_nodes;
+    XMLNode                            **m_nodes;
+    unsigned int                         m_num_nodes;
+
+    const std::string                   *m_file_name;
 
-    void readXML(io::IXMLReader *xml);
+    /** The memory of the tree, only set in the root node. */
+    Arena                               *m_arena;
 
-    std::string                          m_file_name;
+    XMLNode();
+    void init(const std::string &filename);
+    void readXML(io::IXMLReader *xml, Arena *arena);
+    void readDocument(io::IXMLReader *xml);
+    const Attribute *getAttribute(const std::string &name) const;
 
 public:
          LEAK_CHECK();
@@ -65,13 +103,15 @@ public:
          /** \throw runtime_error if the file is not found */
          XMLNode(const std::string &filename);
 
+         XMLNode(const std::string &filename, io::IXMLReader *xml);
+
         ~XMLNode();
 
-    const std::string &getName() const {return m_name; }
+    const std::string &getName() const {return *m_name; }
     const XMLNode     *getNode(const std::string &name) const;
     const void         getNodes(const std::string &s, std::vector<XMLNode*>& out) const;
     const XMLNode     *getNode(unsigned int i) const;
-    unsigned int       getNumNodes() const {return (unsigned int) m_nodes.size(); }
+    unsigned int       getNumNodes() const {return m_num_nodes; }
     int get(const std::string &attribute, std::string *value) const;
     int get(const std::string &attribute, core::stringw *value) const;
     int getAndDecode(const std::string &attribute, core::stringw *value) const;
@@ -99,7 +139,10 @@ public:
     int getHPR(Vec3 *value) const;
 
     bool hasChildNamed(const char* name) const;
-    const std::string& getFilename() const { return m_file_name; }
+    const std::string& getFilename() const { return *m_file_name; }
+    size_t getMemoryUsage() const;
+    static void unitTesting();
+    static void benchmark(const std::vector<std::string> &files);
 
     /** Handy functions to test the bit pattern returned by get(vector3df*).*/
     static bool hasX(int b) { return (b&1)==1; }
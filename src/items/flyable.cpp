@@ -256,11 +256,45 @@ void Flyable::getClosestKart(const AbstractKart **minKart,
     btTransform trans_projectile = (inFrontOf != NULL ? inFrontOf->getTrans()
                                                       : getTrans());
 
+    World *world = World::getWorld();
+    const ProximityIndex &index = world->getProximityIndex();
+    std::vector<unsigned int> karts;
+    // Karts further away than 50 from inFrontOf are ignored. Otherwise
+    // search in a growing radius until the closest kart found is closer
+    // than the radius: the distance used below is never smaller than the
+    // distance in the XZ plane, so all other karts are further away.
+    float radius = 50.0f;
+    const Vec3 center = inFrontOf != NULL ? inFrontOf->getXYZ()
+                                          : Vec3(trans_projectile.getOrigin());
+    while (true)
+    {
+        index.getKartsInRange(center, radius, &karts);
+        findClosestKart(karts, minKart, minDistSquared, minDelta, inFrontOf,
+                        backwards, trans_projectile);
+        if (inFrontOf != NULL || karts.size() == world->getNumKarts() ||
+            (*minKart && *minDistSquared <= radius * radius))
+            break;
+        radius *= 4.0f;
+    }
+}   // getClosestKart
+
+//-----------------------------------------------------------------------------
+/** Finds the closest kart of a list of karts, see getClosestKart above.
+ *  \param karts The world ids of the karts to test in increasing order.
+ *  \param trans_projectile The transform from which distances are measured.
+ */
+void Flyable::findClosestKart(const std::vector<unsigned int> &karts,
+                              const AbstractKart **minKart,
+                              float *minDistSquared, Vec3 *minDelta,
+                              const AbstractKart* inFrontOf,
+                              const bool backwards,
+                              const btTransform &trans_projectile) const
+{
     *minDistSquared = 999999.9f;
     *minKart = NULL;
 
     World *world = World::getWorld();
-    for(unsigned int i=0 ; i<world->getNumKarts(); i++ )
+    for (unsigned int i : karts)
     {
         AbstractKart *kart = world->getKart(i);
         // If a kart has star effect shown, the kart is immune, so
@@ -311,9 +345,9 @@ void Flyable::getClosestKart(const AbstractKart **minKart,
             *minKart  = kart;
             *minDelta = delta;
         }
-    }  // for i<getNumKarts
+    }  // for i in karts
 
-}   // getClosestKart
+}   // findClosestKart
 
 //-----------------------------------------------------------------------------
 /** Returns information on the parameters needed to hit a target kart moving
@@ -664,14 +698,14 @@ void Flyable::moveToInfinity(bool set_moveable_trans)
 }   // moveToInfinity
 
 // ----------------------------------------------------------------------------
-BareNetworkString* Flyable::saveState(std::vector<std::string>* ru)
+bool Flyable::saveState(BareNetworkString* buffer,
+                        std::vector<std::string>* ru)
 {
     if (m_has_hit_something)
-        return NULL;
+        return false;
 
     ru->push_back(getUniqueIdentity());
 
-    BareNetworkString* buffer = new BareNetworkString();
     uint16_t ticks_since_thrown_animation = (m_ticks_since_thrown & 32767) |
         (hasAnimation() ? 32768 : 0);
     buffer->addUInt16(ticks_since_thrown_animation);
@@ -685,7 +719,7 @@ BareNetworkString* Flyable::saveState(std::vector<std::string>* ru)
         CompressNetworkBody::compress(
             m_body.get(), m_motion_state.get(), buffer);
     }
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
@@ -29,6 +29,7 @@
 #include "utils/cpp2011.hpp"
 
 #include <irrString.h>
+#include <vector>
 namespace irr
 {
     namespace scene { class IMesh; }
@@ -165,6 +166,14 @@ protected:
                                      Vec3 *minDelta,
                                      const AbstractKart* inFrontOf=NULL,
                                      const bool backwards=false) const;
+    void              findClosestKart(const std::vector<unsigned int> &karts,
+                                      const AbstractKart **minKart,
+                                      float *minDistSquared,
+                                      Vec3 *minDelta,
+                                      const AbstractKart* inFrontOf,
+                                      const bool backwards,
+                                      const btTransform &trans_projectile)
+                                                                       const;
 
     void getLinearKartItemIntersection(const Vec3 &origin,
                                        const AbstractKart *target_kart,
@@ -259,8 +268,8 @@ public:
     // ------------------------------------------------------------------------
     virtual void computeError() OVERRIDE;
     // ------------------------------------------------------------------------
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru) OVERRIDE;
     // ------------------------------------------------------------------------
     virtual void restoreState(BareNetworkString *buffer, int count) OVERRIDE;
     // ------------------------------------------------------------------------
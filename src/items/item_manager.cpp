@@ -30,6 +30,7 @@
 #include "modes/easter_egg_hunt.hpp"
 #include "modes/profile_world.hpp"
 #include "network/network_config.hpp"
+#include "network/network_string.hpp"
 #include "network/race_event_manager.hpp"
 #include "physics/triangle_mesh.hpp"
 #include "tracks/arena_graph.hpp"
@@ -51,8 +52,8 @@ std::vector<scene::IMesh *>  ItemManager::m_item_lowres_mesh;
 std::vector<video::SColorf>  ItemManager::m_glow_color;
 std::vector<std::string>     ItemManager::m_icon;
 bool                         ItemManager::m_disable_item_collection = false;
-std::mt19937                 ItemManager::m_random_engine;
-uint32_t                     ItemManager::m_random_seed = 0;
+std::mt19937                 ItemManager::m_random_engine[PT_COUNT];
+uint32_t                     ItemManager::m_random_seed[PT_COUNT] = {};
 
 //-----------------------------------------------------------------------------
 /** Loads the default item meshes (high- and low-resolution).
@@ -590,6 +591,75 @@ void ItemManager::switchItemsInternal(std::vector<ItemState*> &all_items)
 
 }   // switchItems
 
+//-----------------------------------------------------------------------------
+/** Save all current items at current ticks, used by the server for live join
+ *  and for the snapshots of a history.
+ */
+void ItemManager::saveCompleteState(BareNetworkString* buffer) const
+{
+    const uint32_t all_items = (uint32_t)m_all_items.size();
+    buffer->addUInt32(World::getWorld()->getTicksSinceStart())
+        .addUInt32(m_switch_ticks).addUInt32(all_items);
+    for (unsigned i = 0; i < all_items; i++)
+    {
+        if (m_all_items[i])
+        {
+            buffer->addUInt8(1);
+            m_all_items[i]->saveCompleteState(buffer);
+        }
+        else
+            buffer->addUInt8(0);
+    }
+}   // saveCompleteState
+
+//-----------------------------------------------------------------------------
+/** Replaces the state of all items with one saved by saveCompleteState,
+ *  used when a snapshot of a history is restored. Items which don't exist
+ *  anymore are deleted, and dropped items which don't exist yet are
+ *  created.
+ */
+void ItemManager::restoreAllItems(const BareNetworkString& buffer)
+{
+    buffer.getUInt32();
+    m_switch_ticks = (int)buffer.getUInt32();
+    const uint32_t all_items = buffer.getUInt32();
+    std::vector<std::unique_ptr<ItemState> > saved(all_items);
+    for (unsigned i = 0; i < all_items; i++)
+    {
+        if (buffer.getUInt8() == 1)
+            saved[i].reset(new ItemState(buffer));
+    }
+
+    const size_t max_index = std::max((size_t)all_items, m_all_items.size());
+    m_all_items.resize(max_index, NULL);
+    for (unsigned i = 0; i < max_index; i++)
+    {
+        ItemState *item     = m_all_items[i];
+        const ItemState *is = i < all_items ? saved[i].get() : NULL;
+        if (is && item)
+        {
+            *item = *is;
+        }
+        else if (is && is->getPreviousOwner())
+        {
+            Vec3 xyz = is->getXYZ();
+            Vec3 normal = is->getNormal();
+            Item *item_new = dropNewItem(is->getType(), is->getPreviousOwner(),
+                                         &xyz, &normal);
+            *((ItemState*)item_new) = *is;
+            m_all_items[i] = item_new;
+            insertItemInQuad(item_new);
+        }
+        else if (item)
+        {
+            deleteItemInQuad(item);
+            delete item;
+            m_all_items[i] = NULL;
+        }
+    }
+    m_all_items.resize(all_items);
+}   // restoreAllItems
+
 //-----------------------------------------------------------------------------
 bool ItemManager::randomItemsForArena(const AlignedArray<btTransform>& pos)
 {
@@ -627,7 +697,7 @@ bool ItemManager::randomItemsForArena(const AlignedArray<btTransform>& pos)
                     "Use default item location.");
                 return false;
             }
-            uint32_t number = m_random_engine();
+            uint32_t number = m_random_engine[STKProcess::getType()]();
             Log::debug("[ItemManager]", "%u from random engine.", number);
             const int node = number % ALL_NODES;
 
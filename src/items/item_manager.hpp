@@ -24,6 +24,7 @@
 #include "items/item.hpp"
 #include "utils/aligned_array.hpp"
 #include "utils/no_copy.hpp"
+#include "utils/stk_process.hpp"
 #include "utils/vec3.hpp"
 
 #include <SColor.h>
@@ -53,9 +54,10 @@ private:
     /** Disable item collection (for debugging purposes). */
     static bool m_disable_item_collection;
 
-    static std::mt19937 m_random_engine;
+    /** Random engine for item placement of each process. */
+    static std::mt19937 m_random_engine[PT_COUNT];
 
-    static uint32_t m_random_seed;
+    static uint32_t m_random_seed[PT_COUNT];
 
     static bool preloadIcon(const std::string& name);
 public:
@@ -63,13 +65,14 @@ public:
     static void removeTextures();
     static void updateRandomSeed(uint32_t seed_number)
     {
-        m_random_engine.seed(seed_number);
-        m_random_seed = seed_number;
+        ProcessType pt = STKProcess::getType();
+        m_random_engine[pt].seed(seed_number);
+        m_random_seed[pt] = seed_number;
     }   // updateRandomSeed
     // ------------------------------------------------------------------------
     static uint32_t getRandomSeed()
     {
-        return m_random_seed;
+        return m_random_seed[STKProcess::getType()];
     }   // getRandomSeed
 
     // ------------------------------------------------------------------------
@@ -149,6 +152,8 @@ public:
     virtual void   collectedItem   (ItemState *item, AbstractKart *kart);
     virtual void   switchItems     ();
     bool           randomItemsForArena(const AlignedArray<btTransform>& pos);
+    void           saveCompleteState(BareNetworkString* buffer) const;
+    void           restoreAllItems (const BareNetworkString& buffer);
 
     // ------------------------------------------------------------------------
     /** Returns true if the items are switched atm. */
@@ -218,30 +218,22 @@ void NetworkItemManager::setItemConfirmationTime(std::weak_ptr<STKPeer> peer,
  *  This function is also called on the client in the first frame of a race
  *  to save the initial state, which is the first confirmed state by all
  *  clients.
+ *  \param[out] buffer The buffer to write the state to.
+ *  \param[out] ru The unique identity of rewinder writing to.
  */
-BareNetworkString* NetworkItemManager::saveState(std::vector<std::string>* ru)
+bool NetworkItemManager::saveState(BareNetworkString* buffer,
+                                   std::vector<std::string>* ru)
 {
     ru->push_back(getUniqueIdentity());
     // On the server:
     // ==============
     m_item_events.lock();
-    uint16_t n = (uint16_t)m_item_events.getData().size();
-    if(n==0)
-    {
-        BareNetworkString *s = new BareNetworkString();
-        m_item_events.unlock();
-        return s;
-    }
-
-    BareNetworkString *s =
-        new BareNetworkString(n * (  sizeof(int) + sizeof(uint16_t)
-                                   + sizeof(uint8_t)              ) );
     for (auto p : m_item_events.getData())
     {
-        p.saveState(s);
+        p.saveState(buffer);
     }
     m_item_events.unlock();
-    return s;
+    return true;
 }   // saveState
 
 //-----------------------------------------------------------------------------
@@ -516,26 +508,6 @@ void NetworkItemManager::restoreState(BareNetworkString *buffer, int count)
     m_confirmed_switch_ticks = m_switch_ticks;
 }   // restoreState
 
-//-----------------------------------------------------------------------------
-/** Save all current items at current ticks in server for live join
- */
-void NetworkItemManager::saveCompleteState(BareNetworkString* buffer) const
-{
-    const uint32_t all_items = (uint32_t)m_all_items.size();
-    buffer->addUInt32(World::getWorld()->getTicksSinceStart())
-        .addUInt32(m_switch_ticks).addUInt32(all_items);
-    for (unsigned i = 0; i < all_items; i++)
-    {
-        if (m_all_items[i])
-        {
-            buffer->addUInt8(1);
-            m_all_items[i]->saveCompleteState(buffer);
-        }
-        else
-            buffer->addUInt8(0);
-    }
-}   // saveCompleteState
-
 //-----------------------------------------------------------------------------
 /** Restore all current items at current ticks in client for live join
  *  or at the start of a race.
@@ -81,8 +81,8 @@ public:
                               const AbstractKart *kart,
                               const Vec3 *server_xyz = NULL,
                               const Vec3 *server_normal = NULL) OVERRIDE;
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru) OVERRIDE;
     virtual void restoreState(BareNetworkString *buffer, int count) OVERRIDE;
     // ------------------------------------------------------------------------
     virtual void rewindToEvent(BareNetworkString *bns) OVERRIDE {};
@@ -107,8 +107,6 @@ public:
         m_last_confirmed_item_ticks.erase(peer);
     }
     // ------------------------------------------------------------------------
-    void saveCompleteState(BareNetworkString* buffer) const;
-    // ------------------------------------------------------------------------
     void restoreCompleteState(const BareNetworkString& buffer);
     // ------------------------------------------------------------------------
     void initServer();
@@ -254,18 +254,18 @@ void Plunger::hitTrack()
 }   // hitTrack
 
 // ----------------------------------------------------------------------------
-BareNetworkString* Plunger::saveState(std::vector<std::string>* ru)
+bool Plunger::saveState(BareNetworkString* buffer,
+                        std::vector<std::string>* ru)
 {
-    BareNetworkString* buffer = Flyable::saveState(ru);
-    if (!buffer)
-        return NULL;
+    if (!Flyable::saveState(buffer, ru))
+        return false;
 
     buffer->addUInt16(m_keep_alive);
     if (m_rubber_band)
         buffer->addUInt8(m_rubber_band->get8BitState());
     else
         buffer->addUInt8(255);
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
@@ -43,7 +43,8 @@ PowerupManager* powerup_manager = nullptr;
 /** The constructor initialises everything to zero. */
 PowerupManager::PowerupManager()
 {
-    m_random_seed.store(0);
+    for (unsigned i = 0; i < PT_COUNT; i++)
+        m_random_seed[i].store(0);
     for(int i=0; i<POWERUP_MAX; i++)
     {
         m_all_meshes[i] = nullptr;
@@ -570,25 +571,26 @@ void PowerupManager::computeWeightsForRace(int num_karts)
 
     // Check if we have exactly one entry (e.g. either class with only one
     // set of data specified, or an exact match):
-    m_current_item_weights.reset();
+    WeightsData& current_item_weights = getCurrentItemWeights();
+    current_item_weights.reset();
     if(prev_index == next_index)
     {
         // Just create a copy of this entry:
-        m_current_item_weights = *wd[prev_index];
+        current_item_weights = *wd[prev_index];
         // The number of karts might need to be increased to make
         // sure enough weight list for all ranks are created: e.g.
         // in soccer mode there is only one weight list (for 1 kart)
         // but we still need to make sure to create rank weight list
         // for all possible ranks
-        m_current_item_weights.setNumKarts(num_karts);
+        current_item_weights.setNumKarts(num_karts);
     }
     else
     {
         // We need to interpolate between prev_index and next_index
-        m_current_item_weights.interpolate(wd[prev_index], wd[next_index],
-                                           num_karts                      );
+        current_item_weights.interpolate(wd[prev_index], wd[next_index],
+                                         num_karts                      );
     }
-    m_current_item_weights.precomputeWeights();
+    current_item_weights.precomputeWeights();
 }   // computeWeightsForRace
 
 // ----------------------------------------------------------------------------
@@ -606,7 +608,7 @@ PowerupManager::PowerupType PowerupManager::getRandomPowerup(unsigned int pos,
                                                              unsigned int *n,
                                                              uint64_t random_number)
 {
-    int powerup = m_current_item_weights.getRandomItem(pos-1, random_number);
+    int powerup = getCurrentItemWeights().getRandomItem(pos-1, random_number);
     if(powerup > POWERUP_LAST)
     {
         powerup -= (POWERUP_LAST-POWERUP_FIRST+1);
@@ -638,7 +640,7 @@ void PowerupManager::unitTesting()
     // ----------------------------------------------------------
     RaceManager::get()->setMinorMode(RaceManager::MINOR_MODE_TUTORIAL);
     powerup_manager->computeWeightsForRace(1);
-    WeightsData wd = powerup_manager->m_current_item_weights;
+    WeightsData wd = powerup_manager->getCurrentItemWeights();
     int num_weights = wd.m_summed_weights_for_rank[0].back();
     for(int i=0; i<num_weights; i++)
     {
@@ -654,7 +656,7 @@ void PowerupManager::unitTesting()
     RaceManager::get()->setMinorMode(RaceManager::MINOR_MODE_NORMAL_RACE);
     int num_karts = 5;
     powerup_manager->computeWeightsForRace(num_karts);
-    wd = powerup_manager->m_current_item_weights;
+    wd = powerup_manager->getCurrentItemWeights();
 
     int position = 5;
     int section, next;
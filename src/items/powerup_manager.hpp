@@ -21,6 +21,7 @@
 
 #include "utils/leak_check.hpp"
 #include "utils/no_copy.hpp"
+#include "utils/stk_process.hpp"
 #include "utils/types.hpp"
 
 #include "btBulletDynamicsCommon.h"
@@ -149,14 +150,19 @@ private:
         has none. */
     irr::scene::IMesh *m_all_meshes[POWERUP_MAX];
 
-    /** The weight distribution to be used for the current race. */
-    WeightsData m_current_item_weights;
+    /** The weight distribution to be used for the current race of each
+     *  process. */
+    WeightsData m_current_item_weights[PT_COUNT];
 
     PowerupType   getPowerupType(const std::string &name) const;
 
     /** Seed for random powerup, for local game it will use a random number,
      *  for network games it will use the start time from server. */
-    std::atomic<uint64_t> m_random_seed;
+    std::atomic<uint64_t> m_random_seed[PT_COUNT];
+
+    // ------------------------------------------------------------------------
+    WeightsData& getCurrentItemWeights()
+                   { return m_current_item_weights[STKProcess::getType()]; }
 
 public:
     static void unitTesting();
@@ -179,9 +185,11 @@ public:
      *  \param type Mesh type for which the model is returned. */
     irr::scene::IMesh *getMesh(int type) const {return m_all_meshes[type];}
     // ------------------------------------------------------------------------
-    uint64_t getRandomSeed() const { return m_random_seed.load(); }
+    uint64_t getRandomSeed() const
+                       { return m_random_seed[STKProcess::getType()].load(); }
     // ------------------------------------------------------------------------
-    void setRandomSeed(uint64_t seed) { m_random_seed.store(seed); }
+    void setRandomSeed(uint64_t seed)
+                        { m_random_seed[STKProcess::getType()].store(seed); }
 
 };   // class PowerupManager
 
@@ -84,6 +84,7 @@ void ProjectileManager::removeTextures()
 void ProjectileManager::cleanup()
 {
     m_active_projectiles.clear();
+    m_generation++;
     for(HitEffects::iterator i  = m_active_hit_effects.begin();
         i != m_active_hit_effects.end(); ++i)
     {
@@ -156,7 +157,10 @@ void ProjectileManager::updateServer(int ticks)
             // Flyables will be deleted by computeError in client
             if (!NetworkConfig::get()->isNetworking() ||
                 NetworkConfig::get()->isServer())
+            {
                 p = m_active_projectiles.erase(p);
+                m_generation++;
+            }
         }
         else
             p++;
@@ -203,12 +207,28 @@ std::shared_ptr<Flyable>
     // This cannot be done in constructor because of virtual function
     f->onFireFlyable();
     m_active_projectiles[uid] = f;
+    m_generation++;
     if (RewindManager::get()->isEnabled())
         f->addForRewind(uid);
 
     return f;
 }   // newProjectile
 
+// -----------------------------------------------------------------------------
+/** Returns all projectiles which can be within the given distance of a point,
+ *  using the proximity index of the world if it is up to date.
+ */
+void ProjectileManager::getNearbyProjectiles(const Vec3 &xyz, float radius,
+                                             std::vector<Flyable*> *nearby)
+{
+    if (World::getWorld()->getProximityIndex()
+                          .getProjectilesInRange(xyz, radius, nearby))
+        return;
+    nearby->clear();
+    for (auto &p : m_active_projectiles)
+        nearby->push_back(p.second.get());
+}   // getNearbyProjectiles
+
 // -----------------------------------------------------------------------------
 /** Returns true if a projectile is within the given distance of the specified
  *  kart.
@@ -219,11 +239,13 @@ bool ProjectileManager::projectileIsClose(const AbstractKart * const kart,
                                          float radius)
 {
     float r2 = radius * radius;
-    for (auto i = m_active_projectiles.begin(); i != m_active_projectiles.end(); i++)
+    std::vector<Flyable*> nearby;
+    getNearbyProjectiles(kart->getXYZ(), radius, &nearby);
+    for (Flyable *f : nearby)
     {
-        if (!i->second->hasServerState())
+        if (!f->hasServerState())
             continue;
-        float dist2 = i->second->getXYZ().distance2(kart->getXYZ());
+        float dist2 = f->getXYZ().distance2(kart->getXYZ());
         if (dist2 < r2)
             return true;
     }
@@ -243,16 +265,18 @@ int ProjectileManager::getNearbyProjectileCount(const AbstractKart * const kart,
 {
     float r2 = radius * radius;
     int projectile_count = 0;
-    for (auto i = m_active_projectiles.begin(); i != m_active_projectiles.end(); i++)
+    std::vector<Flyable*> nearby;
+    getNearbyProjectiles(kart->getXYZ(), radius, &nearby);
+    for (Flyable *f : nearby)
     {
-        if (!i->second->hasServerState())
+        if (!f->hasServerState())
             continue;
-        if (i->second->getType() == type)
+        if (f->getType() == type)
         {
-            if (exclude_owned && (i->second->getOwner() == kart))
+            if (exclude_owned && (f->getOwner() == kart))
                 continue;
 
-            float dist2 = i->second->getXYZ().distance2(kart->getXYZ());
+            float dist2 = f->getXYZ().distance2(kart->getXYZ());
             if (dist2 < r2)
             {
                 projectile_count++;
@@ -369,6 +393,7 @@ std::shared_ptr<Rewinder>
         created_ticks);
 
     m_active_projectiles[uid] = f;
+    m_generation++;
     return f;
 }   // addProjectileFromNetworkState
 
@@ -55,9 +55,15 @@ private:
      *  being shown or have a sfx playing. */
     HitEffects       m_active_hit_effects;
 
+    /** Increased whenever a projectile is added or removed, so that the
+     *  ProximityIndex of the world can detect if it is outdated. */
+    unsigned int     m_generation;
+
     std::string      getUniqueIdentity(AbstractKart* kart,
                                        PowerupManager::PowerupType type);
     void             updateServer(int ticks);
+    void             getNearbyProjectiles(const Vec3 &xyz, float radius,
+                                          std::vector<Flyable*> *nearby);
 public:
     // ----------------------------------------------------------------------------------------
     static ProjectileManager* get();
@@ -68,7 +74,7 @@ public:
     // ----------------------------------------------------------------------------------------
     static void clear();
     // ----------------------------------------------------------------------------------------
-                     ProjectileManager() {}
+                     ProjectileManager() { m_generation = 0; }
                     ~ProjectileManager() {}
     void             loadData         ();
     void             cleanup          ();
@@ -95,11 +101,26 @@ public:
     // ------------------------------------------------------------------------
     std::vector<Vec3> getBasketballPositions();
     // ------------------------------------------------------------------------
+    /** Returns all active projectiles. */
+    const std::map<std::string, std::shared_ptr<Flyable> >&
+                        getActiveProjectiles() const
+                                                { return m_active_projectiles; }
+    // ------------------------------------------------------------------------
+    /** Returns a number which changes whenever a projectile is added or
+     *  removed. */
+    unsigned int getGeneration() const               { return m_generation; }
+    // ------------------------------------------------------------------------
     void addByUID(const std::string& uid, std::shared_ptr<Flyable> f)
-                                             { m_active_projectiles[uid] = f; }
+    {
+        m_active_projectiles[uid] = f;
+        m_generation++;
+    }   // addByUID
     // ------------------------------------------------------------------------
     void removeByUID(const std::string& uid)
-                                           { m_active_projectiles.erase(uid); }
+    {
+        m_active_projectiles.erase(uid);
+        m_generation++;
+    }   // removeByUID
 };
 
 #endif
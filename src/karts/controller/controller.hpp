@@ -62,6 +62,11 @@ public:
     virtual      ~Controller         () {};
     virtual void  reset              () = 0;
     virtual void  update             (int ticks) = 0;
+    /** Called for all karts in parallel before the karts are updated.
+     *  It must only read the world and write to this controller, the
+     *  results can then be used in update(), which is called in kart
+     *  order. */
+    virtual void  prepareUpdate      (int ticks) {}
     virtual void  handleZipper       (bool play_sound) = 0;
     virtual void  collectedItem      (const ItemState &item,
                                       float previous_energy=0) = 0;
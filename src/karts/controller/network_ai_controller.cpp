@@ -57,19 +57,31 @@ bool NetworkAIController::isLocalPlayerController() const
     return NetworkConfig::get()->isNetworkAIInstance();
 }   // isLocalPlayerController
 
+// ----------------------------------------------------------------------------
+/** Returns true if the AI controller should be updated in this frame. */
+bool NetworkAIController::updateAINow() const
+{
+    return !RewindManager::get()->isRewinding() &&
+        (World::getWorld()->isStartPhase() ||
+        World::getWorld()->getTicksSinceStart() > m_prev_update_ticks);
+}   // updateAINow
+
+// ----------------------------------------------------------------------------
+void NetworkAIController::prepareUpdate(int ticks)
+{
+    if (updateAINow())
+        m_ai_controller->prepareUpdate(m_ai_frequency);
+}   // prepareUpdate
+
 // ----------------------------------------------------------------------------
 void NetworkAIController::update(int ticks)
 {
-    if (!RewindManager::get()->isRewinding())
+    if (updateAINow())
     {
-        if (World::getWorld()->isStartPhase() ||
-            World::getWorld()->getTicksSinceStart() > m_prev_update_ticks)
-        {
-            m_prev_update_ticks = World::getWorld()->getTicksSinceStart() +
-                m_ai_frequency;
-            m_ai_controller->update(m_ai_frequency);
-            convertAIToPlayerActions();
-        }
+        m_prev_update_ticks = World::getWorld()->getTicksSinceStart() +
+            m_ai_frequency;
+        m_ai_controller->update(m_ai_frequency);
+        convertAIToPlayerActions();
     }
     PlayerController::update(ticks);
 }   // update
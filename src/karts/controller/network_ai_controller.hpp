@@ -32,11 +32,13 @@ private:
     AIBaseController* m_ai_controller;
     KartControl* m_ai_controls;
     void convertAIToPlayerActions();
+    bool updateAINow() const;
 public:
                  NetworkAIController(AbstractKart *kart, int local_player_id,
                                      AIBaseController* ai);
     virtual     ~NetworkAIController();
     virtual void update(int ticks) OVERRIDE;
+    virtual void prepareUpdate(int ticks) OVERRIDE;
     virtual void reset() OVERRIDE;
     // ------------------------------------------------------------------------
     virtual bool isLocalPlayerController() const OVERRIDE;
@@ -179,6 +179,7 @@ void SkiddingAI::reset()
     m_skid_probability_state     = SKID_PROBAB_NOT_YET;
     m_last_item_random           = NULL;
     m_burster                    = false;
+    m_prepared                   = false;
 
     AIBaseLapController::reset();
     m_track_node               = Graph::UNKNOWN_SECTOR;
@@ -217,6 +218,33 @@ unsigned int SkiddingAI::getNextSector(unsigned int index)
     return m_successor_index[index];
 }   // getNextSector
 
+//-----------------------------------------------------------------------------
+/** Does the decision work which only depends on the state of the world at
+ *  the start of this frame: finding the nearest karts, the crashes and the
+ *  point to aim at. This is called for all AI karts in parallel, so it must
+ *  not change anything except this controller.
+ */
+void SkiddingAI::prepareUpdate(int ticks)
+{
+    m_prepared = false;
+    if (m_kart->getKartAnimation() || m_world->isStartPhase())
+        return;
+
+    computeNearestKarts();
+    checkCrashes(m_kart->getXYZ());
+    m_prepared_last_node = Graph::UNKNOWN_SECTOR;
+    switch(m_point_selection_algorithm)
+    {
+    case PSA_NEW:    findNonCrashingPointNew(&m_prepared_aim_point,
+                                             &m_prepared_last_node);
+                     break;
+    case PSA_DEFAULT:findNonCrashingPoint(&m_prepared_aim_point,
+                                          &m_prepared_last_node);
+                     break;
+    }
+    m_prepared = true;
+}   // prepareUpdate
+
 //-----------------------------------------------------------------------------
 /** This is the main entry point for the AI.
  *  It is called once per frame for each AI and determines the behaviour of
@@ -242,7 +270,10 @@ void SkiddingAI::update(int ticks)
 
     // Don't do anything if there is currently a kart animations shown.
     if(m_kart->getKartAnimation())
+    {
+        m_prepared = false;
         return;
+    }
 
     if (m_superpower == RaceManager::SUPERPOWER_NOLOK_BOSS)
     {
@@ -314,6 +345,7 @@ void SkiddingAI::update(int ticks)
         else
             RescueAnimation::create(m_kart);
         AIBaseLapController::update(ticks);
+        m_prepared = false;
         return;
     }
 
@@ -321,11 +353,13 @@ void SkiddingAI::update(int ticks)
     {
         handleRaceStart();
         AIBaseLapController::update(ticks);
+        m_prepared = false;
         return;
     }
 
     // Get information that is needed by more than 1 of the handling funcs
-    computeNearestKarts();
+    if (!m_prepared)
+        computeNearestKarts();
 
     if (!m_enabled_network_ai)
     {
@@ -341,7 +375,8 @@ void SkiddingAI::update(int ticks)
     }
 
     //Detect if we are going to crash with the track and/or kart
-    checkCrashes(m_kart->getXYZ());
+    if (!m_prepared)
+        checkCrashes(m_kart->getXYZ());
     determineTrackDirection();
 
     /*Response handling functions*/
@@ -356,6 +391,7 @@ void SkiddingAI::update(int ticks)
 
     /*And obviously general kart stuff*/
     AIBaseLapController::update(ticks);
+    m_prepared = false;
 }   // update
 
 //-----------------------------------------------------------------------------
@@ -469,12 +505,20 @@ void SkiddingAI::handleSteering(float dt)
         Vec3 aim_point;
         int last_node = Graph::UNKNOWN_SECTOR;
 
-        switch(m_point_selection_algorithm)
+        if (m_prepared)
+        {
+            aim_point = m_prepared_aim_point;
+            last_node = m_prepared_last_node;
+        }
+        else
         {
-        case PSA_NEW:    findNonCrashingPointNew(&aim_point, &last_node);
-                         break;
-        case PSA_DEFAULT:findNonCrashingPoint(&aim_point, &last_node);
-                         break;
+            switch(m_point_selection_algorithm)
+            {
+            case PSA_NEW:    findNonCrashingPointNew(&aim_point, &last_node);
+                             break;
+            case PSA_DEFAULT:findNonCrashingPoint(&aim_point, &last_node);
+                             break;
+            }
         }
 #ifdef AI_DEBUG
         m_debug_sphere[m_point_selection_algorithm]->setPosition(aim_point.toIrrVector());
@@ -1928,13 +1972,8 @@ void SkiddingAI::computeNearestKarts()
     std::sort(overall_distance.begin(), overall_distance.end(), std::greater<float>());
    
     // Get the AI's position (the position update may not be done, leading to crashes)
-    int curr_position = 1;
-    for(unsigned int i=0; i<m_world->getNumKarts(); i++)
-    {
-        if(   m_world->getOverallDistance(i) > own_overall_distance
-           && !m_world->getKart(i)->isEliminated())
-            curr_position++;
-    }
+    int curr_position = 1 + m_world->getProximityIndex()
+                            .countKartsAhead(m_world, own_overall_distance);
 
     for(unsigned int i=0; i<n; i++)
     {
@@ -2486,8 +2525,6 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
         m_crashes.m_kart = slip->getSlipstreamTarget()->getWorldKartId();
     }
 
-    const size_t NUM_KARTS = m_world->getNumKarts();
-
     float speed = m_kart->getVelocity().length();
     // If the velocity is zero, no sense in checking for crashes in time
     if(speed==0) return;
@@ -2505,6 +2542,14 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
                   steps, m_kart_length, m_kart->getVelocityLC().getZ());
         steps=1000;
     }
+
+    // Only karts which can be reached in the tested time need to be tested:
+    // this kart moves steps*m_kart_length, the other karts at most
+    // max_speed*steps*dt.
+    const ProximityIndex &index = m_world->getProximityIndex();
+    index.getKartsInRange(pos, m_kart_length * (steps + 1) +
+                               index.getMaxSpeed() * steps * dt,
+                          &m_nearby_karts);
     for(int i = 1; steps > i; ++i)
     {
         Vec3 step_coord = pos + vel_normal* m_kart_length * float(i);
@@ -2514,7 +2559,7 @@ void SkiddingAI::checkCrashes(const Vec3& pos )
          */
         if( m_crashes.m_kart == -1 )
         {
-            for( unsigned int j = 0; j < NUM_KARTS; ++j )
+            for (unsigned int j : m_nearby_karts)
             {
                 const AbstractKart* kart = m_world->getKart(j);
                 // Ignore eliminated karts
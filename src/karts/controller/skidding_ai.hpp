@@ -49,6 +49,7 @@
 #include "utils/random_generator.hpp"
 
 #include <line3d.h>
+#include <vector>
 
 class ItemManager;
 class ItemState;
@@ -236,6 +237,17 @@ private:
           m_point_selection_algorithm;
 
     ItemManager* m_item_manager;
+
+    /** True if prepareUpdate() has computed the nearest karts, the crashes
+     *  and the point to aim at for the next update(). */
+    bool m_prepared;
+
+    /** The point to aim at and its graph node found in prepareUpdate(). */
+    Vec3 m_prepared_aim_point;
+    int  m_prepared_last_node;
+
+    /** The karts tested in checkCrashes(), kept to avoid allocations. */
+    std::vector<unsigned int> m_nearby_karts;
 #ifdef AI_DEBUG
     /** For skidding debugging: shows the estimated turn shape. */
     ShowCurve **m_curve;
@@ -302,6 +314,7 @@ public:
                  SkiddingAI(AbstractKart *kart);
                 ~SkiddingAI();
     virtual void update      (int ticks);
+    virtual void prepareUpdate(int ticks);
     virtual void reset       ();
     virtual const irr::core::stringw& getNamePostfix() const;
 };
@@ -231,7 +231,10 @@ void KartProperties::load(const std::string &filename, const std::string &node)
     // Get the default values from STKConfig. This will also allocate any
     // pointers used in KartProperties
 
-    const XMLNode* root = new XMLNode(filename);
+    // The file might have been parsed already by a ManifestCache
+    const XMLNode* root = file_manager->createXMLTree(filename);
+    if (!root)
+        throw std::runtime_error("Cannot find file "+filename);
     std::string kart_type;
 
     if (root->get("type", &kart_type))
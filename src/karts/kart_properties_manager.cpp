@@ -28,6 +28,7 @@
 #include "graphics/material_manager.hpp"
 #include "guiengine/engine.hpp"
 #include "io/file_manager.hpp"
+#include "io/manifest_cache.hpp"
 #include "karts/kart_properties.hpp"
 #include "karts/xml_characteristic.hpp"
 #include "utils/log.hpp"
@@ -198,32 +199,25 @@ void KartPropertiesManager::removeKart(const std::string &ident)
 void KartPropertiesManager::loadAllKarts(bool loading_icon)
 {
     m_all_kart_dirs.clear();
-    std::vector<std::string>::const_iterator dir;
-    for(dir = m_kart_search_path.begin(); dir!=m_kart_search_path.end(); dir++)
+    // The kart.xml and materials.xml files are found and parsed by the
+    // worker threads, only the karts themselves are created here.
+    ManifestCache manifest("karts");
+    std::vector<std::string> dirs =
+        manifest.findDirectories(m_kart_search_path, "", "/kart.xml",
+                                 { "materials.xml" });
+    GUIEngine::reserveLoadingIcons((int)dirs.size());
+    for (const std::string &dir : dirs)
     {
-        // First check if there is a kart in the current directory
-        // -------------------------------------------------------
-        if(loadKart(*dir)) continue;
-
-        // If not, check each subdir of this directory.
-        // --------------------------------------------
-        std::set<std::string> result;
-        file_manager->listFiles(result, *dir);
-        GUIEngine::reserveLoadingIcons(result.size());
-        for(std::set<std::string>::const_iterator subdir=result.begin();
-            subdir!=result.end(); subdir++)
-        {
-            const bool loaded = loadKart(*dir+*subdir);
+        const bool loaded = loadKart(dir);
 
-            if (loaded && loading_icon)
-            {
-                GUIEngine::addLoadingIcon(irr_driver->getTexture(
-                    m_karts_properties[m_karts_properties.size()-1]
-                            .getAbsoluteIconFile()              )
-                                          );
-            }
-        }   // for all files in the currently handled directory
-    }   // for i
+        if (loaded && loading_icon)
+        {
+            GUIEngine::addLoadingIcon(irr_driver->getTexture(
+                m_karts_properties[m_karts_properties.size()-1]
+                        .getAbsoluteIconFile()              )
+                                      );
+        }
+    }   // for all directories
 }   // loadAllKarts
 
 //-----------------------------------------------------------------------------
@@ -40,8 +40,8 @@ public:
     ~KartRewinder() {}
     virtual void saveTransform() OVERRIDE;
     virtual void computeError() OVERRIDE;
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru)
-        OVERRIDE;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru) OVERRIDE;
     void reset() OVERRIDE;
     virtual void restoreState(BareNetworkString *p, int count) OVERRIDE;
     virtual void rewindToEvent(BareNetworkString *p) OVERRIDE {}
@@ -73,6 +73,12 @@ public:
     virtual void undoEvent(BareNetworkString *p) OVERRIDE {}
     // ------------------------------------------------------------------------
     virtual std::function<void()> getLocalStateRestoreFunction() OVERRIDE;
+    // ------------------------------------------------------------------------
+    virtual bool getRewindPosition(Vec3* xyz) const OVERRIDE
+    {
+        *xyz = m_body->getWorldTransform().getOrigin();
+        return true;
+    }
 
 
 };   // Rewinder
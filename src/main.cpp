@@ -220,6 +220,8 @@ extern "C" {
 #include "graphics/particle_kind_manager.hpp"
 #include "graphics/referee.hpp"
 #include "graphics/sp/sp_base.hpp"
+#include "graphics/sp/sp_culling.hpp"
+#include "graphics/sp/sp_draw_list.hpp"
 #include "graphics/sp/sp_shader.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/event_handler.hpp"
@@ -230,6 +232,7 @@ extern "C" {
 #include "input/keyboard_device.hpp"
 #include "input/wiimote_manager.hpp"
 #include "io/file_manager.hpp"
+#include "io/manifest_cache.hpp"
 #include "items/attachment_manager.hpp"
 #include "items/item_manager.hpp"
 #include "items/network_item_manager.hpp"
@@ -244,9 +247,15 @@ extern "C" {
 #include "karts/official_karts.hpp"
 #include "modes/cutscene_world.hpp"
 #include "modes/demo_world.hpp"
+#include "modes/proximity_index.hpp"
+#include "modes/race_benchmark.hpp"
 #include "network/protocols/connect_to_server.hpp"
 #include "network/protocols/client_lobby.hpp"
 #include "network/protocols/server_lobby.hpp"
+#include "network/ban_index.hpp"
+#include "network/database_connector.hpp"
+#include "network/event.hpp"
+#include "network/load_generator.hpp"
 #include "network/network.hpp"
 #include "network/network_config.hpp"
 #include "network/network_string.hpp"
@@ -255,14 +264,17 @@ extern "C" {
 #include "network/protocols/server_lobby.hpp"
 #include "network/race_event_manager.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/rewind_profiler.hpp"
 #include "network/rewind_queue.hpp"
 #include "network/server.hpp"
 #include "network/server_config.hpp"
+#include "network/server_rooms.hpp"
 #include "network/servers_manager.hpp"
 #include "network/socket_address.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
 #include "online/profile_manager.hpp"
+#include "physics/triangle_mesh.hpp"
 #include "online/request_manager.hpp"
 #include "race/grand_prix_manager.hpp"
 #include "race/highscore_manager.hpp"
@@ -281,6 +293,7 @@ extern "C" {
 #include "tracks/arena_graph.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
+#include "utils/bounded_queue.hpp"
 #include "utils/command_line.hpp"
 #include "utils/constants.hpp"
 #include "utils/crash_reporting.hpp"
@@ -288,8 +301,10 @@ extern "C" {
 #include "utils/log.hpp"
 #include "mini_glm.hpp"
 #include "utils/profiler.hpp"
+#include "utils/random_generator.hpp"
 #include "utils/stk_process.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/worker_pool.hpp"
 #include "utils/translation.hpp"
 #include "io/rich_presence.hpp"
 
@@ -621,6 +636,37 @@ void cmdLineHelp()
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
     "       --benchmark        Start Benchmark Mode, save results and exit. \n"
+    "       --race-benchmark=file Run AI races without graphics, write the\n"
+    "                          ticks per second of each subsystem to file and\n"
+    "                          exit (JSON if file ends with .json, else CSV).\n"
+    "                          The loading time of each track is written too.\n"
+    "       --benchmark-tracks=a,b,... Tracks for --race-benchmark (default:\n"
+    "                          all standard race tracks).\n"
+    "       --benchmark-races=n Number of races on each track (default 3).\n"
+    "       --benchmark-seed=n Random seed of the first race on each track.\n"
+    "       --benchmark-verify Run each benchmark race twice and check that\n"
+    "                          the results are the same.\n"
+    "       --benchmark-track-load=track Measure loading the track (and karts)\n"
+    "                          without and with the collision bvh cache, each\n"
+    "                          --benchmark-races times, and exit.\n"
+    "       --rewind-stats=file Write the cost of all network rewinds to file\n"
+    "                          after each race (JSON if file ends with .json,\n"
+    "                          else CSV).\n"
+    "       --track-memory-report Log the memory each world uses for its track\n"
+    "                          at the end of each race.\n"
+    "       --convert-replay=file Convert a text replay to the binary format or\n"
+    "                          the other way round, and exit.\n"
+    "       --benchmark-xml=a,b,... Compare the speed of parsing the given XML\n"
+    "                          files (e.g. scene.xml) with the old parser, and exit.\n"
+    "       --benchmark-broadcast Measure the cost of sending one game state to\n"
+    "                          different numbers of peers, and exit.\n"
+    "       --benchmark-proximity Compare testing all pairs of karts with the\n"
+    "                          kart proximity index, and exit.\n"
+    "       --benchmark-database=file Measure the database reads of the lobby\n"
+    "                          while writes are committed, in a new database\n"
+    "                          file which is deleted afterwards, and exit.\n"
+    "       --benchmark-draw-list Compare culling and batching synthetic nodes\n"
+    "                          with hash maps and the sorted draw list, and exit.\n"
     "       --unlock-all       Permanently unlock all karts and tracks for testing.\n"
     "       --no-unlock-all    Disable unlock-all (i.e. base unlocking on player achievement).\n"
     "       --xmas=n           Toggle Xmas/Christmas mode. n=0 Use current date, n=1, Always enable,\n"
@@ -636,8 +682,13 @@ void cmdLineHelp()
     "       --demo-laps=n      Number of laps to use in a demo.\n"
     "       --demo-karts=n     Number of karts to use in a demo.\n"
     "       --history          Replay history file 'history.dat'.\n"
+    "       --history-seek=s   Start the replayed history after s seconds.\n"
+    "       --record-history   Write 'history.dat' while the race is running.\n"
     "       --server-config=file Specify the server_config.xml for server hosting, it will create\n"
     "                            one if not found.\n"
+    "       --server-rooms=file Host one lobby for each room listed in the file in this\n"
+    "                           process, each room config inherits from the server config.\n"
+    "                           Rooms don't offer tracks which use scripting.\n"
     "       --network-console  Enable network console.\n"
     "       --wan-server=name  Start a Wan server (not a playing client).\n"
     "       --public-server    Allow direct connection to the server (without stk server)\n"
@@ -649,6 +700,10 @@ void cmdLineHelp()
     "       --server-id=n      Server id in stk addons for --connect-now.\n"
     "       --network-ai=n     Numbers of AI for connecting to linear race server, used\n"
     "                          together with --connect-now.\n"
+    "       --load-test=n      Start a LAN server in this process, join it with one network\n"
+    "                          AI and n lightweight bots over loopback, and report\n"
+    "                          server tick times, state sizes, packet rates and rollbacks.\n"
+    "       --load-test-time=s Seconds after which the load test ends (default 120).\n"
     "       --login=s          Automatically log in (set the login).\n"
     "       --password=s       Automatically log in (set the password).\n"
     "       --init-user        Save the above login and password (if set) in config.\n"
@@ -1024,6 +1079,9 @@ int handleCmdLinePreliminary()
     if(CommandLine::has("--dont-load-navmesh"))
         Track::m_dont_load_navmesh = true;
 
+    if (CommandLine::has("--track-memory-report"))
+        Track::m_memory_report = true;
+
     if (CommandLine::has("--no-sound"))
         UserConfigParams::m_enable_sound = false;
 
@@ -1444,6 +1502,34 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
     if (CommandLine::has("--server-ai", &ai_num))
         NetworkConfig::get()->setNumFixedAI(ai_num);
 
+    int load_test_bots = 0;
+    if (CommandLine::has("--load-test", &load_test_bots) &&
+        load_test_bots > 0)
+    {
+        int load_test_time = 120;
+        CommandLine::has("--load-test-time", &load_test_time);
+        // This process joins the server with one network AI, which gives
+        // the rollbacks of a real client
+        PlayerManager::get()->enforceCurrentPlayer();
+        NetworkConfig::get()->setIsServer(false);
+        NetworkConfig::get()->setIsLAN();
+        NetworkConfig::get()->setNetworkAIInstance(true);
+        NetworkConfig::get()->setAutoConnect(true);
+        PlayerManager::get()->createGuestPlayers(1);
+        NetworkConfig::get()->addNetworkPlayer(
+            NULL, PlayerManager::get()->getPlayer(0), HANDICAP_NONE);
+        NetworkConfig::get()->doneAddingNetworkPlayers();
+        LoadGenerator::create(load_test_bots, (float)load_test_time);
+        auto server = std::make_shared<Server>(0/*server_id*/,
+            L"Load test", load_test_bots + 1, /*current_player*/0,
+            ServerConfig::m_server_difficulty, 0,
+            SocketAddress(0x7f000001, 0), false, false);
+        if (!GUIEngine::isNoGraphics())
+            NetworkingLobby::getInstance()->setJoinedServer(server);
+        else
+            std::make_shared<ConnectToServer>(server)->requestStart();
+    }
+
     std::string addr;
     bool has_addr = CommandLine::has("--connect-now", &addr);
     if (has_addr)
@@ -1524,7 +1610,10 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
                 NetworkConfig::get()->getIPDetectionResult(4000);
                 NetworkConfig::get()->setIsWAN();
                 NetworkConfig::get()->setIsPublicServer();
-                ServerConfig::loadServerLobbyFromConfig();
+                if (ServerRooms::isEnabled())
+                    ServerRooms::start(false/*lan_server*/);
+                else
+                    ServerConfig::loadServerLobbyFromConfig();
                 Log::info("main", "Creating a WAN server '%s'.",
                     server_name.c_str());
             }
@@ -1532,7 +1621,10 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         else
         {
             NetworkConfig::get()->setIsLAN();
-            ServerConfig::loadServerLobbyFromConfig();
+            if (ServerRooms::isEnabled())
+                ServerRooms::start(true/*lan_server*/);
+            else
+                ServerConfig::loadServerLobbyFromConfig();
             Log::info("main", "Creating a LAN server '%s'.",
                 server_name.c_str());
         }
@@ -1771,6 +1863,101 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
         RaceManager::get()->setNumLaps(999999); // profile end depends on time
     }   // --profile-time
 
+    if(CommandLine::has("--race-benchmark", &s))
+    {
+        if (!GUIEngine::isNoGraphics())
+        {
+            Log::error("main", "--race-benchmark needs --no-graphics.");
+            return 0;
+        }
+        Log::verbose("main", "Race benchmark results will be written to "
+                     "'%s'.", s.c_str());
+        RaceBenchmark::enable(s);
+        if (CommandLine::has("--benchmark-tracks", &s))
+            RaceBenchmark::setTracks(StringUtils::split(s, ','));
+        if (CommandLine::has("--benchmark-races", &n))
+            RaceBenchmark::setNumRaces(n);
+        if (CommandLine::has("--benchmark-seed", &n))
+            RaceBenchmark::setFirstSeed(n);
+        if (CommandLine::has("--benchmark-verify"))
+            RaceBenchmark::setVerify(true);
+        // Default to one lap races if neither profile mode was selected
+        if (!ProfileWorld::isProfileMode())
+        {
+            ProfileWorld::setProfileModeLaps(1);
+            RaceManager::get()->setNumLaps(1);
+        }
+        UserConfigParams::m_no_start_screen = true;
+    }   // --race-benchmark
+
+    if (CommandLine::has("--benchmark-track-load", &s))
+    {
+        if (!GUIEngine::isNoGraphics())
+        {
+            Log::error("main", "--benchmark-track-load needs --no-graphics.");
+            return 0;
+        }
+        RaceBenchmark::enableTrackLoad(s);
+        if (CommandLine::has("--benchmark-races", &n))
+            RaceBenchmark::setNumRaces(n);
+        // Selects the profile mode, in which RaceBenchmark::run is called
+        if (!ProfileWorld::isProfileMode())
+            ProfileWorld::setProfileModeLaps(1);
+        UserConfigParams::m_no_start_screen = true;
+    }   // --benchmark-track-load
+
+    if(CommandLine::has("--rewind-stats", &s))
+    {
+        Log::verbose("main", "Rewind statistics will be written to '%s'.",
+                     s.c_str());
+        RewindProfiler::get()->setOutputFile(s);
+    }   // --rewind-stats
+
+    if(CommandLine::has("--convert-replay", &s))
+    {
+        std::string converted;
+        if (ReplayBase::convertReplayFile(s, &converted))
+            Log::info("main", "Replay '%s' converted to '%s'.", s.c_str(),
+                      converted.c_str());
+        else
+            Log::error("main", "Can't convert replay '%s'.", s.c_str());
+        return 0;
+    }   // --convert-replay
+
+    if(CommandLine::has("--benchmark-xml", &s))
+    {
+        XMLNode::benchmark(StringUtils::split(s, ','));
+        return 0;
+    }   // --benchmark-xml
+
+    if(CommandLine::has("--benchmark-broadcast"))
+    {
+        STKHost::benchmarkBroadcast();
+        return 0;
+    }   // --benchmark-broadcast
+
+    if(CommandLine::has("--benchmark-proximity"))
+    {
+        ProximityIndex::benchmark();
+        return 0;
+    }   // --benchmark-proximity
+
+#ifdef ENABLE_SQLITE3
+    if(CommandLine::has("--benchmark-database", &s))
+    {
+        DatabaseConnector::benchmark(s);
+        return 0;
+    }   // --benchmark-database
+#endif
+
+#ifndef SERVER_ONLY
+    if(CommandLine::has("--benchmark-draw-list"))
+    {
+        SP::SPDrawList::benchmark();
+        return 0;
+    }   // --benchmark-draw-list
+#endif
+
     if(CommandLine::has("--history"))
     {
         history->setReplayHistory(true);
@@ -1780,6 +1967,16 @@ int handleCmdLine(bool has_server_config, bool has_parent_process)
             UserConfigParams::m_no_start_screen = true;
     }   // --history
 
+    if(CommandLine::has("--history-seek", &s))
+    {
+        float t = 0;
+        StringUtils::fromString(s, t);
+        history->setSeekTicks(stk_config->time2Ticks(t));
+    }   // --history-seek
+
+    if(CommandLine::has("--record-history"))
+        history->setStreamHistory(true);
+
     // Demo mode
     if(CommandLine::has("--demo-mode", &s))
     {
@@ -1985,6 +2182,7 @@ void initRest()
     track_manager           = new TrackManager         ();
     kart_properties_manager = new KartPropertiesManager();
     ProjectileManager::create();
+    RewindProfiler::create();
     powerup_manager         = new PowerupManager       ();
     attachment_manager      = new AttachmentManager    ();
     highscore_manager       = new HighscoreManager     ();
@@ -2273,6 +2471,17 @@ int main(int argc, char *argv[])
         else
             ServerConfig::loadServerConfig();
 
+        if (CommandLine::has("--server-rooms", &s))
+        {
+            if (no_graphics)
+            {
+                GUIEngine::disableGraphics();
+                UserConfigParams::m_enable_sound = false;
+            }
+            NetworkConfig::get()->setIsServer(true);
+            ServerRooms::setRoomsFile(s);
+        }
+
         if (CommandLine::has("--wan-server", &s))
         {
             if (no_graphics)
@@ -2617,9 +2826,17 @@ int main(int argc, char *argv[])
         {
             // Profiling
             // =========
-            RaceManager::get()->setMajorMode (RaceManager::MAJOR_MODE_SINGLE);
-            RaceManager::get()->setupPlayerKartInfo();
-            RaceManager::get()->startNew(false);
+            if (RaceBenchmark::isEnabled())
+            {
+                // Runs all races, and aborts the main loop afterwards
+                RaceBenchmark::run();
+            }
+            else
+            {
+                RaceManager::get()->setMajorMode(RaceManager::MAJOR_MODE_SINGLE);
+                RaceManager::get()->setupPlayerKartInfo();
+                RaceManager::get()->startNew(false);
+            }
         }
 
 #ifdef __SWITCH__
@@ -2656,12 +2873,15 @@ int main(int argc, char *argv[])
 
     if (STKHost::existHost())
         STKHost::get()->shutdown();
+    // After the server thread is stopped
+    LoadGenerator::destroy();
     ClientLobby::destroyBackgroundDownload();
 
     cleanSuperTuxKart();
     NetworkConfig::destroy();
 
     RichPresenceNS::RichPresence::destroy();
+    Event::clearPools();
 
 #ifdef DEBUG
     MemoryLeaks::checkForLeaks();
@@ -2715,6 +2935,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
  */
 static void cleanSuperTuxKart()
 {
+    ServerRooms::stop();
 
     delete main_loop;
 
@@ -2756,6 +2977,8 @@ static void cleanSuperTuxKart()
     ItemManager::removeTextures();
     if(powerup_manager)         delete powerup_manager;
     ProjectileManager::destroy();
+    RewindProfiler::destroy();
+    WorkerPool::destroy();
     if(kart_properties_manager) delete kart_properties_manager;
     if(track_manager)           delete track_manager;
     if(material_manager)        delete material_manager;
@@ -2845,12 +3068,32 @@ void runUnitTests()
     Log::info("UnitTest", "=====================");
     Log::info("UnitTest", "MiniGLM");
     MiniGLM::unitTesting();
+    Log::info("UnitTest", "SPCulling");
+    SP::SPCulling::unitTesting();
     Log::info("UnitTest", "GraphicsRestrictions");
     GraphicsRestrictions::unitTesting();
     Log::info("UnitTest", "NetworkString");
     NetworkString::unitTesting();
     Log::info("UnitTest", "SocketAddress");
     SocketAddress::unitTesting();
+    Log::info("UnitTest", "BanIndex");
+    BanIndex::unitTesting();
+    Log::info("UnitTest", "ServerConfig");
+    ServerConfig::unitTesting();
+#ifdef ENABLE_SQLITE3
+    Log::info("UnitTest", "DatabaseConnector");
+    DatabaseConnector::unitTesting();
+#endif
+    Log::info("UnitTest", "BoundedQueue");
+    BoundedQueue<int>::unitTesting();
+    Log::info("UnitTest", "RandomGenerator");
+    RandomGenerator::unitTesting();
+    Log::info("UnitTest", "ProximityIndex");
+    ProximityIndex::unitTesting();
+    Log::info("UnitTest", "XMLNode");
+    XMLNode::unitTesting();
+    Log::info("UnitTest", "ManifestCache");
+    ManifestCache::unitTesting();
     Log::info("UnitTest", "StringUtils::versionToInt");
     StringUtils::unitTesting();
 
@@ -2894,6 +3137,12 @@ void runUnitTests()
     Log::info("UnitTest", "Arena Graph");
     ArenaGraph::unitTesting();
 
+    Log::info("UnitTest", "Graph spatial grid");
+    Graph::unitTesting();
+
+    Log::info("UnitTest", "Collision bvh cache");
+    TriangleMesh::unitTesting();
+
     Log::info("UnitTest", "Fonts for translation");
     font_manager->unitTesting();
 
@@ -45,6 +45,7 @@
 #include "network/race_event_manager.hpp"
 #include "network/rewind_manager.hpp"
 #include "network/server.hpp"
+#include "network/server_rooms.hpp"
 #include "network/stk_host.hpp"
 #include "online/request_manager.hpp"
 #include "race/history.hpp"
@@ -556,7 +557,7 @@ void MainLoop::run()
             }
         }
 
-        if (was_server && !STKHost::existHost())
+        if (was_server && !STKHost::existHost() && !ServerRooms::isRunning())
             m_abort = true;
 
         if (!m_abort)
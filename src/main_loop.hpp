@@ -68,6 +68,8 @@ public:
     void run();
     /** Set the abort flag, causing the mainloop to be left. */
     void abort() { m_abort = true; }
+    /** Clears the abort flag, so that run() can be called again. */
+    void clearAbort() { m_abort = false; }
     void requestAbort() { m_request_abort = true; }
     void setThrottleFPS(bool throttle) { m_throttle_fps = throttle; }
     void setAllowLargeDt(bool enable) { m_allow_large_dt = enable; }
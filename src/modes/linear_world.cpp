@@ -51,6 +51,7 @@
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
 
+#include <algorithm>
 #include <climits>
 #include <iostream>
 
@@ -882,6 +883,38 @@ void LinearWorld::updateRacePosition()
     bool rank_changed = false;
 #endif
 
+    // A kart is behind all karts that have finished the race (and are not
+    // eliminated), and behind the karts still racing that have covered a
+    // larger overall distance or have the same distance (very unlikely)
+    // but started earlier. So sort the karts still racing once instead of
+    // comparing each kart with all other karts.
+    m_racing_karts.clear();
+    unsigned int num_finished = 0;
+    for (unsigned int j = 0; j < kart_amount; j++)
+    {
+        if (m_karts[j]->isEliminated())
+            continue;
+        if (m_karts[j]->hasFinishedRace())
+            num_finished++;
+        else
+            m_racing_karts.push_back(j);
+    }
+    std::sort(m_racing_karts.begin(), m_racing_karts.end(),
+              [this](unsigned int a, unsigned int b)
+              {
+                  if (m_kart_info[a].m_overall_distance !=
+                      m_kart_info[b].m_overall_distance)
+                  {
+                      return m_kart_info[a].m_overall_distance >
+                             m_kart_info[b].m_overall_distance;
+                  }
+                  return m_karts[a]->getInitialPosition() <
+                         m_karts[b]->getInitialPosition();
+              });
+    m_racing_rank.resize(kart_amount);
+    for (unsigned int r = 0; r < m_racing_karts.size(); r++)
+        m_racing_rank[m_racing_karts[r]] = r;
+
     // NOTE: if you do any changes to this loop, the next loop (see
     // DEBUG_KART_RANK below) needs to have the same changes applied
     // so that debug output is still correct!!!!!!!!!!!
@@ -901,33 +934,7 @@ void LinearWorld::updateRacePosition()
             continue;
         }
 
-        int p = 1 ;
-
-        const unsigned int my_id = kart->getWorldKartId();
-        const float my_distance  = m_kart_info[my_id].m_overall_distance;
-
-        // Count karts ahead of the current kart, i.e. kart that are
-        // already finished or have covered a larger overall distance.
-        for (unsigned int j = 0 ; j < kart_amount ; j++)
-        {
-            // don't compare a kart with itself and ignore eliminated karts
-            if(j == my_id || m_karts[j]->isEliminated())
-                continue;
-
-            // If the other kart has:
-            // - finished the race (but this kart hasn't)
-            // - or is ahead
-            // - or has the same distance (very unlikely) but started earlier
-            // it is ahead --> increase position
-            if((!kart->hasFinishedRace() && m_karts[j]->hasFinishedRace()) ||
-                m_kart_info[j].m_overall_distance > my_distance            ||
-               (m_kart_info[j].m_overall_distance == my_distance &&
-                m_karts[j]->getInitialPosition()<kart->getInitialPosition() ) )
-            {
-                p++;
-            }
-
-        } //next kart
+        int p = 1 + num_finished + m_racing_rank[kart->getWorldKartId()];
 
 #ifndef DEBUG
         setKartPosition(i, p);
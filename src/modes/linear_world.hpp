@@ -132,6 +132,12 @@ protected:
       */
     std::vector<KartInfo> m_kart_info;
 
+    /** The karts still racing, sorted by their overall distance, and the
+     *  rank of each kart among them. Only used in updateRacePosition, kept
+     *  to avoid allocating them each tick. */
+    std::vector<unsigned int> m_racing_karts;
+    std::vector<int> m_racing_rank;
+
     virtual void  checkForWrongDirection(unsigned int i, float dt);
     virtual float estimateFinishTimeForKart(AbstractKart* kart) OVERRIDE;
 
@@ -23,6 +23,7 @@
 #include "graphics/irr_driver.hpp"
 #include "karts/kart_with_stats.hpp"
 #include "karts/controller/controller.hpp"
+#include "modes/race_benchmark.hpp"
 #include "tracks/track.hpp"
 
 #include <ISceneManager.h>
@@ -201,6 +202,14 @@ void ProfileWorld::enterRaceOverState()
         m_karts[i]->finishedRace(estimateFinishTimeForKart(m_karts[i].get()));
     }
 
+    if (RaceBenchmark::isEnabled())
+    {
+        std::vector<float> finish_times;
+        for (unsigned int i = 0; i < m_karts.size(); i++)
+            finish_times.push_back(m_karts[i]->getFinishTime());
+        RaceBenchmark::raceFinished(m_frame_count, finish_times);
+    }
+
     // Print framerate statistics
     float runtime = (irr_driver->getRealTime()-m_start_time)*0.001f;
     Log::verbose("profile", "Number of frames: %d time %f, Average FPS: %f",
@@ -0,0 +1,401 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "modes/proximity_index.hpp"
+
+#include "config/stk_config.hpp"
+#include "items/flyable.hpp"
+#include "items/projectile_manager.hpp"
+#include "karts/abstract_kart.hpp"
+#include "karts/kart_properties.hpp"
+#include "modes/linear_world.hpp"
+#include "modes/world.hpp"
+#include "utils/log.hpp"
+#include "utils/vec3.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+const float ProximityIndex::CELL_SIZE = 20.0f;
+
+/** Queries with a larger radius (or at such a position) return all objects,
+ *  which also keeps the cell coordinates in the range of an int. */
+static const float MAX_QUERY_DISTANCE = 1.0e6f;
+
+/** With fewer karts testing all karts is faster than building and querying
+ *  the index (see benchmark()), so no index is built then. */
+static const unsigned int MIN_KARTS = 64;
+
+// ----------------------------------------------------------------------------
+void ProximityIndex::Grid::add(float x, float z, unsigned int id)
+{
+    int cx = (int)floorf(x / CELL_SIZE);
+    int cz = (int)floorf(z / CELL_SIZE);
+    m_cells.emplace_back(getKey(cx, cz), id);
+}   // add
+
+// ----------------------------------------------------------------------------
+void ProximityIndex::Grid::sort()
+{
+    std::sort(m_cells.begin(), m_cells.end());
+}   // sort
+
+// ----------------------------------------------------------------------------
+/** Adds the ids of all objects in the cells which overlap the square of
+ *  the given radius around (x, z) to ids.
+ *  \return False if the query covers too many cells, in which case the
+ *          caller should use all objects instead.
+ */
+bool ProximityIndex::Grid::query(float x, float z, float radius,
+                                 std::vector<unsigned int> *ids) const
+{
+    if (!(fabsf(x) + radius < MAX_QUERY_DISTANCE &&
+          fabsf(z) + radius < MAX_QUERY_DISTANCE))
+        return false;
+    int x0 = (int)floorf((x - radius) / CELL_SIZE);
+    int x1 = (int)floorf((x + radius) / CELL_SIZE);
+    int z0 = (int)floorf((z - radius) / CELL_SIZE);
+    int z1 = (int)floorf((z + radius) / CELL_SIZE);
+    // Each row costs a binary search, so this is only faster than testing
+    // all objects if there are fewer rows than objects.
+    if ((size_t)(x1 - x0 + 1) > m_cells.size())
+        return false;
+
+    for (int cx = x0; cx <= x1; cx++)
+    {
+        const int64_t last = getKey(cx, z1);
+        auto it = std::lower_bound(m_cells.begin(), m_cells.end(),
+                           std::make_pair(getKey(cx, z0), (unsigned int)0));
+        for (; it != m_cells.end() && it->first <= last; it++)
+            ids->push_back(it->second);
+    }
+    return true;
+}   // query
+
+// ============================================================================
+ProximityIndex::ProximityIndex()
+{
+    m_num_karts             = 0;
+    m_projectile_generation = 0;
+    m_margin                = 0.0f;
+    m_max_speed             = 0.0f;
+    m_max_slipstream_reach  = 0.0f;
+    m_valid                 = false;
+    m_has_distances         = false;
+}   // ProximityIndex
+
+// ----------------------------------------------------------------------------
+/** Builds the index for the current positions of all karts and projectiles.
+ *  \param world The world with the karts.
+ *  \param ticks Number of ticks of the following update.
+ */
+void ProximityIndex::build(const World *world, int ticks)
+{
+    if (world->getNumKarts() < MIN_KARTS)
+    {
+        reset();
+        return;
+    }
+    m_kart_grid.clear();
+    m_projectile_grid.clear();
+    m_always_karts.clear();
+    m_projectiles.clear();
+    m_overall_distances.clear();
+    m_max_speed            = 0.0f;
+    m_max_slipstream_reach = 0.0f;
+
+    m_num_karts = world->getNumKarts();
+    const LinearWorld *lw = dynamic_cast<const LinearWorld*>(world);
+    m_has_distances = lw != NULL;
+    for (unsigned int i = 0; i < m_num_karts; i++)
+    {
+        const AbstractKart *kart = world->getKart(i);
+        const Vec3 &xyz = kart->getXYZ();
+        if (m_has_distances && !kart->isEliminated())
+            m_overall_distances.push_back(lw->getOverallDistance(i));
+
+        // Ghost karts are moved by their replay data and not by physics,
+        // and animations can teleport a kart, so these are always returned
+        if (kart->isGhostKart() || kart->getKartAnimation() ||
+            !std::isfinite(xyz.getX()) || !std::isfinite(xyz.getZ()))
+        {
+            m_always_karts.push_back(i);
+            continue;
+        }
+        m_kart_grid.add(xyz.getX(), xyz.getZ(), i);
+
+        float speed = std::max(kart->getVelocity().length(),
+                               fabsf(kart->getSpeed()));
+        m_max_speed = std::max(m_max_speed, speed);
+        const KartProperties *kp = kart->getKartProperties();
+        float reach = kp->getSlipstreamLength() * 1.1f * speed
+                    / kp->getSlipstreamBaseSpeed() + kart->getKartLength();
+        m_max_slipstream_reach = std::max(m_max_slipstream_reach, reach);
+    }
+    m_kart_grid.sort();
+    std::sort(m_overall_distances.begin(), m_overall_distances.end());
+
+    // A kart can move by the distance of the last physics step (which it
+    // copies in its update) plus the one of this tick.
+    m_margin = 2.0f * m_max_speed * stk_config->ticks2Time(ticks) + 1.0f;
+
+    ProjectileManager *pm = ProjectileManager::get();
+    m_projectile_generation = pm->getGeneration();
+    for (auto &p : pm->getActiveProjectiles())
+    {
+        const Vec3 &xyz = p.second->getXYZ();
+        if (!std::isfinite(xyz.getX()) || !std::isfinite(xyz.getZ()))
+            continue;
+        m_projectile_grid.add(xyz.getX(), xyz.getZ(),
+                              (unsigned int)m_projectiles.size());
+        m_projectiles.push_back(p.second.get());
+    }
+    m_projectile_grid.sort();
+    m_valid = true;
+}   // build
+
+// ----------------------------------------------------------------------------
+void ProximityIndex::getAllKarts(std::vector<unsigned int> *ids) const
+{
+    unsigned int num_karts = World::getWorld()->getNumKarts();
+    ids->resize(num_karts);
+    for (unsigned int i = 0; i < num_karts; i++)
+        (*ids)[i] = i;
+}   // getAllKarts
+
+// ----------------------------------------------------------------------------
+/** Returns (sorted by world kart id) all karts which can be within the given
+ *  distance of a point in this tick. It can contain karts which are further
+ *  away, so the caller still has to do its own test.
+ *  \param center The point to test.
+ *  \param radius The maximum distance from the center.
+ *  \param ids Returns the kart ids.
+ */
+void ProximityIndex::getKartsInRange(const Vec3 &center, float radius,
+                                     std::vector<unsigned int> *ids) const
+{
+    ids->clear();
+    if (!m_valid || m_num_karts != World::getWorld()->getNumKarts() ||
+        !m_kart_grid.query(center.getX(), center.getZ(), radius + m_margin,
+                           ids))
+    {
+        getAllKarts(ids);
+        return;
+    }
+    ids->insert(ids->end(), m_always_karts.begin(), m_always_karts.end());
+    std::sort(ids->begin(), ids->end());
+}   // getKartsInRange
+
+// ----------------------------------------------------------------------------
+/** Returns all projectiles which can be within the given distance of a
+ *  point, the caller still has to do its own test. Projectiles only move
+ *  in ProjectileManager::update() and the physics (after all karts were
+ *  updated), so their positions are the ones of the index.
+ *  \return False if projectiles were added or removed since the index
+ *          was built, in which case the caller must test all projectiles.
+ */
+bool ProximityIndex::getProjectilesInRange(const Vec3 &center, float radius,
+                                     std::vector<Flyable*> *projectiles) const
+{
+    if (!m_valid ||
+        m_projectile_generation != ProjectileManager::get()->getGeneration())
+        return false;
+    projectiles->clear();
+    std::vector<unsigned int> ids;
+    if (!m_projectile_grid.query(center.getX(), center.getZ(), radius + 0.5f,
+                                 &ids))
+    {
+        *projectiles = m_projectiles;
+        return true;
+    }
+    for (unsigned int id : ids)
+        projectiles->push_back(m_projectiles[id]);
+    return true;
+}   // getProjectilesInRange
+
+// ----------------------------------------------------------------------------
+/** Returns the number of karts which are not eliminated and have a larger
+ *  overall distance than the given distance.
+ */
+unsigned int ProximityIndex::countKartsAhead(const LinearWorld *world,
+                                             float distance) const
+{
+    if (m_valid && m_has_distances && m_num_karts == world->getNumKarts())
+    {
+        return (unsigned int)(m_overall_distances.end() -
+                              std::upper_bound(m_overall_distances.begin(),
+                                               m_overall_distances.end(),
+                                               distance));
+    }
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        if (world->getOverallDistance(i) > distance &&
+            !world->getKart(i)->isEliminated())
+            count++;
+    }
+    return count;
+}   // countKartsAhead
+
+// ----------------------------------------------------------------------------
+/** Creates karts spread over a track loop like in a race. */
+static void createPositions(unsigned int num, std::mt19937 *g,
+                            std::vector<float> *x, std::vector<float> *z)
+{
+    std::uniform_real_distribution<float> along(0.0f, 2.0f * 3.1415926f);
+    std::uniform_real_distribution<float> across(-10.0f, 10.0f);
+    x->clear();
+    z->clear();
+    // About a 1.5km track
+    const float r = 250.0f;
+    for (unsigned int i = 0; i < num; i++)
+    {
+        float a = along(*g);
+        x->push_back((r + across(*g)) * cosf(a));
+        z->push_back((r + across(*g)) * sinf(a));
+    }
+}   // createPositions
+
+// ----------------------------------------------------------------------------
+/** Tests that grid queries return all objects within the radius. */
+void ProximityIndex::unitTesting()
+{
+    std::mt19937 g(7);
+    std::uniform_real_distribution<float> radius(0.0f, 120.0f);
+    std::vector<float> x, z;
+    std::vector<unsigned int> ids;
+    for (unsigned int num = 1; num <= 200; num += 13)
+    {
+        createPositions(num, &g, &x, &z);
+        Grid grid;
+        for (unsigned int i = 0; i < num; i++)
+            grid.add(x[i], z[i], i);
+        grid.sort();
+        for (unsigned int q = 0; q < 50; q++)
+        {
+            // Query at kart positions and at random points
+            float cx = q < num ? x[q] : x[q % num] + radius(g) - 60.0f;
+            float cz = q < num ? z[q] : z[q % num] - radius(g) + 60.0f;
+            float r = radius(g);
+            ids.clear();
+            if (!grid.query(cx, cz, r, &ids))
+                continue;
+            std::vector<bool> found(num, false);
+            for (unsigned int id : ids)
+            {
+                if (id >= num || found[id])
+                {
+                    Log::fatal("ProximityIndex", "Invalid or duplicated id "
+                               "%u.", id);
+                }
+                found[id] = true;
+            }
+            for (unsigned int i = 0; i < num; i++)
+            {
+                float dx = x[i] - cx, dz = z[i] - cz;
+                if (!found[i] && dx * dx + dz * dz <= r * r)
+                {
+                    Log::fatal("ProximityIndex", "Kart %u at distance %f "
+                               "not found with radius %f.", i,
+                               sqrtf(dx * dx + dz * dz), r);
+                }
+            }
+        }
+    }
+
+    // Very large queries are answered with 'use all objects'
+    Grid grid;
+    grid.add(0.0f, 0.0f, 0);
+    grid.sort();
+    ids.clear();
+    if (grid.query(0.0f, 0.0f, 2.0f * MAX_QUERY_DISTANCE, &ids) ||
+        grid.query(0.0f, 0.0f, 100.0f, &ids))
+        Log::fatal("ProximityIndex", "Query over too many cells succeeded.");
+}   // unitTesting
+
+// ----------------------------------------------------------------------------
+/** Compares the all-pairs kart tests done each tick (each kart tests each
+ *  other kart) with building the index and querying it once per kart.
+ */
+void ProximityIndex::benchmark()
+{
+    std::mt19937 g(42);
+    std::vector<float> x, z;
+    std::vector<unsigned int> ids;
+    const float r = 30.0f;
+    // The timer of StkTime only has a resolution of milliseconds
+    auto now = []()
+    {
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    for (unsigned int num = 8; num <= 256; num *= 2)
+    {
+        // Roughly the same number of kart pairs for each number of karts
+        const int rounds = 500000 / num;
+        createPositions(num, &g, &x, &z);
+        unsigned int brute_count = 0, index_count = 0;
+
+        double start = now();
+        for (int round = 0; round < rounds; round++)
+        {
+            for (unsigned int i = 0; i < num; i++)
+            {
+                for (unsigned int j = 0; j < num; j++)
+                {
+                    float dx = x[j] - x[i], dz = z[j] - z[i];
+                    if (i != j && dx * dx + dz * dz <= r * r)
+                        brute_count++;
+                }
+            }
+        }
+        double brute = now() - start;
+
+        Grid grid;
+        start = now();
+        for (int round = 0; round < rounds; round++)
+        {
+            grid.clear();
+            for (unsigned int i = 0; i < num; i++)
+                grid.add(x[i], z[i], i);
+            grid.sort();
+            for (unsigned int i = 0; i < num; i++)
+            {
+                ids.clear();
+                grid.query(x[i], z[i], r, &ids);
+                for (unsigned int j : ids)
+                {
+                    float dx = x[j] - x[i], dz = z[j] - z[i];
+                    if (i != j && dx * dx + dz * dz <= r * r)
+                        index_count++;
+                }
+            }
+        }
+        double index = now() - start;
+        if (brute_count != index_count)
+        {
+            Log::fatal("ProximityIndex", "Found %u instead of %u karts.",
+                       index_count, brute_count);
+        }
+        Log::info("ProximityIndex", "%3u karts: all pairs %8.2lf us, "
+                  "index %7.2lf us per tick.", num,
+                  brute * 1.0e6 / rounds, index * 1.0e6 / rounds);
+    }
+}   // benchmark
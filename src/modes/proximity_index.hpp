@@ -0,0 +1,156 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_PROXIMITY_INDEX_HPP
+#define HEADER_PROXIMITY_INDEX_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class Flyable;
+class LinearWorld;
+class Vec3;
+class World;
+
+/** \ingroup modes
+ *  A per-tick index of the positions of all karts and projectiles, and of
+ *  the overall distances of the karts in linear races. It is built by
+ *  World::update() once per tick before the karts are updated (i.e. with
+ *  the result of the last physics step), and replaces the loops over all
+ *  karts (or projectiles) which slipstream, AI, ranking and projectiles
+ *  did for each kart, so the cost per tick grows roughly linearly with the
+ *  number of karts instead of quadratically.
+ *
+ *  The queries only return candidates: a superset of all objects which
+ *  are within the given distance, sorted by id. Karts are moved during the
+ *  tick (each kart copies its physics position in Kart::update), so kart
+ *  queries are extended by the distance a kart can move in a tick, and
+ *  karts with an animation (which can teleport them) are always returned.
+ *  The callers then do their original exact test on the candidates, so the
+ *  result does not change compared with testing all karts.
+ *
+ *  Building the index only pays off with many karts, in races with fewer
+ *  karts it is not built and all queries return all karts (see build()).
+ */
+class ProximityIndex : public NoCopy
+{
+private:
+    /** A uniform grid in the XZ plane, stored as a list of (cell, id)
+     *  sorted by cell, so each row of cells in a query is found with one
+     *  binary search and nothing is allocated after the first ticks. */
+    class Grid
+    {
+    private:
+        std::vector<std::pair<int64_t, unsigned int> > m_cells;
+
+        // --------------------------------------------------------------------
+        static int64_t getKey(int x, int z)
+        {
+            // Flip the sign bit so that the unsigned z keeps its order
+            return ((int64_t)x << 32) | ((uint32_t)z ^ 0x80000000u);
+        }   // getKey
+    public:
+        void clear() { m_cells.clear(); }
+        // --------------------------------------------------------------------
+        void add(float x, float z, unsigned int id);
+        // --------------------------------------------------------------------
+        void sort();
+        // --------------------------------------------------------------------
+        bool query(float x, float z, float radius,
+                   std::vector<unsigned int> *ids) const;
+    };   // Grid
+
+    /** Size of a grid cell. */
+    static const float CELL_SIZE;
+
+    Grid m_kart_grid;
+
+    Grid m_projectile_grid;
+
+    /** Karts which are not in the grid because they can be teleported
+     *  during the tick (animations) or have an invalid position. */
+    std::vector<unsigned int> m_always_karts;
+
+    /** The projectiles in the order of their ids in m_projectile_grid. */
+    std::vector<Flyable*> m_projectiles;
+
+    /** The sorted overall distances of all karts which are not eliminated,
+     *  only used in linear races. */
+    std::vector<float> m_overall_distances;
+
+    /** Number of karts when the index was built. */
+    unsigned int m_num_karts;
+
+    /** The generation of the projectile manager when the index was built,
+     *  see ProjectileManager::getGeneration(). */
+    unsigned int m_projectile_generation;
+
+    /** Added to each kart query for the movement of karts in a tick. */
+    float m_margin;
+
+    /** Largest velocity of all karts. */
+    float m_max_speed;
+
+    /** Largest distance in which any kart can give slipstream. */
+    float m_max_slipstream_reach;
+
+    /** If the index was built for the current world. */
+    bool m_valid;
+
+    /** If m_overall_distances is used. */
+    bool m_has_distances;
+
+    // ------------------------------------------------------------------------
+    void getAllKarts(std::vector<unsigned int> *ids) const;
+
+public:
+    ProximityIndex();
+    // ------------------------------------------------------------------------
+    void build(const World *world, int ticks);
+    // ------------------------------------------------------------------------
+    /** Called when the world is reset or deleted, or a state is restored,
+     *  so that no stale data (especially no stale projectile pointers or
+     *  kart positions) is used. */
+    void reset() { m_valid = false; m_projectiles.clear(); }
+    // ------------------------------------------------------------------------
+    void getKartsInRange(const Vec3 &center, float radius,
+                         std::vector<unsigned int> *ids) const;
+    // ------------------------------------------------------------------------
+    bool getProjectilesInRange(const Vec3 &center, float radius,
+                               std::vector<Flyable*> *projectiles) const;
+    // ------------------------------------------------------------------------
+    unsigned int countKartsAhead(const LinearWorld *world,
+                                 float distance) const;
+    // ------------------------------------------------------------------------
+    /** Returns the largest velocity of all karts, plus a margin for the
+     *  acceleration during a tick. */
+    float getMaxSpeed() const { return m_max_speed + 1.0f; }
+    // ------------------------------------------------------------------------
+    /** Returns the largest distance from a kart at which another kart can
+     *  be in its slipstream. */
+    float getMaxSlipstreamReach() const { return m_max_slipstream_reach; }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+    // ------------------------------------------------------------------------
+    static void benchmark();
+};   // ProximityIndex
+
+#endif
@@ -0,0 +1,363 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "modes/race_benchmark.hpp"
+
+#include "config/user_config.hpp"
+#include "main_loop.hpp"
+#include "race/race_manager.hpp"
+#include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+#include "utils/random_generator.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+std::string              RaceBenchmark::m_output_file;
+std::vector<std::string> RaceBenchmark::m_tracks;
+unsigned int             RaceBenchmark::m_num_races  = 3;
+unsigned int             RaceBenchmark::m_first_seed = 0;
+bool                     RaceBenchmark::m_verify     = false;
+std::string              RaceBenchmark::m_load_track;
+int                      RaceBenchmark::m_race_ticks = 0;
+std::vector<float>       RaceBenchmark::m_race_finish_times;
+std::vector<RaceBenchmark::RaceResult> RaceBenchmark::m_results;
+
+namespace
+{
+    /** The profiler marker which measures each subsystem. */
+    const char* SUBSYSTEM_MARKERS[RaceBenchmark::SS_COUNT] =
+    {
+        "World::update()",
+        "World::update (physics)",
+        "World::update (Controller::prepareUpdate)",
+        "Track::update (items)",
+        "World::update (projectiles)",
+        "World::update (RewindManager)"
+    };
+
+    // ------------------------------------------------------------------------
+    /** Returns the ticks per second, or a negative number if no time was
+     *  measured (e.g. no rewinds in an offline race). */
+    double ticksPerSecond(int ticks, double seconds)
+    {
+        return seconds > 0.0 ? ticks / seconds : -1.0;
+    }   // ticksPerSecond
+}   // namespace
+
+// ----------------------------------------------------------------------------
+const char* RaceBenchmark::getSubsystemName(Subsystem s)
+{
+    switch (s)
+    {
+    case SS_WORLD:       return "world";
+    case SS_PHYSICS:     return "physics";
+    case SS_AI:          return "ai";
+    case SS_ITEMS:       return "items";
+    case SS_PROJECTILES: return "projectiles";
+    case SS_REWIND:      return "rewind";
+    default:             return "unknown";
+    }
+}   // getSubsystemName
+
+// ----------------------------------------------------------------------------
+/** Runs all races of the benchmark and writes the results. This is called
+ *  instead of starting a single profile race, and aborts the main loop
+ *  at the end.
+ */
+void RaceBenchmark::run()
+{
+    if (!m_load_track.empty())
+    {
+        runTrackLoad();
+        return;
+    }
+
+    std::vector<std::string> tracks = m_tracks;
+    if (tracks.empty())
+    {
+        for (unsigned int i = 0; i < track_manager->getNumberOfTracks(); i++)
+        {
+            const Track* t = track_manager->getTrack(i);
+            if (t->isRaceTrack() && !t->isInternal() && !t->isAddon())
+                tracks.push_back(t->getIdent());
+        }
+    }
+
+    // The profiler is only initialised with graphics
+    profiler.init();
+    UserConfigParams::m_profiler_enabled = true;
+    profiler.setDrawing(false);
+
+    m_results.clear();
+    unsigned int mismatches = 0;
+    RaceManager::get()->setMajorMode(RaceManager::MAJOR_MODE_SINGLE);
+    RaceManager::get()->setMinorMode(RaceManager::MINOR_MODE_NORMAL_RACE);
+    for (const std::string& ident : tracks)
+    {
+        if (!track_manager->getTrack(ident))
+        {
+            Log::warn("RaceBenchmark", "Can't find track named '%s'.",
+                      ident.c_str());
+            continue;
+        }
+        for (unsigned int race = 0; race < m_num_races; race++)
+        {
+            RaceResult result = runRace(ident, m_first_seed + race);
+            if (m_verify)
+            {
+                RaceResult repeated = runRace(ident, result.m_seed);
+                if (repeated.m_ticks != result.m_ticks ||
+                    repeated.m_finish_times != result.m_finish_times)
+                {
+                    Log::error("RaceBenchmark", "%s seed %u: the repeated "
+                               "race has other results.", ident.c_str(),
+                               result.m_seed);
+                    mismatches++;
+                }
+            }
+            m_results.push_back(result);
+        }
+    }
+    if (m_verify)
+    {
+        Log::info("RaceBenchmark", "%u of %u races had the same results "
+                  "when repeated.", (unsigned)m_results.size() - mismatches,
+                  (unsigned)m_results.size());
+    }
+    UserConfigParams::m_profiler_enabled = false;
+
+    writeToFile(m_output_file);
+    main_loop->abort();
+}   // run
+
+// ----------------------------------------------------------------------------
+/** Runs one race and measures it.
+ *  \param track Ident of the track.
+ *  \param seed Seed of all random numbers in the race.
+ */
+RaceBenchmark::RaceResult RaceBenchmark::runRace(const std::string& track,
+                                                 unsigned int seed)
+{
+    RaceResult result;
+    result.m_track = track;
+    result.m_seed = seed;
+    // Also used for the items and powerups of the track, see Track::loadTrack
+    srand(result.m_seed);
+    RandomGenerator::seed(result.m_seed);
+
+    RaceManager::get()->setTrack(track);
+    RaceManager::get()->setupPlayerKartInfo();
+    double load_start = StkTime::getRealTime();
+    RaceManager::get()->startNew(false);
+    result.m_load_time = StkTime::getRealTime() - load_start;
+
+    // Only measure the race, not the loading of the track
+    m_race_ticks = 0;
+    m_race_finish_times.clear();
+    profiler.reset();
+    double start = StkTime::getRealTime();
+    main_loop->run();
+    main_loop->clearAbort();
+    result.m_wall_time = StkTime::getRealTime() - start;
+    result.m_ticks = m_race_ticks;
+    result.m_finish_times = m_race_finish_times;
+    for (unsigned int i = 0; i < SS_COUNT; i++)
+    {
+        result.m_subsystem_time[i] =
+            profiler.getTotalTime(SUBSYSTEM_MARKERS[i]) * 0.001;
+    }
+    Log::info("RaceBenchmark", "%s seed %u: loaded in %lf s, "
+              "%d ticks in %lf s, physics %.0lf ticks/s, "
+              "ai %.0lf ticks/s.",
+              track.c_str(), result.m_seed, result.m_load_time,
+              result.m_ticks, result.m_wall_time,
+              ticksPerSecond(result.m_ticks,
+                             result.m_subsystem_time[SS_PHYSICS]),
+              ticksPerSecond(result.m_ticks,
+                             result.m_subsystem_time[SS_AI]));
+    return result;
+}   // runRace
+
+// ----------------------------------------------------------------------------
+/** Loads a track with its karts and deletes the world again without racing.
+ *  \param track Ident of the track.
+ *  \return The loading time in seconds.
+ */
+double RaceBenchmark::loadTrack(const std::string& track)
+{
+    RaceManager::get()->setTrack(track);
+    RaceManager::get()->setupPlayerKartInfo();
+    double start = StkTime::getRealTime();
+    RaceManager::get()->startNew(false);
+    double load_time = StkTime::getRealTime() - start;
+    RaceManager::get()->exitRace();
+    return load_time;
+}   // loadTrack
+
+// ----------------------------------------------------------------------------
+/** Measures loading the track given with --benchmark-track-load, first
+ *  without and then with the collision bvh cache (see
+ *  TriangleMesh::createCollisionShape). The first load with the cache
+ *  builds and writes the bvhs unless they were cached before, and is
+ *  reported separately. Each other measurement loads the track
+ *  --benchmark-races times. Aborts the main loop at the end.
+ */
+void RaceBenchmark::runTrackLoad()
+{
+    if (!track_manager->getTrack(m_load_track))
+    {
+        Log::error("RaceBenchmark", "Can't find track named '%s'.",
+                   m_load_track.c_str());
+        main_loop->abort();
+        return;
+    }
+    RaceManager::get()->setMajorMode(RaceManager::MAJOR_MODE_SINGLE);
+    RaceManager::get()->setMinorMode(RaceManager::MINOR_MODE_NORMAL_RACE);
+    const bool cache_bvh = UserConfigParams::m_cache_collision_bvh;
+    const unsigned int num_loads = std::max(m_num_races, 1u);
+
+    auto measure = [num_loads](const char* name)
+    {
+        double total = 0.0, fastest = 0.0;
+        for (unsigned int i = 0; i < num_loads; i++)
+        {
+            double t = loadTrack(m_load_track);
+            total += t;
+            if (i == 0 || t < fastest)
+                fastest = t;
+        }
+        Log::info("RaceBenchmark", "%s %s: %u loads, average %lf s, "
+                  "fastest %lf s.", m_load_track.c_str(), name, num_loads,
+                  total / num_loads, fastest);
+    };
+
+    // The first load also reads all files from disk
+    UserConfigParams::m_cache_collision_bvh = false;
+    loadTrack(m_load_track);
+    measure("without bvh cache");
+    UserConfigParams::m_cache_collision_bvh = true;
+    Log::info("RaceBenchmark", "%s first load with bvh cache: %lf s.",
+              m_load_track.c_str(), loadTrack(m_load_track));
+    measure("with bvh cache");
+    UserConfigParams::m_cache_collision_bvh = cache_bvh;
+    main_loop->abort();
+}   // runTrackLoad
+
+// ----------------------------------------------------------------------------
+void RaceBenchmark::writeCSV(std::ostream& os)
+{
+    os << "track,seed,load_time,ticks,wall_time,ticks_per_second";
+    for (unsigned int i = 0; i < SS_COUNT; i++)
+        os << "," << getSubsystemName((Subsystem)i) << "_ticks_per_second";
+    os << "\n";
+    for (const RaceResult& r : m_results)
+    {
+        os << r.m_track << "," << r.m_seed << "," << r.m_load_time << ","
+           << r.m_ticks << ","
+           << r.m_wall_time << "," << ticksPerSecond(r.m_ticks, r.m_wall_time);
+        // Leave the field empty if the subsystem was never used
+        for (unsigned int i = 0; i < SS_COUNT; i++)
+        {
+            double tps = ticksPerSecond(r.m_ticks, r.m_subsystem_time[i]);
+            os << ",";
+            if (tps >= 0.0)
+                os << tps;
+        }
+        os << "\n";
+    }
+}   // writeCSV
+
+// ----------------------------------------------------------------------------
+void RaceBenchmark::writeJSON(std::ostream& os)
+{
+    auto write_tps = [&os](int ticks, double seconds)
+    {
+        double tps = ticksPerSecond(ticks, seconds);
+        if (tps >= 0.0)
+            os << tps;
+        else
+            os << "null";
+    };
+
+    int total_ticks = 0;
+    double total_load_time = 0.0;
+    double total_time[SS_COUNT] = { 0.0 };
+    os << "{\n  \"races\": [";
+    for (unsigned int i = 0; i < m_results.size(); i++)
+    {
+        const RaceResult& r = m_results[i];
+        os << (i == 0 ? "\n" : ",\n")
+           << "    {\"track\": \"" << r.m_track << "\""
+           << ", \"seed\": " << r.m_seed
+           << ", \"load_time\": " << r.m_load_time
+           << ", \"ticks\": " << r.m_ticks
+           << ", \"wall_time\": " << r.m_wall_time
+           << ", \"ticks_per_second\": ";
+        write_tps(r.m_ticks, r.m_wall_time);
+        for (unsigned int j = 0; j < SS_COUNT; j++)
+        {
+            os << ", \"" << getSubsystemName((Subsystem)j)
+               << "_ticks_per_second\": ";
+            write_tps(r.m_ticks, r.m_subsystem_time[j]);
+            total_time[j] += r.m_subsystem_time[j];
+        }
+        os << "}";
+        total_ticks += r.m_ticks;
+        total_load_time += r.m_load_time;
+    }
+    os << "\n  ],\n  \"total\": {\"load_time\": " << total_load_time
+       << ", \"ticks\": " << total_ticks;
+    for (unsigned int j = 0; j < SS_COUNT; j++)
+    {
+        os << ", \"" << getSubsystemName((Subsystem)j)
+           << "_ticks_per_second\": ";
+        write_tps(total_ticks, total_time[j]);
+    }
+    os << "}\n}\n";
+}   // writeJSON
+
+// ----------------------------------------------------------------------------
+/** Writes the results of all races to the given file. If the file name ends
+ *  with .json the results are written as JSON, otherwise one CSV line is
+ *  written for each race.
+ *  \return True if the file was written.
+ */
+bool RaceBenchmark::writeToFile(const std::string& filename)
+{
+    std::ofstream f(filename);
+    if (!f.is_open())
+    {
+        Log::error("RaceBenchmark", "Can't open '%s' for writing.",
+                   filename.c_str());
+        return false;
+    }
+    if (StringUtils::toLowerCase(StringUtils::getExtension(filename)) ==
+        "json")
+        writeJSON(f);
+    else
+        writeCSV(f);
+    Log::info("RaceBenchmark", "Wrote %d races to '%s'.",
+              (int)m_results.size(), filename.c_str());
+    return true;
+}   // writeToFile
@@ -0,0 +1,145 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_RACE_BENCHMARK_HPP
+#define HEADER_RACE_BENCHMARK_HPP
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/** \ingroup modes
+ *  Runs a number of AI only races (using ProfileWorld) on each of a list of
+ *  tracks without graphics, and measures how many ticks per second each
+ *  subsystem (physics, AI, items, ...) could do. The time of a subsystem is
+ *  taken from its profiler marker. Each race uses a fixed random seed, so
+ *  results of different builds can be compared. The results are written to
+ *  a CSV or JSON file, started with --race-benchmark=file. The time to
+ *  load each track is written too, which makes this a track loading
+ *  benchmark as well. With --benchmark-verify each race is run twice, and
+ *  the finish times of all karts have to be the same both times.
+ *  With --benchmark-track-load=track only the loading of one track is
+ *  measured, with and without the collision bvh cache.
+ */
+class RaceBenchmark
+{
+public:
+    /** The subsystems which are measured. */
+    enum Subsystem
+    {
+        SS_WORLD, SS_PHYSICS, SS_AI, SS_ITEMS, SS_PROJECTILES, SS_REWIND,
+        SS_COUNT
+    };
+
+    /** The measurements of one race. */
+    struct RaceResult
+    {
+        std::string m_track;
+        unsigned int m_seed;
+        /** Number of ticks simulated. */
+        int m_ticks;
+        /** Wall time of the whole race in seconds. */
+        double m_wall_time;
+        /** Time to load the track and karts in seconds, which is mostly
+         *  spent creating meshes and looking up their materials. */
+        double m_load_time;
+        /** Time spent in each subsystem in seconds. */
+        double m_subsystem_time[SS_COUNT];
+        /** Finish time of each kart, which is the same for each race on a
+         *  track with the same seed. */
+        std::vector<float> m_finish_times;
+    };
+
+private:
+    /** File the results are written to, empty if the benchmark is not
+     *  enabled. */
+    static std::string m_output_file;
+
+    /** The tracks to use, all standard race tracks if empty. */
+    static std::vector<std::string> m_tracks;
+
+    /** Number of races on each track. */
+    static unsigned int m_num_races;
+
+    /** Seed of the first race on each track, the following races use the
+     *  following numbers. */
+    static unsigned int m_first_seed;
+
+    /** If each race is run twice to check that the results are the
+     *  same. */
+    static bool m_verify;
+
+    /** Track of which only the loading is measured, empty if not used. */
+    static std::string m_load_track;
+
+    /** Ticks and finish times of the current race, set by ProfileWorld at
+     *  the end of the race. */
+    static int m_race_ticks;
+    static std::vector<float> m_race_finish_times;
+
+    static std::vector<RaceResult> m_results;
+
+    // ------------------------------------------------------------------------
+    static RaceResult runRace(const std::string& track, unsigned int seed);
+    // ------------------------------------------------------------------------
+    static double loadTrack(const std::string& track);
+    // ------------------------------------------------------------------------
+    static void runTrackLoad();
+    // ------------------------------------------------------------------------
+    static void writeCSV(std::ostream& os);
+    // ------------------------------------------------------------------------
+    static void writeJSON(std::ostream& os);
+
+public:
+    static void run();
+    // ------------------------------------------------------------------------
+    static bool writeToFile(const std::string& filename);
+    // ------------------------------------------------------------------------
+    static const char* getSubsystemName(Subsystem s);
+    // ------------------------------------------------------------------------
+    /** Enables the benchmark, results are written to the given file. */
+    static void enable(const std::string& filename)
+                                                   { m_output_file = filename; }
+    // ------------------------------------------------------------------------
+    static bool isEnabled()
+                  { return !m_output_file.empty() || !m_load_track.empty(); }
+    // ------------------------------------------------------------------------
+    /** Only measures the loading of the given track. */
+    static void enableTrackLoad(const std::string& track)
+                                                    { m_load_track = track; }
+    // ------------------------------------------------------------------------
+    static void setTracks(const std::vector<std::string>& tracks)
+                                                         { m_tracks = tracks; }
+    // ------------------------------------------------------------------------
+    static void setNumRaces(unsigned int n)               { m_num_races = n; }
+    // ------------------------------------------------------------------------
+    static void setFirstSeed(unsigned int seed)       { m_first_seed = seed; }
+    // ------------------------------------------------------------------------
+    static void setVerify(bool verify)                    { m_verify = verify; }
+    // ------------------------------------------------------------------------
+    /** Called by ProfileWorld when a race is over. */
+    static void raceFinished(int ticks, const std::vector<float>& finish_times)
+    {
+        m_race_ticks = ticks;
+        m_race_finish_times = finish_times;
+    }   // raceFinished
+    // ------------------------------------------------------------------------
+    static const std::vector<RaceResult>& getResults()     { return m_results; }
+};   // RaceBenchmark
+
+#endif
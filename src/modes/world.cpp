@@ -83,11 +83,13 @@
 #include "utils/profiler.hpp"
 #include "utils/translation.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <IrrlichtDevice.h>
 #include <ISceneManager.h>
 
 World* World::m_world[PT_COUNT];
+std::mutex World::m_room_world_mutex;
 
 /** The main world class is used to handle the track and the karts.
  *  The end of the race is detected in two phases: first the (abstract)
@@ -125,7 +127,10 @@ World* World::m_world[PT_COUNT];
  */
 World::World() : WorldStatus()
 {
-    RewindManager::setEnable(NetworkConfig::get()->isNetworking());
+    // The snapshots of a replayed history are restored by the rewinders,
+    // so they are needed in an offline replay, too
+    RewindManager::setEnable(NetworkConfig::get()->isNetworking() ||
+        (history->replayHistory() && history->hasSnapshots()));
 #ifdef DEBUG
     m_magic_number = 0xB01D6543;
 #endif
@@ -154,6 +159,11 @@ World::World() : WorldStatus()
  */
 void World::init()
 {
+    std::unique_lock<std::mutex> room_lock(m_room_world_mutex,
+                                           std::defer_lock);
+    if (STKProcess::isRoom(m_process_type))
+        room_lock.lock();
+
     m_ended_early         = false;
     m_faster_music_active = false;
     m_fastest_kart        = 0;
@@ -203,6 +213,20 @@ void World::init()
     // This also defines the static Track::getCurrentTrack function.
     if (m_process_type == PT_MAIN)
         track->loadTrackModel(RaceManager::get()->getReverseTrack());
+    else if (STKProcess::isRoom(m_process_type))
+    {
+        if (!track)
+        {
+            std::ostringstream msg;
+            msg << "Track '" << RaceManager::get()->getTrackName()
+                << "' not found.\n";
+            throw std::runtime_error(msg.str());
+        }
+        // Each room has its own copy of the track, which is deleted in the
+        // destructor of world
+        track = new Track(track->getFilename());
+        track->loadTrackModel(RaceManager::get()->getReverseTrack());
+    }
     else
     {
         Track* child_track = Track::getCurrentTrack();
@@ -278,8 +302,7 @@ void World::init()
     if (m_race_gui)
         m_race_gui->init();
 
-    if (m_process_type == PT_MAIN)
-        powerup_manager->computeWeightsForRace(RaceManager::get()->getNumberOfKarts());
+    powerup_manager->computeWeightsForRace(RaceManager::get()->getNumberOfKarts());
     main_loop->renderGUI(7200);
     if (m_process_type == PT_MAIN && UserConfigParams::m_particles_effects > 1)
     {
@@ -371,6 +394,7 @@ void World::reset(bool restart)
     m_eliminated_karts    = 0;
     m_eliminated_players  = 0;
     m_is_network_world = false;
+    m_proximity_index.reset();
 
     for ( KartList::iterator i = m_karts.begin(); i != m_karts.end() ; ++i )
     {
@@ -619,9 +643,16 @@ Controller* World::loadAIController(AbstractKart* kart)
 //-----------------------------------------------------------------------------
 World::~World()
 {
+    std::unique_lock<std::mutex> room_lock(m_room_world_mutex,
+                                           std::defer_lock);
+    if (STKProcess::isRoom(m_process_type))
+        room_lock.lock();
+
     if (m_process_type == PT_MAIN)
     {
         material_manager->unloadAllTextures();
+        if (!history->replayHistory())
+            history->stopRecording();
     }
 
     RewindManager::destroy();
@@ -637,6 +668,15 @@ World::~World()
         if(Track::getCurrentTrack())
             Track::getCurrentTrack()->cleanup();
     }
+    else if (STKProcess::isRoom(m_process_type))
+    {
+        Track* track = Track::getCurrentTrack();
+        if (track)
+        {
+            track->cleanup();
+            delete track;
+        }
+    }
     else
         Track::cleanChildTrack();
 
@@ -1198,12 +1238,35 @@ void World::update(int ticks)
     // which causes all AI steering commands set. So in the following
     // physics update the new steering is taken into account.
     const int kart_amount = (int)m_karts.size();
+    m_karts_to_update.resize(kart_amount);
     for (int i = 0 ; i < kart_amount; ++i)
     {
         SpareTireAI* sta =
             dynamic_cast<SpareTireAI*>(m_karts[i]->getController());
         // Update all karts that are not eliminated
-        if(!m_karts[i]->isEliminated() || (sta && sta->isMoving()))
+        m_karts_to_update[i] =
+            !m_karts[i]->isEliminated() || (sta && sta->isMoving());
+    }
+
+    // Index the positions of all karts and projectiles once, so that the
+    // controllers and karts do not need to test all other karts.
+    m_proximity_index.build(this, ticks);
+
+    // First let all controllers do their decision work in parallel. This
+    // only reads the world, the results are applied in kart order below,
+    // so the outcome does not depend on the number of threads used.
+    PROFILER_PUSH_CPU_MARKER("World::update (Controller::prepareUpdate)",
+                             0x40, 0x7F, 0x40);
+    WorkerPool::get()->parallelFor(kart_amount, [this, ticks](unsigned i)
+        {
+            if (m_karts_to_update[i])
+                m_karts[i]->getController()->prepareUpdate(ticks);
+        });
+    PROFILER_POP_CPU_MARKER();
+
+    for (int i = 0 ; i < kart_amount; ++i)
+    {
+        if (m_karts_to_update[i])
             m_karts[i]->update(ticks);
         if (isStartPhase())
             m_karts[i]->makeKartRest();
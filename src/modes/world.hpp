@@ -29,10 +29,12 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <stdexcept>
 
 #include "graphics/weather.hpp"
+#include "modes/proximity_index.hpp"
 #include "modes/world_status.hpp"
 #include "race/highscores.hpp"
 #include "states_screens/race_gui_base.hpp"
@@ -91,6 +93,12 @@ public:
 private:
     /** A pointer to the global world object for a race. */
     static World *m_world[PT_COUNT];
+
+    /** The rooms of a multi room server create and delete their worlds one
+     *  after another, since track loading uses global data (e.g. the scene
+     *  manager, material manager and the search paths of the file
+     *  manager). */
+    static std::mutex m_room_world_mutex;
     // ------------------------------------------------------------------------
     void setAITeam();
     // ------------------------------------------------------------------------
@@ -115,6 +123,13 @@ protected:
     KartList                  m_karts;
     RandomGenerator           m_random;
 
+    /** Which karts are updated in the current update(), used in the
+     *  parallel controller phase. */
+    std::vector<bool>         m_karts_to_update;
+
+    /** Positions of all karts and projectiles in the current update(). */
+    ProximityIndex            m_proximity_index;
+
     AbstractKart* m_fastest_kart;
     /** Number of eliminated karts. */
     int         m_eliminated_karts;
@@ -348,6 +363,16 @@ public:
     /** Returns all karts. */
     const KartList & getKarts() const { return m_karts; }
     // ------------------------------------------------------------------------
+    /** Returns the index of the kart and projectile positions of the
+     *  current update. */
+    const ProximityIndex& getProximityIndex() const
+                                                { return m_proximity_index; }
+    // ------------------------------------------------------------------------
+    /** Called when karts and projectiles are moved outside of update (e.g.
+     *  when a state is restored), the queries test all karts and
+     *  projectiles until the index is built again in the next update. */
+    void invalidateProximityIndex()          { m_proximity_index.reset(); }
+    // ------------------------------------------------------------------------
     /** Returns the number of currently active (i.e.non-elikminated) karts. */
     unsigned int    getCurrentNumKarts() const { return (int)m_karts.size() -
                                                          m_eliminated_karts; }
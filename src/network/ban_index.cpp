@@ -0,0 +1,467 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/ban_index.hpp"
+
+#include "network/stk_ipv6.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+
+// ----------------------------------------------------------------------------
+/** Returns the first length bits of an IPv6 address, with all other bits
+ *  cleared.
+ */
+BanIndex::Ipv6Prefix BanIndex::getPrefix(const unsigned char* ipv6,
+                                         int length)
+{
+    uint64_t part[2] = { 0, 0 };
+    for (unsigned i = 0; i < 16; i++)
+        part[i / 8] = (part[i / 8] << 8) | ipv6[i];
+    if (length < 64)
+    {
+        part[0] = length == 0 ? 0 : part[0] & (~0ULL << (64 - length));
+        part[1] = 0;
+    }
+    else if (length < 128)
+        part[1] = length == 64 ? 0 : part[1] & (~0ULL << (128 - length));
+    return Ipv6Prefix(part[0], part[1]);
+}   // getPrefix
+
+// ----------------------------------------------------------------------------
+void BanIndex::addIpBan(const IpBan& ban)
+{
+    if (ban.m_ip_start > ban.m_ip_end)
+        return;
+    m_ip_bans.push_back(ban);
+}   // addIpBan
+
+// ----------------------------------------------------------------------------
+/** Adds an IPv6 ban.
+ *  \return False if the CIDR block of the ban is invalid, in which case the
+ *          ban is ignored (it would never match in the database either).
+ */
+bool BanIndex::addIpv6Ban(const Ipv6Ban& ban)
+{
+    unsigned char prefix[16];
+    int length;
+    if (parseIPv6CIDR(ban.m_ipv6_cidr.c_str(), prefix, &length) != 1)
+        return false;
+
+    auto it = std::find_if(m_ipv6_prefixes.begin(), m_ipv6_prefixes.end(),
+        [length](const std::pair<int, Ipv6PrefixMap>& p)
+        {
+            return p.first <= length;
+        });
+    if (it == m_ipv6_prefixes.end() || it->first != length)
+        it = m_ipv6_prefixes.emplace(it, length, Ipv6PrefixMap());
+    it->second[getPrefix(prefix, length)].push_back(
+        (unsigned)m_ipv6_bans.size());
+    m_ipv6_bans.push_back(ban);
+    return true;
+}   // addIpv6Ban
+
+// ----------------------------------------------------------------------------
+void BanIndex::addOnlineIdBan(const OnlineIdBan& ban)
+{
+    m_online_id_map[ban.m_online_id].push_back(
+        (unsigned)m_online_id_bans.size());
+    m_online_id_bans.push_back(ban);
+}   // addOnlineIdBan
+
+// ----------------------------------------------------------------------------
+/** Adds the IPv4 bans of another index, in the same order.
+ *  \param skip_rows Row ids of the bans which are not copied.
+ */
+void BanIndex::copyIpBans(const BanIndex& index,
+                          const std::set<int>& skip_rows)
+{
+    for (const IpBan& ban : index.m_ip_bans)
+    {
+        if (skip_rows.find(ban.m_row_id) == skip_rows.end())
+            m_ip_bans.push_back(ban);
+    }
+}   // copyIpBans
+
+// ----------------------------------------------------------------------------
+/** Adds the IPv6 bans of another index, in the same order.
+ *  \param skip_rows Row ids of the bans which are not copied.
+ */
+void BanIndex::copyIpv6Bans(const BanIndex& index,
+                            const std::set<int>& skip_rows)
+{
+    for (const Ipv6Ban& ban : index.m_ipv6_bans)
+    {
+        if (skip_rows.find(ban.m_row_id) == skip_rows.end())
+            addIpv6Ban(ban);
+    }
+}   // copyIpv6Bans
+
+// ----------------------------------------------------------------------------
+/** Adds the online id bans of another index, in the same order.
+ *  \param skip_rows Row ids of the bans which are not copied.
+ */
+void BanIndex::copyOnlineIdBans(const BanIndex& index,
+                                const std::set<int>& skip_rows)
+{
+    for (const OnlineIdBan& ban : index.m_online_id_bans)
+    {
+        if (skip_rows.find(ban.m_row_id) == skip_rows.end())
+            addOnlineIdBan(ban);
+    }
+}   // copyOnlineIdBans
+
+// ----------------------------------------------------------------------------
+/** Splits the IPv4 ban ranges into disjoint segments. Must be called after
+ *  all bans are added and before the first IPv4 lookup.
+ */
+void BanIndex::build()
+{
+    // Bans of changed rows are added after the copied ones, sort all by row
+    // id so the same ban is found first as in the table
+    std::stable_sort(m_ip_bans.begin(), m_ip_bans.end(),
+        [](const IpBan& a, const IpBan& b) { return a.m_row_id < b.m_row_id; });
+    for (auto& p : m_ipv6_prefixes)
+    {
+        for (auto& bans : p.second)
+        {
+            std::stable_sort(bans.second.begin(), bans.second.end(),
+                [this](unsigned a, unsigned b)
+                {
+                    return m_ipv6_bans[a].m_row_id < m_ipv6_bans[b].m_row_id;
+                });
+        }
+    }
+    for (auto& bans : m_online_id_map)
+    {
+        std::stable_sort(bans.second.begin(), bans.second.end(),
+            [this](unsigned a, unsigned b)
+            {
+                return m_online_id_bans[a].m_row_id <
+                    m_online_id_bans[b].m_row_id;
+            });
+    }
+
+    // Each ban starts at ip_start and ends before ip_end + 1, which can be
+    // 2^32, so 64 bit is used for the boundaries. Removing sorts before
+    // adding at the same boundary.
+    std::vector<std::pair<uint64_t, int> > events;
+    events.reserve(m_ip_bans.size() * 2);
+    for (unsigned i = 0; i < m_ip_bans.size(); i++)
+    {
+        events.emplace_back(m_ip_bans[i].m_ip_start, (int)i + 1);
+        events.emplace_back((uint64_t)m_ip_bans[i].m_ip_end + 1, -(int)i - 1);
+    }
+    std::sort(events.begin(), events.end());
+
+    m_ip_segments.clear();
+    m_ip_segment_bans.clear();
+    // Ordered by index, so the same ban is found first as in the table
+    std::set<unsigned> active;
+    unsigned e = 0;
+    while (e < events.size())
+    {
+        uint64_t boundary = events[e].first;
+        for (; e < events.size() && events[e].first == boundary; e++)
+        {
+            if (events[e].second > 0)
+                active.insert(events[e].second - 1);
+            else
+                active.erase(-events[e].second - 1);
+        }
+        if (boundary > 0xffffffffULL)
+            break;
+        IpSegment segment;
+        segment.m_start = (uint32_t)boundary;
+        segment.m_first = (uint32_t)m_ip_segment_bans.size();
+        segment.m_count = (uint32_t)active.size();
+        m_ip_segment_bans.insert(m_ip_segment_bans.end(), active.begin(),
+                                 active.end());
+        m_ip_segments.push_back(segment);
+    }
+}   // build
+
+// ----------------------------------------------------------------------------
+/** Returns an effective ban which covers the given IPv4 address, or NULL if
+ *  the address is not banned.
+ *  \param now Current time in seconds since epoch.
+ */
+const BanIndex::IpBan* BanIndex::findIpBan(uint32_t ip, int64_t now) const
+{
+    auto it = std::upper_bound(m_ip_segments.begin(), m_ip_segments.end(), ip,
+        [](uint32_t ip, const IpSegment& s) { return ip < s.m_start; });
+    if (it == m_ip_segments.begin())
+        return NULL;
+    --it;
+    for (uint32_t i = it->m_first; i < it->m_first + it->m_count; i++)
+    {
+        const IpBan& ban = m_ip_bans[m_ip_segment_bans[i]];
+        if (ban.isEffective(now))
+            return &ban;
+    }
+    return NULL;
+}   // findIpBan
+
+// ----------------------------------------------------------------------------
+/** Returns an effective ban whose CIDR block contains the given IPv6 address,
+ *  or NULL if the address is not banned. The most specific block is found
+ *  first.
+ *  \param now Current time in seconds since epoch.
+ */
+const BanIndex::Ipv6Ban* BanIndex::findIpv6Ban(const std::string& ipv6,
+                                               int64_t now) const
+{
+    if (m_ipv6_prefixes.empty())
+        return NULL;
+    unsigned char address[16];
+    if (parseIPv6(ipv6.c_str(), address) != 1)
+        return NULL;
+    for (auto& p : m_ipv6_prefixes)
+    {
+        auto it = p.second.find(getPrefix(address, p.first));
+        if (it == p.second.end())
+            continue;
+        for (unsigned i : it->second)
+        {
+            if (m_ipv6_bans[i].isEffective(now))
+                return &m_ipv6_bans[i];
+        }
+    }
+    return NULL;
+}   // findIpv6Ban
+
+// ----------------------------------------------------------------------------
+/** Returns an effective ban of the given online id, or NULL if it is not
+ *  banned.
+ *  \param now Current time in seconds since epoch.
+ */
+const BanIndex::OnlineIdBan* BanIndex::findOnlineIdBan(uint32_t online_id,
+                                                       int64_t now) const
+{
+    auto it = m_online_id_map.find(online_id);
+    if (it == m_online_id_map.end())
+        return NULL;
+    for (unsigned i : it->second)
+    {
+        if (m_online_id_bans[i].isEffective(now))
+            return &m_online_id_bans[i];
+    }
+    return NULL;
+}   // findOnlineIdBan
+
+// ----------------------------------------------------------------------------
+/** Compares the lookups with a linear search through random bans. */
+void BanIndex::unitTesting()
+{
+    srand(1234);
+    const int64_t now = 1000000;
+    auto random_times = [now](Ban* ban)
+    {
+        // Mostly effective bans, some expired or not yet started
+        int r = rand() % 10;
+        ban->m_start_time = r == 0 ? now + 100 : now - 100;
+        ban->m_end_time = r == 1 ? now - 1 : (r < 5 ? -1 : now + 100);
+    };
+    auto random_ip = []()
+    {
+        return ((uint32_t)(rand() & 0xffff) << 16) | (uint32_t)(rand() & 0xffff);
+    };
+
+    BanIndex index;
+    std::vector<IpBan> ip_bans;
+    for (int i = 0; i < 3000; i++)
+    {
+        IpBan ban;
+        ban.m_row_id = i;
+        random_times(&ban);
+        ban.m_ip_start = random_ip();
+        uint32_t size = (rand() % 4 == 0) ? rand() % 0x1000000 : rand() % 256;
+        ban.m_ip_end = ban.m_ip_start + std::min(size,
+                                                 0xffffffffU - ban.m_ip_start);
+        ip_bans.push_back(ban);
+        index.addIpBan(ban);
+    }
+    // Ranges at both ends of the address space
+    IpBan edge = ip_bans[0];
+    edge.m_start_time = 0;
+    edge.m_end_time = -1;
+    edge.m_ip_start = 0xffffff00U;
+    edge.m_ip_end = 0xffffffffU;
+    ip_bans.push_back(edge);
+    index.addIpBan(edge);
+    edge.m_ip_start = 0;
+    edge.m_ip_end = 10;
+    ip_bans.push_back(edge);
+    index.addIpBan(edge);
+
+    std::vector<Ipv6Ban> ipv6_bans;
+    std::vector<std::string> ipv6_addresses;
+    for (int i = 0; i < 2000; i++)
+    {
+        // Few different first groups, so that blocks contain each other
+        char address[INET6_ADDRSTRLEN];
+        snprintf(address, sizeof(address), "%x:%x:%x:%x:%x:%x:%x:%x",
+            0x2000 + rand() % 4, rand() % 8, rand() & 0xffff,
+            rand() & 0xffff, rand() & 0xffff, rand() & 0xffff,
+            rand() & 0xffff, rand() & 0xffff);
+        ipv6_addresses.push_back(address);
+        if (i % 2 == 0)
+            continue;
+        Ipv6Ban ban;
+        ban.m_row_id = i;
+        random_times(&ban);
+        ban.m_ipv6_cidr = std::string(address) + "/" +
+            StringUtils::toString(1 + rand() % 128);
+        ipv6_bans.push_back(ban);
+        index.addIpv6Ban(ban);
+    }
+    Ipv6Ban invalid = ipv6_bans[0];
+    invalid.m_ipv6_cidr = "2001::";
+    if (index.addIpv6Ban(invalid))
+        Log::fatal("BanIndex", "Accepted CIDR block without mask.");
+
+    std::vector<OnlineIdBan> online_id_bans;
+    for (int i = 0; i < 2000; i++)
+    {
+        OnlineIdBan ban;
+        ban.m_row_id = i;
+        random_times(&ban);
+        ban.m_online_id = rand() % 10000;
+        online_id_bans.push_back(ban);
+        index.addOnlineIdBan(ban);
+    }
+
+    uint64_t start = StkTime::getMonoTimeMs();
+    index.build();
+    Log::info("BanIndex", "Built index of %u bans in %dms.",
+              index.getNumberOfBans(),
+              (int)(StkTime::getMonoTimeMs() - start));
+
+    unsigned errors = 0;
+    for (int i = 0; i < 20000; i++)
+    {
+        uint32_t ip = i % 2 == 0 ? random_ip() :
+            ip_bans[rand() % ip_bans.size()].m_ip_start + rand() % 300;
+        bool banned = false;
+        for (const IpBan& ban : ip_bans)
+        {
+            if (ban.m_ip_start <= ip && ban.m_ip_end >= ip &&
+                ban.isEffective(now))
+                banned = true;
+        }
+        const IpBan* found = index.findIpBan(ip, now);
+        if (banned != (found != NULL) || (found &&
+            (found->m_ip_start > ip || found->m_ip_end < ip ||
+             !found->isEffective(now))))
+        {
+            Log::error("BanIndex", "Wrong result for ip %u.", ip);
+            errors++;
+        }
+    }
+
+    for (const std::string& address : ipv6_addresses)
+    {
+        bool banned = false;
+        for (const Ipv6Ban& ban : ipv6_bans)
+        {
+            if (insideIPv6CIDR(ban.m_ipv6_cidr.c_str(), address.c_str()) == 1
+                && ban.isEffective(now))
+                banned = true;
+        }
+        const Ipv6Ban* found = index.findIpv6Ban(address, now);
+        if (banned != (found != NULL) || (found &&
+            (insideIPv6CIDR(found->m_ipv6_cidr.c_str(), address.c_str()) != 1
+             || !found->isEffective(now))))
+        {
+            Log::error("BanIndex", "Wrong result for ipv6 %s.",
+                       address.c_str());
+            errors++;
+        }
+    }
+
+    for (uint32_t id = 0; id < 10000; id++)
+    {
+        bool banned = false;
+        for (const OnlineIdBan& ban : online_id_bans)
+        {
+            if (ban.m_online_id == id && ban.isEffective(now))
+                banned = true;
+        }
+        const OnlineIdBan* found = index.findOnlineIdBan(id, now);
+        if (banned != (found != NULL) ||
+            (found && found->m_online_id != id))
+        {
+            Log::error("BanIndex", "Wrong result for online id %u.", id);
+            errors++;
+        }
+    }
+
+    // A new index which copies the bans of this one (as done when another
+    // ban table changed) finds the same bans
+    BanIndex copy;
+    copy.copyIpBans(index, std::set<int>());
+    copy.copyIpv6Bans(index, std::set<int>());
+    copy.copyOnlineIdBans(index, std::set<int>());
+    copy.build();
+    if (copy.getNumberOfBans() != index.getNumberOfBans())
+        Log::fatal("BanIndex", "Copied index has a different size.");
+    for (const IpBan& ban : ip_bans)
+    {
+        const IpBan* found = index.findIpBan(ban.m_ip_end, now);
+        const IpBan* found_copy = copy.findIpBan(ban.m_ip_end, now);
+        if ((found != NULL) != (found_copy != NULL) ||
+            (found && found->m_row_id != found_copy->m_row_id))
+        {
+            Log::error("BanIndex", "Wrong result for ip %u in copy.",
+                       ban.m_ip_end);
+            errors++;
+        }
+    }
+    for (const std::string& address : ipv6_addresses)
+    {
+        const Ipv6Ban* found = index.findIpv6Ban(address, now);
+        const Ipv6Ban* found_copy = copy.findIpv6Ban(address, now);
+        if ((found != NULL) != (found_copy != NULL) ||
+            (found && found->m_row_id != found_copy->m_row_id))
+        {
+            Log::error("BanIndex", "Wrong result for ipv6 %s in copy.",
+                       address.c_str());
+            errors++;
+        }
+    }
+    for (uint32_t id = 0; id < 10000; id++)
+    {
+        const OnlineIdBan* found = index.findOnlineIdBan(id, now);
+        const OnlineIdBan* found_copy = copy.findOnlineIdBan(id, now);
+        if ((found != NULL) != (found_copy != NULL) ||
+            (found && found->m_row_id != found_copy->m_row_id))
+        {
+            Log::error("BanIndex", "Wrong result for online id %u in copy.",
+                       id);
+            errors++;
+        }
+    }
+
+    if (errors > 0)
+        Log::fatal("BanIndex", "%u lookups were wrong.", errors);
+}   // unitTesting
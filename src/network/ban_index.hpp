@@ -0,0 +1,149 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_BAN_INDEX_HPP
+#define HEADER_BAN_INDEX_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** \ingroup network
+ *  An in-memory copy of the IPv4, IPv6 and online id ban tables, so that
+ *  a joining peer can be checked without a database query. IPv4 ranges
+ *  (which can overlap) are split into disjoint segments which are found
+ *  with a binary search, IPv6 CIDR blocks are kept in one hash table for
+ *  each used prefix length. The index is built once by DatabaseConnector
+ *  and not changed afterwards, a changed ban table results in a new index
+ *  which copies the unchanged bans from the old one.
+ */
+class BanIndex : public NoCopy
+{
+public:
+    /** Data common to all kinds of bans. */
+    struct Ban
+    {
+        int m_row_id;
+        /** Time (in seconds since epoch) after which the ban is effective. */
+        int64_t m_start_time;
+        /** Time at which the ban expires, or -1 for a permanent ban. */
+        int64_t m_end_time;
+        std::string m_reason;
+        std::string m_description;
+        // --------------------------------------------------------------------
+        bool isEffective(int64_t now) const
+        {
+            return now > m_start_time && (m_end_time < 0 || m_end_time > now);
+        }
+    };
+    struct IpBan : public Ban
+    {
+        uint32_t m_ip_start;
+        uint32_t m_ip_end;
+    };
+    struct Ipv6Ban : public Ban
+    {
+        std::string m_ipv6_cidr;
+    };
+    struct OnlineIdBan : public Ban
+    {
+        uint32_t m_online_id;
+    };
+
+private:
+    /** A range of IPv4 addresses which is covered by the same bans. It ends
+     *  where the next segment starts. */
+    struct IpSegment
+    {
+        uint32_t m_start;
+        /** The bans covering this segment are m_ip_segment_bans[m_first]
+         *  to m_ip_segment_bans[m_first + m_count - 1]. */
+        uint32_t m_first;
+        uint32_t m_count;
+    };
+
+    /** An IPv6 prefix with all bits after the prefix length cleared. */
+    typedef std::pair<uint64_t, uint64_t> Ipv6Prefix;
+
+    struct Ipv6PrefixHash
+    {
+        size_t operator()(const Ipv6Prefix& p) const
+        {
+            return std::hash<uint64_t>()(p.first ^ (p.second * 0x9e3779b97f4a7c15ULL));
+        }
+    };
+
+    typedef std::unordered_map<Ipv6Prefix, std::vector<unsigned>,
+                               Ipv6PrefixHash> Ipv6PrefixMap;
+
+    std::vector<IpBan> m_ip_bans;
+
+    std::vector<IpSegment> m_ip_segments;
+
+    std::vector<unsigned> m_ip_segment_bans;
+
+    std::vector<Ipv6Ban> m_ipv6_bans;
+
+    /** For each used prefix length (longest first) the indices of the bans
+     *  with that length, by prefix. */
+    std::vector<std::pair<int, Ipv6PrefixMap> > m_ipv6_prefixes;
+
+    std::vector<OnlineIdBan> m_online_id_bans;
+
+    std::unordered_map<uint32_t, std::vector<unsigned> > m_online_id_map;
+
+    // ------------------------------------------------------------------------
+    static Ipv6Prefix getPrefix(const unsigned char* ipv6, int length);
+
+public:
+    void addIpBan(const IpBan& ban);
+    // ------------------------------------------------------------------------
+    bool addIpv6Ban(const Ipv6Ban& ban);
+    // ------------------------------------------------------------------------
+    void addOnlineIdBan(const OnlineIdBan& ban);
+    // ------------------------------------------------------------------------
+    void copyIpBans(const BanIndex& index, const std::set<int>& skip_rows);
+    // ------------------------------------------------------------------------
+    void copyIpv6Bans(const BanIndex& index, const std::set<int>& skip_rows);
+    // ------------------------------------------------------------------------
+    void copyOnlineIdBans(const BanIndex& index,
+                          const std::set<int>& skip_rows);
+    // ------------------------------------------------------------------------
+    void build();
+    // ------------------------------------------------------------------------
+    const IpBan* findIpBan(uint32_t ip, int64_t now) const;
+    // ------------------------------------------------------------------------
+    const Ipv6Ban* findIpv6Ban(const std::string& ipv6, int64_t now) const;
+    // ------------------------------------------------------------------------
+    const OnlineIdBan* findOnlineIdBan(uint32_t online_id, int64_t now) const;
+    // ------------------------------------------------------------------------
+    unsigned getNumberOfBans() const
+    {
+        return (unsigned)(m_ip_bans.size() + m_ipv6_bans.size() +
+                          m_online_id_bans.size());
+    }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // BanIndex
+
+#endif
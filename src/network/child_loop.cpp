@@ -20,6 +20,7 @@
 #include "guiengine/engine.hpp"
 #include "items/projectile_manager.hpp"
 #include "modes/world.hpp"
+#include "network/load_generator.hpp"
 #include "network/network_config.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/protocols/server_lobby.hpp"
@@ -78,8 +79,11 @@ float ChildLoop::getLimitedDt()
 // ----------------------------------------------------------------------------
 void ChildLoop::run()
 {
-    VS::setThreadName("ChildLoop");
-    STKProcess::init(PT_CHILD);
+    const ProcessType pt = m_cl_config->m_process_type;
+    std::string thread_name =
+        "ChildLoop" + STKProcess::getThreadNameSuffix(pt);
+    VS::setThreadName(thread_name.c_str());
+    STKProcess::init(pt);
 
     GUIEngine::disableGraphics();
     RaceManager::create();
@@ -87,6 +91,15 @@ void ChildLoop::run()
     NetworkConfig::get()->setIsServer(true);
     if (m_cl_config->m_lan_server)
         NetworkConfig::get()->setIsLAN();
+    else if (STKProcess::isRoom(pt))
+    {
+        // The main process of a multi room server has already detected
+        // the ip type
+        NetworkConfig::get()->copyIPDetectionResult(
+            NetworkConfig::getByType(PT_MAIN));
+        NetworkConfig::get()->setIsWAN();
+        NetworkConfig::get()->setIsPublicServer();
+    }
     else
     {
         if (UserConfigParams::m_default_ip_type == NetworkConfig::IP_NONE)
@@ -127,6 +140,8 @@ void ChildLoop::run()
             {
                 m_port = STKHost::get()->getPrivatePort();
                 m_server_online_id = sl->getServerIdOnline();
+                if (LoadGenerator* lg = LoadGenerator::get())
+                    lg->setServerPort(m_port);
             }
         }
 
@@ -135,8 +150,10 @@ void ChildLoop::run()
         float dt = stk_config->ticks2Time(1);
         left_over_time -= num_steps * dt;
 
+        LoadGenerator* lg = LoadGenerator::get();
         for (int i = 0; i < num_steps; i++)
         {
+            const uint64_t tick_start = lg ? StkTime::getMonoTimeUs() : 0;
             if (auto pm = ProtocolManager::lock())
                 pm->update(1);
 
@@ -156,6 +173,11 @@ void ChildLoop::run()
                 else
                     w->updateWorld(1);
                 w->updateTime(1);
+                if (lg)
+                {
+                    lg->addServerTickTime(
+                        StkTime::getMonoTimeUs() - tick_start);
+                }
             }
             if (m_abort)
                 break;
@@ -171,4 +193,5 @@ void ChildLoop::run()
     ProjectileManager::destroy();
     NetworkConfig::destroy();
     StateManager::deallocate();
+    m_stopped = true;
 }   // run
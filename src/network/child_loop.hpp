@@ -18,6 +18,7 @@
 #ifndef HEADER_SERVER_LOOP_HPP
 #define HEADER_SERVER_LOOP_HPP
 
+#include "utils/stk_process.hpp"
 #include "utils/types.hpp"
 #include <atomic>
 #include <string>
@@ -28,6 +29,9 @@ struct ChildLoopConfig
     uint32_t m_login_id;
     std::string m_token;
     unsigned m_server_ai;
+    /** PT_CHILD for the server of a graphical client, or the room of a
+     *  server hosting several lobbies. */
+    ProcessType m_process_type = PT_CHILD;
 };
 
 class ChildLoop
@@ -37,6 +41,9 @@ private:
 
     std::atomic_bool m_abort;
 
+    /** Set when run() has returned. */
+    std::atomic_bool m_stopped;
+
     std::atomic<uint16_t> m_port;
 
     std::atomic<uint32_t> m_server_online_id;
@@ -49,6 +56,7 @@ public:
         : m_cl_config(new ChildLoopConfig(clc))
     {
         m_abort = false;
+        m_stopped = false;
         m_prev_time = m_curr_time = 0;
         m_port = 0;
         m_server_online_id = 0;
@@ -57,6 +65,7 @@ public:
     /** Set the abort flag, causing the mainloop to be left. */
     void abort() { m_abort = true; }
     bool isAborted() const { return m_abort; }
+    bool isStopped() const { return m_stopped; }
     uint16_t getPort() const { return m_port; }
     uint32_t getServerOnlineId() const { return m_server_online_id; }
 };   // ChildLoop
@@ -81,7 +81,7 @@ public:
     // ------------------------------------------------------------------------
     ENetPacket* encryptSend(BareNetworkString& ns, bool reliable);
     // ------------------------------------------------------------------------
-    NetworkString* decryptRecieve(ENetPacket* p);
+    void decryptRecieve(ENetPacket* p, NetworkString* ns);
 };
 
 #endif // HEADER_CRYPTO_CRYPTOKIT_HPP
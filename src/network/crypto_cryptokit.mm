@@ -166,7 +166,7 @@ ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
 }   // encryptSend
 
 // ----------------------------------------------------------------------------
-NetworkString* Crypto::decryptRecieve(ENetPacket* p)
+void Crypto::decryptRecieve(ENetPacket* p, NetworkString* ns)
 {
 
     std::array<uint8_t, 12> iv = {};
@@ -185,9 +185,7 @@ NetworkString* Crypto::decryptRecieve(ENetPacket* p)
     if (clen != decrypted.length)
         throw std::runtime_error("aesGcmDecryptWithCiphertext produced different size.");
 
-    NetworkString* ns = new NetworkString(p->data, clen);
-    memcpy(ns->m_buffer.data(), decrypted.bytes, decrypted.length);
-    return ns;
+    memcpy(ns->prepareReceive(clen), decrypted.bytes, decrypted.length);
 }   // decryptRecieve
 
 #endif
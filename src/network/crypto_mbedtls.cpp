@@ -148,10 +148,12 @@ ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
 }   // encryptSend
 
 // ----------------------------------------------------------------------------
-NetworkString* Crypto::decryptRecieve(ENetPacket* p)
+void Crypto::decryptRecieve(ENetPacket* p, NetworkString* ns)
 {
-    int clen = (int)(p->dataLength - 4 - m_tag_size);
-    auto ns = std::unique_ptr<NetworkString>(new NetworkString(p->data, clen));
+    int clen = (int)p->dataLength - 4 - (int)m_tag_size;
+    if (clen < 0)
+        throw std::runtime_error("Packet too short.");
+    uint8_t* plain = ns->prepareReceive(clen);
 
     std::array<uint8_t, 12> iv = {};
     if (NetworkConfig::get()->isClient())
@@ -162,14 +164,10 @@ NetworkString* Crypto::decryptRecieve(ENetPacket* p)
     uint8_t* packet_start = p->data + 4 + m_tag_size;
     uint8_t* tag = p->data + 4;
     if (mbedtls_gcm_auth_decrypt(&m_aes_decrypt_context, clen, iv.data(),
-        iv.size(), NULL, 0, tag, m_tag_size, packet_start, ns->m_buffer.data()) != 0)
+        iv.size(), NULL, 0, tag, m_tag_size, packet_start, plain) != 0)
     {
         throw std::runtime_error("Failed authentication.");
     }
-
-    NetworkString* result = ns.get();
-    ns.release();
-    return result;
 }   // decryptRecieve
 
 #endif
@@ -208,10 +208,12 @@ ENetPacket* Crypto::encryptSend(BareNetworkString& ns, bool reliable)
 }   // encryptSend
 
 // ----------------------------------------------------------------------------
-NetworkString* Crypto::decryptRecieve(ENetPacket* p)
+void Crypto::decryptRecieve(ENetPacket* p, NetworkString* ns)
 {
-    int clen = (int)(p->dataLength - 4 - m_tag_size);
-    auto ns = std::unique_ptr<NetworkString>(new NetworkString(p->data, clen));
+    int clen = (int)p->dataLength - 4 - (int)m_tag_size;
+    if (clen < 0)
+        throw std::runtime_error("Packet too short.");
+    uint8_t* plain = ns->prepareReceive(clen);
 
     std::array<uint8_t, 12> iv = {};
     if (NetworkConfig::get()->isClient())
@@ -231,17 +233,14 @@ NetworkString* Crypto::decryptRecieve(ENetPacket* p)
     }
 
     int dlen;
-    if (EVP_DecryptUpdate(m_decrypt, ns->m_buffer.data(), &dlen,
-        packet_start, clen) != 1)
+    if (EVP_DecryptUpdate(m_decrypt, plain, &dlen, packet_start, clen) != 1)
     {
         throw std::runtime_error("Failed to decrypt.");
     }
     if (EVP_DecryptFinal_ex(m_decrypt, unused_16_blocks.data(), &dlen) > 0)
     {
         assert(dlen == 0);
-        NetworkString* result = ns.get();
-        ns.release();
-        return result;
+        return;
     }
     throw std::runtime_error("Failed to finalize decryption.");
 }   // decryptRecieve
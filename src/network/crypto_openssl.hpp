@@ -161,7 +161,7 @@ public:
     // ------------------------------------------------------------------------
     ENetPacket* encryptSend(BareNetworkString& ns, bool reliable);
     // ------------------------------------------------------------------------
-    NetworkString* decryptRecieve(ENetPacket* p);
+    void decryptRecieve(ENetPacket* p, NetworkString* ns);
 
 };
 
@@ -20,6 +20,7 @@
 
 #include "network/database_connector.hpp"
 
+#include "network/ban_index.hpp"
 #include "network/network_player_profile.hpp"
 #include "network/server_config.hpp"
 #include "network/socket_address.hpp"
@@ -27,6 +28,25 @@
 #include "network/stk_ipv6.hpp"
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
+#include "utils/vs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    /** Binds a string (copied) to a parameter of a prepared statement, or NULL
+     *  if requested and the string is empty. */
+    void bindText(sqlite3_stmt* stmt, int idx, const std::string& value,
+                  bool use_null_if_empty = false)
+    {
+        if (use_null_if_empty && value.empty())
+            sqlite3_bind_null(stmt, idx);
+        else
+            sqlite3_bind_text(stmt, idx, value.c_str(), -1, SQLITE_TRANSIENT);
+    }   // bindText
+}   // namespace
 
 //-----------------------------------------------------------------------------
 /** Prints "?" to the output stream and saves the Binder object to the
@@ -83,33 +103,22 @@ std::function<void(sqlite3_stmt* stmt)> BinderCollection::getBindFunction() cons
 }   // BinderCollection::getBindFunction
 
 //-----------------------------------------------------------------------------
-/** Opens the database, sets its busy handler and variables related to it. */
-void DatabaseConnector::initDatabase()
+/** Opens a connection to the database and sets its busy handler and the
+ *   functions used in queries.
+ *  \return The connection, or NULL if the database can't be opened.
+ */
+sqlite3* DatabaseConnector::openDatabase(const std::string& path, int flags)
 {
-    m_last_poll_db_time = StkTime::getMonoTimeMs();
-    m_db = NULL;
-    m_ip_ban_table_exists = false;
-    m_ipv6_ban_table_exists = false;
-    m_online_id_ban_table_exists = false;
-    m_ip_geolocation_table_exists = false;
-    m_ipv6_geolocation_table_exists = false;
-    m_player_reports_table_exists = false;
-    if (!ServerConfig::m_sql_management)
-        return;
-    const std::string& path = ServerConfig::getConfigDirectory() + "/" +
-        ServerConfig::m_database_file.c_str();
-    int ret = sqlite3_open_v2(path.c_str(), &m_db,
-        SQLITE_OPEN_SHAREDCACHE | SQLITE_OPEN_FULLMUTEX |
-        SQLITE_OPEN_READWRITE, NULL);
+    sqlite3* db = NULL;
+    int ret = sqlite3_open_v2(path.c_str(), &db, flags, NULL);
     if (ret != SQLITE_OK)
     {
         Log::error("ServerLobby", "Cannot open database: %s.",
-            sqlite3_errmsg(m_db));
-        sqlite3_close(m_db);
-        m_db = NULL;
-        return;
+            sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
     }
-    sqlite3_busy_handler(m_db, [](void* data, int retry)
+    sqlite3_busy_handler(db, [](void* data, int retry)
         {
             int retry_count = ServerConfig::m_database_timeout / 100;
             if (retry < retry_count)
@@ -121,10 +130,77 @@ void DatabaseConnector::initDatabase()
             // Return zero to let caller return SQLITE_BUSY immediately
             return 0;
         }, NULL);
-    sqlite3_create_function(m_db, "insideIPv6CIDR", 2, SQLITE_UTF8, NULL,
+    sqlite3_create_function(db, "insideIPv6CIDR", 2, SQLITE_UTF8, NULL,
         &insideIPv6CIDRSQL, NULL, NULL);
-    sqlite3_create_function(m_db, "upperIPv6", 1, SQLITE_UTF8, NULL,
+    sqlite3_create_function(db, "upperIPv6", 1, SQLITE_UTF8, NULL,
         &upperIPv6SQL, NULL, NULL);
+    return db;
+}   // openDatabase
+
+//-----------------------------------------------------------------------------
+/** Switches the database to write-ahead logging, in which reads are not
+ *   blocked while the writer thread commits. The mode is stored in the
+ *   database file, so it is kept for all connections.
+ *  
+eturn True if the database uses write-ahead logging.
+ */
+bool DatabaseConnector::enableWAL(sqlite3* db)
+{
+    sqlite3_stmt* stmt = NULL;
+    bool wal = false;
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode=WAL;", -1, &stmt,
+        NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char* mode = sqlite3_column_text(stmt, 0);
+        wal = mode && std::string((const char*)mode) == "wal";
+    }
+    sqlite3_finalize(stmt);
+    if (!wal)
+    {
+        Log::warn("DatabaseConnector", "Cannot use write-ahead logging, "
+            "reads will wait for writes.");
+    }
+    return wal;
+}   // enableWAL
+
+//-----------------------------------------------------------------------------
+/** Opens the database, sets its busy handler and variables related to it,
+ *   and starts the writer thread. */
+void DatabaseConnector::initDatabase()
+{
+    m_last_poll_db_time = StkTime::getMonoTimeMs();
+    m_db = NULL;
+    m_writer_db = NULL;
+    m_write_exit = false;
+    for (unsigned i = 0; i < SI_COUNT; i++)
+    {
+        m_statements[i] = NULL;
+        m_writer_statements[i] = NULL;
+    }
+    m_ip_ban_table_exists = false;
+    m_ipv6_ban_table_exists = false;
+    m_online_id_ban_table_exists = false;
+    m_ip_geolocation_table_exists = false;
+    m_ipv6_geolocation_table_exists = false;
+    m_player_reports_table_exists = false;
+    m_ban_index = std::make_shared<BanIndex>();
+    m_ip_ban_changes = BanTableChanges();
+    m_ipv6_ban_changes = BanTableChanges();
+    m_online_id_ban_changes = BanTableChanges();
+    if (!ServerConfig::m_sql_management)
+        return;
+    const std::string& path = ServerConfig::getConfigDirectory() + "/" +
+        ServerConfig::m_database_file.c_str();
+    m_db = openDatabase(path, SQLITE_OPEN_SHAREDCACHE | SQLITE_OPEN_FULLMUTEX |
+        SQLITE_OPEN_READWRITE);
+    if (!m_db)
+        return;
+    // Only the log is synced, and only at checkpoints, which can lose the
+    // last commits on a power loss but never corrupts the database
+    const char* synchronous = "PRAGMA synchronous=NORMAL;";
+    bool wal = enableWAL(m_db);
+    if (wal)
+        sqlite3_exec(m_db, synchronous, NULL, NULL, NULL);
     checkTableExists(ServerConfig::m_ip_ban_table, m_ip_ban_table_exists);
     checkTableExists(ServerConfig::m_ipv6_ban_table, m_ipv6_ban_table_exists);
     checkTableExists(ServerConfig::m_online_id_ban_table,
@@ -135,8 +211,56 @@ void DatabaseConnector::initDatabase()
         m_ip_geolocation_table_exists);
     checkTableExists(ServerConfig::m_ipv6_geolocation_table,
         m_ipv6_geolocation_table_exists);
+    if (m_ip_ban_table_exists)
+    {
+        trackBanTableChanges(ServerConfig::m_ip_ban_table,
+            "ip_start, ip_end", &m_ip_ban_changes);
+    }
+    if (m_ipv6_ban_table_exists)
+    {
+        trackBanTableChanges(ServerConfig::m_ipv6_ban_table, "ipv6_cidr",
+            &m_ipv6_ban_changes);
+    }
+    if (m_online_id_ban_table_exists)
+    {
+        trackBanTableChanges(ServerConfig::m_online_id_ban_table,
+            "online_id", &m_online_id_ban_changes);
+    }
+    updateBanIndex(true/*force*/);
+
+    // The writer uses a private cache, so that committing its transactions
+    // does not lock the connection used by the lobby
+    m_writer_db = openDatabase(path, SQLITE_OPEN_NOMUTEX |
+        SQLITE_OPEN_PRIVATECACHE | SQLITE_OPEN_READWRITE);
+    if (m_writer_db && wal)
+        sqlite3_exec(m_writer_db, synchronous, NULL, NULL, NULL);
+    if (m_writer_db)
+        m_writer_thread = std::thread(&DatabaseConnector::writerLoop, this);
+    else
+        Log::warn("DatabaseConnector", "Database writes will be synchronous.");
 }   // initDatabase
 
+//-----------------------------------------------------------------------------
+/** Writes all pending queries and stops the writer thread. */
+void DatabaseConnector::stopWriter()
+{
+    if (!m_writer_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        m_write_exit = true;
+    }
+    m_write_cv.notify_one();
+    m_writer_thread.join();
+    for (unsigned i = 0; i < SI_COUNT; i++)
+    {
+        sqlite3_finalize(m_writer_statements[i]);
+        m_writer_statements[i] = NULL;
+    }
+    sqlite3_close(m_writer_db);
+    m_writer_db = NULL;
+}   // stopWriter
+
 //-----------------------------------------------------------------------------
 /** Closes the database. */
 void DatabaseConnector::destroyDatabase()
@@ -144,28 +268,34 @@ void DatabaseConnector::destroyDatabase()
     auto peers = STKHost::get()->getPeers();
     for (auto& peer : peers)
         writeDisconnectInfoTable(peer.get());
+    stopWriter();
     if (m_db != NULL)
+    {
+        for (unsigned i = 0; i < SI_COUNT; i++)
+        {
+            sqlite3_finalize(m_statements[i]);
+            m_statements[i] = NULL;
+        }
         sqlite3_close(m_db);
+        m_db = NULL;
+    }
 }   // destroyDatabase
 
 //-----------------------------------------------------------------------------
-/** Runs simple query with optional bind function. If output vector pointer is
- *   not (default) nullptr, then the output is written there.
- *  \param query The SQL query with '?'-placeholders for values to bind.
- *  \param output The 2D vector for output rows. If nullptr, the query output
- *                is ignored.
- *  \param bind_function The function for binding missing values.
- *  \return True if no error occurs.
+/** Runs a query on the given connection, see easySQLQuery.
+ *  \param cached_stmt If not NULL, the prepared statement is kept here for
+ *                     the next call (and reused if it was already prepared).
  */
-bool DatabaseConnector::easySQLQuery(
-       const std::string& query, std::vector<std::vector<std::string>>* output,
+bool DatabaseConnector::runQuery(sqlite3* db, sqlite3_stmt** cached_stmt,
+                         const std::string& query,
+                         std::vector<std::vector<std::string>>* output,
                          std::function<void(sqlite3_stmt* stmt)> bind_function,
-                                                  std::string null_value) const
+                         const std::string& null_value)
 {
-    if (!m_db)
-        return false;
-    sqlite3_stmt* stmt = NULL;
-    int ret = sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, 0);
+    sqlite3_stmt* stmt = cached_stmt ? *cached_stmt : NULL;
+    int ret = SQLITE_OK;
+    if (!stmt)
+        ret = sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, 0);
     if (ret == SQLITE_OK)
     {
         if (bind_function)
@@ -189,12 +319,21 @@ bool DatabaseConnector::easySQLQuery(
                 ret = sqlite3_step(stmt);
             }
         }
-        ret = sqlite3_finalize(stmt);
+        if (cached_stmt)
+        {
+            // Reset it at once, so no read is left open while other
+            // connections commit
+            *cached_stmt = stmt;
+            ret = sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        else
+            ret = sqlite3_finalize(stmt);
         if (ret != SQLITE_OK)
         {
             Log::error("DatabaseConnector",
                 "Error finalize database for easy query %s: %s",
-                query.c_str(), sqlite3_errmsg(m_db));
+                query.c_str(), sqlite3_errmsg(db));
             return false;
         }
     }
@@ -202,12 +341,115 @@ bool DatabaseConnector::easySQLQuery(
     {
         Log::error("DatabaseConnector",
             "Error preparing database for easy query %s: %s",
-            query.c_str(), sqlite3_errmsg(m_db));
+            query.c_str(), sqlite3_errmsg(db));
         return false;
     }
     return true;
+}   // runQuery
+
+//-----------------------------------------------------------------------------
+/** Runs simple query with optional bind function. If output vector pointer is
+ *   not (default) nullptr, then the output is written there.
+ *  \param query The SQL query with '?'-placeholders for values to bind.
+ *  \param output The 2D vector for output rows. If nullptr, the query output
+ *                is ignored.
+ *  \param bind_function The function for binding missing values.
+ *  \return True if no error occurs.
+ */
+bool DatabaseConnector::easySQLQuery(
+       const std::string& query, std::vector<std::vector<std::string>>* output,
+                         std::function<void(sqlite3_stmt* stmt)> bind_function,
+                                                  std::string null_value) const
+{
+    if (!m_db)
+        return false;
+    return runQuery(m_db, NULL, query, output, bind_function, null_value);
 }   // easySQLQuery
 
+//-----------------------------------------------------------------------------
+/** Same as above, but the statement is only prepared on the first call with
+ *   the given id and then reused. The query is ignored after that.
+ */
+bool DatabaseConnector::easySQLQuery(StatementId id,
+       const std::string& query, std::vector<std::vector<std::string>>* output,
+                         std::function<void(sqlite3_stmt* stmt)> bind_function,
+                                                  std::string null_value) const
+{
+    if (!m_db)
+        return false;
+    if (id == SI_NONE)
+        return runQuery(m_db, NULL, query, output, bind_function, null_value);
+    std::lock_guard<std::mutex> lock(m_statements_mutex);
+    return runQuery(m_db, &m_statements[id], query, output, bind_function,
+                    null_value);
+}   // easySQLQuery
+
+//-----------------------------------------------------------------------------
+/** Queues a query without output for the writer thread. If there is no
+ *   writer thread the query is run at once.
+ *  \param id Id of the statement to reuse, or SI_NONE.
+ *  \param query The SQL query with '?'-placeholders for values to bind.
+ *  \param bind_function The function for binding missing values, it must
+ *                       not reference any data of the caller.
+ */
+void DatabaseConnector::asyncSQLQuery(StatementId id, const std::string& query,
+            std::function<void(sqlite3_stmt* stmt)> bind_function) const
+{
+    if (!m_db)
+        return;
+    if (!m_writer_db)
+    {
+        easySQLQuery(id, query, nullptr, bind_function);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        m_write_queue.push_back({ id, query, bind_function });
+    }
+    m_write_cv.notify_one();
+}   // asyncSQLQuery
+
+//-----------------------------------------------------------------------------
+/** The main loop of the writer thread. All queries queued while the last
+ *   batch was written are written in one transaction, so a wave of joining
+ *   players only needs one sync of the database file.
+ */
+void DatabaseConnector::writerLoop()
+{
+    VS::setThreadName("DatabaseWriter");
+    std::vector<WriteRequest> batch;
+    std::unique_lock<std::mutex> ul(m_write_mutex);
+    while (true)
+    {
+        m_write_cv.wait(ul, [this]
+            {
+                return m_write_exit || !m_write_queue.empty();
+            });
+        if (m_write_queue.empty())
+            return;
+        batch.swap(m_write_queue);
+        ul.unlock();
+
+        bool transaction = batch.size() > 1 &&
+            sqlite3_exec(m_writer_db, "BEGIN;", NULL, NULL, NULL) == SQLITE_OK;
+        for (WriteRequest& request : batch)
+        {
+            runQuery(m_writer_db, request.m_id == SI_NONE ?
+                NULL : &m_writer_statements[request.m_id], request.m_query,
+                nullptr, request.m_bind_function, "");
+        }
+        if (transaction &&
+            sqlite3_exec(m_writer_db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+        {
+            Log::error("DatabaseConnector", "Error committing %d writes: %s",
+                (int)batch.size(), sqlite3_errmsg(m_writer_db));
+            sqlite3_exec(m_writer_db, "ROLLBACK;", NULL, NULL, NULL);
+        }
+        batch.clear();
+        ul.lock();
+    }
+}   // writerLoop
+
 //-----------------------------------------------------------------------------
 /** Performs a query to determine if a certain table exists.
  *  \param table The searched name.
@@ -258,13 +500,15 @@ std::string DatabaseConnector::ip2Country(const SocketAddress& addr) const
     std::string cc_code;
     std::string query = StringUtils::insertValues(
         "SELECT country_code FROM %s "
-        "WHERE `ip_start` <= %d AND `ip_end` >= %d "
+        "WHERE `ip_start` <= ?1 AND `ip_end` >= ?1 "
         "ORDER BY `ip_start` DESC LIMIT 1;",
-        ServerConfig::m_ip_geolocation_table.c_str(), addr.getIP(),
-        addr.getIP());
+        ServerConfig::m_ip_geolocation_table.c_str());
+    const uint32_t ip = addr.getIP();
 
     std::vector<std::vector<std::string>> output;
-    if (easySQLQuery(query, &output) && !output.empty())
+    if (easySQLQuery(SI_IP_TO_COUNTRY, query, &output,
+        [ip](sqlite3_stmt* stmt) { sqlite3_bind_int64(stmt, 1, ip); }) &&
+        !output.empty())
     {
         cc_code = output[0][0];
     }
@@ -287,13 +531,14 @@ std::string DatabaseConnector::ipv62Country(const SocketAddress& addr) const
     const std::string& ipv6 = addr.toString(false/*show_port*/);
     std::string query = StringUtils::insertValues(
         "SELECT country_code FROM %s "
-        "WHERE `ip_start` <= upperIPv6(\"%s\") AND `ip_end` >= upperIPv6(\"%s\") "
+        "WHERE `ip_start` <= upperIPv6(?1) AND `ip_end` >= upperIPv6(?1) "
         "ORDER BY `ip_start` DESC LIMIT 1;",
-        ServerConfig::m_ipv6_geolocation_table.c_str(), ipv6.c_str(),
-        ipv6.c_str());
+        ServerConfig::m_ipv6_geolocation_table.c_str());
 
     std::vector<std::vector<std::string>> output;
-    if (easySQLQuery(query, &output) && !output.empty())
+    if (easySQLQuery(SI_IPV6_TO_COUNTRY, query, &output,
+        [ipv6](sqlite3_stmt* stmt) { bindText(stmt, 1, ipv6); }) &&
+        !output.empty())
     {
         cc_code = output[0][0];
     }
@@ -374,11 +619,18 @@ void DatabaseConnector::writeDisconnectInfoTable(STKPeer* peer)
         return;
     std::string query = StringUtils::insertValues(
         "UPDATE %s SET disconnected_time = datetime('now'), "
-        "ping = %d, packet_loss = %d "
-        "WHERE host_id = %u;", m_server_stats_table.c_str(),
-        peer->getAveragePing(), peer->getPacketLoss(),
-        peer->getHostId());
-    easySQLQuery(query);
+        "ping = ?, packet_loss = ? "
+        "WHERE host_id = ?;", m_server_stats_table.c_str());
+    const int ping = peer->getAveragePing();
+    const int packet_loss = peer->getPacketLoss();
+    const uint32_t host_id = peer->getHostId();
+    asyncSQLQuery(SI_DISCONNECT_INFO, query,
+        [ping, packet_loss, host_id](sqlite3_stmt* stmt)
+        {
+            sqlite3_bind_int(stmt, 1, ping);
+            sqlite3_bind_int(stmt, 2, packet_loss);
+            sqlite3_bind_int64(stmt, 3, host_id);
+        });
 }   // writeDisconnectInfoTable
 
 //-----------------------------------------------------------------------------
@@ -393,7 +645,7 @@ void DatabaseConnector::initServerStatsTable()
         return;
     std::string table_name = std::string("v") +
         StringUtils::toString(ServerConfig::m_server_db_version) + "_" +
-        ServerConfig::m_server_uid + "_stats";
+        ServerConfig::getServerUid() + "_stats";
 
     std::ostringstream oss;
     oss << "CREATE TABLE IF NOT EXISTS " << table_name << " (\n"
@@ -439,7 +691,7 @@ void DatabaseConnector::initServerStatsTable()
     // players in minutes
     std::string full_stats_view_name = std::string("v") +
         StringUtils::toString(ServerConfig::m_server_db_version) + "_" +
-        ServerConfig::m_server_uid + "_full_stats";
+        ServerConfig::getServerUid() + "_full_stats";
     oss.str("");
     oss << "CREATE VIEW IF NOT EXISTS " << full_stats_view_name << " AS\n"
         << "    SELECT host_id, ip,\n"
@@ -461,7 +713,7 @@ void DatabaseConnector::initServerStatsTable()
     // played of each players in minutes
     std::string current_players_view_name = std::string("v") +
         StringUtils::toString(ServerConfig::m_server_db_version) + "_" +
-        ServerConfig::m_server_uid + "_current_players";
+        ServerConfig::getServerUid() + "_current_players";
     oss.str("");
     oss.clear();
     oss << "CREATE VIEW IF NOT EXISTS " << current_players_view_name << " AS\n"
@@ -485,7 +737,7 @@ void DatabaseConnector::initServerStatsTable()
     // If sqlite supports window functions (since 3.25), it will include last session player info (ip, country, ping...)
     std::string player_stats_view_name = std::string("v") +
         StringUtils::toString(ServerConfig::m_server_db_version) + "_" +
-        ServerConfig::m_server_uid + "_player_stats";
+        ServerConfig::getServerUid() + "_player_stats";
     oss.str("");
     oss.clear();
     if (sqlite3_libversion_number() < 3025000)
@@ -594,7 +846,7 @@ bool DatabaseConnector::writeReport(
             "info, reporting_ip, reporting_ipv6, reporting_online_id, reporting_username) "
             "VALUES (%s, %u, \"%s\", %u, %s, %s, %u, \"%s\", %u, %s);",
             ServerConfig::m_player_reports_table.c_str(),
-            Binder(coll, ServerConfig::m_server_uid, "server_uid"),
+            Binder(coll, ServerConfig::getServerUid(), "server_uid"),
             !reporter->getAddress().isIPv6() ? reporter->getAddress().getIP() : 0,
             reporter->getAddress().isIPv6() ? reporter->getAddress().toString(false) : "",
             reporter_npp->getOnlineId(),
@@ -614,7 +866,7 @@ bool DatabaseConnector::writeReport(
             "info, reporting_ip, reporting_online_id, reporting_username) "
             "VALUES (%s, %u, %u, %s, %s, %u, %u, %s);",
             ServerConfig::m_player_reports_table.c_str(),
-            Binder(coll, ServerConfig::m_server_uid, "server_uid"),
+            Binder(coll, ServerConfig::getServerUid(), "server_uid"),
             reporter->getAddress().getIP(),
             reporter_npp->getOnlineId(),
             Binder(coll, StringUtils::wideToUtf8(reporter_npp->getName()), "reporter_name"),
@@ -627,12 +879,264 @@ bool DatabaseConnector::writeReport(
     return easySQLQuery(query, nullptr, coll->getBindFunction());
 }   // writeReport
 
+//-----------------------------------------------------------------------------
+/** Creates the triggers which log the changed rows of a ban table in the
+ *   table <table>_changes, each with an increasing change id. Only the
+ *   columns used by BanIndex are tracked, so the trigger counts which are
+ *   written for each banned peer are not logged.
+ *  \param table Name of the ban table.
+ *  \param columns The columns of the table which identify the banned
+ *                 peers.
+ *  \param changes Set to tracked if the triggers exist.
+ */
+void DatabaseConnector::trackBanTableChanges(const std::string& table,
+                                             const std::string& columns,
+                                             BanTableChanges* changes)
+{
+    const char* t = table.c_str();
+    // Several servers can share the ban tables, so all of them use the same
+    // triggers
+    auto log_row = [t](const char* row)
+    {
+        return StringUtils::insertValues("INSERT OR REPLACE INTO %s_changes "
+            "VALUES (%s.rowid, (SELECT IFNULL(MAX(change_id), 0) + 1 FROM "
+            "%s_changes));", t, row, t);
+    };
+    // INSERT OR REPLACE (and UPDATE OR REPLACE) delete the rows with the
+    // same unique columns without running the delete trigger, so these rows
+    // are logged before
+    std::string conflict;
+    for (std::string column : StringUtils::split(columns, ','))
+    {
+        column.erase(0, column.find_first_not_of(' '));
+        conflict += (conflict.empty() ? "" : " OR ") + column + " = NEW." +
+            column;
+    }
+    const std::string log_conflicts = StringUtils::insertValues(
+        "INSERT OR REPLACE INTO %s_changes SELECT rowid, (SELECT "
+        "IFNULL(MAX(change_id), 0) + 1 FROM %s_changes) FROM %s WHERE %s;",
+        t, t, t, conflict.c_str());
+    changes->m_tracked =
+        easySQLQuery(StringUtils::insertValues(
+        "CREATE TABLE IF NOT EXISTS %s_changes (ban_rowid INTEGER PRIMARY "
+        "KEY, change_id INTEGER NOT NULL);", t)) &&
+        easySQLQuery(StringUtils::insertValues(
+        "CREATE INDEX IF NOT EXISTS %s_changes_id ON %s_changes (change_id);",
+        t, t)) &&
+        easySQLQuery(StringUtils::insertValues(
+        "CREATE TRIGGER IF NOT EXISTS %s_replace BEFORE INSERT ON %s BEGIN "
+        "%s END;", t, t, log_conflicts.c_str())) &&
+        easySQLQuery(StringUtils::insertValues(
+        "CREATE TRIGGER IF NOT EXISTS %s_replace_update BEFORE UPDATE OF %s "
+        "ON %s BEGIN %s END;", t, columns.c_str(), t,
+        log_conflicts.c_str())) &&
+        easySQLQuery(StringUtils::insertValues(
+        "CREATE TRIGGER IF NOT EXISTS %s_insert AFTER INSERT ON %s BEGIN %s "
+        "END;", t, t, log_row("NEW").c_str())) &&
+        easySQLQuery(StringUtils::insertValues(
+        "CREATE TRIGGER IF NOT EXISTS %s_update AFTER UPDATE OF %s, "
+        "starting_time, expired_days, reason, description ON %s BEGIN %s %s "
+        "END;", t, columns.c_str(), t,
+        log_row("OLD").c_str(),
+        log_row("NEW").c_str())) &&
+        easySQLQuery(StringUtils::insertValues(
+        "CREATE TRIGGER IF NOT EXISTS %s_delete AFTER DELETE ON %s BEGIN %s "
+        "END;", t, t, log_row("OLD").c_str()));
+    if (!changes->m_tracked)
+    {
+        Log::warn("DatabaseConnector", "Changes of table %s can't be "
+            "tracked, it will be loaded completely at each poll.", t);
+    }
+}   // trackBanTableChanges
+
+//-----------------------------------------------------------------------------
+/** Finds the rows of a ban table which were inserted, updated or deleted
+ *   since the last call, see trackBanTableChanges().
+ *  \param table Name of the ban table.
+ *  \param changes The last change which was read before, updated.
+ *  \param rows Row ids of the changed bans are added to it.
+ *  \return False if the changes can't be read, the whole table has to be
+ *          loaded then.
+ */
+bool DatabaseConnector::getBanTableChanges(const std::string& table,
+                                           BanTableChanges* changes,
+                                           std::set<int>* rows) const
+{
+    if (!changes->m_tracked)
+        return false;
+    std::string query = StringUtils::insertValues(
+        "SELECT ban_rowid, change_id FROM %s_changes WHERE change_id > %s;",
+        table.c_str(), changes->m_last_change);
+    std::vector<std::vector<std::string>> output;
+    if (!easySQLQuery(query, &output))
+        return false;
+    for (std::vector<std::string>& row : output)
+    {
+        int row_id;
+        int64_t change;
+        if (row.size() != 2 || !StringUtils::fromString(row[0], row_id) ||
+            !StringUtils::fromString(row[1], change))
+            continue;
+        rows->insert(row_id);
+        changes->m_last_change = std::max(changes->m_last_change, change);
+    }
+    return true;
+}   // getBanTableChanges
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const BanIndex> DatabaseConnector::getBanIndex() const
+{
+    std::lock_guard<std::mutex> lock(m_ban_index_mutex);
+    return m_ban_index;
+}   // getBanIndex
+
+//-----------------------------------------------------------------------------
+/** Updates the in-memory copy of the ban tables (or loads all of them if
+ *   force is set). Only the bans of the rows which were changed since the
+ *   last time are loaded again, the others are copied from the current
+ *   BanIndex. Bans which are not expired are loaded, including those which
+ *   start or expire later, the index checks their times for each lookup.
+ */
+void DatabaseConnector::updateBanIndex(bool force)
+{
+    if (!m_db)
+        return;
+
+    uint64_t start = StkTime::getMonoTimeMs();
+    // Not formed with insertValues, it would replace the %s of strftime
+    const std::string columns = "rowid, reason, description, "
+        "CAST(strftime('%s', starting_time) AS INTEGER), "
+        "IFNULL(CAST(strftime('%s', starting_time, "
+        "'+'||expired_days||' days') AS INTEGER), -1)";
+    // Returns the condition for the rows to load, which is empty if the
+    // table is unchanged. Sets all if all rows are loaded, otherwise rows
+    // are the changed rows, which are not copied from the old index.
+    auto changed_rows = [this, force](bool exists, const std::string& table,
+                                      BanTableChanges* changes,
+                                      std::set<int>* rows, bool* all)
+    {
+        rows->clear();
+        *all = false;
+        if (!exists)
+            return std::string();
+        std::string where = " WHERE (expired_days is NULL OR "
+            "datetime(starting_time, '+'||expired_days||' days') > "
+            "datetime('now'))";
+        *all = !getBanTableChanges(table, changes, rows) || force;
+        if (*all)
+            return where + ";";
+        if (rows->empty())
+            return std::string();
+        where += " AND rowid IN (";
+        for (int row : *rows)
+            where += StringUtils::toString(row) + ",";
+        where.back() = ')';
+        return where + ";";
+    };
+    auto read_ban = [](const std::vector<std::string>& row, BanIndex::Ban* ban)
+    {
+        if (!StringUtils::fromString(row[0], ban->m_row_id))
+            return false;
+        ban->m_reason = row[1];
+        ban->m_description = row[2];
+        if (!StringUtils::fromString(row[3], ban->m_start_time))
+            ban->m_start_time = 0;
+        if (!StringUtils::fromString(row[4], ban->m_end_time))
+            ban->m_end_time = -1;
+        return true;
+    };
+
+    std::shared_ptr<const BanIndex> old_index = getBanIndex();
+    std::shared_ptr<BanIndex> index = std::make_shared<BanIndex>();
+    std::vector<std::vector<std::string>> output;
+    std::set<int> rows;
+    bool all = false;
+    unsigned loaded = 0;
+    bool changed = false;
+
+    std::string where = changed_rows(m_ip_ban_table_exists,
+        ServerConfig::m_ip_ban_table, &m_ip_ban_changes, &rows, &all);
+    if (!all)
+        index->copyIpBans(*old_index, rows);
+    if (!where.empty())
+    {
+        changed = true;
+        easySQLQuery("SELECT " + columns + ", ip_start, ip_end FROM " +
+            (std::string)ServerConfig::m_ip_ban_table + where, &output);
+        for (std::vector<std::string>& row : output)
+        {
+            BanIndex::IpBan ban;
+            if (read_ban(row, &ban) &&
+                StringUtils::fromString(row[5], ban.m_ip_start) &&
+                StringUtils::fromString(row[6], ban.m_ip_end))
+                index->addIpBan(ban);
+        }
+        loaded += (unsigned)output.size();
+        output.clear();
+    }
+
+    where = changed_rows(m_ipv6_ban_table_exists,
+        ServerConfig::m_ipv6_ban_table, &m_ipv6_ban_changes, &rows, &all);
+    if (!all)
+        index->copyIpv6Bans(*old_index, rows);
+    if (!where.empty())
+    {
+        changed = true;
+        easySQLQuery("SELECT " + columns + ", ipv6_cidr FROM " +
+            (std::string)ServerConfig::m_ipv6_ban_table + where, &output);
+        for (std::vector<std::string>& row : output)
+        {
+            BanIndex::Ipv6Ban ban;
+            if (!read_ban(row, &ban))
+                continue;
+            ban.m_ipv6_cidr = row[5];
+            if (!index->addIpv6Ban(ban))
+            {
+                Log::warn("DatabaseConnector", "Invalid IPv6 CIDR block "
+                    "'%s' in ban table.", ban.m_ipv6_cidr.c_str());
+            }
+        }
+        loaded += (unsigned)output.size();
+        output.clear();
+    }
+
+    where = changed_rows(m_online_id_ban_table_exists,
+        ServerConfig::m_online_id_ban_table, &m_online_id_ban_changes, &rows,
+        &all);
+    if (!all)
+        index->copyOnlineIdBans(*old_index, rows);
+    if (!where.empty())
+    {
+        changed = true;
+        easySQLQuery("SELECT " + columns + ", online_id FROM " +
+            (std::string)ServerConfig::m_online_id_ban_table + where,
+            &output);
+        for (std::vector<std::string>& row : output)
+        {
+            BanIndex::OnlineIdBan ban;
+            if (read_ban(row, &ban) &&
+                StringUtils::fromString(row[5], ban.m_online_id))
+                index->addOnlineIdBan(ban);
+        }
+        loaded += (unsigned)output.size();
+    }
+
+    if (!changed)
+        return;
+    index->build();
+    Log::debug("DatabaseConnector", "Loaded %u of %u bans in %dms.", loaded,
+        index->getNumberOfBans(), (int)(StkTime::getMonoTimeMs() - start));
+
+    std::lock_guard<std::mutex> lock(m_ban_index_mutex);
+    m_ban_index = index;
+}   // updateBanIndex
+
 //-----------------------------------------------------------------------------
 /** Gets the rows from IPv4 ban table, either all of them (for polling
  *   purposes), or those describing a certain address (if only one peer has to
  *   be checked).
- *  \param ip The IP address to check the database for. If zero, all rows
- *            will be given.
+ *  \param ip The IP address to check (using the in-memory ban index). If
+ *            zero, all rows will be given.
  *  \return A vector of rows in the form of IpBanTableData structures.
  */
 std::vector<DatabaseConnector::IpBanTableData>
@@ -643,19 +1147,29 @@ DatabaseConnector::getIpBanTableData(uint32_t ip) const
     {
         return result;
     }
-    bool single_ip = (ip != 0);
-    std::ostringstream oss;
-    oss << "SELECT rowid, ip_start, ip_end, reason, description FROM ";
-    oss << (std::string)ServerConfig::m_ip_ban_table << " WHERE ";
-    if (single_ip)
-        oss << "ip_start <= " << ip << " AND ip_end >= " << ip << " AND ";
-    oss << "datetime('now') > datetime(starting_time) AND "
+    if (ip != 0)
+    {
+        std::shared_ptr<const BanIndex> index = getBanIndex();
+        const BanIndex::IpBan* ban =
+            index->findIpBan(ip, StkTime::getTimeSinceEpoch());
+        if (ban)
+        {
+            IpBanTableData element;
+            element.row_id = ban->m_row_id;
+            element.ip_start = ban->m_ip_start;
+            element.ip_end = ban->m_ip_end;
+            element.reason = ban->m_reason;
+            element.description = ban->m_description;
+            result.push_back(element);
+        }
+        return result;
+    }
+    std::string query = StringUtils::insertValues(
+        "SELECT rowid, ip_start, ip_end, reason, description FROM %s WHERE "
+        "datetime('now') > datetime(starting_time) AND "
         "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now'))";
-    if (single_ip)
-        oss << " LIMIT 1";
-    oss << ";";
-    std::string query = oss.str();
+        "(starting_time, '+'||expired_days||' days') > datetime('now'));",
+        ServerConfig::m_ip_ban_table.c_str());
 
     std::vector<std::vector<std::string>> output;
     easySQLQuery(query, &output);
@@ -687,17 +1201,22 @@ void DatabaseConnector::increaseIpBanTriggerCount(uint32_t ip_start, uint32_t ip
     std::string query = StringUtils::insertValues(
         "UPDATE %s SET trigger_count = trigger_count + 1, "
         "last_trigger = datetime('now') "
-        "WHERE ip_start = %u AND ip_end = %u;",
-        ServerConfig::m_ip_ban_table.c_str(), ip_start, ip_end);
-    easySQLQuery(query);
-}   // getIpBanTableData
+        "WHERE ip_start = ? AND ip_end = ?;",
+        ServerConfig::m_ip_ban_table.c_str());
+    asyncSQLQuery(SI_IP_BAN_TRIGGER, query,
+        [ip_start, ip_end](sqlite3_stmt* stmt)
+        {
+            sqlite3_bind_int64(stmt, 1, ip_start);
+            sqlite3_bind_int64(stmt, 2, ip_end);
+        });
+}   // increaseIpBanTriggerCount
 
 //-----------------------------------------------------------------------------
 /** Gets the rows from IPv6 ban table, either all of them (for polling
  *   purposes), or those describing a certain address (if only one peer has to
  *   be checked).
- *  \param ip The IPv6 address to check the database for. If empty, all rows
- *            will be given.
+ *  \param ip The IPv6 address to check (using the in-memory ban index). If
+ *            empty, all rows will be given.
  *  \return A vector of rows in the form of Ipv6BanTableData structures.
  */
 std::vector<DatabaseConnector::Ipv6BanTableData>
@@ -708,29 +1227,31 @@ DatabaseConnector::getIpv6BanTableData(std::string ipv6) const
     {
         return result;
     }
-    bool single_ip = !ipv6.empty();
-    std::string query;
-    std::shared_ptr<BinderCollection> coll = std::make_shared<BinderCollection>();
-
-    query = StringUtils::insertValues(
-        "SELECT rowid, ipv6_cidr, reason, description FROM %s WHERE ",
-        ServerConfig::m_ipv6_ban_table.c_str()
-    );
-    if (single_ip)
-        query += StringUtils::insertValues(
-            "insideIPv6CIDR(ipv6_cidr, %s) = 1 AND ",
-            Binder(coll, ipv6, "ipv6")
-        );
-
-    query += "datetime('now') > datetime(starting_time) AND "
+    if (!ipv6.empty())
+    {
+        std::shared_ptr<const BanIndex> index = getBanIndex();
+        const BanIndex::Ipv6Ban* ban =
+            index->findIpv6Ban(ipv6, StkTime::getTimeSinceEpoch());
+        if (ban)
+        {
+            Ipv6BanTableData element;
+            element.row_id = ban->m_row_id;
+            element.ipv6_cidr = ban->m_ipv6_cidr;
+            element.reason = ban->m_reason;
+            element.description = ban->m_description;
+            result.push_back(element);
+        }
+        return result;
+    }
+    std::string query = StringUtils::insertValues(
+        "SELECT rowid, ipv6_cidr, reason, description FROM %s WHERE "
+        "datetime('now') > datetime(starting_time) AND "
         "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now'))";
-
-    if (single_ip)
-        query += " LIMIT 1;";
+        "(starting_time, '+'||expired_days||' days') > datetime('now'));",
+        ServerConfig::m_ipv6_ban_table.c_str());
 
     std::vector<std::vector<std::string>> output;
-    easySQLQuery(query, &output, coll->getBindFunction());
+    easySQLQuery(query, &output);
 
     for (std::vector<std::string>& row: output)
     {
@@ -760,15 +1281,15 @@ void DatabaseConnector::increaseIpv6BanTriggerCount(const std::string& ipv6_cidr
         ServerConfig::m_ipv6_ban_table.c_str(),
         Binder(coll, ipv6_cidr, "ipv6_cidr")
     );
-    easySQLQuery(query, nullptr, coll->getBindFunction());
+    asyncSQLQuery(SI_IPV6_BAN_TRIGGER, query, coll->getBindFunction());
 }   // increaseIpv6BanTriggerCount
 
 //-----------------------------------------------------------------------------
 /** Gets the rows from online id ban table, either all of them (for polling
  *   purposes), or those describing a certain online id (if only one peer has
  *   to be checked).
- *  \param online_id The online id to check the database for. If empty, all
- *                   rows will be given.
+ *  \param online_id The online id to check (using the in-memory ban index).
+ *                   If zero, all rows will be given.
  *  \return A vector of rows in the form of OnlineIdBanTableData structures.
  */
 std::vector<DatabaseConnector::OnlineIdBanTableData>
@@ -779,34 +1300,43 @@ DatabaseConnector::getOnlineIdBanTableData(uint32_t online_id) const
     {
         return result;
     }
-    bool single_id = (online_id != 0);
-    std::ostringstream oss;
-    oss << "SELECT rowid, online_id, reason, description FROM ";
-    oss << (std::string)ServerConfig::m_online_id_ban_table;
-    oss << " WHERE ";
-    if (single_id)
-        oss << "online_id = " << online_id << " AND ";
-    oss << "datetime('now') > datetime(starting_time) AND "
-        "(expired_days is NULL OR datetime"
-        "(starting_time, '+'||expired_days||' days') > datetime('now'))";
-    if (single_id)
-        oss << " LIMIT 1";
-    oss << ";";
-    std::string query = oss.str();
-    sqlite3_exec(m_db, query.c_str(),
-        [](void* ptr, int count, char** data, char** columns)
+    if (online_id != 0)
+    {
+        std::shared_ptr<const BanIndex> index = getBanIndex();
+        const BanIndex::OnlineIdBan* ban =
+            index->findOnlineIdBan(online_id, StkTime::getTimeSinceEpoch());
+        if (ban)
         {
-            std::vector<OnlineIdBanTableData>* vec = (std::vector<OnlineIdBanTableData>*)ptr;
             OnlineIdBanTableData element;
-            if (!StringUtils::fromString(data[0], element.row_id))
-                return 0;
-            if (!StringUtils::fromString(data[1], element.online_id))
-                return 0;
-            element.reason = std::string(data[2]);
-            element.description = std::string(data[3]);
-            vec->push_back(element);
-            return 0;
-        }, &result, NULL);
+            element.row_id = ban->m_row_id;
+            element.online_id = ban->m_online_id;
+            element.reason = ban->m_reason;
+            element.description = ban->m_description;
+            result.push_back(element);
+        }
+        return result;
+    }
+    std::string query = StringUtils::insertValues(
+        "SELECT rowid, online_id, reason, description FROM %s WHERE "
+        "datetime('now') > datetime(starting_time) AND "
+        "(expired_days is NULL OR datetime"
+        "(starting_time, '+'||expired_days||' days') > datetime('now'));",
+        ServerConfig::m_online_id_ban_table.c_str());
+
+    std::vector<std::vector<std::string>> output;
+    easySQLQuery(query, &output);
+
+    for (std::vector<std::string>& row: output)
+    {
+        OnlineIdBanTableData element;
+        if (!StringUtils::fromString(row[0], element.row_id))
+            continue;
+        if (!StringUtils::fromString(row[1], element.online_id))
+            continue;
+        element.reason = row[2];
+        element.description = row[3];
+        result.push_back(element);
+    }
     return result;
 }   // getOnlineIdBanTableData
 
@@ -820,9 +1350,13 @@ void DatabaseConnector::increaseOnlineIdBanTriggerCount(uint32_t online_id) cons
     std::string query = StringUtils::insertValues(
         "UPDATE %s SET trigger_count = trigger_count + 1, "
         "last_trigger = datetime('now') "
-        "WHERE online_id = %u;",
-        ServerConfig::m_online_id_ban_table.c_str(), online_id);
-    easySQLQuery(query);
+        "WHERE online_id = ?;",
+        ServerConfig::m_online_id_ban_table.c_str());
+    asyncSQLQuery(SI_ONLINE_ID_BAN_TRIGGER, query,
+        [online_id](sqlite3_stmt* stmt)
+        {
+            sqlite3_bind_int64(stmt, 1, online_id);
+        });
 }   // increaseOnlineIdBanTriggerCount
 
 //-----------------------------------------------------------------------------
@@ -839,8 +1373,8 @@ void DatabaseConnector::clearOldReports()
             "WHERE datetime"
             "(reported_time, '+%f days') < datetime('now');",
             ServerConfig::m_player_reports_table.c_str(),
-            ServerConfig::m_player_reports_expired_days);
-        easySQLQuery(query);
+            (float)ServerConfig::m_player_reports_expired_days);
+        asyncSQLQuery(SI_NONE, query);
     }
 }   // clearOldReports
 
@@ -873,7 +1407,7 @@ void DatabaseConnector::setDisconnectionTimes(std::vector<uint32_t>& present_hos
         oss << ");";
     }
     std::string query = oss.str();
-    easySQLQuery(query);
+    asyncSQLQuery(SI_NONE, query);
 }   // setDisconnectionTimes
 
 //-----------------------------------------------------------------------------
@@ -890,7 +1424,7 @@ void DatabaseConnector::saveAddressToIpBanTable(const SocketAddress& addr)
         "INSERT INTO %s (ip_start, ip_end) "
         "VALUES (%u, %u);",
         ServerConfig::m_ip_ban_table.c_str(), addr.getIP(), addr.getIP());
-    easySQLQuery(query);
+    asyncSQLQuery(SI_NONE, query);
 }   // saveAddressToIpBanTable
 
 //-----------------------------------------------------------------------------
@@ -905,50 +1439,42 @@ void DatabaseConnector::onPlayerJoinQueries(std::shared_ptr<STKPeer> peer,
 {
     if (m_server_stats_table.empty() || peer->isAIPeer())
         return;
-    std::string query;
-    std::shared_ptr<BinderCollection> coll = std::make_shared<BinderCollection>();
     auto version_os = StringUtils::extractVersionOS(peer->getUserVersion());
-    if (ServerConfig::m_ipv6_connection && peer->getAddress().isIPv6())
-    {
-        query = StringUtils::insertValues(
-            "INSERT INTO %s "
-            "(host_id, ip, ipv6, port, online_id, username, player_num, "
-            "country_code, version, os, ping) "
-            "VALUES (%u, 0, \"%s\", %u, %u, %s, %u, %s, %s, %s, %u);",
-            m_server_stats_table.c_str(),
-            peer->getHostId(),
-            peer->getAddress().toString(false),
-            peer->getAddress().getPort(),
-            online_id,
-            Binder(coll, StringUtils::wideToUtf8(peer->getPlayerProfiles()[0]->getName()), "player_name"),
-            player_count,
-            Binder(coll, country_code, "country_code", true),
-            Binder(coll, version_os.first, "version"),
-            Binder(coll, version_os.second, "os"),
-            peer->getAveragePing()
-        );
-    }
-    else
-    {
-        query = StringUtils::insertValues(
-            "INSERT INTO %s "
-            "(host_id, ip, port, online_id, username, player_num, "
-            "country_code, version, os, ping) "
-            "VALUES (%u, %u, %u, %u, %s, %u, %s, %s, %s, %u);",
-            m_server_stats_table.c_str(),
-            peer->getHostId(),
-            peer->getAddress().getIP(),
-            peer->getAddress().getPort(),
-            online_id,
-            Binder(coll, StringUtils::wideToUtf8(peer->getPlayerProfiles()[0]->getName()), "player_name"),
-            player_count,
-            Binder(coll, country_code, "country_code", true),
-            Binder(coll, version_os.first, "version"),
-            Binder(coll, version_os.second, "os"),
-            peer->getAveragePing()
-        );
-    }
-    easySQLQuery(query, nullptr, coll->getBindFunction());
+    const bool ipv6 = ServerConfig::m_ipv6_connection &&
+        peer->getAddress().isIPv6();
+    std::string query = StringUtils::insertValues(
+        "INSERT INTO %s "
+        "(host_id, ip, %sport, online_id, username, player_num, "
+        "country_code, version, os, ping) "
+        "VALUES (?, ?, %s?, ?, ?, ?, ?, ?, ?, ?);",
+        m_server_stats_table.c_str(), ipv6 ? "ipv6, " : "",
+        ipv6 ? "?, " : "");
+
+    const uint32_t host_id = peer->getHostId();
+    const uint32_t ip = ipv6 ? 0 : peer->getAddress().getIP();
+    const std::string ipv6_address =
+        ipv6 ? peer->getAddress().toString(false) : "";
+    const uint16_t port = peer->getAddress().getPort();
+    const std::string name =
+        StringUtils::wideToUtf8(peer->getPlayerProfiles()[0]->getName());
+    const int ping = peer->getAveragePing();
+    asyncSQLQuery(ipv6 ? SI_PLAYER_JOIN_IPV6 : SI_PLAYER_JOIN, query,
+        [=](sqlite3_stmt* stmt)
+        {
+            int idx = 1;
+            sqlite3_bind_int64(stmt, idx++, host_id);
+            sqlite3_bind_int64(stmt, idx++, ip);
+            if (ipv6)
+                bindText(stmt, idx++, ipv6_address);
+            sqlite3_bind_int(stmt, idx++, port);
+            sqlite3_bind_int64(stmt, idx++, online_id);
+            bindText(stmt, idx++, name);
+            sqlite3_bind_int(stmt, idx++, player_count);
+            bindText(stmt, idx++, country_code, true/*use_null_if_empty*/);
+            bindText(stmt, idx++, version_os.first);
+            bindText(stmt, idx++, version_os.second);
+            sqlite3_bind_int(stmt, idx++, ping);
+        });
 }   // onPlayerJoinQueries
 
 //-----------------------------------------------------------------------------
@@ -984,4 +1510,231 @@ void DatabaseConnector::listBanTable()
         sqlite3_exec(m_db, query.c_str(), printer, NULL, NULL);
     }
 }   // listBanTable
+//-----------------------------------------------------------------------------
+/** Checks that updating the ban index finds every changed ban row, with the
+ *   ban tables of NETWORKING.md in a database in memory. */
+void DatabaseConnector::unitTesting()
+{
+    bool sql_management = ServerConfig::m_sql_management;
+    ServerConfig::m_sql_management = false;
+    DatabaseConnector db;
+    db.initDatabase();
+    ServerConfig::m_sql_management = sql_management;
+    db.m_db = openDatabase(":memory:", SQLITE_OPEN_FULLMUTEX |
+        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    if (!db.m_db)
+        Log::fatal("DatabaseConnector", "Cannot open database in memory.");
+
+    // Bans are effective after their starting time, so the rows start in
+    // the past instead of CURRENT_TIMESTAMP
+    const std::string columns = "starting_time TIMESTAMP NOT NULL DEFAULT "
+        "(datetime('now', '-1 hour')), expired_days REAL NULL DEFAULT NULL, reason "
+        "TEXT NOT NULL DEFAULT '', description TEXT NOT NULL DEFAULT '', "
+        "trigger_count INTEGER UNSIGNED NOT NULL DEFAULT 0, last_trigger "
+        "TIMESTAMP NULL DEFAULT NULL);";
+    if (!db.easySQLQuery("CREATE TABLE ip_ban (ip_start INTEGER UNSIGNED "
+        "NOT NULL UNIQUE, ip_end INTEGER UNSIGNED NOT NULL UNIQUE, " +
+        columns) ||
+        !db.easySQLQuery("CREATE TABLE ipv6_ban (ipv6_cidr TEXT NOT NULL "
+        "UNIQUE, " + columns) ||
+        !db.easySQLQuery("CREATE TABLE online_id_ban (online_id INTEGER "
+        "UNSIGNED NOT NULL UNIQUE, " + columns))
+        Log::fatal("DatabaseConnector", "Cannot create ban tables.");
+    db.m_ip_ban_table_exists = true;
+    db.m_ipv6_ban_table_exists = true;
+    db.m_online_id_ban_table_exists = true;
+    db.trackBanTableChanges("ip_ban", "ip_start, ip_end",
+        &db.m_ip_ban_changes);
+    db.trackBanTableChanges("ipv6_ban", "ipv6_cidr", &db.m_ipv6_ban_changes);
+    db.trackBanTableChanges("online_id_ban", "online_id",
+        &db.m_online_id_ban_changes);
+    if (!db.m_ip_ban_changes.m_tracked || !db.m_ipv6_ban_changes.m_tracked ||
+        !db.m_online_id_ban_changes.m_tracked)
+        Log::fatal("DatabaseConnector", "Ban tables are not tracked.");
+
+    auto query = [&db](const std::string& q)
+    {
+        if (!db.easySQLQuery(q))
+            Log::fatal("DatabaseConnector", "Query failed: %s", q.c_str());
+    };
+    // Returns the reason of the ban found for an IPv4 address, "" if none
+    auto ip_ban = [&db](uint32_t ip)
+    {
+        std::shared_ptr<const BanIndex> index = db.getBanIndex();
+        const BanIndex::IpBan* ban =
+            index->findIpBan(ip, StkTime::getTimeSinceEpoch());
+        return ban ? ban->m_reason : std::string();
+    };
+    auto online_id_ban = [&db](uint32_t online_id)
+    {
+        std::shared_ptr<const BanIndex> index = db.getBanIndex();
+        const BanIndex::OnlineIdBan* ban =
+            index->findOnlineIdBan(online_id, StkTime::getTimeSinceEpoch());
+        return ban ? ban->m_reason : std::string();
+    };
+    auto ipv6_ban = [&db](const std::string& ipv6)
+    {
+        std::shared_ptr<const BanIndex> index = db.getBanIndex();
+        const BanIndex::Ipv6Ban* ban =
+            index->findIpv6Ban(ipv6, StkTime::getTimeSinceEpoch());
+        return ban ? ban->m_reason : std::string();
+    };
+
+    query("INSERT INTO ip_ban (ip_start, ip_end, reason) VALUES "
+        "(100, 199, 'a'), (300, 399, 'b');");
+    query("INSERT INTO ipv6_ban (ipv6_cidr, reason) VALUES "
+        "('2001:db8::/32', 'a');");
+    query("INSERT INTO online_id_ban (online_id, reason) VALUES (7, 'a');");
+    db.updateBanIndex(true/*force*/);
+    if (ip_ban(150) != "a" || ip_ban(350) != "b" || ip_ban(250) != "" ||
+        ipv6_ban("2001:db8::1") != "a" || online_id_ban(7) != "a")
+        Log::fatal("DatabaseConnector", "Initial bans are not loaded.");
+
+    // Trigger counts are written for each banned peer, they don't change the
+    // index
+    std::shared_ptr<const BanIndex> index = db.getBanIndex();
+    query("UPDATE ip_ban SET trigger_count = trigger_count + 1, "
+        "last_trigger = datetime('now');");
+    query("UPDATE online_id_ban SET trigger_count = trigger_count + 1;");
+    db.updateBanIndex();
+    if (db.getBanIndex() != index)
+        Log::fatal("DatabaseConnector", "Trigger count reloaded the bans.");
+
+    // Deleting the last row and inserting another one reuses its rowid,
+    // which keeps the number of rows and the largest rowid
+    query("DELETE FROM ip_ban WHERE ip_start = 300;");
+    query("INSERT INTO ip_ban (ip_start, ip_end, reason) VALUES "
+        "(500, 599, 'c');");
+    std::vector<std::vector<std::string> > rows;
+    db.easySQLQuery("SELECT rowid FROM ip_ban WHERE ip_start = 500;", &rows);
+    if (rows.size() != 1 || rows[0][0] != "2")
+        Log::fatal("DatabaseConnector", "Rowid of the deleted row not reused.");
+    db.updateBanIndex();
+    if (ip_ban(350) != "" || ip_ban(550) != "c" || ip_ban(150) != "a")
+        Log::fatal("DatabaseConnector", "Delete and reinsert not found.");
+
+    // In-place updates of the banned range, the expiry and the reason
+    query("UPDATE ip_ban SET ip_start = 120, ip_end = 129 WHERE "
+        "ip_start = 100;");
+    query("UPDATE ipv6_ban SET reason = 'd';");
+    query("UPDATE online_id_ban SET expired_days = 1, starting_time = "
+        "datetime('now', '-2 days');");
+    db.updateBanIndex();
+    if (ip_ban(110) != "" || ip_ban(125) != "a" ||
+        ipv6_ban("2001:db8::1") != "d" || online_id_ban(7) != "")
+        Log::fatal("DatabaseConnector", "In-place updates not found.");
+
+    // INSERT OR REPLACE deletes the row with the same online id without the
+    // delete trigger, the new row gets another rowid
+    query("UPDATE online_id_ban SET expired_days = NULL;");
+    query("INSERT INTO online_id_ban (online_id, reason) VALUES (8, 'e');");
+    db.updateBanIndex();
+    query("INSERT OR REPLACE INTO online_id_ban (online_id, reason) VALUES "
+        "(7, 'e');");
+    db.updateBanIndex();
+    if (online_id_ban(7) != "e" || online_id_ban(8) != "e" ||
+        db.getBanIndex()->getNumberOfBans() != 5)
+        Log::fatal("DatabaseConnector", "Replaced row not found.");
+
+    // Overlapping bans are found in the order of the table, also after one
+    // of them was reloaded
+    query("INSERT INTO ip_ban (ip_start, ip_end, reason) VALUES "
+        "(0, 1000, 'f');");
+    query("UPDATE ip_ban SET reason = 'g' WHERE ip_start = 120;");
+    db.updateBanIndex();
+    if (ip_ban(125) != "g" || ip_ban(550) != "c" || ip_ban(900) != "f")
+        Log::fatal("DatabaseConnector", "Bans are not in table order.");
+
+    sqlite3_close(db.m_db);
+    db.m_db = NULL;
+}   // unitTesting
+//-----------------------------------------------------------------------------
+/** Measures how long the reads of the lobby take while the writer thread
+ *   commits, with the rollback journal and with write-ahead logging.
+ *  \param path The database file to create, it is deleted afterwards.
+ */
+void DatabaseConnector::benchmark(const std::string& path)
+{
+    auto remove_files = [path]()
+    {
+        for (const char* suffix : { "", "-journal", "-wal", "-shm" })
+            remove((path + suffix).c_str());
+    };
+    for (int wal = 0; wal < 2; wal++)
+    {
+        remove_files();
+        bool sql_management = ServerConfig::m_sql_management;
+        ServerConfig::m_sql_management = false;
+        DatabaseConnector db;
+        db.initDatabase();
+        ServerConfig::m_sql_management = sql_management;
+        db.m_db = openDatabase(path, SQLITE_OPEN_SHAREDCACHE |
+            SQLITE_OPEN_FULLMUTEX | SQLITE_OPEN_READWRITE |
+            SQLITE_OPEN_CREATE);
+        if (!db.m_db)
+            return;
+        // A geolocation table which is read for each joining player, and a
+        // table which gets a row for each of them
+        db.easySQLQuery("CREATE TABLE ip_mapping (ip_start INTEGER UNSIGNED "
+            "NOT NULL PRIMARY KEY, ip_end INTEGER UNSIGNED NOT NULL, "
+            "country_code TEXT NOT NULL);");
+        db.easySQLQuery("WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT "
+            "i + 1 FROM n WHERE i < 99999) INSERT INTO ip_mapping SELECT "
+            "i * 1000, i * 1000 + 999, 'AA' FROM n;");
+        db.easySQLQuery("CREATE TABLE joins (host_id INTEGER UNSIGNED NOT "
+            "NULL, online_id INTEGER UNSIGNED NOT NULL, connected_time "
+            "TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP);");
+        if (wal && !enableWAL(db.m_db))
+            break;
+        const char* synchronous = "PRAGMA synchronous=NORMAL;";
+        if (wal)
+            sqlite3_exec(db.m_db, synchronous, NULL, NULL, NULL);
+        db.m_writer_db = openDatabase(path, SQLITE_OPEN_NOMUTEX |
+            SQLITE_OPEN_PRIVATECACHE | SQLITE_OPEN_READWRITE);
+        if (!db.m_writer_db)
+            return;
+        if (wal)
+            sqlite3_exec(db.m_writer_db, synchronous, NULL, NULL, NULL);
+        db.m_writer_thread = std::thread(&DatabaseConnector::writerLoop, &db);
+
+        // Each read is done while the writes of the players before are in
+        // flight, as when many players join at the same time
+        std::vector<double> latency;
+        unsigned failed = 0;
+        std::vector<std::vector<std::string> > output;
+        for (unsigned i = 0; i < 2000; i++)
+        {
+            for (unsigned j = 0; j < 5; j++)
+            {
+                db.asyncSQLQuery(SI_NONE, "INSERT INTO joins (host_id, "
+                    "online_id) VALUES (1, 2);");
+            }
+            uint32_t ip = (i * 7919u) % 100000u * 1000u + 500u;
+            auto start = std::chrono::steady_clock::now();
+            // The query of ip2Country
+            if (!db.easySQLQuery(StringUtils::insertValues("SELECT "
+                "country_code FROM ip_mapping WHERE ip_start <= %u AND "
+                "ip_end >= %u ORDER BY ip_start DESC LIMIT 1;", ip, ip),
+                &output))
+                failed++;
+            latency.push_back(std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count());
+            output.clear();
+        }
+        db.stopWriter();
+        sqlite3_close(db.m_db);
+        db.m_db = NULL;
+
+        std::sort(latency.begin(), latency.end());
+        double total = 0.0;
+        for (double l : latency)
+            total += l;
+        Log::info("DatabaseConnector", "%s: read %.0lf us on average, 99%% "
+            "within %.0lf us, at most %.0lf us, %u failed.",
+            wal ? "Write-ahead log" : "Rollback journal",
+            total / latency.size(), latency[latency.size() * 99 / 100],
+            latency.back(), failed);
+    }
+    remove_files();
+}   // benchmark
 #endif // ENABLE_SQLITE3
@@ -24,13 +24,18 @@
 #include "utils/string_utils.hpp"
 #include "utils/time.hpp"
 
+#include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <sqlite3.h>
 #include <string>
+#include <thread>
 #include <vector>
 
+class BanIndex;
 class SocketAddress;
 class STKPeer;
 class NetworkPlayerProfile;
@@ -103,11 +108,70 @@ std::ostream& operator << (std::ostream& os, const Binder& binder);
  *   The SQL queries are intended to be placed only within the implementation
  *   of this class, while the logic corresponding to those queries should not
  *   belong here.
+ *  Queries which are done for each joining or leaving player are prepared
+ *   only once and then kept (see StatementId). Writes which don't need a
+ *   result are done by a writer thread with its own connection, which
+ *   collects all pending writes into one transaction, so the lobby never
+ *   waits for the database to be synced to disk.
+ *  The ban tables are kept in memory (see BanIndex), so checking a joining
+ *   peer does not need a query. The copy is updated at most once per poll,
+ *   only with the rows which were inserted, updated or deleted since.
  */
 class DatabaseConnector
 {
+public:
+    /** Identifies a prepared statement which is kept for reuse. The query
+     *  of such a statement must not change while the server is running,
+     *  all values have to be bound. */
+    enum StatementId
+    {
+        SI_NONE = -1,
+        SI_IP_TO_COUNTRY,
+        SI_IPV6_TO_COUNTRY,
+        SI_PLAYER_JOIN,
+        SI_PLAYER_JOIN_IPV6,
+        SI_DISCONNECT_INFO,
+        SI_IP_BAN_TRIGGER,
+        SI_IPV6_BAN_TRIGGER,
+        SI_ONLINE_ID_BAN_TRIGGER,
+        SI_COUNT
+    };
+
 private:
+    /** A query queued for the writer thread. */
+    struct WriteRequest
+    {
+        StatementId m_id;
+        std::string m_query;
+        std::function<void(sqlite3_stmt* stmt)> m_bind_function;
+    };
+
     sqlite3* m_db;
+
+    /** Prepared statements of m_db, NULL if not used yet. */
+    mutable sqlite3_stmt* m_statements[SI_COUNT];
+
+    /** A prepared statement can only be used by one thread at a time. */
+    mutable std::mutex m_statements_mutex;
+
+    /** Connection used by the writer thread only, NULL if the writes are
+     *  done directly with m_db. */
+    sqlite3* m_writer_db;
+
+    /** Prepared statements of m_writer_db. */
+    sqlite3_stmt* m_writer_statements[SI_COUNT];
+
+    std::thread m_writer_thread;
+
+    /** Protects m_write_queue and m_write_exit. */
+    mutable std::mutex m_write_mutex;
+
+    mutable std::condition_variable m_write_cv;
+
+    mutable std::vector<WriteRequest> m_write_queue;
+
+    bool m_write_exit;
+
     std::string m_server_stats_table;
     bool m_ip_ban_table_exists;
     bool m_ipv6_ban_table_exists;
@@ -117,6 +181,47 @@ private:
     bool m_player_reports_table_exists;
     uint64_t m_last_poll_db_time;
 
+    /** In-memory copy of the ban tables. Replaced (not changed) when the
+     *  database changes, so a lookup only needs to lock the mutex to copy
+     *  the pointer. */
+    std::shared_ptr<const BanIndex> m_ban_index;
+
+    mutable std::mutex m_ban_index_mutex;
+
+    /** Changes of a ban table since it was loaded into m_ban_index. They
+     *  are logged by triggers in a table next to it, see
+     *  trackBanTableChanges(). */
+    struct BanTableChanges
+    {
+        /** False if the changes are not logged, the table is then loaded
+         *  again at each poll. */
+        bool m_tracked;
+        /** Last logged change which is in m_ban_index. */
+        int64_t m_last_change;
+        BanTableChanges() : m_tracked(false), m_last_change(0) {}
+    };
+
+    BanTableChanges m_ip_ban_changes;
+    BanTableChanges m_ipv6_ban_changes;
+    BanTableChanges m_online_id_ban_changes;
+
+    void trackBanTableChanges(const std::string& table,
+                              const std::string& columns,
+                              BanTableChanges* changes);
+    bool getBanTableChanges(const std::string& table,
+                            BanTableChanges* changes,
+                            std::set<int>* rows) const;
+    std::shared_ptr<const BanIndex> getBanIndex() const;
+    static sqlite3* openDatabase(const std::string& path, int flags);
+    static bool enableWAL(sqlite3* db);
+    static bool runQuery(sqlite3* db, sqlite3_stmt** cached_stmt,
+                         const std::string& query,
+                         std::vector<std::vector<std::string>>* output,
+                         std::function<void(sqlite3_stmt* stmt)> bind_function,
+                         const std::string& null_value);
+    void writerLoop();
+    void stopWriter();
+
 public:
     /** Corresponds to the row of IPv4 ban table. */
     struct IpBanTableData
@@ -145,12 +250,22 @@ public:
     };
     void initDatabase();
     void destroyDatabase();
+    static void unitTesting();
+    static void benchmark(const std::string& path);
 
     bool easySQLQuery(const std::string& query,
                        std::vector<std::vector<std::string>>* output = nullptr,
                std::function<void(sqlite3_stmt* stmt)> bind_function = nullptr,
                                             std::string null_value = "") const;
 
+    bool easySQLQuery(StatementId id, const std::string& query,
+                       std::vector<std::vector<std::string>>* output = nullptr,
+               std::function<void(sqlite3_stmt* stmt)> bind_function = nullptr,
+                                            std::string null_value = "") const;
+
+    void asyncSQLQuery(StatementId id, const std::string& query,
+        std::function<void(sqlite3_stmt* stmt)> bind_function = nullptr) const;
+
     void checkTableExists(const std::string& table, bool& result);
 
     std::string ip2Country(const SocketAddress& addr) const;
@@ -177,6 +292,7 @@ public:
     bool isTimeToPoll() const
             { return StkTime::getMonoTimeMs() >= m_last_poll_db_time + 60000; }
     void updatePollTime()   { m_last_poll_db_time = StkTime::getMonoTimeMs(); }
+    void updateBanIndex(bool force = false);
     std::vector<IpBanTableData> getIpBanTableData(uint32_t ip = 0) const;
     std::vector<Ipv6BanTableData> getIpv6BanTableData(std::string ipv6 = "") const;
     std::vector<OnlineIdBanTableData> getOnlineIdBanTableData(uint32_t online_id = 0) const;
@@ -21,11 +21,39 @@
 #include "network/crypto.hpp"
 #include "network/protocols/client_lobby.hpp"
 #include "network/stk_peer.hpp"
+#include "utils/bounded_queue.hpp"
 #include "utils/log.hpp"
 #include "utils/time.hpp"
 
 #include <string.h>
 
+namespace
+{
+    /** Number of deleted events and message buffers which are kept for
+     *  reuse. */
+    const size_t POOL_SIZE = 1024;
+
+    /** Buffers which grew bigger than this (e.g. for a data transfer) are
+     *  not kept. */
+    const size_t MAX_POOLED_BUFFER = 16 * 1024;
+
+    /** The pools are never freed, since events can be deleted by any thread
+     *  until the very end. */
+    BoundedQueue<void*>* getEventMemoryPool()
+    {
+        static BoundedQueue<void*>* pool = new BoundedQueue<void*>(POOL_SIZE);
+        return pool;
+    }   // getEventMemoryPool
+
+    // ------------------------------------------------------------------------
+    BoundedQueue<NetworkString*>* getMessageBufferPool()
+    {
+        static BoundedQueue<NetworkString*>* pool =
+            new BoundedQueue<NetworkString*>(POOL_SIZE);
+        return pool;
+    }   // getMessageBufferPool
+}   // anonymous namespace
+
 /** \brief Constructor
  *  \param event : The event that needs to be translated.
  */
@@ -41,6 +69,7 @@ constexpr bool isConnectionRequestPacket(unsigned char* data, size_t length)
 // ============================================================================
 Event::Event(ENetEvent* event, std::shared_ptr<STKPeer> peer)
 {
+    m_data = NULL;
     m_arrival_time = StkTime::getMonoTimeMs();
     m_pdi = PDI_TIMEOUT;
     m_peer = peer;
@@ -75,19 +104,27 @@ Event::Event(ENetEvent* event, std::shared_ptr<STKPeer> peer)
         {
             throw std::runtime_error("Unencrypted content at wrong state.");
         }
+        m_data = getMessageBuffer();
         if (m_peer->getCrypto() && (event->channelID == EVENT_CHANNEL_NORMAL ||
             event->channelID == EVENT_CHANNEL_DATA_TRANSFER))
         {
-            m_data = m_peer->getCrypto()->decryptRecieve(event->packet);
+            try
+            {
+                m_peer->getCrypto()->decryptRecieve(event->packet, m_data);
+            }
+            catch (std::exception&)
+            {
+                // The destructor is not called if the constructor throws
+                releaseMessageBuffer(m_data);
+                throw;
+            }
         }
         else
         {
-            m_data = new NetworkString(event->packet->data, 
+            m_data->setReceived(event->packet->data,
                 (int)event->packet->dataLength);
         }
     }
-    else
-        m_data = NULL;
 
     if (event->packet)
     {
@@ -102,6 +139,60 @@ Event::Event(ENetEvent* event, std::shared_ptr<STKPeer> peer)
  */
 Event::~Event()
 {
-    delete m_data;
+    if (m_data)
+        releaseMessageBuffer(m_data);
 }   // ~Event
 
+// ----------------------------------------------------------------------------
+void* Event::operator new(size_t size)
+{
+    assert(size == sizeof(Event));
+    void* memory;
+    if (getEventMemoryPool()->pop(&memory))
+        return memory;
+    return ::operator new(size);
+}   // operator new
+
+// ----------------------------------------------------------------------------
+void Event::operator delete(void* memory)
+{
+    if (memory && !getEventMemoryPool()->push(memory))
+        ::operator delete(memory);
+}   // operator delete
+
+// ----------------------------------------------------------------------------
+/** Returns a NetworkString for a received message, reusing the memory of
+ *  the messages of deleted events if possible.
+ */
+NetworkString* Event::getMessageBuffer()
+{
+    NetworkString* ns;
+    if (getMessageBufferPool()->pop(&ns))
+        return ns;
+    return new NetworkString(PROTOCOL_NONE);
+}   // getMessageBuffer
+
+// ----------------------------------------------------------------------------
+/** Keeps a no longer needed message for reuse, or deletes it if there are
+ *  already enough messages kept, or it is too big.
+ */
+void Event::releaseMessageBuffer(NetworkString* ns)
+{
+    if (ns->getCapacity() > MAX_POOLED_BUFFER ||
+        !getMessageBufferPool()->push(ns))
+        delete ns;
+}   // releaseMessageBuffer
+
+
+// ----------------------------------------------------------------------------
+/** Frees all memory kept for reuse, called when STK exits.
+ */
+void Event::clearPools()
+{
+    void* memory;
+    while (getEventMemoryPool()->pop(&memory))
+        ::operator delete(memory);
+    NetworkString* ns;
+    while (getMessageBufferPool()->pop(&ns))
+        delete ns;
+}   // clearPools
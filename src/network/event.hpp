@@ -74,7 +74,8 @@ class Event
 private:
     LEAK_CHECK()
 
-    /** Copy of the data passed by the event. */
+    /** Copy of the data passed by the event. The NetworkString (and its
+     *  buffer) is reused for later events once this event is deleted. */
     NetworkString *m_data;
 
     /**  Type of the event. */
@@ -89,9 +90,22 @@ private:
     /** For disconnection event, a bit more info is provided. */
     PeerDisconnectInfo m_pdi;
 
+    // ------------------------------------------------------------------------
+    static NetworkString* getMessageBuffer();
+    // ------------------------------------------------------------------------
+    static void releaseMessageBuffer(NetworkString* ns);
+
 public:
          Event(ENetEvent* event, std::shared_ptr<STKPeer> peer);
         ~Event();
+    // ------------------------------------------------------------------------
+    /** An event is created for each received packet, so the memory of
+     *  deleted events is reused. */
+    static void* operator new(size_t size);
+    // ------------------------------------------------------------------------
+    static void operator delete(void* memory);
+    // ------------------------------------------------------------------------
+    static void clearPools();
 
     // ------------------------------------------------------------------------
     /** Returns the type of this event. */
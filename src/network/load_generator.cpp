@@ -0,0 +1,609 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/load_generator.hpp"
+
+#include "config/stk_config.hpp"
+#include "input/input.hpp"
+#include "main_loop.hpp"
+#include "network/child_loop.hpp"
+#include "network/event.hpp"
+#include "network/network.hpp"
+#include "network/network_string.hpp"
+#include "network/peer_vote.hpp"
+#include "network/protocols/client_lobby.hpp"
+#include "network/protocols/game_protocol.hpp"
+#include "network/remote_kart_info.hpp"
+#include "network/rewind_profiler.hpp"
+#include "network/server_config.hpp"
+#include "network/socket_address.hpp"
+#include "network/stk_host.hpp"
+#include "network/stk_peer.hpp"
+#include "utils/log.hpp"
+#include "utils/random_generator.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+#include "utils/vs.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+#include <limits>
+
+LoadGenerator* LoadGenerator::m_load_generator = NULL;
+
+// ----------------------------------------------------------------------------
+/** Starts a LAN server in a child thread which is configured for the load
+ *  test, and the thread which runs the bots. The full client of this
+ *  process must have been configured as network AI client before.
+ *  \param num_bots Number of lightweight clients.
+ *  \param duration Time in seconds after the bots are connected at which
+ *         the game is quit.
+ */
+void LoadGenerator::create(unsigned num_bots, float duration)
+{
+    assert(!m_load_generator);
+    // Player counts are sent as 8 bit values, one player is the full client
+    if (num_bots > 254)
+    {
+        Log::warn("LoadGenerator", "Only 254 bots are supported.");
+        num_bots = 254;
+    }
+
+    // Start a race as soon as all bots are connected, and start the next
+    // one after the previous one
+    ServerConfig::m_server_name = "Load test";
+    ServerConfig::m_server_max_players = num_bots + 1;
+    ServerConfig::m_max_players_in_game = 0;
+    ServerConfig::m_owner_less = true;
+    ServerConfig::m_min_start_game_players = num_bots + 1;
+    ServerConfig::m_start_game_counter = 1.0f;
+    ServerConfig::m_track_voting = false;
+    ServerConfig::m_voting_timeout = 3.0f;
+    // The bots do not drive to the finish line
+    ServerConfig::m_auto_end = true;
+
+    m_load_generator = new LoadGenerator(num_bots, duration);
+
+    ChildLoopConfig clc;
+    clc.m_lan_server = true;
+    clc.m_login_id = 0;
+    clc.m_server_ai = 0;
+    STKHost::create(new ChildLoop(clc));
+
+    m_load_generator->m_thread =
+        std::thread(std::bind(&LoadGenerator::run, m_load_generator));
+}   // create
+
+// ----------------------------------------------------------------------------
+LoadGenerator::LoadGenerator(unsigned num_bots, float duration)
+            : m_tick_histogram(NUM_TICK_BUCKETS)
+{
+    for (auto &bucket : m_tick_histogram)
+        bucket.store(0);
+    m_tick_total_us.store(0);
+    m_tick_max_us.store(0);
+    m_server_port.store(0);
+    m_abort.store(false);
+    m_duration = (uint64_t)(duration * 1000.0f);
+    m_start_time = m_end_time = 0;
+    m_rollback_tick = 0;
+    m_rollbacks_in_tick = 0;
+    memset(&m_statistics, 0, sizeof(m_statistics));
+
+    Bot bot;
+    memset(&bot, 0, sizeof(bot));
+    bot.m_kart_id = -1;
+    bot.m_clock_ticks = -1;
+    bot.m_pending_state_ticks = -1;
+    m_bots.resize(num_bots, bot);
+
+    // The connection request of a LAN player without online account (like
+    // ClientLobby sends it), which only differs by the player name. The
+    // karts and tracks must be read in the main thread.
+    NetworkString request(PROTOCOL_LOBBY_ROOM);
+    request.addUInt8(LobbyProtocol::LE_CONNECTION_REQUESTED)
+        .addUInt32(ServerConfig::m_server_version)
+        .encodeString(StringUtils::getUserAgentString())
+        .addUInt16((uint16_t)stk_config->m_network_capabilities.size());
+    for (const std::string &cap : stk_config->m_network_capabilities)
+        request.encodeString(cap);
+    ClientLobby::getKartsTracksNetworkString(&request);
+    // One player, no online id and no encrypted data
+    request.addUInt8(1).addUInt32(0).addUInt32(0)
+        .encodeString(ServerConfig::m_private_server_password);
+    const uint8_t *data = (const uint8_t*)request.getData();
+    m_connection_request.assign(data, data + request.getTotalSize());
+}   // LoadGenerator
+
+// ----------------------------------------------------------------------------
+LoadGenerator::~LoadGenerator()
+{
+    m_abort.store(true);
+    if (m_thread.joinable())
+        m_thread.join();
+    printReport();
+}   // ~LoadGenerator
+
+// ----------------------------------------------------------------------------
+/** Called by the server thread after each tick of a race.
+ *  \param us Time the tick took in microseconds.
+ */
+void LoadGenerator::addServerTickTime(uint64_t us)
+{
+    uint64_t bucket = std::min(us / TICK_BUCKET_US,
+                               (uint64_t)NUM_TICK_BUCKETS - 1);
+    m_tick_histogram[(size_t)bucket].fetch_add(1, std::memory_order_relaxed);
+    m_tick_total_us.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max_us = m_tick_max_us.load(std::memory_order_relaxed);
+    while (us > max_us &&
+           !m_tick_max_us.compare_exchange_weak(max_us, us,
+                                                std::memory_order_relaxed))
+    {
+    }
+}   // addServerTickTime
+
+// ----------------------------------------------------------------------------
+/** Creates the ENet hosts of all bots and connects them to the server. */
+void LoadGenerator::connectBots(uint16_t port)
+{
+    ENetAddress server_address =
+        SocketAddress(0x7f000001, port).toENetAddress();
+    for (Bot &bot : m_bots)
+    {
+        // Any free port
+        ENetAddress ea = {};
+        bot.m_network = new Network(/*peer_count*/1,
+            /*channel_limit*/EVENT_CHANNEL_COUNT,
+            /*max_in_bandwidth*/0, /*max_out_bandwidth*/0, &ea);
+        if (!bot.m_network->getENetHost())
+        {
+            Log::error("LoadGenerator", "Failed to create a socket for a "
+                "bot.");
+            continue;
+        }
+        bot.m_peer = bot.m_network->connectTo(server_address);
+    }
+    Log::info("LoadGenerator", "Connecting %u bots to port %d.",
+              (unsigned)m_bots.size(), port);
+}   // connectBots
+
+// ----------------------------------------------------------------------------
+/** The main function of the bot thread: services the ENet hosts of all
+ *  bots, and quits the game when the test time is over. */
+void LoadGenerator::run()
+{
+    VS::setThreadName("LoadGenerator");
+    uint16_t port = 0;
+    while (!m_abort.load() && (port = m_server_port.load()) == 0)
+        StkTime::sleep(10);
+    if (port != 0)
+        connectBots(port);
+
+    m_start_time = StkTime::getMonoTimeMs();
+    bool requested_abort = false;
+    ENetEvent event;
+    while (!m_abort.load())
+    {
+        const uint64_t now = StkTime::getMonoTimeMs();
+        if (!requested_abort && now > m_start_time + m_duration)
+        {
+            Log::info("LoadGenerator", "Test time is over.");
+            main_loop->requestAbort();
+            requested_abort = true;
+        }
+        for (unsigned i = 0; i < m_bots.size(); i++)
+        {
+            Bot &bot = m_bots[i];
+            if (!bot.m_network || !bot.m_network->getENetHost())
+                continue;
+            ENetHost *host = bot.m_network->getENetHost();
+            while (enet_host_service(host, &event, 0) > 0)
+            {
+                switch (event.type)
+                {
+                case ENET_EVENT_TYPE_CONNECT:
+                {
+                    bot.m_connected = true;
+                    BareNetworkString request(
+                        (const char*)m_connection_request.data(),
+                        (int)m_connection_request.size());
+                    core::stringw name = StringUtils::toWString(
+                        "Load bot " + StringUtils::toString(i + 1));
+                    request.addUInt8(1).encodeString(name).addFloat(0.0f)
+                        .addUInt8(HANDICAP_NONE);
+                    sendToServer(&bot, request, /*reliable*/true);
+                    break;
+                }
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    bot.m_connected = false;
+                    bot.m_peer = NULL;
+                    bot.m_kart_id = -1;
+                    bot.m_clock_ticks = -1;
+                    m_statistics.m_disconnected++;
+                    break;
+                case ENET_EVENT_TYPE_RECEIVE:
+                    handleMessage(i, event.packet);
+                    enet_packet_destroy(event.packet);
+                    break;
+                case ENET_EVENT_TYPE_NONE:
+                    break;
+                }
+            }
+            if (bot.m_kart_id >= 0 && bot.m_clock_ticks >= 0)
+            {
+                mergeStates(&bot, now);
+                if (now >= bot.m_next_action_time)
+                    sendActions(&bot, now);
+            }
+
+            // The counters of ENet are only 32 bit
+            m_statistics.m_sent_packets += host->totalSentPackets;
+            m_statistics.m_sent_bytes += host->totalSentData;
+            m_statistics.m_received_packets += host->totalReceivedPackets;
+            m_statistics.m_received_bytes += host->totalReceivedData;
+            host->totalSentPackets = host->totalSentData = 0;
+            host->totalReceivedPackets = host->totalReceivedData = 0;
+        }
+        StkTime::sleep(1);
+    }
+    m_end_time = StkTime::getMonoTimeMs();
+
+    for (Bot &bot : m_bots)
+    {
+        if (bot.m_peer && bot.m_connected)
+            enet_peer_disconnect_now(bot.m_peer, PDI_NORMAL);
+        delete bot.m_network;
+        bot.m_network = NULL;
+        bot.m_peer = NULL;
+    }
+}   // run
+
+// ----------------------------------------------------------------------------
+/** Handles a message from the server to a bot. Only the messages which a
+ *  client has to answer are decoded.
+ */
+void LoadGenerator::handleMessage(unsigned bot_id, const ENetPacket *packet)
+{
+    Bot *bot = &m_bots[bot_id];
+    m_statistics.m_messages++;
+    // Ping packets from the server start with 255
+    if (packet->dataLength < 2 || packet->data[0] == 255)
+        return;
+
+    NetworkString data(packet->data, (int)packet->dataLength);
+    try
+    {
+        const uint8_t type = data.getUInt8();
+        if (data.getProtocolType() == PROTOCOL_CONTROLLER_EVENTS)
+        {
+            if (type != GameProtocol::GP_STATE &&
+                type != GameProtocol::GP_STATE_DELTA)
+                return;
+            if (type == GameProtocol::GP_STATE)
+                m_statistics.m_full_states++;
+            else
+                m_statistics.m_delta_states++;
+            m_statistics.m_state_bytes += packet->dataLength;
+            m_statistics.m_max_state_size =
+                std::max(m_statistics.m_max_state_size,
+                         (unsigned)packet->dataLength);
+            if (bot->m_kart_id < 0)
+                return;
+
+            const int ticks = data.getUInt32();
+            const uint64_t now = StkTime::getMonoTimeMs();
+            if (bot->m_clock_ticks < 0)
+                bot->m_next_action_time = now;
+            // A client starts ahead of the server by about the round trip
+            // time (and is adjusted by the server if it falls behind), a
+            // small lead avoids that the actions are in the past for the
+            // server
+            if (bot->m_clock_ticks < 0 || getBotTicks(*bot, now) < ticks)
+            {
+                const float rtt = bot->m_peer ?
+                    bot->m_peer->roundTripTime * 0.001f : 0.0f;
+                bot->m_clock_ticks = ticks + 2 + stk_config->time2Ticks(rtt);
+                bot->m_clock_time = now;
+            }
+            bot->m_pending_state_ticks =
+                std::max(bot->m_pending_state_ticks, ticks);
+            NetworkString ack(PROTOCOL_CONTROLLER_EVENTS, 5);
+            ack.addUInt8(GameProtocol::GP_STATE_ACK).addUInt32(ticks);
+            sendToServer(bot, ack, /*reliable*/false);
+            return;
+        }
+        if (data.getProtocolType() != PROTOCOL_LOBBY_ROOM)
+            return;
+
+        switch (type)
+        {
+        case LobbyProtocol::LE_CONNECTION_ACCEPTED:
+            bot->m_host_id = data.getUInt32();
+            break;
+        case LobbyProtocol::LE_CONNECTION_REFUSED:
+            m_statistics.m_refused++;
+            Log::warn("LoadGenerator", "Bot %u was refused, reason %d.",
+                      bot_id + 1, data.getUInt8());
+            break;
+        case LobbyProtocol::LE_LOAD_WORLD:
+        {
+            // See ServerLobby::getLoadWorldMessage, the kart id is the
+            // index in the list of players
+            data.getUInt32();
+            PeerVote vote(data);
+            data.getUInt8();
+            bot->m_kart_id = -1;
+            unsigned player_count = data.getUInt8();
+            for (unsigned i = 0; i < player_count; i++)
+            {
+                core::stringw name;
+                std::string country, kart;
+                data.decodeStringW(&name);
+                uint32_t host_id = data.getUInt32();
+                data.getFloat();
+                data.getUInt32();
+                data.getUInt8();
+                data.getUInt8();
+                data.getUInt8();
+                data.decodeString(&country);
+                data.decodeString(&kart);
+                if (host_id == bot->m_host_id)
+                    bot->m_kart_id = i;
+            }
+            bot->m_clock_ticks = -1;
+            bot->m_pending_state_ticks = -1;
+            bot->m_steer_val_l = bot->m_steer_val_r = 0;
+            bot->m_accelerating = false;
+            NetworkString loaded(PROTOCOL_LOBBY_ROOM, 1);
+            loaded.addUInt8(LobbyProtocol::LE_CLIENT_LOADED_WORLD);
+            sendToServer(bot, loaded, /*reliable*/true);
+            break;
+        }
+        case LobbyProtocol::LE_RACE_FINISHED:
+        {
+            bot->m_kart_id = -1;
+            m_statistics.m_races++;
+            NetworkString ack(PROTOCOL_LOBBY_ROOM, 1);
+            ack.setSynchronous(true);
+            ack.addUInt8(LobbyProtocol::LE_RACE_FINISHED_ACK);
+            sendToServer(bot, ack, /*reliable*/true);
+            break;
+        }
+        case LobbyProtocol::LE_BACK_LOBBY:
+            bot->m_kart_id = -1;
+            break;
+        default:
+            break;
+        }
+    }
+    catch (std::exception &e)
+    {
+        Log::warn("LoadGenerator", "Invalid message for bot %u: %s",
+                  bot_id + 1, e.what());
+    }
+}   // handleMessage
+
+// ----------------------------------------------------------------------------
+/** Returns the world ticks of a bot at the given time. */
+int LoadGenerator::getBotTicks(const Bot &bot, uint64_t now) const
+{
+    return bot.m_clock_ticks +
+        stk_config->time2Ticks((now - bot.m_clock_time) * 0.001f);
+}   // getBotTicks
+
+// ----------------------------------------------------------------------------
+/** Like RewindQueue::mergeNetworkData on a client: if a state was received
+ *  for a time which the bot already passed, a client would rewind to the
+ *  latest such state and simulate all ticks since then again.
+ */
+void LoadGenerator::mergeStates(Bot *bot, uint64_t now)
+{
+    const int ticks = getBotTicks(*bot, now);
+    if (bot->m_pending_state_ticks < 0 || bot->m_pending_state_ticks > ticks)
+        return;
+
+    const int depth = ticks - bot->m_pending_state_ticks;
+    bot->m_pending_state_ticks = -1;
+    bot->m_rollbacks++;
+    m_statistics.m_rollback_depth += depth;
+    m_statistics.m_max_rollback_depth =
+        std::max(m_statistics.m_max_rollback_depth, depth);
+
+    // Count the rollbacks of all bots in the same (real time) tick
+    const uint64_t tick = (uint64_t)stk_config->time2Ticks(
+        (now - m_start_time) * 0.001f);
+    if (tick != m_rollback_tick)
+    {
+        m_rollback_tick = tick;
+        m_rollbacks_in_tick = 0;
+    }
+    m_rollbacks_in_tick++;
+    m_statistics.m_max_rollbacks_at_once =
+        std::max(m_statistics.m_max_rollbacks_at_once, m_rollbacks_in_tick);
+}   // mergeStates
+
+// ----------------------------------------------------------------------------
+/** Sends a random steering (and the acceleration once per race) like a
+ *  NetworkAIController, for the current world time of the bot. */
+void LoadGenerator::sendActions(Bot *bot, uint64_t now)
+{
+    RandomGenerator random;
+    const int ticks = getBotTicks(*bot, now);
+
+    NetworkString ns(PROTOCOL_CONTROLLER_EVENTS, 24);
+    ns.addUInt8(GameProtocol::GP_CONTROLLER_ACTION)
+      .addUInt8(bot->m_accelerating ? 1 : 2);
+    auto add_action = [&](PlayerAction action, int value)
+    {
+        GameProtocol::addAction(&ns, ticks, bot->m_kart_id, action, value,
+                                bot->m_steer_val_l, bot->m_steer_val_r);
+    };
+    if (!bot->m_accelerating)
+    {
+        add_action(PA_ACCEL, 32768);
+        bot->m_accelerating = true;
+    }
+    const int steer = random.get(65537) - 32768;
+    if (steer < 0)
+    {
+        add_action(PA_STEER_LEFT, -steer);
+        bot->m_steer_val_l = -steer;
+    }
+    else
+    {
+        add_action(PA_STEER_RIGHT, steer);
+        bot->m_steer_val_r = -steer;
+    }
+    sendToServer(bot, ns, /*reliable*/true);
+    m_statistics.m_actions_sent++;
+    bot->m_next_action_time = now + 100 + random.get(100);
+}   // sendActions
+
+// ----------------------------------------------------------------------------
+void LoadGenerator::sendToServer(Bot *bot, const BareNetworkString &ns,
+                                 bool reliable)
+{
+    if (!bot->m_peer || !bot->m_connected)
+        return;
+    ENetPacket *packet = enet_packet_create(ns.getData(), ns.getTotalSize(),
+        reliable ? ENET_PACKET_FLAG_RELIABLE :
+        (ENET_PACKET_FLAG_UNSEQUENCED | ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT));
+    if (enet_peer_send(bot->m_peer, EVENT_CHANNEL_NORMAL, packet) < 0)
+        enet_packet_destroy(packet);
+}   // sendToServer
+
+// ----------------------------------------------------------------------------
+/** Returns the time in microseconds below which the given fraction of all
+ *  server ticks are. */
+unsigned LoadGenerator::getTickPercentile(double fraction) const
+{
+    uint64_t total = 0;
+    for (const auto &bucket : m_tick_histogram)
+        total += bucket.load();
+    const uint64_t wanted = (uint64_t)(total * fraction);
+    uint64_t count = 0;
+    for (unsigned i = 0; i < NUM_TICK_BUCKETS; i++)
+    {
+        count += m_tick_histogram[i].load();
+        if (count > wanted)
+            return (i + 1) * TICK_BUCKET_US;
+    }
+    return NUM_TICK_BUCKETS * TICK_BUCKET_US;
+}   // getTickPercentile
+
+// ----------------------------------------------------------------------------
+void LoadGenerator::printReport() const
+{
+    const double seconds = m_end_time > m_start_time ?
+        (m_end_time - m_start_time) * 0.001 : 0.0;
+    Log::info("LoadGenerator", "Load test with %u bots for %.1lf s.",
+              (unsigned)m_bots.size(), seconds);
+    if (seconds <= 0.0)
+        return;
+
+    uint64_t ticks = 0, over_budget = 0;
+    const unsigned budget_us =
+        (unsigned)(stk_config->ticks2Time(1) * 1000000.0f);
+    for (unsigned i = 0; i < NUM_TICK_BUCKETS; i++)
+    {
+        ticks += m_tick_histogram[i].load();
+        if (i * TICK_BUCKET_US >= budget_us)
+            over_budget += m_tick_histogram[i].load();
+    }
+    if (ticks > 0)
+    {
+        Log::info("LoadGenerator", "Server: %llu ticks, mean %.3lf ms, "
+            "50%% %.2lf ms, 90%% %.2lf ms, 99%% %.2lf ms, 99.9%% %.2lf ms, "
+            "max %.2lf ms, %llu ticks longer than %.2lf ms.",
+            (unsigned long long)ticks,
+            m_tick_total_us.load() * 0.001 / ticks,
+            getTickPercentile(0.5) * 0.001, getTickPercentile(0.9) * 0.001,
+            getTickPercentile(0.99) * 0.001,
+            getTickPercentile(0.999) * 0.001, m_tick_max_us.load() * 0.001,
+            (unsigned long long)over_budget, budget_us * 0.001);
+    }
+    else
+        Log::info("LoadGenerator", "Server: no race ticks.");
+
+    const BotStatistics &s = m_statistics;
+    const uint64_t states = s.m_full_states + s.m_delta_states;
+    const double bots = (double)std::max<size_t>(m_bots.size(), 1);
+    if (states > 0)
+    {
+        Log::info("LoadGenerator", "States: %.1lf per second for each bot, "
+            "%llu full and %llu delta states, mean %.0lf bytes, max %u "
+            "bytes.", states / seconds / bots,
+            (unsigned long long)s.m_full_states,
+            (unsigned long long)s.m_delta_states,
+            (double)s.m_state_bytes / states, s.m_max_state_size);
+    }
+    Log::info("LoadGenerator", "Bots received %.0lf packets/s (%.1lf KB/s) "
+        "and sent %.0lf packets/s (%.1lf KB/s), %.0lf messages/s received "
+        "and %.0lf action messages/s sent.",
+        s.m_received_packets / seconds, s.m_received_bytes / seconds / 1024.0,
+        s.m_sent_packets / seconds, s.m_sent_bytes / seconds / 1024.0,
+        s.m_messages / seconds, s.m_actions_sent / seconds);
+    Log::info("LoadGenerator", "Bots: %u refused, %u disconnected, %u "
+        "races finished.", s.m_refused, s.m_disconnected, s.m_races);
+
+    uint64_t rollbacks = 0;
+    uint64_t min_rollbacks = std::numeric_limits<uint64_t>::max();
+    uint64_t max_rollbacks = 0;
+    for (const Bot &bot : m_bots)
+    {
+        rollbacks += bot.m_rollbacks;
+        min_rollbacks = std::min(min_rollbacks, bot.m_rollbacks);
+        max_rollbacks = std::max(max_rollbacks, bot.m_rollbacks);
+    }
+    if (rollbacks > 0)
+    {
+        Log::info("LoadGenerator", "Bots: %llu rollbacks (%.1lf per minute "
+            "for each bot, %llu to %llu for one bot), mean depth %.1lf "
+            "ticks, max depth %d ticks, up to %u rollbacks in the same "
+            "tick.", (unsigned long long)rollbacks,
+            rollbacks * 60.0 / seconds / bots,
+            (unsigned long long)min_rollbacks,
+            (unsigned long long)max_rollbacks,
+            (double)s.m_rollback_depth / rollbacks, s.m_max_rollback_depth,
+            s.m_max_rollbacks_at_once);
+    }
+
+    const RewindProfiler *rp = RewindProfiler::get();
+    if (rp)
+    {
+        const RewindProfiler::RewindTotals &t = rp->getTotals();
+        const double n = (double)std::max(t.m_num_rewinds, 1u);
+        Log::info("LoadGenerator", "Client: %u rollbacks (%.1lf per "
+            "minute), mean depth %.1lf ticks, max depth %d ticks, mean "
+            "time %.2lf ms.", t.m_num_rewinds,
+            t.m_num_rewinds * 60.0 / seconds, t.m_depth / n, t.m_max_depth,
+            t.m_time_ms / n);
+        // The cost per replayed tick of the full client gives an estimate
+        // of the time all bots would need for their rollbacks
+        if (t.m_replayed_ticks > 0 && rollbacks > 0)
+        {
+            const double ms_per_tick = t.m_time_ms / t.m_replayed_ticks;
+            Log::info("LoadGenerator", "Rollbacks take %.3lf ms per "
+                "replayed tick on the client, the bots would need %.1lf ms "
+                "per second for theirs (%.1lf ms for each bot).",
+                ms_per_tick, s.m_rollback_depth * ms_per_tick / seconds,
+                s.m_rollback_depth * ms_per_tick / seconds / bots);
+        }
+    }
+}   // printReport
@@ -0,0 +1,191 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_LOAD_GENERATOR_HPP
+#define HEADER_LOAD_GENERATOR_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <enet/enet.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+class BareNetworkString;
+class Network;
+
+/** \ingroup network
+ *  Measures the capacity of a server on one machine (--load-test=n). A LAN
+ *  server is started in a child thread of this process (like a server
+ *  created from the GUI), and this process joins it as a normal client
+ *  with one NetworkAIController. Then n lightweight bots connect over the
+ *  loopback interface, each with its own ENet host, all serviced by one
+ *  thread: they speak the lobby and game protocol like a network AI client
+ *  (join, load the world, acknowledge states and send steering and
+ *  acceleration actions), but do not simulate the race, so hundreds of
+ *  them can be run on one machine.
+ *
+ *  Each bot keeps a world clock which runs ahead of the server by the round
+ *  trip time like the one of a client, and sends its actions for that
+ *  time. A state received for a time before this clock causes a rollback
+ *  on a client (see RewindQueue::mergeNetworkData), so each bot counts the
+ *  rollbacks and their depth a client would have. The full client measures
+ *  what a rollback costs (with the RewindProfiler).
+ *
+ *  When the test time is over (or the game is quit) a report is printed:
+ *  the distribution of the time the server needs for a tick, the size and
+ *  rate of the states received by the bots, the packet and byte rates of
+ *  the bots, the rollbacks of the bots (and how many happen in the same
+ *  tick) and of the full client.
+ */
+class LoadGenerator : public NoCopy
+{
+private:
+    /** One lightweight client. */
+    struct Bot
+    {
+        Network  *m_network;
+        ENetPeer *m_peer;
+        /** Host id given by the server, 0 until the connection is
+         *  accepted. */
+        uint32_t  m_host_id;
+        /** Kart id in the current race, or -1. */
+        int       m_kart_id;
+        /** The world ticks of the bot were m_clock_ticks at m_clock_time,
+         *  m_clock_ticks is -1 until the first state of a race. */
+        int       m_clock_ticks;
+        uint64_t  m_clock_time;
+        /** Ticks of the latest state which did not cause a rollback yet, or
+         *  -1. */
+        int       m_pending_state_ticks;
+        /** Number of rollbacks of this bot. */
+        uint64_t  m_rollbacks;
+        /** When the next action is sent. */
+        uint64_t  m_next_action_time;
+        /** The steering of the kart like in PlayerController. */
+        int       m_steer_val_l, m_steer_val_r;
+        bool      m_connected;
+        bool      m_accelerating;
+    };
+
+    /** Statistics of all bots, only used by the bot thread. */
+    struct BotStatistics
+    {
+        uint64_t m_sent_packets, m_sent_bytes;
+        uint64_t m_received_packets, m_received_bytes;
+        uint64_t m_messages, m_actions_sent;
+        uint64_t m_full_states, m_delta_states, m_state_bytes;
+        unsigned m_max_state_size;
+        unsigned m_refused, m_disconnected, m_races;
+        /** Sum and maximum of the depth of all rollbacks of the bots. */
+        uint64_t m_rollback_depth;
+        int      m_max_rollback_depth;
+        /** Largest number of rollbacks of the bots in the same tick. */
+        unsigned m_max_rollbacks_at_once;
+    };
+
+    /** Server tick times are counted in buckets of this many
+     *  microseconds. */
+    static const unsigned TICK_BUCKET_US = 10;
+
+    static const unsigned NUM_TICK_BUCKETS = 20000;
+
+    static LoadGenerator *m_load_generator;
+
+    std::vector<Bot> m_bots;
+
+    BotStatistics m_statistics;
+
+    /** The start of the connection request which is the same for all
+     *  bots. */
+    std::vector<uint8_t> m_connection_request;
+
+    /** Number of server ticks for each time bucket, the last bucket counts
+     *  all longer ticks. */
+    std::vector<std::atomic<uint32_t> > m_tick_histogram;
+
+    std::atomic<uint64_t> m_tick_total_us;
+
+    std::atomic<uint64_t> m_tick_max_us;
+
+    /** Port of the server, set by the server thread once it is ready. */
+    std::atomic<uint16_t> m_server_port;
+
+    std::atomic_bool m_abort;
+
+    std::thread m_thread;
+
+    /** Duration of the test in ms. */
+    uint64_t m_duration;
+
+    /** Start and end of the time in which the bots were connected. */
+    uint64_t m_start_time, m_end_time;
+
+    /** The tick (counted in real time since m_start_time) of the last
+     *  rollback of a bot, and the number of rollbacks in it. */
+    uint64_t m_rollback_tick;
+    unsigned m_rollbacks_in_tick;
+
+    // ------------------------------------------------------------------------
+    LoadGenerator(unsigned num_bots, float duration);
+    // ------------------------------------------------------------------------
+    ~LoadGenerator();
+    // ------------------------------------------------------------------------
+    void run();
+    // ------------------------------------------------------------------------
+    void connectBots(uint16_t port);
+    // ------------------------------------------------------------------------
+    void handleMessage(unsigned bot_id, const ENetPacket *packet);
+    // ------------------------------------------------------------------------
+    void sendActions(Bot *bot, uint64_t now);
+    // ------------------------------------------------------------------------
+    int getBotTicks(const Bot &bot, uint64_t now) const;
+    // ------------------------------------------------------------------------
+    void mergeStates(Bot *bot, uint64_t now);
+    // ------------------------------------------------------------------------
+    void sendToServer(Bot *bot, const BareNetworkString &ns, bool reliable);
+    // ------------------------------------------------------------------------
+    void printReport() const;
+    // ------------------------------------------------------------------------
+    unsigned getTickPercentile(double fraction) const;
+
+public:
+    // ------------------------------------------------------------------------
+    static void create(unsigned num_bots, float duration);
+    // ------------------------------------------------------------------------
+    /** Returns the load generator, or NULL if no load test is running. */
+    static LoadGenerator *get()                    { return m_load_generator; }
+    // ------------------------------------------------------------------------
+    /** Prints the report and deletes the load generator, must be called
+     *  after the server thread is stopped. */
+    static void destroy()
+    {
+        delete m_load_generator;
+        m_load_generator = NULL;
+    }   // destroy
+    // ------------------------------------------------------------------------
+    /** Called by the server thread when it accepts connections. */
+    void setServerPort(uint16_t port)            { m_server_port.store(port); }
+    // ------------------------------------------------------------------------
+    void addServerTickTime(uint64_t us);
+};   // LoadGenerator
+
+#endif
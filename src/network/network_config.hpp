@@ -302,6 +302,15 @@ public:
     // ------------------------------------------------------------------------
     IPType getIPType() const                       { return m_ip_type.load(); }
     // ------------------------------------------------------------------------
+    /** Uses the ip type (and NAT64 prefix) detected by another process
+     *  instead of detecting it again. */
+    void copyIPDetectionResult(const NetworkConfig* other)
+    {
+        m_ip_type.store(other->m_ip_type.load());
+        m_nat64_prefix = other->m_nat64_prefix;
+        m_nat64_prefix_data = other->m_nat64_prefix_data;
+    }
+    // ------------------------------------------------------------------------
     void setIPType(IPType ip_type)                { m_ip_type.store(ip_type); }
     // ------------------------------------------------------------------------
     const std::string& getNAT64Prefix() const        { return m_nat64_prefix; }
@@ -69,6 +69,34 @@ void NetworkString::unitTesting()
     std::string log = slog.getLogMessage();
     assert(log=="0x000 | 00 01 02 03 04 05 06 07  08 09 0a 0b 0c 0d 0e 0f   | ................\n"
                 "0x010 | 10 11 12 13 14 15 16 17  18 19 1a 1b               | ............\n");
+
+    // Check delta encoding against a base, including size changes
+    std::vector<uint8_t> base, target, decoded;
+    for (unsigned i = 0; i < 300; i++)
+        base.push_back((uint8_t)(i * 7));
+    target = base;
+    target[0] = 1;
+    target[150] ^= 0xff;
+    target[151] ^= 0x0f;
+    target.resize(320, 42);
+    BareNetworkString sdelta;
+    sdelta.encodeDelta(base, target.data(), (unsigned)target.size());
+    assert(sdelta.size() < target.size());
+    assert(sdelta.decodeDelta(base, &decoded));
+    assert(decoded == target);
+    assert(sdelta.size() == 0);
+
+    target.resize(100);
+    BareNetworkString sshrink;
+    sshrink.encodeDelta(base, target.data(), (unsigned)target.size());
+    assert(sshrink.decodeDelta(base, &decoded));
+    assert(decoded == target);
+
+    // Corrupted delta must be rejected
+    BareNetworkString sbad;
+    sbad.encodeDelta(base, target.data(), (unsigned)target.size());
+    sbad.getBuffer().resize(sbad.getBuffer().size() - 1);
+    assert(!sbad.decodeDelta(base, &decoded));
 }   // unitTesting
 
 // ============================================================================
@@ -194,6 +222,84 @@ int BareNetworkString::decodeString16(irr::core::stringw* out,
     return str_len * 4 + 2;
 }   // decodeString16
 
+// ----------------------------------------------------------------------------
+/** Adds the difference between data and base, so that the receiver can
+ *  rebuild data if it knows base (see decodeDelta). The data is xor'ed with
+ *  base (bytes past the end of base are xor'ed with 0), and the result is
+ *  stored as a sequence of (zero run length, literal length, literal bytes).
+ *  Unchanged bytes therefore cost nearly nothing.
+ *  \param base The data the receiver already has.
+ *  \param data Pointer to the new data.
+ *  \param len Length of the new data.
+ */
+BareNetworkString& BareNetworkString::encodeDelta(
+                                           const std::vector<uint8_t>& base,
+                                           const uint8_t* data, unsigned len)
+{
+    auto xor_at = [&base, data](unsigned i) -> uint8_t
+    {
+        return i < base.size() ? data[i] ^ base[i] : data[i];
+    };
+    addVarUInt(len);
+    unsigned i = 0;
+    while (i < len)
+    {
+        unsigned zero_start = i;
+        while (i < len && xor_at(i) == 0)
+            i++;
+        unsigned literal_start = i;
+        // Keep single zero bytes inside a literal, a new run header would
+        // cost more than the zero byte itself.
+        while (i < len && (xor_at(i) != 0 ||
+               (i + 1 < len && xor_at(i + 1) != 0)))
+            i++;
+        addVarUInt(literal_start - zero_start);
+        addVarUInt(i - literal_start);
+        for (unsigned j = literal_start; j < i; j++)
+            addUInt8(xor_at(j));
+    }
+    return *this;
+}   // encodeDelta
+
+// ----------------------------------------------------------------------------
+/** Rebuilds data encoded by encodeDelta with the same base.
+ *  \param base The data which was used as base when encoding.
+ *  \param[out] out The decoded data.
+ *  \return False if the delta is corrupted.
+ */
+bool BareNetworkString::decodeDelta(const std::vector<uint8_t>& base,
+                                    std::vector<uint8_t>* out) const
+{
+    try
+    {
+        unsigned len = getVarUInt();
+        // Avoid huge allocation from a corrupted packet
+        if (len > 1024 * 1024)
+            return false;
+        out->resize(len);
+        unsigned i = 0;
+        while (i < len)
+        {
+            unsigned zeros = getVarUInt();
+            unsigned literals = getVarUInt();
+            if (zeros + literals == 0 || i + zeros + literals > len)
+                return false;
+            for (unsigned j = 0; j < zeros; j++, i++)
+                (*out)[i] = i < base.size() ? base[i] : 0;
+            for (unsigned j = 0; j < literals; j++, i++)
+            {
+                uint8_t b = getUInt8();
+                (*out)[i] = i < base.size() ? b ^ base[i] : b;
+            }
+        }
+    }
+    catch (std::exception&)
+    {
+        return false;
+    }
+    return true;
+}   // decodeDelta
+
 // ----------------------------------------------------------------------------
 /** Returns a string representing this message suitable to be printed
  *  to stdout or via the Log mechanism. Format
@@ -157,6 +157,10 @@ public:
     int decodeString(std::string *out) const;
     int decodeStringW(irr::core::stringw *out) const;
     std::string getLogMessage(const std::string &indent="") const;
+    BareNetworkString& encodeDelta(const std::vector<uint8_t>& base,
+                                   const uint8_t* data, unsigned len);
+    bool decodeDelta(const std::vector<uint8_t>& base,
+                     std::vector<uint8_t>* out) const;
     // ------------------------------------------------------------------------
     /** Returns the internal buffer of the network string. */
     std::vector<uint8_t>& getBuffer() { return m_buffer; }
@@ -285,6 +289,20 @@ public:
         return *this;
     }   // operator+=
 
+    // ------------------------------------------------------------------------
+    /** Adds an unsigned integer using 7 bits per byte, the highest bit set
+     *  indicates that more bytes follow. Small values need only 1 byte. */
+    BareNetworkString& addVarUInt(uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            m_buffer.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        m_buffer.push_back((uint8_t)value);
+        return *this;
+    }   // addVarUInt
+
     // ------------------------------------------------------------------------
     /** Adds a floating point number */
     BareNetworkString& add(float f)
@@ -348,6 +366,20 @@ public:
         return m_buffer.at(m_current_offset++);
     }   // getUInt8
     // ------------------------------------------------------------------------
+    /** Returns an unsigned integer added with addVarUInt. */
+    uint32_t getVarUInt() const
+    {
+        uint32_t value = 0;
+        for (unsigned shift = 0; shift < 32; shift += 7)
+        {
+            uint8_t b = getUInt8();
+            value |= (uint32_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+                return value;
+        }
+        throw std::out_of_range("getVarUInt too long.");
+    }   // getVarUInt
+    // ------------------------------------------------------------------------
     /** Returns an unsigned 8-bit integer. */
     inline int8_t getInt8() const
     {
@@ -442,6 +474,27 @@ public:
         m_current_offset = 1;   // ignore type
     }   // NetworkString
 
+    // ------------------------------------------------------------------------
+    /** Replaces the content with a received message of the given length,
+     *  which must then be written to the returned buffer. Already allocated
+     *  memory is kept, so one NetworkString can be reused for many received
+     *  messages. */
+    uint8_t* prepareReceive(int len)
+    {
+        m_buffer.resize(len);
+        m_current_offset = 1;   // ignore type
+        return m_buffer.data();
+    }   // prepareReceive
+    // ------------------------------------------------------------------------
+    /** Replaces the content with a copy of a received message. */
+    void setReceived(const uint8_t *data, int len)
+    {
+        m_buffer.assign(data, data + len);
+        m_current_offset = 1;   // ignore type
+    }   // setReceived
+    // ------------------------------------------------------------------------
+    /** Returns the number of bytes allocated for this string. */
+    size_t getCapacity() const { return m_buffer.capacity(); }
     // ------------------------------------------------------------------------
     /** Empties the string, but does not reset the pre-allocated size. */
     void clear()
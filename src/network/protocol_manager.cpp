@@ -53,9 +53,8 @@ std::shared_ptr<ProtocolManager> ProtocolManager::createInstance()
     auto pm = std::make_shared<ProtocolManager>();
     pm->m_asynchronous_update_thread = std::thread([pm, pt]()
         {
-            std::string thread_name = "PtlMgr";
-            if (pt == PT_CHILD)
-                thread_name += "_child";
+            std::string thread_name = "PtlMgr" +
+                STKProcess::getThreadNameSuffix(pt);
             VS::setThreadName(thread_name.c_str());
             STKProcess::init(pt);
             while(!pm->m_exit.load())
@@ -72,33 +71,46 @@ std::shared_ptr<ProtocolManager> ProtocolManager::createInstance()
             {
                 VS::setThreadName("CtrlEvents");
                 STKProcess::init(pt);
-                while (true)
+                std::vector<Event*> events;
+                bool stop = false;
+                while (!stop)
                 {
-                    std::unique_lock<std::mutex> ul(pm->m_game_protocol_mutex);
-                    pm->m_game_protocol_cv.wait(ul, [&pm]
-                        {
-                            return !pm->m_controller_events_list.empty();
-                        });
-                    Event* event_top = pm->m_controller_events_list.front();
-                    pm->m_controller_events_list.pop_front();
-                    ul.unlock();
-                    if (event_top == NULL)
-                        break;
-                    auto sl = LobbyProtocol::get<ServerLobby>();
-                    if (sl)
+                    pm->m_controller_events.popAll(&events);
+                    if (events.empty())
+                    {
+                        std::unique_lock<std::mutex> ul(
+                            pm->m_game_protocol_mutex);
+                        pm->m_game_protocol_cv.wait(ul, [&pm]
+                            {
+                                return !pm->m_controller_events.empty();
+                            });
+                        continue;
+                    }
+                    for (Event* event_top : events)
                     {
-                        ServerLobby::ServerState ss = sl->getCurrentState();
-                        if (!(ss >= ServerLobby::WAIT_FOR_WORLD_LOADED &&
-                            ss <= ServerLobby::RACING))
+                        if (event_top == NULL || stop)
                         {
+                            stop = true;
                             delete event_top;
                             continue;
                         }
+                        auto sl = LobbyProtocol::get<ServerLobby>();
+                        if (sl)
+                        {
+                            ServerLobby::ServerState ss = sl->getCurrentState();
+                            if (!(ss >= ServerLobby::WAIT_FOR_WORLD_LOADED &&
+                                ss <= ServerLobby::RACING))
+                            {
+                                delete event_top;
+                                continue;
+                            }
+                        }
+                        auto gp = GameProtocol::lock();
+                        if (gp)
+                            gp->notifyEventAsynchronous(event_top);
+                        delete event_top;
                     }
-                    auto gp = GameProtocol::lock();
-                    if (gp)
-                        gp->notifyEventAsynchronous(event_top);
-                    delete event_top;
+                    events.clear();
                 }
             });
     }
@@ -121,27 +133,60 @@ ProtocolManager::~ProtocolManager()
         m_all_protocols[i].abort();
     }
 
-    m_sync_events_to_process.lock();
-    for (EventList::iterator i =m_sync_events_to_process.getData().begin();
-                             i!=m_sync_events_to_process.getData().end(); ++i)
-        delete *i;
-    m_sync_events_to_process.getData().clear();
-    m_sync_events_to_process.unlock();
-
-    m_async_events_to_process.lock();
-    for (EventList::iterator i = m_async_events_to_process.getData().begin();
-                             i!= m_async_events_to_process.getData().end(); ++i)
-        delete *i;
-    m_async_events_to_process.getData().clear();
-    m_async_events_to_process.unlock();
-
-    for (EventList::iterator i = m_controller_events_list.begin();
-                             i!= m_controller_events_list.end(); ++i)
-        delete *i;
-    m_controller_events_list.clear();
+    std::vector<Event*> events;
+    m_sync_events_to_process.popAll(&events);
+    m_async_events_to_process.popAll(&events);
+    m_controller_events.popAll(&events);
+    events.insert(events.end(), m_sync_events_pending.begin(),
+                  m_sync_events_pending.end());
+    events.insert(events.end(), m_async_events_pending.begin(),
+                  m_async_events_pending.end());
+    for (Event* event : events)
+        delete event;
 
 }   // ~ProtocolManager
 
+// ----------------------------------------------------------------------------
+ProtocolManager::EventQueue::EventQueue() : m_queue(1024)
+{
+    m_use_overflow.store(false);
+}   // EventQueue
+
+// ----------------------------------------------------------------------------
+/** Adds an event to the queue, this can be called by any thread.
+ */
+void ProtocolManager::EventQueue::push(Event* event)
+{
+    if (!m_use_overflow.load(std::memory_order_acquire) &&
+        m_queue.push(event))
+        return;
+    std::lock_guard<std::mutex> lock(m_overflow_mutex);
+    m_overflow.push_back(event);
+    m_use_overflow.store(true, std::memory_order_release);
+}   // EventQueue::push
+
+// ----------------------------------------------------------------------------
+/** Appends all events in the queue to the given vector, in the order in
+ *  which they were added.
+ */
+void ProtocolManager::EventQueue::popAll(std::vector<Event*>* events)
+{
+    Event* event;
+    while (m_queue.pop(&event))
+        events->push_back(event);
+    if (!m_use_overflow.load(std::memory_order_acquire))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_overflow_mutex);
+    // Events which are still in the queue were added before the overflow
+    // list was used, since no events are added to the queue while it is.
+    while (m_queue.pop(&event))
+        events->push_back(event);
+    events->insert(events->end(), m_overflow.begin(), m_overflow.end());
+    m_overflow.clear();
+    m_use_overflow.store(false, std::memory_order_release);
+}   // EventQueue::popAll
+
 // ----------------------------------------------------------------------------
 void ProtocolManager::OneProtocolType::abort()
 {
@@ -162,10 +207,11 @@ void ProtocolManager::abort()
     m_exit.store(true);
     if (NetworkConfig::get()->isServer())
     {
-        std::unique_lock<std::mutex> ul(m_game_protocol_mutex);
-        m_controller_events_list.push_back(NULL);
+        m_controller_events.push(NULL);
+        {
+            std::lock_guard<std::mutex> lock(m_game_protocol_mutex);
+        }
         m_game_protocol_cv.notify_one();
-        ul.unlock();
         m_game_protocol_thread.join();
     }
     // wait the thread to finish
@@ -184,23 +230,19 @@ void ProtocolManager::propagateEvent(Event* event)
         event->getType() == EVENT_TYPE_MESSAGE &&
         event->data().getProtocolType() == PROTOCOL_CONTROLLER_EVENTS)
     {
-        std::lock_guard<std::mutex> lock(m_game_protocol_mutex);
-        m_controller_events_list.push_back(event);
+        m_controller_events.push(event);
+        // Taking the mutex makes sure that the game protocol thread is
+        // either waiting (and gets notified), or will see the new event
+        {
+            std::lock_guard<std::mutex> lock(m_game_protocol_mutex);
+        }
         m_game_protocol_cv.notify_one();
         return;
     }
     if (event->isSynchronous())
-    {
-        m_sync_events_to_process.lock();
-        m_sync_events_to_process.getData().push_back(event);
-        m_sync_events_to_process.unlock();
-    }
+        m_sync_events_to_process.push(event);
     else
-    {
-        m_async_events_to_process.lock();
-        m_async_events_to_process.getData().push_back(event);
-        m_async_events_to_process.unlock();
-    }
+        m_async_events_to_process.push(event);
 }   // propagateEvent
 
 // ----------------------------------------------------------------------------
@@ -378,45 +420,61 @@ void ProtocolManager::update(int ticks)
     ul.unlock();
 
     // before updating, notify protocols that they have received events
-    m_sync_events_to_process.lock();
-    EventList::iterator i = m_sync_events_to_process.getData().begin();
+    deliverEvents(&m_sync_events_to_process, &m_sync_events_pending,
+                  all_protocols, /*async*/false);
+
+    // Now update all protocols.
+    for (unsigned int i = 0; i < all_protocols.size(); i++)
+    {
+        OneProtocolType &opt = all_protocols[i];
+        opt.update(ticks, /*async*/false);
+    }
+}   // update
 
-    while (i != m_sync_events_to_process.getData().end())
+// ----------------------------------------------------------------------------
+/** Takes all events from a queue and passes them (and the events which could
+ *  not be delivered before) to the protocols. Events which can still not be
+ *  delivered are kept in the pending list, in their original order.
+ *  \param queue The queue with new events.
+ *  \param pending The events which could not be delivered before.
+ *  \param protocols A copy of all protocols.
+ *  \param async If this is called from the asynchronous update thread.
+ */
+void ProtocolManager::deliverEvents(EventQueue* queue,
+                      std::vector<Event*>* pending,
+                      std::array<OneProtocolType, PROTOCOL_MAX>& protocols,
+                      bool async)
+{
+    queue->popAll(pending);
+    size_t kept = 0;
+    for (size_t i = 0; i < pending->size(); i++)
     {
-        m_sync_events_to_process.unlock();
+        Event* event = (*pending)[i];
         bool can_be_deleted = true;
         try
         {
-            can_be_deleted = sendEvent(*i, all_protocols);
+            can_be_deleted = sendEvent(event, protocols);
         }
         catch (std::exception& e)
         {
-            const std::string& name = (*i)->getPeer()->getAddress().toString();
+            const std::string& name = event->getPeer()->getAddress().toString();
+            Log::error("ProtocolManager", "%s event error from %s: %s",
+                async ? "Asynchronous" : "Synchronous", name.c_str(),
+                e.what());
             Log::error("ProtocolManager",
-                "Synchronous event error from %s: %s", name.c_str(), e.what());
-            Log::error("ProtocolManager", (*i)->data().getLogMessage().c_str());
+                event->data().getLogMessage().c_str());
         }
-        m_sync_events_to_process.lock();
         if (can_be_deleted)
-        {
-            delete *i;
-            i = m_sync_events_to_process.getData().erase(i);
-        }
+            delete event;
         else
         {
             // This should only happen if the protocol has not been started
-            ++i;
+            // or already terminated (e.g. late ping answer)
+            (*pending)[kept++] = event;
         }
     }
-    m_sync_events_to_process.unlock();
-
-    // Now update all protocols.
-    for (unsigned int i = 0; i < all_protocols.size(); i++)
-    {
-        OneProtocolType &opt = all_protocols[i];
-        opt.update(ticks, /*async*/false);
-    }
-}   // update
+    pending->resize(kept);
+}   // deliverEvents
 
 // ----------------------------------------------------------------------------
 /** \brief Updates the manager.
@@ -437,40 +495,8 @@ void ProtocolManager::asynchronousUpdate()
     auto all_protocols = m_all_protocols;
     ul.unlock();
 
-    m_async_events_to_process.lock();
-    EventList::iterator i = m_async_events_to_process.getData().begin();
-    while (i != m_async_events_to_process.getData().end())
-    {
-        m_async_events_to_process.unlock();
-
-        bool result = true;
-        try
-        {
-            result = sendEvent(*i, all_protocols);
-        }
-        catch (std::exception& e)
-        {
-            const std::string& name = (*i)->getPeer()->getAddress().toString();
-            Log::error("ProtocolManager", "Asynchronous event "
-                "error from %s: %s", name.c_str(), e.what());
-            Log::error("ProtocolManager",
-                (*i)->data().getLogMessage().c_str());
-        }
-
-        m_async_events_to_process.lock();
-        if (result)
-        {
-            delete *i;
-            i = m_async_events_to_process.getData().erase(i);
-        }
-        else
-        {
-            // This should only happen if the protocol has not been started
-            // or already terminated (e.g. late ping answer)
-            ++i;
-        }
-    }   // while i != m_events_to_process.end()
-    m_async_events_to_process.unlock();
+    deliverEvents(&m_async_events_to_process, &m_async_events_pending,
+                  all_protocols, /*async*/true);
 
     PROFILER_POP_CPU_MARKER();
     PROFILER_PUSH_CPU_MARKER("Message delivery", 255, 0, 0);
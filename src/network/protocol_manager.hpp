@@ -25,6 +25,7 @@
 
 #include "network/network_string.hpp"
 #include "network/protocol.hpp"
+#include "utils/bounded_queue.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/singleton.hpp"
 #include "utils/stk_process.hpp"
@@ -147,16 +148,50 @@ private:
      *  empty) list of protocols. */
     std::array<OneProtocolType, PROTOCOL_MAX> m_all_protocols;
 
-    /** A list of network events - messages, disconnect and disconnects. */
-    typedef std::list<Event*> EventList;
+    /** A queue of network events - messages, disconnect and disconnects.
+     *  It can be filled by any thread, and is emptied by one thread. The
+     *  events are passed through a lock-free bounded queue. Only if it is
+     *  full they are added to an overflow list instead (protected by a
+     *  mutex), and all following events are then added to the overflow
+     *  list as well until the consumer took them, so the order of events
+     *  is kept. */
+    class EventQueue : public NoCopy
+    {
+    private:
+        BoundedQueue<Event*> m_queue;
+
+        std::vector<Event*> m_overflow;
+
+        std::mutex m_overflow_mutex;
+
+        std::atomic_bool m_use_overflow;
+
+    public:
+        EventQueue();
+        // --------------------------------------------------------------------
+        void push(Event* event);
+        // --------------------------------------------------------------------
+        void popAll(std::vector<Event*>* events);
+        // --------------------------------------------------------------------
+        /** Returns if no events are waiting. */
+        bool empty() const
+        {
+            return m_queue.empty() && !m_use_overflow.load();
+        }   // empty
+    };   // class EventQueue
 
     /** Contains the network events to pass synchronously to protocols
      *  (i.e. from the main thread). */
-    Synchronised<EventList> m_sync_events_to_process;
+    EventQueue m_sync_events_to_process;
 
     /** Contains the network events to pass asynchronously to protocols
     *  (i.e. from the separate ProtocolManager thread). */
-    Synchronised<EventList> m_async_events_to_process;
+    EventQueue m_async_events_to_process;
+
+    /** Events which were taken from the queues, but could not be delivered
+     *  yet since the protocol was not started. Each list is only used by
+     *  the thread handling the corresponding queue. */
+    std::vector<Event*> m_sync_events_pending, m_async_events_pending;
 
     /** When set to true, the main thread will exit. */
     std::atomic_bool m_exit;
@@ -172,7 +207,9 @@ private:
 
     std::mutex m_game_protocol_mutex, m_protocols_mutex;
 
-    EventList m_controller_events_list;
+    /** Controller actions on a server, which are handled by the game
+     *  protocol thread. A NULL event stops the thread. */
+    EventQueue m_controller_events;
 
     /*! Single instance of protocol manager.*/
     static std::weak_ptr<ProtocolManager> m_protocol_manager[PT_COUNT];
@@ -180,6 +217,10 @@ private:
     bool sendEvent(Event* event,
                    std::array<OneProtocolType, PROTOCOL_MAX>& protocols);
 
+    void deliverEvents(EventQueue* queue, std::vector<Event*>* pending,
+                       std::array<OneProtocolType, PROTOCOL_MAX>& protocols,
+                       bool async);
+
     void asynchronousUpdate();
 
 public:
@@ -52,6 +52,7 @@
 #include "network/protocols/server_lobby.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/race_event_manager.hpp"
+#include "network/rewind_manager.hpp"
 #include "network/server.hpp"
 #include "network/server_config.hpp"
 #include "network/stk_host.hpp"
@@ -1029,6 +1030,9 @@ void ClientLobby::startGame(Event* event)
         (Track::getCurrentTrack()->getItemManager());
     assert(nim);
     nim->restoreCompleteState(event->data());
+    if (NetworkConfig::get()->getServerCapabilities().find("rewinder_id") !=
+        NetworkConfig::get()->getServerCapabilities().end())
+        RewindManager::get()->decodeRewinderTable(event->data());
 
     core::stringw err_msg = _("Failed to start the network game.");
     // Different stk process thread may have different stk host
@@ -1358,6 +1362,9 @@ void ClientLobby::liveJoinAcknowledged(Event* event)
             }
         }
     }
+    if (NetworkConfig::get()->getServerCapabilities().find("rewinder_id") !=
+        NetworkConfig::get()->getServerCapabilities().end())
+        RewindManager::get()->decodeRewinderTable(data);
 }   // liveJoinAcknowledged
 
 //-----------------------------------------------------------------------------
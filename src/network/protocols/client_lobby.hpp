@@ -150,7 +150,6 @@ private:
          bool* is_spectator = NULL) const;
     void getPlayersAddonKartType(const BareNetworkString& data,
         std::vector<std::shared_ptr<NetworkPlayerProfile> >& players) const;
-    void getKartsTracksNetworkString(BareNetworkString* ns);
     void doInstallAddonsPack();
 public:
              ClientLobby(std::shared_ptr<Server> s);
@@ -202,6 +201,7 @@ public:
              { return m_background_download.joinable() || m_download_request; }
     static void downloadAddonsPack(std::shared_ptr<Online::HTTPRequest> r);
     static void destroyBackgroundDownload();
+    static void getKartsTracksNetworkString(BareNetworkString* ns);
     void updateAssetsToServer();
 };
 
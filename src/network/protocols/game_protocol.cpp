@@ -17,6 +17,7 @@
 
 #include "network/protocols/game_protocol.hpp"
 
+#include "config/stk_config.hpp"
 #include "items/item_manager.hpp"
 #include "items/network_item_manager.hpp"
 #include "karts/abstract_kart.hpp"
@@ -34,11 +35,24 @@
 #include "network/socket_address.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
+#include "race/history.hpp"
 #include "tracks/track.hpp"
 #include "utils/log.hpp"
 #include "utils/time.hpp"
 #include "main_loop.hpp"
 
+#include <algorithm>
+
+namespace
+{
+    /** Full states older than this (in seconds) are not used as delta base
+     *  anymore. Server and client must use the same value, so that a state
+     *  acknowledged by a client is always still available there. */
+    const float STATE_HISTORY_TIME = 1.0f;
+    /** Ticks, protocol type and event type in front of each state. */
+    const unsigned STATE_HEADER_SIZE = 1 + 1 + 4;
+}
+
 // ============================================================================
 std::weak_ptr<GameProtocol> GameProtocol::m_game_protocol[PT_COUNT];
 // ============================================================================
@@ -63,12 +77,19 @@ GameProtocol::GameProtocol()
     m_network_item_manager = static_cast<NetworkItemManager*>
         (Track::getCurrentTrack()->getItemManager());
     m_data_to_send = getNetworkString();
+    m_legacy_to_send = getNetworkString();
+    m_rewinder_ids_size = 0;
 }   // GameProtocol
 
 //-----------------------------------------------------------------------------
 GameProtocol::~GameProtocol()
 {
+    if (NetworkConfig::get()->isServer())
+        logStateBandwidth();
     delete m_data_to_send;
+    for (NetworkString* ns : m_deltas_to_send)
+        delete ns;
+    delete m_legacy_to_send;
 }   // ~GameProtocol
 
 //-----------------------------------------------------------------------------
@@ -101,11 +122,8 @@ void GameProtocol::sendActions()
                 a.m_ticks, a.m_kart_id, a.m_action, a.m_value, a.m_value_l,
                 a.m_value_r);
         }
-        m_data_to_send->addUInt32(a.m_ticks);
-        m_data_to_send->addUInt8(a.m_kart_id);
-        const auto& c = compressAction(a);
-        m_data_to_send->addUInt8(std::get<0>(c)).addUInt16(std::get<1>(c))
-            .addUInt16(std::get<2>(c)).addUInt16(std::get<3>(c));
+        addAction(m_data_to_send, a.m_ticks, a.m_kart_id, a.m_action,
+                  a.m_value, a.m_value_l, a.m_value_r);
     }   // for a in m_all_actions
 
     // FIXME: for now send reliable
@@ -113,6 +131,28 @@ void GameProtocol::sendActions()
     m_all_actions.clear();
 }   // sendActions
 
+//-----------------------------------------------------------------------------
+/** Adds one action to a GP_CONTROLLER_ACTION message. Also used by the bots
+ *  of a load test (see LoadGenerator), which have no GameProtocol.
+ *  \param ns The message after the message type and the action count.
+ */
+void GameProtocol::addAction(BareNetworkString* ns, int ticks, int kart_id,
+                             PlayerAction action, int value, int val_l,
+                             int val_r)
+{
+    Action a;
+    a.m_ticks   = ticks;
+    a.m_kart_id = kart_id;
+    a.m_action  = action;
+    a.m_value   = value;
+    a.m_value_l = val_l;
+    a.m_value_r = val_r;
+    const auto& c = compressAction(a);
+    ns->addUInt32(a.m_ticks).addUInt8((uint8_t)a.m_kart_id)
+        .addUInt8(std::get<0>(c)).addUInt16(std::get<1>(c))
+        .addUInt16(std::get<2>(c)).addUInt16(std::get<3>(c));
+}   // addAction
+
 //-----------------------------------------------------------------------------
 /** Called when a message from a remote GameProtocol is received.
  */
@@ -131,6 +171,8 @@ bool GameProtocol::notifyEventAsynchronous(Event* event)
     {
     case GP_CONTROLLER_ACTION: handleControllerAction(event); break;
     case GP_STATE:             handleState(event);            break;
+    case GP_STATE_DELTA:       handleStateDelta(event);       break;
+    case GP_STATE_ACK:         handleStateAck(event);         break;
     case GP_ITEM_CONFIRMATION: handleItemEventConfirmation(event); break;
     case GP_ADJUST_TIME:
     case GP_ITEM_UPDATE:
@@ -166,13 +208,14 @@ void GameProtocol::controllerAction(int kart_id, PlayerAction action,
 
     m_all_actions.push_back(a);
     const auto& c = compressAction(a);
-    // Store the event in the rewind manager, which is responsible
-    // for freeing the allocated memory
-    BareNetworkString *s = new BareNetworkString(4);
-    s->addUInt8(kart_id).addUInt8(std::get<0>(c)).addUInt16(std::get<1>(c))
-        .addUInt16(std::get<2>(c)).addUInt16(std::get<3>(c));
-
-    RewindManager::get()->addEvent(this, s, /*confirmed*/true,
+    // Store the event in the rewind manager, which copies the data
+    m_local_event.getBuffer().clear();
+    m_local_event.reset();
+    m_local_event.addUInt8(kart_id).addUInt8(std::get<0>(c))
+        .addUInt16(std::get<1>(c)).addUInt16(std::get<2>(c))
+        .addUInt16(std::get<3>(c));
+
+    RewindManager::get()->addEvent(this, &m_local_event, /*confirmed*/true,
                                    World::getWorld()->getTicksSinceStart());
 }   // controllerAction
 
@@ -227,10 +270,12 @@ void GameProtocol::handleControllerAction(Event *event)
                 cur_ticks, kart_id, std::get<0>(a), std::get<1>(a),
                 std::get<2>(a), std::get<3>(a));
         }
-        BareNetworkString *s = new BareNetworkString(3);
-        s->addUInt8(kart_id).addUInt8(w).addUInt16(x).addUInt16(y)
-            .addUInt16(z);
-        RewindManager::get()->addNetworkEvent(this, s, cur_ticks);
+        m_network_event.getBuffer().clear();
+        m_network_event.reset();
+        m_network_event.addUInt8(kart_id).addUInt8(w).addUInt16(x)
+            .addUInt16(y).addUInt16(z);
+        RewindManager::get()->addNetworkEvent(this, &m_network_event,
+                                              cur_ticks);
     }
 
     if (data.size() > 0)
@@ -304,38 +349,155 @@ void GameProtocol::addState(BareNetworkString *buffer)
 
 // ----------------------------------------------------------------------------
 /** Called by a server to finalize the current state, which add updated
- *  names of rewinder using to the beginning of state buffer
- *  \param cur_rewinder List of current rewinder using.
+ *  rewinder using to the beginning of state buffer. Rewinders in the
+ *  rewinder table are only sent as id, all others with their name. The
+ *  names of all rewinders are kept for clients which do not support
+ *  rewinder ids.
+ *  \param cur_rewinder List of names of current rewinder using.
+ *  \param rewinder_ids Rewinder id for each name, or -1.
  */
-void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder)
+void GameProtocol::finalizeState(std::vector<std::string>& cur_rewinder,
+                                 std::vector<int>& rewinder_ids)
 {
     assert(NetworkConfig::get()->isServer());
+    assert(cur_rewinder.size() == rewinder_ids.size());
     auto& buffer = m_data_to_send->getBuffer();
-    auto pos = buffer.begin() + 1/*protocol type*/ + 1 /*gp event type*/+
-        4/*time*/;
+    auto pos = buffer.begin() + STATE_HEADER_SIZE;
 
     m_data_to_send->reset();
-    std::vector<uint8_t> names;
-    names.push_back((uint8_t)cur_rewinder.size());
+    // Id 0 means that the name follows, otherwise it is rewinder id + 1
+    BareNetworkString ids;
+    ids.addVarUInt((uint32_t)cur_rewinder.size());
+    for (unsigned i = 0; i < cur_rewinder.size(); i++)
+    {
+        if (rewinder_ids[i] == -1)
+            ids.addVarUInt(0).encodeString(cur_rewinder[i]);
+        else
+            ids.addVarUInt((uint32_t)rewinder_ids[i] + 1);
+    }
+    buffer.insert(pos, ids.getBuffer().begin(), ids.getBuffer().end());
+    m_rewinder_ids_size = ids.getTotalSize();
+
+    m_legacy_names.clear();
+    m_legacy_names.push_back((uint8_t)cur_rewinder.size());
     for (std::string& name : cur_rewinder)
     {
-        names.push_back((uint8_t)name.size());
-        std::vector<uint8_t> rewinder(name.begin(), name.end());
-        names.insert(names.end(), rewinder.begin(), rewinder.end());
+        m_legacy_names.push_back((uint8_t)name.size());
+        m_legacy_names.insert(m_legacy_names.end(), name.begin(), name.end());
     }
-    buffer.insert(pos, names.begin(), names.end());
+    m_legacy_to_send->clear();
 }   // finalizeState
 
 // ----------------------------------------------------------------------------
 /** Called when the last state information has been added and the message
- *  can be sent to the clients.
+ *  can be sent to the clients. Clients which support it get the state
+ *  delta encoded against the latest state they have acknowledged, all other
+ *  clients (or if no acknowledged state is available anymore) get the full
+ *  state as keyframe.
  */
 void GameProtocol::sendState()
 {
     assert(NetworkConfig::get()->isServer());
-    sendMessageToPeers(m_data_to_send, /*reliable*/false);
+    const int ticks = World::getWorld()->getTicksSinceStart();
+    const std::vector<uint8_t>& buffer = m_data_to_send->getBuffer();
+    std::vector<uint8_t> state(buffer.begin() + STATE_HEADER_SIZE,
+                               buffer.end());
+
+    std::unique_lock<std::mutex> ul(m_peer_state_info_mutex);
+    for (auto it = m_peer_state_info.begin(); it != m_peer_state_info.end();)
+    {
+        if (it->first.expired())
+            it = m_peer_state_info.erase(it);
+        else
+            it++;
+    }
+
+    // The messages are sent together, so they can be encrypted in parallel
+    auto peers = STKHost::get()->getPeers();
+    std::vector<std::pair<STKPeer*, NetworkString*> > messages;
+    unsigned num_deltas = 0;
+    for (auto& peer : peers)
+    {
+        if (!peer->isValidated())
+            continue;
+        if (peer->isWaitingForGame())
+        {
+            // The peer will need a new keyframe after joining
+            m_peer_state_info.erase(peer);
+            continue;
+        }
+
+        auto info_it = m_peer_state_info.find(peer);
+        if (info_it == m_peer_state_info.end())
+        {
+            PeerStateInfo info;
+            info.m_acked_ticks = -1;
+            info.m_first_ticks = ticks;
+            info.m_bytes_sent = 0;
+            info.m_full_bytes = 0;
+            info_it = m_peer_state_info.emplace(peer, info).first;
+        }
+        PeerStateInfo& info = info_it->second;
+
+        NetworkString* ns = m_data_to_send;
+        const std::set<std::string>& caps = peer->getClientCapabilities();
+        auto base = m_state_history.find(info.m_acked_ticks);
+        if (caps.find("rewinder_id") == caps.end())
+        {
+            // Old clients need the names of all rewinders in each state
+            if (m_legacy_to_send->size() == 0)
+            {
+                std::vector<uint8_t>& legacy = m_legacy_to_send->getBuffer();
+                legacy.insert(legacy.end(), buffer.begin() + 1,
+                    buffer.begin() + STATE_HEADER_SIZE);
+                legacy.insert(legacy.end(), m_legacy_names.begin(),
+                    m_legacy_names.end());
+                legacy.insert(legacy.end(),
+                    buffer.begin() + STATE_HEADER_SIZE + m_rewinder_ids_size,
+                    buffer.end());
+            }
+            ns = m_legacy_to_send;
+        }
+        else if (base != m_state_history.end() &&
+            caps.find("delta_state") != caps.end())
+        {
+            if (num_deltas == m_deltas_to_send.size())
+                m_deltas_to_send.push_back(getNetworkString());
+            NetworkString* delta = m_deltas_to_send[num_deltas];
+            delta->clear();
+            delta->addUInt8(GP_STATE_DELTA).addUInt32(ticks)
+                .addUInt32(base->first)
+                .encodeDelta(base->second, state.data(),
+                (unsigned)state.size());
+            if (delta->getTotalSize() < m_data_to_send->getTotalSize())
+            {
+                ns = delta;
+                num_deltas++;
+            }
+        }
+        messages.emplace_back(peer.get(), ns);
+        info.m_bytes_sent += ns->getTotalSize();
+        info.m_full_bytes += m_data_to_send->getTotalSize();
+    }
+    ul.unlock();
+    STKHost::get()->sendPackets(messages, /*reliable*/false);
+
+    m_state_history[ticks] = std::move(state);
+    removeOldStates(ticks);
 }   // sendState
 
+// ----------------------------------------------------------------------------
+/** Removes all states from the history which are too old to be used as base
+ *  for delta states.
+ *  \param ticks Time of the latest state.
+ */
+void GameProtocol::removeOldStates(int ticks)
+{
+    const int oldest = ticks - stk_config->time2Ticks(STATE_HISTORY_TIME);
+    m_state_history.erase(m_state_history.begin(),
+        m_state_history.lower_bound(oldest));
+}   // removeOldStates
+
 // ----------------------------------------------------------------------------
 /** Called when a new full state is received form the server.
  */
@@ -345,22 +507,138 @@ void GameProtocol::handleState(Event *event)
         return;
     NetworkString &data = event->data();
     int ticks          = data.getUInt32();
+    addNetworkState(ticks, data);
+}   // handleState
+
+// ----------------------------------------------------------------------------
+/** Called when a delta encoded state is received from the server. The full
+ *  state is rebuilt from the base state it refers to, and then handled like
+ *  a full state.
+ */
+void GameProtocol::handleStateDelta(Event *event)
+{
+    if (!NetworkConfig::get()->isClient())
+        return;
+    NetworkString &data = event->data();
+    int ticks = data.getUInt32();
+    int base_ticks = data.getUInt32();
+    auto base = m_state_history.find(base_ticks);
+    if (base == m_state_history.end())
+    {
+        // Can happen if states arrive very late, the server will send a
+        // keyframe or use a newer base soon.
+        Log::debug("GameProtocol", "Missing base state %d for state %d.",
+            base_ticks, ticks);
+        return;
+    }
+
+    BareNetworkString state;
+    if (!data.decodeDelta(base->second, &state.getBuffer()))
+    {
+        Log::warn("GameProtocol", "Invalid delta state at %d.", ticks);
+        return;
+    }
+    addNetworkState(ticks, state);
+}   // handleStateDelta
+
+// ----------------------------------------------------------------------------
+/** Acknowledges (if the server supports delta states) and stores a full
+ *  state, then passes it to the RewindManager.
+ *  \param ticks Time of the state.
+ *  \param data The full state without header, the memory of its buffer is
+ *         taken over by the RewindInfoState.
+ */
+void GameProtocol::addNetworkState(int ticks, BareNetworkString& data)
+{
+    const std::set<std::string>& caps =
+        NetworkConfig::get()->getServerCapabilities();
+    if (caps.find("delta_state") != caps.end())
+    {
+        m_state_history[ticks] = std::vector<uint8_t>(
+            data.getBuffer().begin() + data.getCurrentOffset(),
+            data.getBuffer().end());
+        if (m_state_history.rbegin()->first == ticks)
+            removeOldStates(ticks);
+
+        NetworkString *ns = getNetworkString(5);
+        ns->addUInt8(GP_STATE_ACK).addUInt32(ticks);
+        sendToServer(ns, /*reliable*/false);
+        delete ns;
+    }
 
     // Check for updated rewinder using
-    unsigned rewinder_size = data.getUInt8();
-    std::vector<std::string> rewinder_using;
-    for (unsigned i = 0; i < rewinder_size; i++)
+    std::vector<RewinderUsing> rewinder_using;
+    if (caps.find("rewinder_id") != caps.end())
     {
-        std::string name;
-        data.decodeString(&name);
-        rewinder_using.push_back(name);
+        unsigned rewinder_size = data.getVarUInt();
+        for (unsigned i = 0; i < rewinder_size; i++)
+        {
+            unsigned id = data.getVarUInt();
+            if (id == 0)
+            {
+                std::string name;
+                data.decodeString(&name);
+                rewinder_using.emplace_back(-1, name);
+            }
+            else
+                rewinder_using.emplace_back((int)id - 1);
+        }
+    }
+    else
+    {
+        unsigned rewinder_size = data.getUInt8();
+        for (unsigned i = 0; i < rewinder_size; i++)
+        {
+            std::string name;
+            data.decodeString(&name);
+            rewinder_using.emplace_back(-1, name);
+        }
     }
 
-    // The memory for bns will be handled in the RewindInfoState object
-    RewindInfoState* ris = new RewindInfoState(ticks, data.getCurrentOffset(),
+    // The buffer is swapped into the RewindInfoState object
+    RewindManager::get()->addNetworkState(ticks, data.getCurrentOffset(),
         rewinder_using, data.getBuffer());
-    RewindManager::get()->addNetworkRewindInfo(ris);
-}   // handleState
+}   // addNetworkState
+
+// ----------------------------------------------------------------------------
+/** Handles a state acknowledgement from a client, the acknowledged state
+ *  can be used as base for the next delta state sent to this client.
+ *  \param event The data from the client.
+ */
+void GameProtocol::handleStateAck(Event *event)
+{
+    if (!NetworkConfig::get()->isServer())
+        return;
+    int ticks = event->data().getUInt32();
+    std::lock_guard<std::mutex> lock(m_peer_state_info_mutex);
+    auto it = m_peer_state_info.find(event->getPeerSP());
+    if (it != m_peer_state_info.end() && ticks > it->second.m_acked_ticks)
+        it->second.m_acked_ticks = ticks;
+}   // handleStateAck
+
+// ----------------------------------------------------------------------------
+/** Logs the state upload rate for each peer, and the rate which would have
+ *  been needed without delta states.
+ */
+void GameProtocol::logStateBandwidth()
+{
+    if (m_state_history.empty())
+        return;
+    const int last_ticks = m_state_history.rbegin()->first;
+    std::lock_guard<std::mutex> lock(m_peer_state_info_mutex);
+    for (auto& p : m_peer_state_info)
+    {
+        auto peer = p.first.lock();
+        const PeerStateInfo& info = p.second;
+        float time = stk_config->ticks2Time(last_ticks - info.m_first_ticks);
+        if (!peer || time <= 0.0f)
+            continue;
+        Log::info("GameProtocol",
+            "State upload to %s: %.1f bytes/s (%.1f bytes/s without delta).",
+            peer->getAddress().toString().c_str(),
+            (float)info.m_bytes_sent / time, (float)info.m_full_bytes / time);
+    }
+}   // logStateBandwidth
 
 // ----------------------------------------------------------------------------
 /** Called from the RewindManager when rolling back.
@@ -391,6 +669,14 @@ void GameProtocol::rewind(BareNetworkString *buffer)
     {
         pc->actionFromNetwork(std::get<0>(a), std::get<1>(a), std::get<2>(a),
             std::get<3>(a));
+        // The server has no local player, so record the actions of the
+        // clients to be able to replay the race.
+        if (NetworkConfig::get()->isServer() &&
+            STKProcess::getType() == PT_MAIN && !history->replayHistory())
+        {
+            history->addNetworkEvent(kart_id, std::get<0>(a), std::get<1>(a),
+                                     std::get<2>(a), std::get<3>(a));
+        }
     }
 }   // rewind
 
@@ -20,6 +20,7 @@
 #define GAME_PROTOCOL_HPP
 
 #include "network/event_rewinder.hpp"
+#include "network/network_string.hpp"
 #include "network/protocol.hpp"
 
 #include "input/input.hpp"                // for PlayerAction
@@ -27,11 +28,12 @@
 #include "utils/stk_process.hpp"
 
 #include <cstdlib>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <tuple>
 
-class BareNetworkString;
 class NetworkItemManager;
 class NetworkString;
 class STKPeer;
@@ -39,23 +41,63 @@ class STKPeer;
 class GameProtocol : public Protocol
                    , public EventRewinder
 {
-private:
-    /* Used to check if deleting world is doing at the same the for
-     * asynchronous event update. */
-    mutable std::mutex m_world_deleting_mutex;
-
+public:
     /** The type of game events to be forwarded to the server. */
     enum { GP_CONTROLLER_ACTION,
            GP_STATE,
            GP_ITEM_UPDATE,
            GP_ITEM_CONFIRMATION,
-           GP_ADJUST_TIME
+           GP_ADJUST_TIME,
+           GP_STATE_DELTA,
+           GP_STATE_ACK
     };
 
+private:
+    /* Used to check if deleting world is doing at the same the for
+     * asynchronous event update. */
+    mutable std::mutex m_world_deleting_mutex;
+
     /** A network string that collects all information from the server to be sent
      *  next. */
     NetworkString *m_data_to_send;
 
+    /** Server only: the delta encoded states for the peers, which are all
+     *  sent at the end of sendState. The strings are reused for each state. */
+    std::vector<NetworkString*> m_deltas_to_send;
+
+    /** Server only: the state with rewinder names instead of rewinder ids,
+     *  for clients without rewinder id support. */
+    NetworkString *m_legacy_to_send;
+
+    /** Server only: the rewinder names header of the current state. */
+    std::vector<uint8_t> m_legacy_names;
+
+    /** Server only: size of the rewinder ids header of the current state. */
+    unsigned m_rewinder_ids_size;
+
+    /** Server: the full states sent recently, indexed by ticks, which can be
+     *  used as base for delta states. Client: the full states received
+     *  recently, which are needed to rebuild delta states. */
+    std::map<int, std::vector<uint8_t> > m_state_history;
+
+    /** Server only: per peer information about delta states. */
+    struct PeerStateInfo
+    {
+        /** Ticks of the latest state acknowledged by the peer, or -1. */
+        int m_acked_ticks;
+        /** Ticks when the first state was sent to the peer. */
+        int m_first_ticks;
+        /** Number of state bytes sent to the peer. */
+        uint64_t m_bytes_sent;
+        /** Number of bytes which would have been sent without delta. */
+        uint64_t m_full_bytes;
+    };
+    std::map<std::weak_ptr<STKPeer>, PeerStateInfo,
+        std::owner_less<std::weak_ptr<STKPeer> > > m_peer_state_info;
+
+    /** Acknowledgements are received in the network thread. */
+    std::mutex m_peer_state_info_mutex;
+
     /** The server might request that the world clock of a client is adjusted
      *  to reduce number of rollbacks. */
     std::vector<int8_t> m_adjust_time;
@@ -74,14 +116,23 @@ private:
     // List of all kart actions to send to the server
     std::vector<Action> m_all_actions;
 
+    /** Reused buffers for events added to the rewind manager from the main
+     *  thread (local actions) and from the network thread. */
+    BareNetworkString m_local_event;
+    BareNetworkString m_network_event;
+
     void handleControllerAction(Event *event);
     void handleState(Event *event);
+    void handleStateDelta(Event *event);
+    void handleStateAck(Event *event);
+    void addNetworkState(int ticks, BareNetworkString& data);
+    void removeOldStates(int ticks);
     void handleAdjustTime(Event *event);
     void handleItemEventConfirmation(Event *event);
     static std::weak_ptr<GameProtocol> m_game_protocol[PT_COUNT];
     NetworkItemManager* m_network_item_manager;
     // Maximum value of values are only 32768
-    std::tuple<uint8_t, uint16_t, uint16_t, uint16_t>
+    static std::tuple<uint8_t, uint16_t, uint16_t, uint16_t>
                                                 compressAction(const Action& a)
     {
         uint8_t w = (uint8_t)(a.m_action & 63) |
@@ -109,13 +160,18 @@ public:
     virtual bool notifyEventAsynchronous(Event* event) OVERRIDE;
     virtual void update(int ticks) OVERRIDE;
     void sendActions();
+    static void addAction(BareNetworkString* ns, int ticks, int kart_id,
+                          PlayerAction action, int value, int val_l,
+                          int val_r);
     void controllerAction(int kart_id, PlayerAction action,
                           int value, int val_l, int val_r);
     void startNewState();
     void addState(BareNetworkString *buffer);
     void sendState();
-    void finalizeState(std::vector<std::string>& cur_rewinder);
+    void finalizeState(std::vector<std::string>& cur_rewinder,
+                       std::vector<int>& rewinder_ids);
     void sendItemEventConfirmation(int ticks);
+    void logStateBandwidth();
 
     virtual void undo(BareNetworkString *buffer) OVERRIDE;
     virtual void rewind(BareNetworkString *buffer) OVERRIDE;
@@ -43,6 +43,7 @@
 #include "network/protocols/game_events_protocol.hpp"
 #include "network/protocols/ranking.hpp"
 #include "network/race_event_manager.hpp"
+#include "network/rewind_manager.hpp"
 #include "network/server_config.hpp"
 #include "network/socket_address.hpp"
 #include "network/stk_host.hpp"
@@ -205,7 +206,9 @@ ServerLobby::~ServerLobby()
     }
     delete m_result_ns;
     delete m_items_complete_state;
-    if (m_save_server_config)
+    // A room file only lists the values which differ from the main config,
+    // writing all values back would stop later main changes reaching it
+    if (m_save_server_config && !STKProcess::isRoom(m_process_type))
         ServerConfig::writeServerConfigToDisk();
     delete m_default_vote;
 
@@ -363,6 +366,22 @@ void ServerLobby::updateTracksForMode()
             break;
     }
 
+    // Rooms have no script engine, so scripted tracks would behave
+    // differently than on a normal server
+    if (STKProcess::isRoom(m_process_type))
+    {
+        auto it = m_available_kts.second.begin();
+        while (it != m_available_kts.second.end())
+        {
+            Track* t =  track_manager->getTrack(*it);
+            if (t->usesScripting())
+            {
+                it = m_available_kts.second.erase(it);
+            }
+            else
+                it++;
+        }
+    }
 }   // updateTracksForMode
 
 //-----------------------------------------------------------------------------
@@ -643,7 +662,8 @@ bool ServerLobby::notifyEventAsynchronous(Event* event)
 /* Every 1 minute STK will poll database:
  * 1. Set disconnected time to now for non-exists host.
  * 2. Clear expired player reports if necessary
- * 3. Kick active peer from ban list
+ * 3. Reload the ban lists if the database was changed and kick active
+ *    peers which are banned
  */
 void ServerLobby::pollDatabase()
 {
@@ -654,13 +674,7 @@ void ServerLobby::pollDatabase()
         return;
 
     m_db_connector->updatePollTime();
-
-    std::vector<DatabaseConnector::IpBanTableData> ip_ban_list =
-            m_db_connector->getIpBanTableData();
-    std::vector<DatabaseConnector::Ipv6BanTableData> ipv6_ban_list =
-            m_db_connector->getIpv6BanTableData();
-    std::vector<DatabaseConnector::OnlineIdBanTableData> online_id_ban_list =
-            m_db_connector->getOnlineIdBanTableData();
+    m_db_connector->updateBanIndex();
 
     for (std::shared_ptr<STKPeer>& p : STKHost::get()->getPeers())
     {
@@ -676,44 +690,43 @@ void ServerLobby::pollDatabase()
             address = p->getAddress().toString(false);
             if (address.empty())
                 continue;
-            for (auto& item: ipv6_ban_list)
+            std::vector<DatabaseConnector::Ipv6BanTableData> ipv6_ban_list =
+                m_db_connector->getIpv6BanTableData(address);
+            if (!ipv6_ban_list.empty())
             {
-                if (insideIPv6CIDR(item.ipv6_cidr.c_str(), address.c_str()) == 1)
-                {
-                    is_kicked = true;
-                    reason = item.reason;
-                    description = item.description;
-                    break;
-                }
+                is_kicked = true;
+                reason = ipv6_ban_list[0].reason;
+                description = ipv6_ban_list[0].description;
             }
         }
         else
         {
-            uint32_t peer_addr = p->getAddress().getIP();
             address = p->getAddress().toString();
-            for (auto& item: ip_ban_list)
+            std::vector<DatabaseConnector::IpBanTableData> ip_ban_list =
+                m_db_connector->getIpBanTableData(p->getAddress().getIP());
+            if (!ip_ban_list.empty())
             {
-                if (item.ip_start <= peer_addr && item.ip_end >= peer_addr)
-                {
-                    is_kicked = true;
-                    reason = item.reason;
-                    description = item.description;
-                    break;
-                }
+                is_kicked = true;
+                reason = ip_ban_list[0].reason;
+                description = ip_ban_list[0].description;
             }
         }
         if (!is_kicked && !p->getPlayerProfiles().empty())
         {
             uint32_t online_id = p->getPlayerProfiles()[0]->getOnlineId();
-            for (auto& item: online_id_ban_list)
+            std::vector<DatabaseConnector::OnlineIdBanTableData>
+                online_id_ban_list;
+            // Zero would return the whole table
+            if (online_id != 0)
             {
-                if (item.online_id == online_id)
-                {
-                    is_kicked = true;
-                    reason = item.reason;
-                    description = item.description;
-                    break;
-                }
+                online_id_ban_list =
+                    m_db_connector->getOnlineIdBanTableData(online_id);
+            }
+            if (!online_id_ban_list.empty())
+            {
+                is_kicked = true;
+                reason = online_id_ban_list[0].reason;
+                description = online_id_ban_list[0].description;
             }
         }
         if (is_kicked)
@@ -1481,6 +1494,9 @@ void ServerLobby::finishedLoadingLiveJoinClient(Event* event)
         for (unsigned i = 0; i < players.size(); i++)
             players[i]->getKartData().encode(ns);
     }
+    if (peer->getClientCapabilities().find("rewinder_id") !=
+        peer->getClientCapabilities().end())
+        RewindManager::get()->encodeRewinderTable(ns);
 
     m_peers_ready[peer] = false;
     peer->setWaitingForGame(false);
@@ -3124,7 +3140,7 @@ void ServerLobby::updateServerOwner()
         // Only matching host id can be server owner in case of
         // graphics-client-server
         if (peer->isValidated() && !peer->isAIPeer() &&
-            (m_process_type == PT_MAIN ||
+            (m_process_type != PT_CHILD ||
             peer->getHostId() == m_client_server_host_id.load()))
         {
             owner = peer;
@@ -3678,6 +3694,9 @@ void ServerLobby::configPeersStartTime()
     const uint8_t cc = (uint8_t)Track::getCurrentTrack()->getCheckManager()->getCheckStructureCount();
     ns->addUInt8(cc);
     *ns += *m_items_complete_state;
+    // Clients without rewinder id support ignore the table
+    RewindManager::get()->createRewinderTable();
+    RewindManager::get()->encodeRewinderTable(ns);
     m_client_starting_time = start_time;
     sendMessageToPeers(ns, /*reliable*/true);
 
@@ -21,6 +21,7 @@
 #include "network/network_config.hpp"
 #include "network/rewinder.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/rewind_profiler.hpp"
 #include "items/projectile_manager.hpp"
 #include "utils/log.hpp"
 
@@ -48,7 +49,7 @@ void RewindInfo::setTicks(int ticks)
 
 // ============================================================================
 RewindInfoState::RewindInfoState(int ticks, int start_offset,
-                                 std::vector<std::string>& rewinder_using,
+                                 std::vector<RewinderUsing>& rewinder_using,
                                  std::vector<uint8_t>& buffer)
                : RewindInfo(ticks, true/*is_confirmed*/)
 {
@@ -58,6 +59,23 @@ RewindInfoState::RewindInfoState(int ticks, int start_offset,
     std::swap(m_buffer->getBuffer(), buffer);
 }   // RewindInfoState
 
+// ------------------------------------------------------------------------
+/** Sets the data of this state, used when a RewindInfoState is reused. The
+ *  vectors are swapped, so the caller gets the previous memory back.
+ */
+void RewindInfoState::set(int ticks, int start_offset,
+                          std::vector<RewinderUsing>& rewinder_using,
+                          std::vector<uint8_t>& buffer)
+{
+    reinit(ticks, true/*is_confirmed*/);
+    std::swap(m_rewinder_using, rewinder_using);
+    m_start_offset = start_offset;
+    if (!m_buffer)
+        m_buffer = new BareNetworkString();
+    m_buffer->reset();
+    std::swap(m_buffer->getBuffer(), buffer);
+}   // set
+
 // ------------------------------------------------------------------------
 /** Constructor used only in unit testing (without list of rewinder using).
  */
@@ -78,14 +96,22 @@ void RewindInfoState::restore()
 {
     m_buffer->reset();
     m_buffer->skip(m_start_offset);
-    for (const std::string& name : m_rewinder_using)
+    for (const RewinderUsing& ru : m_rewinder_using)
     {
         const uint16_t data_size = m_buffer->getUInt16();
         const unsigned current_offset_now = m_buffer->getCurrentOffset();
-        std::shared_ptr<Rewinder> r =
-            RewindManager::get()->getRewinder(name);
+        std::shared_ptr<Rewinder> r;
+        std::string name = ru.m_name;
+        if (ru.m_id != -1)
+        {
+            r = RewindManager::get()->getRewinder(ru.m_id);
+            if (!r)
+                name = RewindManager::get()->getRewinderTableName(ru.m_id);
+        }
+        else
+            r = RewindManager::get()->getRewinder(name);
 
-        if (!r)
+        if (!r && ru.m_id == -1)
         {
             // For now we only need to get missing rewinder from
             // projectile_manager
@@ -122,15 +148,37 @@ void RewindInfoState::restore()
             m_buffer->reset();
             m_buffer->skip(current_offset_now + data_size);
         }
+        if (RewindProfiler* rp = RewindProfiler::get())
+            rp->checkPrediction(getTicks(), *r);
     }   // for all rewinder
 }   // restore
 
 // ============================================================================
 RewindInfoEvent::RewindInfoEvent(int ticks, EventRewinder *event_rewinder,
-                                 BareNetworkString *buffer, bool is_confirmed)
+                                 const BareNetworkString *buffer,
+                                 bool is_confirmed)
                : RewindInfo(ticks, is_confirmed)
 {
-    m_event_rewinder = event_rewinder;
-    m_buffer         = buffer;
+    set(ticks, event_rewinder, buffer, is_confirmed);
 }   // RewindInfoEvent
 
+// ------------------------------------------------------------------------
+/** Sets the data of this event, used when a RewindInfoEvent is reused. The
+ *  unread content of buffer is copied, so no allocation takes place if the
+ *  previous event had at least the same size.
+ *  \param buffer The event data, can be NULL in unit testing.
+ */
+void RewindInfoEvent::set(int ticks, EventRewinder *event_rewinder,
+                          const BareNetworkString *buffer, bool is_confirmed)
+{
+    reinit(ticks, is_confirmed);
+    m_event_rewinder = event_rewinder;
+    std::vector<uint8_t>& data = m_buffer.getBuffer();
+    data.clear();
+    m_buffer.reset();
+    if (buffer)
+    {
+        const uint8_t* start = (const uint8_t*)buffer->getCurrentData();
+        data.insert(data.end(), start, start + buffer->size());
+    }
+}   // set
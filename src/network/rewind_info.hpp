@@ -54,6 +54,15 @@ private:
      *  object.  */
     bool m_is_confirmed;
 
+protected:
+    // ------------------------------------------------------------------------
+    /** Used when a RewindInfo is reused by the RewindQueue. */
+    void reinit(int ticks, bool is_confirmed)
+    {
+        m_ticks = ticks;
+        m_is_confirmed = is_confirmed;
+    }   // reinit
+
 public:
     RewindInfo(int ticks, bool is_confirmed);
 
@@ -86,13 +95,26 @@ public:
     // ------------------------------------------------------------------------
 };   // RewindInfo
 
+// ============================================================================
+/** Identifies a rewinder in a network state: either by its index in the
+ *  rewinder table of the RewindManager, or (if the id is -1) by its unique
+ *  identity.
+ */
+struct RewinderUsing
+{
+    int m_id;
+    std::string m_name;
+    RewinderUsing(int id, const std::string& name = "")
+                                             : m_id(id), m_name(name) {}
+};   // RewinderUsing
+
 // ============================================================================
 /** A class that stores a game state and can rewind it.
  */
 class RewindInfoState: public RewindInfo
 {
 private:
-    std::vector<std::string> m_rewinder_using;
+    std::vector<RewinderUsing> m_rewinder_using;
 
     int m_start_offset;
 
@@ -102,13 +124,17 @@ private:
 public:
     // ------------------------------------------------------------------------
     RewindInfoState(int ticks, int start_offset,
-                    std::vector<std::string>& rewinder_using,
+                    std::vector<RewinderUsing>& rewinder_using,
                     std::vector<uint8_t>& buffer);
     // ------------------------------------------------------------------------
     RewindInfoState(int ticks, BareNetworkString *buffer, bool is_confirmed);
     // ------------------------------------------------------------------------
     virtual ~RewindInfoState()                             { delete m_buffer; }
     // ------------------------------------------------------------------------
+    void set(int ticks, int start_offset,
+             std::vector<RewinderUsing>& rewinder_using,
+             std::vector<uint8_t>& buffer);
+    // ------------------------------------------------------------------------
     virtual void restore();
     // ------------------------------------------------------------------------
     /** Returns a pointer to the state buffer. */
@@ -138,16 +164,16 @@ private:
     /** Pointer to the event rewinder responsible for this event. */
     EventRewinder *m_event_rewinder;
 
-    /** Buffer with the event data. */
-    BareNetworkString *m_buffer;
+    /** Buffer with the event data. It is owned by this object, so its memory
+     *  is kept when the RewindQueue reuses this RewindInfoEvent. */
+    BareNetworkString m_buffer;
 public:
              RewindInfoEvent(int ticks, EventRewinder *event_rewinder,
-                             BareNetworkString *buffer, bool is_confirmed);
-    virtual ~RewindInfoEvent()
-    {
-        delete m_buffer;
-    }   // ~RewindInfoEvent
-
+                             const BareNetworkString *buffer,
+                             bool is_confirmed);
+    // ------------------------------------------------------------------------
+    void set(int ticks, EventRewinder *event_rewinder,
+             const BareNetworkString *buffer, bool is_confirmed);
     // ------------------------------------------------------------------------
     /** An event is never 'restored', it is only rewound. */
     void restore() {}
@@ -158,8 +184,8 @@ public:
      *  It calls undoEvent in the rewinder. */
     virtual void undo()
     {
-        m_buffer->reset();
-        m_event_rewinder->undo(m_buffer);
+        m_buffer.reset();
+        m_event_rewinder->undo(&m_buffer);
     }   // undo
     // ------------------------------------------------------------------------
     /** This is called while going forwards in time again to reach current
@@ -168,12 +194,12 @@ public:
     virtual void replay()
     {
         // Make sure to reset the buffer so we read from the beginning
-        m_buffer->reset();
-        m_event_rewinder->rewind(m_buffer);
+        m_buffer.reset();
+        m_event_rewinder->rewind(&m_buffer);
     }   // rewind
     // ------------------------------------------------------------------------
     /** Returns the buffer with the event information in it. */
-    BareNetworkString *getBuffer() { return m_buffer; }
+    BareNetworkString *getBuffer() { return &m_buffer; }
 };   // class RewindIndoEvent
 
 
@@ -25,6 +25,7 @@
 #include "network/protocols/game_protocol.hpp"
 #include "network/rewinder.hpp"
 #include "network/rewind_info.hpp"
+#include "network/rewind_profiler.hpp"
 #include "network/smooth_network_body.hpp"
 #include "physics/physics.hpp"
 #include "race/history.hpp"
@@ -34,6 +35,7 @@
 #include "tracks/track_object_manager.hpp"
 #include "utils/log.hpp"
 #include "utils/profiler.hpp"
+#include "utils/time.hpp"
 
 #include <algorithm>
 
@@ -89,28 +91,32 @@ void RewindManager::reset()
     m_overall_state_size = 0;
     m_state_frequency = stk_config->getPhysicsFPS() /
         NetworkConfig::get()->getStateFrequency();
+    // The rewinder ids are assigned again for each race
+    m_rewinder_table.clear();
+    m_rewinder_table_names.clear();
 
     if (!m_enable_rewind_manager) return;
 
     clearExpiredRewinder();
     m_rewind_queue.reset();
     m_missing_rewinders.clear();
+    // Only a client rewinds, the profiler then starts with the new race
+    if (RewindProfiler::get() && NetworkConfig::get()->isClient())
+        RewindProfiler::get()->reset();
 }   // reset
 
 // ----------------------------------------------------------------------------    
-/** Adds an event to the rewind data. The data to be stored must be allocated
- *  and not freed by the caller!
+/** Adds an event to the rewind data. The data in buffer is copied.
  *  \param time Time at which the event was recorded. If time is not specified
  *          (or set to -1), the current world time is used.
  *  \param buffer Pointer to the event data.
  */
 void RewindManager::addEvent(EventRewinder *event_rewinder,
-                             BareNetworkString *buffer, bool confirmed,
+                             const BareNetworkString *buffer, bool confirmed,
                              int ticks)
 {
     if (m_is_rewinding)
     {
-        delete buffer;
         Log::error("RewindManager", "Adding event when rewinding");
         return;
     }
@@ -123,13 +129,13 @@ void RewindManager::addEvent(EventRewinder *event_rewinder,
 // ----------------------------------------------------------------------------
 /** Adds an event to the list of network rewind data. This function is
  *  threadsafe so can be called by the network thread. The data is synched
- *  to m_rewind_info by the main thread. The data to be stored must be
- *  allocated and not freed by the caller!
+ *  to m_rewind_info by the main thread. The data in buffer is copied.
  *  \param time Time at which the event was recorded.
  *  \param buffer Pointer to the event data.
  */
 void RewindManager::addNetworkEvent(EventRewinder *event_rewinder,
-                                     BareNetworkString *buffer, int ticks)
+                                     const BareNetworkString *buffer,
+                                     int ticks)
 {
     m_rewind_queue.addNetworkEvent(event_rewinder, buffer, ticks);
 }   // addNetworkEvent
@@ -161,23 +167,34 @@ void RewindManager::saveState()
     gp->startNewState();
 
     m_overall_state_size = 0;
-    std::vector<std::string> rewinder_using;
+    m_state_rewinder_using.clear();
+    m_state_rewinder_ids.clear();
+    // Some of the states are also used as snapshots in the history
+    const bool snapshot =
+        history->isSnapshotDue(World::getWorld()->getTicksSinceStart());
 
     for (auto& p : m_all_rewinder)
     {
-        // TODO: check if it's worth passing in a sufficiently large buffer from
-        // GameProtocol - this would save the copy operation.
-        BareNetworkString* buffer = NULL;
-        if (auto r = p.second.lock())
-            buffer = r->saveState(&rewinder_using);
-        if (buffer != NULL)
-        {
-            m_overall_state_size += buffer->size();
-            gp->addState(buffer);
-        }
-        delete buffer;    // buffer can be freed
+        auto r = p.second.lock();
+        if (!r)
+            continue;
+        // The buffer keeps its capacity, so it only grows till it fits the
+        // largest state of a rewinder
+        m_state_buffer.getBuffer().clear();
+        m_state_buffer.reset();
+        if (!r->saveState(&m_state_buffer, &m_state_rewinder_using))
+            continue;
+        // Rewinders add their unique identity if they saved a state
+        if (m_state_rewinder_using.size() > m_state_rewinder_ids.size())
+            m_state_rewinder_ids.push_back(r->getRewinderId());
+        m_overall_state_size += m_state_buffer.size();
+        if (snapshot)
+            history->addSnapshotState(p.first, m_state_buffer);
+        gp->addState(&m_state_buffer);
     }
-    gp->finalizeState(rewinder_using);
+    gp->finalizeState(m_state_rewinder_using, m_state_rewinder_ids);
+    if (snapshot)
+        history->finishSnapshot();
     PROFILER_POP_CPU_MARKER();
 }   // saveState
 
@@ -205,10 +222,15 @@ void RewindManager::update(int ticks_not_used)
     if (NetworkConfig::get()->isClient())
     {
         auto& ret = m_local_state[ticks];
+        RewindProfiler* rp = RewindProfiler::get();
         for (auto& p : m_all_rewinder)
         {
             if (auto r = p.second.lock())
+            {
                 ret.push_back(r->getLocalStateRestoreFunction());
+                if (rp)
+                    rp->savePrediction(ticks, *r);
+            }
         }
     }
     else
@@ -280,6 +302,69 @@ bool RewindManager::addRewinder(std::shared_ptr<Rewinder> rewinder)
     return true;
 }   // addRewinder
 
+// ----------------------------------------------------------------------------
+/** Called by the server when the race starts: assigns a rewinder id to all
+ *  current rewinders. The ids follow the order of m_all_rewinder, so states
+ *  are still restored in the same order.
+ */
+void RewindManager::createRewinderTable()
+{
+    clearExpiredRewinder();
+    m_rewinder_table.clear();
+    m_rewinder_table_names.clear();
+    for (auto& p : m_all_rewinder)
+    {
+        auto r = p.second.lock();
+        r->setRewinderId((int)m_rewinder_table.size());
+        m_rewinder_table.push_back(r);
+        m_rewinder_table_names.push_back(p.first);
+    }
+}   // createRewinderTable
+
+// ----------------------------------------------------------------------------
+/** Adds the names of all rewinders in the rewinder table, so that clients
+ *  can map rewinder ids in states to their own rewinders.
+ */
+void RewindManager::encodeRewinderTable(BareNetworkString* ns) const
+{
+    ns->addVarUInt((uint32_t)m_rewinder_table_names.size());
+    for (const std::string& name : m_rewinder_table_names)
+        ns->encodeString(name);
+}   // encodeRewinderTable
+
+// ----------------------------------------------------------------------------
+/** Called by the client with the rewinder table from the server. Rewinders
+ *  which do not exist on this client are kept as empty entries, restoring
+ *  a state for them will report a missing rewinder.
+ */
+void RewindManager::decodeRewinderTable(const BareNetworkString& ns)
+{
+    unsigned count = ns.getVarUInt();
+    m_rewinder_table.clear();
+    m_rewinder_table_names.clear();
+    for (unsigned i = 0; i < count; i++)
+    {
+        std::string name;
+        ns.decodeString(&name);
+        std::shared_ptr<Rewinder> r = getRewinder(name);
+        if (r)
+            r->setRewinderId((int)i);
+        m_rewinder_table.push_back(r);
+        m_rewinder_table_names.push_back(name);
+    }
+}   // decodeRewinderTable
+
+// ----------------------------------------------------------------------------
+/** Returns the unique identity of the rewinder with the given id, used for
+ *  logging missing rewinders.
+ */
+std::string RewindManager::getRewinderTableName(int id) const
+{
+    if (id < 0 || id >= (int)m_rewinder_table_names.size())
+        return std::string("#") + std::to_string(id);
+    return m_rewinder_table_names[id];
+}   // getRewinderTableName
+
 // ----------------------------------------------------------------------------
 /** Rewinds to the specified time, then goes forward till the current
  *  World::getTime() is reached again: it will replay everything before
@@ -295,6 +380,7 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
                              bool fast_forward)
 {
     assert(!m_is_rewinding);
+    const double start_time = StkTime::getRealTime();
     bool is_history = history->replayHistory();
     history->setReplayHistory(false);
 
@@ -324,6 +410,9 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
     // on having the access to the 'confirmed' state time using 
     // the world timer.
     world->setTicksForRewind(exact_rewind_ticks);
+    // The karts are moved to the restored positions, and projectiles
+    // created for the state query the index of the current positions
+    world->invalidateProximityIndex();
 
     // Get the (first) full state to which we have to rewind
     RewindInfo *current = m_rewind_queue.getCurrent();
@@ -402,6 +491,26 @@ void RewindManager::rewindTo(int rewind_ticks, int now_ticks,
             r->computeError();
     }
 
+    if (RewindProfiler* rp = RewindProfiler::get())
+    {
+        // The rewinder whose confirmed state differed most from the
+        // prediction of this client caused the misprediction
+        std::string mismatch_rewinder;
+        const float error = rp->takeMismatch(exact_rewind_ticks,
+                                             &mismatch_rewinder);
+        RewindProfiler::RewindRecord record;
+        record.m_ticks = now_ticks;
+        record.m_rewind_ticks = exact_rewind_ticks;
+        record.m_replayed_ticks =
+            fast_forward ? 0 : now_ticks - exact_rewind_ticks;
+        record.m_time_ms =
+            (float)((StkTime::getRealTime() - start_time) * 1000.0);
+        record.m_error = error;
+        record.m_rewinder =
+            RewindProfiler::getReadableName(mismatch_rewinder);
+        rp->addRewind(record);
+    }
+
     history->setReplayHistory(is_history);
     m_is_rewinding = false;
     mergeRewindInfoEventFunction();
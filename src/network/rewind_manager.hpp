@@ -19,6 +19,7 @@
 #ifndef HEADER_REWIND_MANAGER_HPP
 #define HEADER_REWIND_MANAGER_HPP
 
+#include "network/network_string.hpp"
 #include "network/rewind_queue.hpp"
 #include "utils/stk_process.hpp"
 
@@ -96,12 +97,29 @@ private:
     /** A list of all objects that can be rewound. */
     std::map<std::string, std::weak_ptr<Rewinder> > m_all_rewinder;
 
+    /** All rewinders which exist when the race starts, indexed by their
+     *  rewinder id. The server sends the names once to the clients, so
+     *  states only need the (much smaller) id, and the client can find the
+     *  rewinder without a string lookup. */
+    std::vector<std::weak_ptr<Rewinder> > m_rewinder_table;
+
+    /** The unique identity of each rewinder in m_rewinder_table. */
+    std::vector<std::string> m_rewinder_table_names;
+
     /** The queue that stores all rewind infos. */
     RewindQueue m_rewind_queue;
 
     /** Overall amount of memory allocated by states. */
     unsigned int m_overall_state_size;
 
+    /** The buffer each rewinder writes its state to, and the identities
+     *  and ids of the rewinders in the current state. They are reused for
+     *  all states, so saving a state does not allocate memory once they
+     *  are large enough. */
+    BareNetworkString m_state_buffer;
+    std::vector<std::string> m_state_rewinder_using;
+    std::vector<int> m_state_rewinder_ids;
+
     /** Indicates if currently a rewind is happening. */
     bool m_is_rewinding;
 
@@ -170,10 +188,11 @@ public:
     void update(int ticks);
     void rewindTo(int target_ticks, int ticks_now, bool fast_forward);
     void playEventsTill(int world_ticks, bool fast_forward);
-    void addEvent(EventRewinder *event_rewinder, BareNetworkString *buffer,
-                  bool confirmed, int ticks = -1);
+    void addEvent(EventRewinder *event_rewinder,
+                  const BareNetworkString *buffer, bool confirmed,
+                  int ticks = -1);
     void addNetworkEvent(EventRewinder *event_rewinder,
-                         BareNetworkString *buffer, int ticks);
+                         const BareNetworkString *buffer, int ticks);
     void addNetworkState(BareNetworkString *buffer, int ticks);
     void saveState();
     // ------------------------------------------------------------------------
@@ -188,6 +207,23 @@ public:
         return nullptr;
     }
     // ------------------------------------------------------------------------
+    /** Returns the rewinder with the given rewinder id, or nullptr if it
+     *  does not exist (anymore). */
+    std::shared_ptr<Rewinder> getRewinder(int id)
+    {
+        if (id < 0 || id >= (int)m_rewinder_table.size())
+            return nullptr;
+        return m_rewinder_table[id].lock();
+    }
+    // ------------------------------------------------------------------------
+    std::string getRewinderTableName(int id) const;
+    // ------------------------------------------------------------------------
+    void createRewinderTable();
+    // ------------------------------------------------------------------------
+    void encodeRewinderTable(BareNetworkString* ns) const;
+    // ------------------------------------------------------------------------
+    void decodeRewinderTable(const BareNetworkString& ns);
+    // ------------------------------------------------------------------------
     bool addRewinder(std::shared_ptr<Rewinder> rewinder);
     // ------------------------------------------------------------------------
     /** Returns true if currently a rewind is happening. */
@@ -210,8 +246,13 @@ public:
     void addRewindInfoEventFunction(RewindInfoEventFunction* rief)
                                             { m_pending_rief.push_back(rief); }
     // ------------------------------------------------------------------------
-    void addNetworkRewindInfo(RewindInfo* ri)
-                                   { m_rewind_queue.addNetworkRewindInfo(ri); }
+    void addNetworkState(int ticks, int start_offset,
+                         std::vector<RewinderUsing>& rewinder_using,
+                         std::vector<uint8_t>& buffer)
+    {
+        m_rewind_queue.addNetworkState(ticks, start_offset, rewinder_using,
+                                       buffer);
+    }   // addNetworkState
     // ------------------------------------------------------------------------
     bool shouldSaveState(int ticks)
     {
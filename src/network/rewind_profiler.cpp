@@ -0,0 +1,339 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/rewind_profiler.hpp"
+
+#include "network/rewinder.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+RewindProfiler* RewindProfiler::m_rewind_profiler = NULL;
+
+namespace
+{
+    /** Rewinds deeper than this (in ticks) are counted in the last bucket
+     *  of the depth histogram. */
+    const unsigned MAX_HISTOGRAM_DEPTH = 120;
+
+    /** Number of rewinds stored for each race, older ones are only counted
+     *  in the totals and the depth histogram. */
+    const unsigned MAX_RECORDS = 4096;
+
+    /** Predictions are only kept for this many state ticks, in case that
+     *  states are lost. */
+    const unsigned MAX_PREDICTIONS = 64;
+}   // namespace
+
+// ----------------------------------------------------------------------------
+void RewindProfiler::RewindTotals::reset()
+{
+    m_num_rewinds = 0;
+    m_depth = 0;
+    m_replayed_ticks = 0;
+    m_max_depth = 0;
+    m_time_ms = 0.0;
+    m_max_time_ms = 0.0f;
+}   // RewindTotals::reset
+
+// ----------------------------------------------------------------------------
+void RewindProfiler::RewindTotals::add(const RewindRecord& record)
+{
+    const int depth = std::max(record.getDepth(), 0);
+    m_num_rewinds++;
+    m_depth += depth;
+    m_replayed_ticks += record.m_replayed_ticks;
+    m_max_depth = std::max(m_max_depth, depth);
+    m_time_ms += record.m_time_ms;
+    m_max_time_ms = std::max(m_max_time_ms, record.m_time_ms);
+}   // RewindTotals::add
+
+// ----------------------------------------------------------------------------
+RewindProfiler::RewindProfiler()
+{
+    m_num_races = 0;
+    m_totals.reset();
+    m_race_totals.reset();
+    reset();
+}   // RewindProfiler
+
+// ----------------------------------------------------------------------------
+RewindProfiler::~RewindProfiler()
+{
+    writeRace();
+    if (m_output && isJSON())
+        *m_output << "\n]\n";
+    if (m_output)
+    {
+        Log::info("RewindProfiler", "Wrote the rewinds of %u races to '%s'.",
+                  m_num_races, m_output_file.c_str());
+    }
+}   // ~RewindProfiler
+
+// ----------------------------------------------------------------------------
+/** Called by the RewindManager of a client before each race: writes the
+ *  rewinds of the previous race to the output file (if requested), and
+ *  removes them.
+ */
+void RewindProfiler::reset()
+{
+    writeRace();
+    m_records.clear();
+    m_first_record = 0;
+    m_depth_histogram.clear();
+    m_depth_histogram.resize(MAX_HISTOGRAM_DEPTH + 2, 0);
+    m_race_totals.reset();
+    m_predictions.clear();
+    m_mismatch_error = 0.0f;
+    m_mismatch_rewinder.clear();
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Converts the binary unique identity of a rewinder into a string which
+ *  can be used in logs and files, e.g. "kart 2".
+ */
+std::string RewindProfiler::getReadableName(const std::string& uid)
+{
+    if (uid.empty())
+        return "";
+
+    std::string name;
+    switch ((RewinderName)uid[0])
+    {
+    case RN_ITEM_MANAGER: name = "item_manager";    break;
+    case RN_KART:         name = "kart";            break;
+    case RN_RED_FLAG:     name = "red_flag";        break;
+    case RN_BLUE_FLAG:    name = "blue_flag";       break;
+    case RN_CAKE:         name = "cake";            break;
+    case RN_BOWLING:      name = "bowling";         break;
+    case RN_PLUNGER:      name = "plunger";         break;
+    case RN_RUBBERBALL:   name = "rubberball";      break;
+    case RN_PHYSICAL_OBJ: name = "physical_object"; break;
+    default:
+        name = "unknown_" + StringUtils::toString((int)(uint8_t)uid[0]);
+        break;
+    }
+    if (uid.size() == 1)
+        return name;
+
+    // Karts only store the world kart id, print it as a number. For all
+    // other rewinders print the remaining bytes as hex.
+    if (uid[0] == RN_KART && uid.size() == 2)
+        return name + " " + StringUtils::toString((int)(uint8_t)uid[1]);
+
+    std::ostringstream oss;
+    oss << name << " " << std::hex << std::setfill('0');
+    for (unsigned i = 1; i < uid.size(); i++)
+        oss << std::setw(2) << (int)(uint8_t)uid[i];
+    return oss.str();
+}   // getReadableName
+
+// ----------------------------------------------------------------------------
+/** Called by a client for each rewinder when it saves its local state, i.e.
+ *  at the ticks for which the server sends a state: stores the predicted
+ *  position of the rewinder.
+ */
+void RewindProfiler::savePrediction(int ticks, const Rewinder& rewinder)
+{
+    Vec3 xyz;
+    if (!rewinder.getRewindPosition(&xyz))
+        return;
+    m_predictions[ticks][rewinder.getUniqueIdentity()] = xyz;
+    if (m_predictions.size() > MAX_PREDICTIONS)
+        m_predictions.erase(m_predictions.begin());
+}   // savePrediction
+
+// ----------------------------------------------------------------------------
+/** Called during a rewind after the confirmed state of a rewinder was
+ *  restored: compares the confirmed position with the prediction.
+ *  \param ticks Ticks of the restored state.
+ */
+void RewindProfiler::checkPrediction(int ticks, const Rewinder& rewinder)
+{
+    auto it = m_predictions.find(ticks);
+    if (it == m_predictions.end())
+        return;
+    auto prediction = it->second.find(rewinder.getUniqueIdentity());
+    Vec3 xyz;
+    if (prediction == it->second.end() || !rewinder.getRewindPosition(&xyz))
+        return;
+    const float error = (xyz - prediction->second).length();
+    if (error > m_mismatch_error)
+    {
+        m_mismatch_error = error;
+        m_mismatch_rewinder = prediction->first;
+    }
+}   // checkPrediction
+
+// ----------------------------------------------------------------------------
+/** Returns the largest misprediction found since the last call, and removes
+ *  all predictions which are not needed anymore.
+ *  \param ticks Ticks of the confirmed state the rewind restored.
+ *  \param unique_identity[out] The rewinder with the largest error, empty
+ *         if all predictions were confirmed.
+ */
+float RewindProfiler::takeMismatch(int ticks, std::string* unique_identity)
+{
+    m_predictions.erase(m_predictions.begin(),
+                        m_predictions.upper_bound(ticks));
+    const float error = m_mismatch_error;
+    unique_identity->swap(m_mismatch_rewinder);
+    m_mismatch_rewinder.clear();
+    m_mismatch_error = 0.0f;
+    return error;
+}   // takeMismatch
+
+// ----------------------------------------------------------------------------
+/** Adds the information about one rewind.
+ */
+void RewindProfiler::addRewind(const RewindRecord& record)
+{
+    if (m_records.size() < MAX_RECORDS)
+        m_records.push_back(record);
+    else
+    {
+        m_records[m_first_record] = record;
+        m_first_record = (m_first_record + 1) % MAX_RECORDS;
+    }
+    unsigned depth = (unsigned)std::max(record.getDepth(), 0);
+    m_depth_histogram[std::min(depth, MAX_HISTOGRAM_DEPTH + 1)]++;
+    m_race_totals.add(record);
+    m_totals.add(record);
+}   // addRewind
+
+// ----------------------------------------------------------------------------
+/** Returns a short summary of the rewinds of the current race, used in the
+ *  in-game profiler.
+ */
+std::string RewindProfiler::getSummary() const
+{
+    const RewindTotals& t = m_race_totals;
+    if (t.m_num_rewinds == 0)
+        return "No rewinds";
+
+    const RewindRecord& last = getRecord(getNumRecords() - 1);
+    const float n = (float)t.m_num_rewinds;
+
+    std::ostringstream oss;
+    oss.precision(3);
+    oss << "Rewinds: " << t.m_num_rewinds
+        << "  avg depth " << t.m_depth / n << " ticks"
+        << "  avg replayed " << t.m_replayed_ticks / n << " ticks\n"
+        << "Rewind time: avg " << t.m_time_ms / n << " ms  max "
+        << t.m_max_time_ms << " ms  total " << t.m_time_ms << " ms\n"
+        << "Last: depth " << last.getDepth() << " ticks, "
+        << last.m_time_ms << " ms";
+    if (!last.m_rewinder.empty())
+        oss << ", " << last.m_rewinder << " off by " << last.m_error;
+    return oss.str();
+}   // getSummary
+
+// ----------------------------------------------------------------------------
+bool RewindProfiler::isJSON() const
+{
+    return StringUtils::toLowerCase(
+        StringUtils::getExtension(m_output_file)) == "json";
+}   // isJSON
+
+// ----------------------------------------------------------------------------
+/** Writes the rewinds of the current race to the output file, which is
+ *  opened (and overwritten) for the first race. A JSON file contains an
+ *  array with one object for each race, a CSV file one line per rewind.
+ */
+void RewindProfiler::writeRace()
+{
+    if (m_output_file.empty() || m_race_totals.m_num_rewinds == 0)
+        return;
+    if (!m_output)
+    {
+        m_output.reset(new std::ofstream(m_output_file));
+        if (!m_output->is_open())
+        {
+            Log::error("RewindProfiler", "Can't open '%s' for writing.",
+                       m_output_file.c_str());
+            m_output_file.clear();
+            m_output.reset();
+            return;
+        }
+        if (isJSON())
+            *m_output << "[";
+        else
+        {
+            *m_output << "race,ticks,rewind_ticks,depth,replayed_ticks,"
+                         "time_ms,error,rewinder\n";
+        }
+    }
+    if (isJSON())
+        writeJSON(*m_output);
+    else
+        writeCSV(*m_output);
+    m_output->flush();
+    m_num_races++;
+    if (m_race_totals.m_num_rewinds > getNumRecords())
+    {
+        Log::warn("RewindProfiler", "Only the last %u of %u rewinds of race "
+                  "%u were written.", getNumRecords(),
+                  m_race_totals.m_num_rewinds, m_num_races);
+    }
+}   // writeRace
+
+// ----------------------------------------------------------------------------
+void RewindProfiler::writeCSV(std::ostream& os) const
+{
+    for (unsigned i = 0; i < getNumRecords(); i++)
+    {
+        const RewindRecord& r = getRecord(i);
+        os << m_num_races + 1 << "," << r.m_ticks << "," << r.m_rewind_ticks
+           << "," << r.getDepth() << "," << r.m_replayed_ticks << ","
+           << r.m_time_ms << "," << r.m_error << "," << r.m_rewinder << "\n";
+    }
+}   // writeCSV
+
+// ----------------------------------------------------------------------------
+void RewindProfiler::writeJSON(std::ostream& os) const
+{
+    const RewindTotals& t = m_race_totals;
+    os << (m_num_races == 0 ? "\n" : ",\n")
+       << "  {\n    \"race\": " << m_num_races + 1
+       << ",\n    \"num_rewinds\": " << t.m_num_rewinds
+       << ",\n    \"rewinds\": [";
+    for (unsigned i = 0; i < getNumRecords(); i++)
+    {
+        const RewindRecord& r = getRecord(i);
+        os << (i == 0 ? "\n" : ",\n")
+           << "      {\"ticks\": " << r.m_ticks
+           << ", \"rewind_ticks\": " << r.m_rewind_ticks
+           << ", \"depth\": " << r.getDepth()
+           << ", \"replayed_ticks\": " << r.m_replayed_ticks
+           << ", \"time_ms\": " << r.m_time_ms
+           << ", \"error\": " << r.m_error
+           << ", \"rewinder\": \"" << r.m_rewinder << "\"}";
+    }
+    os << "\n    ],\n    \"depth_histogram\": [";
+    // The last bucket contains all rewinds deeper than MAX_HISTOGRAM_DEPTH
+    for (unsigned i = 0; i < m_depth_histogram.size(); i++)
+    {
+        os << (i == 0 ? "" : ", ") << m_depth_histogram[i];
+    }
+    os << "],\n    \"total_time_ms\": " << t.m_time_ms
+       << ",\n    \"max_time_ms\": " << t.m_max_time_ms << "\n  }";
+}   // writeJSON
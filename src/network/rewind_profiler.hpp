@@ -0,0 +1,186 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_REWIND_PROFILER_HPP
+#define HEADER_REWIND_PROFILER_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include <assert.h>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Rewinder;
+
+/** \ingroup network
+ *  Collects the cost of each rollback done by the RewindManager of a
+ *  client: how far back the rewind went, how many ticks had to be simulated
+ *  again, the wall time it took and the rewinder whose prediction differed
+ *  most from the confirmed state that was restored. A short summary of the
+ *  current race is shown in the in-game profiler; with --rewind-stats=file
+ *  the rewinds of each race are written to a CSV or JSON file.
+ *
+ *  To find the rewinder which caused a rollback, the client saves the
+ *  position of each kart and physical object at every tick for which the
+ *  server sends a state. When the state is restored during a rewind, the
+ *  confirmed position is compared with this prediction (before any tick is
+ *  simulated again, so errors which only spread to other objects during the
+ *  replay are not counted).
+ */
+class RewindProfiler : public NoCopy
+{
+public:
+    /** Information about one rewind. */
+    struct RewindRecord
+    {
+        /** World ticks when the rewind was triggered. */
+        int m_ticks;
+        /** Ticks of the confirmed state which was restored. */
+        int m_rewind_ticks;
+        /** Number of ticks simulated again to get back to m_ticks. */
+        int m_replayed_ticks;
+        /** Wall time of the whole rewind in milliseconds. */
+        float m_time_ms;
+        /** Distance between the predicted and the confirmed position of
+         *  m_rewinder at m_rewind_ticks. */
+        float m_error;
+        /** Readable name of the rewinder with the largest misprediction,
+         *  empty if all predicted positions were confirmed. */
+        std::string m_rewinder;
+        // --------------------------------------------------------------------
+        int getDepth() const                { return m_ticks - m_rewind_ticks; }
+    };
+
+    /** Sums over a number of rewinds. */
+    struct RewindTotals
+    {
+        unsigned m_num_rewinds;
+        uint64_t m_depth;
+        uint64_t m_replayed_ticks;
+        int      m_max_depth;
+        double   m_time_ms;
+        float    m_max_time_ms;
+        // --------------------------------------------------------------------
+        void reset();
+        // --------------------------------------------------------------------
+        void add(const RewindRecord& record);
+    };
+
+private:
+    /** Static pointer to the one instance of the rewind profiler. */
+    static RewindProfiler* m_rewind_profiler;
+
+    /** The last rewinds of the current race, used as a ring buffer once it
+     *  is full, so long races don't need more memory. */
+    std::vector<RewindRecord> m_records;
+
+    /** Index of the oldest record in m_records. */
+    unsigned m_first_record;
+
+    /** Number of rewinds for each rewind depth in ticks in the current
+     *  race, the last entry counts all rewinds which are deeper. */
+    std::vector<unsigned> m_depth_histogram;
+
+    /** Sums over the rewinds of the current race, and since startup. */
+    RewindTotals m_race_totals, m_totals;
+
+    /** The predicted position of each rewinder (by unique identity) at the
+     *  ticks of the states which were not restored yet. */
+    std::map<int, std::map<std::string, Vec3> > m_predictions;
+
+    /** Largest misprediction found in the states restored by the current
+     *  rewind, and the unique identity of its rewinder. */
+    float m_mismatch_error;
+    std::string m_mismatch_rewinder;
+
+    /** File the statistics are written to at the end of each race, empty
+     *  to disable. */
+    std::string m_output_file;
+
+    /** The output file, opened when the first race is written. */
+    std::unique_ptr<std::ofstream> m_output;
+
+    /** Number of races written to the output file. */
+    unsigned m_num_races;
+
+    RewindProfiler();
+    ~RewindProfiler();
+    // ------------------------------------------------------------------------
+    void writeRace();
+    // ------------------------------------------------------------------------
+    void writeCSV(std::ostream& os) const;
+    // ------------------------------------------------------------------------
+    void writeJSON(std::ostream& os) const;
+    // ------------------------------------------------------------------------
+    bool isJSON() const;
+
+public:
+    // ------------------------------------------------------------------------
+    static void create()
+    {
+        assert(!m_rewind_profiler);
+        m_rewind_profiler = new RewindProfiler();
+    }
+    // ------------------------------------------------------------------------
+    static RewindProfiler* get()                   { return m_rewind_profiler; }
+    // ------------------------------------------------------------------------
+    /** Writes the statistics if requested and deletes the instance. */
+    static void destroy()
+    {
+        delete m_rewind_profiler;
+        m_rewind_profiler = NULL;
+    }
+    // ------------------------------------------------------------------------
+    static std::string getReadableName(const std::string& unique_identity);
+    // ------------------------------------------------------------------------
+    void savePrediction(int ticks, const Rewinder& rewinder);
+    // ------------------------------------------------------------------------
+    void checkPrediction(int ticks, const Rewinder& rewinder);
+    // ------------------------------------------------------------------------
+    float takeMismatch(int ticks, std::string* unique_identity);
+    // ------------------------------------------------------------------------
+    void addRewind(const RewindRecord& record);
+    // ------------------------------------------------------------------------
+    void reset();
+    // ------------------------------------------------------------------------
+    std::string getSummary() const;
+    // ------------------------------------------------------------------------
+    void setOutputFile(const std::string& filename)
+                                                 { m_output_file = filename; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of rewinds stored for the current race. */
+    unsigned getNumRecords() const      { return (unsigned)m_records.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns the stored rewinds of the current race, 0 is the oldest. */
+    const RewindRecord& getRecord(unsigned i) const
+              { return m_records[(m_first_record + i) % m_records.size()]; }
+    // ------------------------------------------------------------------------
+    const RewindTotals& getRaceTotals() const        { return m_race_totals; }
+    // ------------------------------------------------------------------------
+    const RewindTotals& getTotals() const                 { return m_totals; }
+    // ------------------------------------------------------------------------
+    const std::vector<unsigned>& getDepthHistogram() const
+                                                  { return m_depth_histogram; }
+};   // RewindProfiler
+
+#endif
@@ -26,8 +26,10 @@
 #include "network/rewinder.hpp"
 #include "network/rewind_info.hpp"
 #include "network/rewind_manager.hpp"
+#include "utils/time.hpp"
 
 #include <algorithm>
+#include <list>
 
 /** The RewindQueue stores one TimeStepInfo for each time step done.
  *  The TimeStepInfo stores all states and events to be used at the
@@ -45,6 +47,9 @@
  */
 RewindQueue::RewindQueue()
 {
+    m_ring.resize(256, NULL);
+    m_ring_start = 0;
+    m_ring_size = 0;
     reset();
 }   // RewindQueue
 
@@ -56,6 +61,10 @@ RewindQueue::~RewindQueue()
 {
     // This frees all current data
     reset();
+    for (RewindInfoEvent* rie : m_free_events)
+        delete rie;
+    for (RewindInfoState* ris : m_free_states)
+        delete ris;
 }   // ~RewindQueue
 
 // ----------------------------------------------------------------------------
@@ -69,20 +78,63 @@ void RewindQueue::reset()
     for (AllNetworkRewindInfo::const_iterator i  = info.begin(); 
                                               i != info.end(); ++i)
     {
-        delete *i;
+        freeRewindInfo(*i);
     }
     m_network_events.getData().clear();
     m_network_events.unlock();
 
-    AllRewindInfo::const_iterator i;
-    for (i = m_all_rewind_info.begin(); i != m_all_rewind_info.end(); ++i)
-        delete *i;
+    for (unsigned i = 0; i < m_ring_size; i++)
+        freeRewindInfo(at(i));
 
-    m_all_rewind_info.clear();
-    m_current = m_all_rewind_info.end();
+    m_ring_start = 0;
+    m_ring_size = 0;
+    m_current = 0;
     m_latest_confirmed_state_time = -1;
 }   // reset
 
+// ----------------------------------------------------------------------------
+/** Keeps a RewindInfo which is not needed anymore for later reuse, or
+ *  deletes it if it can't be reused.
+ */
+void RewindQueue::freeRewindInfo(RewindInfo* ri)
+{
+    if (RewindInfoEvent* rie = dynamic_cast<RewindInfoEvent*>(ri))
+    {
+        std::lock_guard<std::mutex> lock(m_free_mutex);
+        m_free_events.push_back(rie);
+    }
+    else if (RewindInfoState* ris = dynamic_cast<RewindInfoState*>(ri))
+    {
+        std::lock_guard<std::mutex> lock(m_free_mutex);
+        m_free_states.push_back(ris);
+    }
+    else
+        delete ri;
+}   // freeRewindInfo
+
+// ----------------------------------------------------------------------------
+/** Returns a RewindInfoEvent with the given data, reusing a previously
+ *  freed one if possible. Thread-safe, as network events are created in the
+ *  network thread.
+ */
+RewindInfoEvent* RewindQueue::getRewindInfoEvent(int ticks,
+                                              EventRewinder *event_rewinder,
+                                              const BareNetworkString *buffer,
+                                              bool confirmed)
+{
+    std::unique_lock<std::mutex> ul(m_free_mutex);
+    if (m_free_events.empty())
+    {
+        ul.unlock();
+        return new RewindInfoEvent(ticks, event_rewinder, buffer, confirmed);
+    }
+    RewindInfoEvent* rie = m_free_events.back();
+    m_free_events.pop_back();
+    ul.unlock();
+    rie->set(ticks, event_rewinder, buffer, confirmed);
+    return rie;
+}   // getRewindInfoEvent
+
 // ----------------------------------------------------------------------------
 /** Inserts a RewindInfo object in the list of all events at the correct time.
  *  If there are several RewindInfo at the exact same time, state RewindInfo
@@ -94,37 +146,51 @@ void RewindQueue::reset()
  */
 void RewindQueue::insertRewindInfo(RewindInfo *ri)
 {
-    AllRewindInfo::iterator i = m_all_rewind_info.end();
+    if (m_ring_size == m_ring.size())
+    {
+        // Double the capacity, and move the content to the beginning
+        std::vector<RewindInfo*> ring(m_ring.size() * 2, NULL);
+        for (unsigned j = 0; j < m_ring_size; j++)
+            ring[j] = at(j);
+        std::swap(m_ring, ring);
+        m_ring_start = 0;
+    }
 
-    while (i != m_all_rewind_info.begin())
+    unsigned i = m_ring_size;
+    while (i > 0)
     {
-        AllRewindInfo::iterator i_prev = i;
-        i_prev--;
+        RewindInfo* prev = at(i - 1);
         // Now test if 'ri' needs to be inserted after the
         // previous element, i.e. before the current element:
-        if ((*i_prev)->getTicks() < ri->getTicks()) break;
-        if ((*i_prev)->getTicks() == ri->getTicks() &&
-            ri->isEvent()                              ) break;
-        i = i_prev;
+        if (prev->getTicks() < ri->getTicks()) break;
+        if (prev->getTicks() == ri->getTicks() && ri->isEvent()) break;
+        i--;
     }
-    if(m_current == m_all_rewind_info.end())
-        m_current = m_all_rewind_info.insert(i, ri);
-    else
-        m_all_rewind_info.insert(i, ri);  
+
+    // Move all later elements one slot back, usually there are none or
+    // only a few, since most infos are added at the current time
+    m_ring_size++;
+    for (unsigned j = m_ring_size - 1; j > i; j--)
+        at(j) = at(j - 1);
+    at(i) = ri;
+
+    if (m_current == m_ring_size - 1)
+        m_current = i;
+    else if (i <= m_current)
+        m_current++;
 }   // insertRewindInfo
 
 // ----------------------------------------------------------------------------
-/** Adds an event to the rewind data. The data to be stored must be allocated
- *  and not freed by the caller!
+/** Adds an event to the rewind data. The data in buffer is copied.
  *  \param buffer Pointer to the event data. 
  *  \param ticks Time at which the event happened.
  */
 void RewindQueue::addLocalEvent(EventRewinder *event_rewinder,
-                                BareNetworkString *buffer, bool confirmed,
-                                int ticks                                  )
+                                const BareNetworkString *buffer,
+                                bool confirmed, int ticks)
 {
-    RewindInfo *ri = new RewindInfoEvent(ticks, event_rewinder,
-                                         buffer, confirmed);
+    RewindInfo *ri = getRewindInfoEvent(ticks, event_rewinder, buffer,
+                                        confirmed);
     insertRewindInfo(ri);
 }   // addLocalEvent
 
@@ -154,16 +220,16 @@ void RewindQueue::addLocalState(BareNetworkString *buffer,
 // ----------------------------------------------------------------------------
 /** Adds an event to the list of network rewind data. This function is
  *  threadsafe so can be called by the network thread. The data is synched
- *  to m_tRewindInformation list by the main thread. The data to be stored
- *  must be allocated and not freed by the caller!
+ *  to m_tRewindInformation list by the main thread. The data in buffer is
+ *  copied.
  *  \param buffer Pointer to the event data.
  *  \param ticks Time at which the event happened.
  */
 void RewindQueue::addNetworkEvent(EventRewinder *event_rewinder,
-                                  BareNetworkString *buffer, int ticks)
+                                  const BareNetworkString *buffer, int ticks)
 {
-    RewindInfo *ri = new RewindInfoEvent(ticks, event_rewinder,
-                                         buffer, /*confirmed*/true);
+    RewindInfo *ri = getRewindInfoEvent(ticks, event_rewinder, buffer,
+                                        /*confirmed*/true);
 
     m_network_events.lock();
     m_network_events.getData().push_back(ri);
@@ -187,6 +253,40 @@ void RewindQueue::addNetworkState(BareNetworkString *buffer, int ticks)
     m_network_events.unlock();
 }   // addNetworkState
 
+// ----------------------------------------------------------------------------
+/** Adds a state received from the server to the list of network rewind
+ *  data, reusing a previously freed state if possible. This function is
+ *  threadsafe so can be called by the network thread.
+ *  \param ticks Time of the state.
+ *  \param start_offset Offset in buffer where the state data starts.
+ *  \param rewinder_using The rewinders in this state, swapped.
+ *  \param buffer The state data, swapped.
+ */
+void RewindQueue::addNetworkState(int ticks, int start_offset,
+                                  std::vector<RewinderUsing>& rewinder_using,
+                                  std::vector<uint8_t>& buffer)
+{
+    RewindInfoState* ris = NULL;
+    std::unique_lock<std::mutex> ul(m_free_mutex);
+    if (!m_free_states.empty())
+    {
+        ris = m_free_states.back();
+        m_free_states.pop_back();
+    }
+    ul.unlock();
+    if (ris)
+        ris->set(ticks, start_offset, rewinder_using, buffer);
+    else
+    {
+        ris = new RewindInfoState(ticks, start_offset, rewinder_using,
+                                  buffer);
+    }
+
+    m_network_events.lock();
+    m_network_events.getData().push_back(ris);
+    m_network_events.unlock();
+}   // addNetworkState
+
 // ----------------------------------------------------------------------------
 /** Merges thread-safe all data received from the network up to and including
  *  the current time (tick) with the current local rewind information.
@@ -236,7 +336,7 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
                       (*i)->isEvent() ? "event" : "state",
                       (*i)->getTicks(),
                       m_latest_confirmed_state_time);
-            delete *i;
+            freeRewindInfo(*i);
             i = m_network_events.getData().erase(i);
             continue;
         }
@@ -327,25 +427,23 @@ void RewindQueue::mergeNetworkData(int world_ticks, bool *needs_rewind,
  */
 void RewindQueue::cleanupOldRewindInfo(int ticks)
 {
-    auto i = m_all_rewind_info.begin();
-
-    while (!m_all_rewind_info.empty() &&
-        (*i)->getTicks() < ticks)
+    while (m_ring_size > 0 && at(0)->getTicks() < ticks)
     {
-        if (m_current == i) next();
-        delete *i;
-        i = m_all_rewind_info.erase(i);
+        freeRewindInfo(at(0));
+        at(0) = NULL;
+        m_ring_start = (m_ring_start + 1) & (m_ring.size() - 1);
+        m_ring_size--;
+        // If current pointed to the removed info, it now points to the
+        // next one
+        if (m_current > 0)
+            m_current--;
     }
-
-    if (m_all_rewind_info.empty())
-        m_current = m_all_rewind_info.end();
-
 }   // cleanupOldRewindInfo
 
 // ----------------------------------------------------------------------------
 bool RewindQueue::isEmpty() const
 {
-    return m_current == m_all_rewind_info.end();
+    return m_current == m_ring_size;
 }   // isEmpty
 
 // ----------------------------------------------------------------------------
@@ -353,7 +451,7 @@ bool RewindQueue::isEmpty() const
  */
 bool RewindQueue::hasMoreRewindInfo() const
 {
-    return m_current != m_all_rewind_info.end();
+    return m_current < m_ring_size;
 }   // hasMoreRewindInfo
 
 // ----------------------------------------------------------------------------
@@ -367,27 +465,26 @@ int RewindQueue::undoUntil(int undo_ticks)
 {
     // A rewind is done after a state in the past is inserted. This function
     // makes sure that m_current is not end()
-    //assert(m_current != m_all_rewind_info.end());
-    assert(!m_all_rewind_info.empty());
-    m_current = m_all_rewind_info.end();
-    m_current--;
-    while((*m_current)->getTicks() > undo_ticks ||
-        (*m_current)->isEvent() || !(*m_current)->isConfirmed())
+    assert(m_ring_size > 0);
+    m_current = m_ring_size - 1;
+    while(at(m_current)->getTicks() > undo_ticks ||
+        at(m_current)->isEvent() || !at(m_current)->isConfirmed())
     {
         // Undo all events and states from the current time
-        (*m_current)->undo();
-        if(m_current == m_all_rewind_info.begin())
+        at(m_current)->undo();
+        if(m_current == 0)
         {
             // This shouldn't happen, but add some debug info just in case
             Log::error("undoUntil",
                        "At %d rewinding to %d current = %d = begin",
                        World::getWorld()->getTicksSinceStart(), undo_ticks, 
-                       (*m_current)->getTicks());
+                       at(m_current)->getTicks());
+            break;
         }
         m_current--;
     }
 
-    return (*m_current)->getTicks();
+    return at(m_current)->getTicks();
 }   // undoUntil
 
 // ----------------------------------------------------------------------------
@@ -397,10 +494,10 @@ int RewindQueue::undoUntil(int undo_ticks)
 void RewindQueue::replayAllEvents(int ticks)
 {
     // Replay all events that happened at the current time step
-    while ( hasMoreRewindInfo() && (*m_current)->getTicks() == ticks )
+    while ( hasMoreRewindInfo() && at(m_current)->getTicks() == ticks )
     {
-        if ((*m_current)->isEvent())
-            (*m_current)->replay();
+        if (at(m_current)->isEvent())
+            at(m_current)->replay();
         m_current++;
     }   // while current->getTIcks == ticks
 
@@ -413,6 +510,8 @@ void RewindQueue::replayAllEvents(int ticks)
  *  - Sorting order of RewindInfos with different timestamps (and a mixture
  *    of types).
  *  - Special cases that triggered incorrect behaviour previously.
+ *  - Growing and wrapping around of the ring buffer.
+ *  It also compares the throughput with the previous list based queue.
  */
 void RewindQueue::unitTesting()
 {
@@ -427,57 +526,47 @@ void RewindQueue::unitTesting()
     assert(!q0.hasMoreRewindInfo());
 
     q0.addLocalState(NULL, /*confirmed*/true, 0);
-    assert(q0.m_all_rewind_info.front()->isState());
-    assert(!q0.m_all_rewind_info.front()->isEvent());
+    assert(q0.at(0)->isState());
+    assert(!q0.at(0)->isEvent());
     assert(q0.hasMoreRewindInfo());
     assert(q0.undoUntil(0) == 0);
 
     q0.addNetworkEvent(dummy_rewinder.get(), NULL, 0);
     // Network events are not immediately merged
-    assert(q0.m_all_rewind_info.size() == 1);
+    assert(q0.m_ring_size == 1);
 
     bool needs_rewind;
     int rewind_ticks;
     int world_ticks = 0;
     q0.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
     assert(q0.hasMoreRewindInfo());
-    assert(q0.m_all_rewind_info.size() == 2);
-    AllRewindInfo::iterator rii = q0.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    assert(q0.m_ring_size == 2);
+    assert(q0.at(0)->isState());
+    assert(q0.at(1)->isEvent());
 
     // Another state must be sorted before the event:
     q0.addNetworkState(NULL, 0);
     assert(q0.hasMoreRewindInfo());
     q0.mergeNetworkData(world_ticks, &needs_rewind, &rewind_ticks);
-    assert(q0.m_all_rewind_info.size() == 3);
-    rii = q0.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    assert(q0.m_ring_size == 3);
+    assert(q0.at(0)->isState());
+    assert(q0.at(1)->isState());
+    assert(q0.at(2)->isEvent());
 
     // Test time base comparisons: adding an event to the end
     q0.addLocalEvent(dummy_rewinder.get(), NULL, true, 4);
     // Then adding an earlier event
     q0.addLocalEvent(dummy_rewinder.get(), NULL, false, 1);
-    // rii points to the 3rd element, the ones added just now
-    // should be elements4 and 5:
-    rii++;
-    assert((*rii)->getTicks()==1);
-    rii++;
-    assert((*rii)->getTicks()==4);
+    // The ones added just now should be elements 4 and 5:
+    assert(q0.at(3)->getTicks()==1);
+    assert(q0.at(4)->getTicks()==4);
 
     // Now test inserting an event first, then the state
     RewindQueue q1;
     q1.addLocalEvent(NULL, NULL, true, 5);
     q1.addLocalState(NULL, true, 5);
-    rii = q1.m_all_rewind_info.begin();
-    assert((*rii)->isState());
-    rii++;
-    assert((*rii)->isEvent());
+    assert(q1.at(0)->isState());
+    assert(q1.at(1)->isEvent());
 
     // Bugs seen before
     // ----------------
@@ -496,7 +585,7 @@ void RewindQueue::unitTesting()
     //    event, that m_current pooints to the first event, otherwise
     //    events with same time stamp will not be handled correctly.
     //    At this stage current points to the event at time 2 from above
-    AllRewindInfo::iterator current_old = b1.m_current;
+    unsigned current_old = b1.m_current;
     b1.addLocalEvent(NULL, NULL, true, 2);
     // Make sure that current was not modified, i.e. the new event at time
     // 2 was added at the end of the list:
@@ -509,7 +598,7 @@ void RewindQueue::unitTesting()
     assert(ri->getTicks() == 2);
     assert(ri->isEvent());
     b1.next();
-    assert(b1.m_current == b1.m_all_rewind_info.end());
+    assert(b1.m_current == b1.m_ring_size);
 
     // 3) Test that if cleanupOldRewindInfo is called, it will if necessary
     //    adjust m_current to point to the latest confirmed state.
@@ -518,7 +607,68 @@ void RewindQueue::unitTesting()
     b2.addNetworkState(NULL, 2);
     b2.addNetworkState(NULL, 3);
     b2.mergeNetworkData(4, &needs_rewind, &rewind_ticks);
-    assert((*b2.m_current)->getTicks() == 3);
-
-
+    assert(b2.at(b2.m_current)->getTicks() == 3);
+
+    // Ring buffer: grow beyond the initial capacity while wrapping around,
+    // and make sure the order and reuse of events is kept.
+    RewindQueue r1;
+    BareNetworkString event(1);
+    event.addUInt8(42);
+    for (int t = 0; t < 1000; t++)
+    {
+        r1.addLocalEvent(dummy_rewinder.get(), &event, true, t);
+        if (t % 3 == 0)
+            r1.addLocalState(NULL, true, t);
+        r1.replayAllEvents(t);
+        if (t > 100)
+            r1.cleanupOldRewindInfo(t - 100 + (t / 2) % 300);
+    }
+    assert(r1.m_ring.size() >= r1.m_ring_size);
+    for (unsigned i = 1; i < r1.m_ring_size; i++)
+        assert(r1.at(i - 1)->getTicks() <= r1.at(i)->getTicks());
+    assert(!r1.hasMoreRewindInfo());
+    RewindInfoEvent* rie = dynamic_cast<RewindInfoEvent*>(
+        r1.at(r1.m_ring_size - 1));
+    if (!rie || rie->getBuffer()->getUInt8() != 42)
+        Log::fatal("RewindQueue", "Wrong event data after reuse");
+    assert(!r1.m_free_events.empty());
+
+    // Throughput compared to the previous std::list based queue, which
+    // allocated a new RewindInfo and BareNetworkString for each event
+    const int count = 200000;
+    const int keep = 120;
+    double start = StkTime::getRealTime();
+    std::list<RewindInfo*> old_queue;
+    for (int t = 0; t < count; t++)
+    {
+        BareNetworkString* s = new BareNetworkString(9);
+        s->addUInt8(0).addUInt8(1).addUInt16(2).addUInt16(3).addUInt16(4);
+        old_queue.push_back(new RewindInfoEvent(t, dummy_rewinder.get(), s,
+            true));
+        delete s;
+        while (old_queue.front()->getTicks() < t - keep)
+        {
+            delete old_queue.front();
+            old_queue.pop_front();
+        }
+    }
+    for (RewindInfo* old_ri : old_queue)
+        delete old_ri;
+    double old_time = StkTime::getRealTime() - start;
+
+    start = StkTime::getRealTime();
+    RewindQueue new_queue;
+    BareNetworkString s(9);
+    for (int t = 0; t < count; t++)
+    {
+        s.getBuffer().clear();
+        s.reset();
+        s.addUInt8(0).addUInt8(1).addUInt16(2).addUInt16(3).addUInt16(4);
+        new_queue.addLocalEvent(dummy_rewinder.get(), &s, true, t);
+        new_queue.cleanupOldRewindInfo(t - keep);
+    }
+    double new_time = StkTime::getRealTime() - start;
+    Log::info("RewindQueue", "%d events: list queue %.2fms, "
+        "ring buffer queue %.2fms.", count, old_time * 1000.0,
+        new_time * 1000.0);
 }   // unitTesting
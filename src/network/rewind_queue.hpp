@@ -22,13 +22,16 @@
 #include "utils/synchronised.hpp"
 
 #include <assert.h>
-#include <list>
+#include <mutex>
+#include <string>
 #include <vector>
 
 class BareNetworkString;
 class EventRewinder;
 class RewindInfo;
-class TimeStepInfo;
+class RewindInfoEvent;
+class RewindInfoState;
+struct RewinderUsing;
 
 /** \ingroup network
  */
@@ -37,9 +40,16 @@ class RewindQueue
 {
 private:
 
-    typedef std::list<RewindInfo*> AllRewindInfo;
+    /** All rewind infos sorted by ticks, stored as a ring buffer so that
+     *  adding at the end and removing old infos at the front does not
+     *  allocate memory. The capacity is always a power of 2. */
+    std::vector<RewindInfo*> m_ring;
 
-    AllRewindInfo m_all_rewind_info;
+    /** Index in m_ring of the first (oldest) rewind info. */
+    unsigned m_ring_start;
+
+    /** Number of rewind infos in m_ring. */
+    unsigned m_ring_size;
 
     /** The list of all events received from the network. They are stored
      *  in a separate thread (so this data structure is thread-save), and
@@ -49,14 +59,34 @@ private:
     typedef std::vector<RewindInfo*> AllNetworkRewindInfo;
     Synchronised<AllNetworkRewindInfo> m_network_events;
 
-    /** Iterator to the curren time step info to be handled. */
-    AllRewindInfo::iterator m_current;
+    /** Index (relative to m_ring_start) of the current rewind info to be
+     *  handled, m_ring_size if there is none. */
+    unsigned m_current;
 
     /** Time at which the latest confirmed state is at. */
     int m_latest_confirmed_state_time;
 
+    /** Events and states which are not used anymore. They are reused
+     *  (including the memory of their buffers) instead of allocating new
+     *  ones. Events can be created by the network thread. */
+    std::vector<RewindInfoEvent*> m_free_events;
+    std::vector<RewindInfoState*> m_free_states;
+    std::mutex m_free_mutex;
 
     void cleanupOldRewindInfo(int ticks);
+    void freeRewindInfo(RewindInfo* ri);
+    RewindInfoEvent* getRewindInfoEvent(int ticks,
+                                        EventRewinder *event_rewinder,
+                                        const BareNetworkString *buffer,
+                                        bool confirmed);
+    // ------------------------------------------------------------------------
+    /** Returns the rewind info at the given index relative to the oldest
+     *  rewind info. */
+    RewindInfo*& at(unsigned i)
+    {
+        assert(i < m_ring_size);
+        return m_ring[(m_ring_start + i) & (m_ring.size() - 1)];
+    }   // at
 
 public:
         static void unitTesting();
@@ -64,18 +94,16 @@ public:
          RewindQueue();
         ~RewindQueue();
     void reset();
-    void addLocalEvent(EventRewinder *event_rewinder, BareNetworkString *buffer,
-                       bool confirmed, int ticks);
+    void addLocalEvent(EventRewinder *event_rewinder,
+                       const BareNetworkString *buffer, bool confirmed,
+                       int ticks);
     void addLocalState(BareNetworkString *buffer, bool confirmed, int ticks);
     void addNetworkEvent(EventRewinder *event_rewinder,
-                         BareNetworkString *buffer, int ticks);
+                         const BareNetworkString *buffer, int ticks);
     void addNetworkState(BareNetworkString *buffer, int ticks);
-    void addNetworkRewindInfo(RewindInfo* ri)
-    {
-        m_network_events.lock();
-        m_network_events.getData().push_back(ri);
-        m_network_events.unlock();
-    }
+    void addNetworkState(int ticks, int start_offset,
+                         std::vector<RewinderUsing>& rewinder_using,
+                         std::vector<uint8_t>& buffer);
     void mergeNetworkData(int world_ticks,  bool *needs_rewind, 
                           int *rewind_ticks);
     void replayAllEvents(int ticks);
@@ -95,7 +123,7 @@ public:
      *  RewindInfo element. */
     void next()
     {
-        assert(m_current != m_all_rewind_info.end());
+        assert(m_current < m_ring_size);
         m_current++;
         return;
     }   // operator++
@@ -105,7 +133,7 @@ public:
      *  least one more RewindInfo (see hasMoreRewindInfo()). */
     RewindInfo* getCurrent()
     {
-        return (m_current != m_all_rewind_info.end() ) ? *m_current : NULL;
+        return m_current < m_ring_size ? at(m_current) : NULL;
     }   // getNext
 
 };   // RewindQueue
@@ -26,6 +26,7 @@
 #include <vector>
 
 class BareNetworkString;
+class Vec3;
 
 enum RewinderName : char
 {
@@ -56,8 +57,17 @@ private:
     */
     std::string m_unique_identity;
 
+    /** Index in the rewinder table of the RewindManager, or -1 if this
+     *  rewinder was created after the table (e.g. a flyable), in which case
+     *  the unique identity is used in network states. */
+    int m_rewinder_id;
+
 public:
-    Rewinder(const std::string& ui = "")             { m_unique_identity = ui; }
+    Rewinder(const std::string& ui = "")
+    {
+        m_unique_identity = ui;
+        m_rewinder_id = -1;
+    }
 
     virtual ~Rewinder() {}
 
@@ -71,11 +81,15 @@ public:
     virtual void computeError() = 0;
 
     /** Provides a copy of the state of the object in one memory buffer.
-     *  The memory is managed by the RewindManager.
+     *  The buffer is managed by the RewindManager, which reuses it for all
+     *  rewinders and states.
+     *  \param[out] buffer The empty buffer to write the state to.
      *  \param[out] ru The unique identity of rewinder writing to.
-     *  \return The address of the memory buffer with the state.
+     *  \return True if a state was saved, false if this object needs no
+     *          state (anything written to buffer is then ignored).
      */
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru) = 0;
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru) = 0;
 
     /** Called when an event needs to be undone. This is called while going
      *  backwards for rewinding - all stored events will get an 'undo' call.
@@ -106,12 +120,21 @@ public:
     virtual std::function<void()> getLocalStateRestoreFunction()
                                                              { return nullptr; }
     // -------------------------------------------------------------------------
+    /** Used by the rewind profiler to compare the position predicted by a
+     *  client with the position in a confirmed state.
+     *  \return False if this object has no position to compare. */
+    virtual bool getRewindPosition(Vec3* xyz) const          { return false; }
+    // -------------------------------------------------------------------------
     const std::string& getUniqueIdentity() const
     {
         assert(!m_unique_identity.empty() && m_unique_identity.size() < 255);
         return m_unique_identity;
     }
     // -------------------------------------------------------------------------
+    void setRewinderId(int id)                          { m_rewinder_id = id; }
+    // -------------------------------------------------------------------------
+    int getRewinderId() const                          { return m_rewinder_id; }
+    // -------------------------------------------------------------------------
     bool rewinderAdd();
     // -------------------------------------------------------------------------
     template<typename T> std::shared_ptr<T> getShared()
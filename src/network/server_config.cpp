@@ -29,6 +29,8 @@
 // ============================================================================
 class UserConfigParam;
 static std::vector<UserConfigParam*> g_server_params;
+namespace ServerConfig { class ProcessServerConfigParam; }
+static std::vector<ServerConfig::ProcessServerConfigParam*> g_process_params;
 // ============================================================================
 
 // X-macros
@@ -38,6 +40,7 @@ static std::vector<UserConfigParam*> g_server_params;
 #include "network/server_config.hpp"
 #include "config/stk_config.hpp"
 #include "io/file_manager.hpp"
+#include "io/xml_node.hpp"
 #include "network/game_setup.hpp"
 #include "network/network_config.hpp"
 #include "network/protocols/lobby_protocol.hpp"
@@ -52,8 +55,25 @@ static std::vector<UserConfigParam*> g_server_params;
 namespace ServerConfig
 {
 // ============================================================================
-std::string g_server_config_path;
-std::string m_server_uid;
+/** Path of the config file and server uid (the file name without .xml) of
+ *  each process. Processes without their own config use the ones of the
+ *  main process. */
+std::string g_server_config_path[PT_COUNT];
+std::string g_server_uid[PT_COUNT];
+// ============================================================================
+/** Writes the value of a process in the same format as the write() of the
+ *  user config parameters. */
+template<typename T>
+static void writeProcessValue(std::stringstream& stream,
+                              const std::string& param_name,
+                              const std::string& comment, const T& value)
+{
+    if (comment.size() > 0)
+        stream << "    <!-- " << comment.c_str() << " -->\n";
+    stream << "    <" << param_name.c_str() << " value=\"" << value
+           << "\" />\n\n";
+}   // writeProcessValue
+
 // ============================================================================
 FloatServerConfigParam::FloatServerConfigParam(float default_value,
                                                const char* param_name,
@@ -64,8 +84,34 @@ FloatServerConfigParam::FloatServerConfigParam(float default_value,
     m_value = default_value;
     m_default_value = default_value;
     g_server_params.push_back(this);
+    g_process_params.push_back(this);
 }   // FloatServerConfigParam
 
+// ----------------------------------------------------------------------------
+void FloatServerConfigParam::writeProcess(ProcessType pt,
+                                          std::stringstream& stream) const
+{
+    const float* value = m_process_values.getProcess(pt);
+    if (!value)
+    {
+        write(stream);
+        return;
+    }
+    writeProcessValue(stream, m_param_name, m_comment, *value);
+}   // writeProcess
+
+// ----------------------------------------------------------------------------
+void FloatServerConfigParam::findProcessDataInAChildOf(ProcessType pt,
+                                                       const XMLNode* node)
+{
+    float* value = m_process_values.getProcess(pt);
+    const XMLNode* child = node->getNode(m_param_name);
+    if (!value || !child)
+        return;
+
+    child->get("value", value);
+}   // findProcessDataInAChildOf
+
 // ============================================================================
 IntServerConfigParam::IntServerConfigParam(int default_value,
                                            const char* param_name,
@@ -76,8 +122,34 @@ IntServerConfigParam::IntServerConfigParam(int default_value,
     m_value = default_value;
     m_default_value = default_value;
     g_server_params.push_back(this);
+    g_process_params.push_back(this);
 }   // IntServerConfigParam
 
+// ----------------------------------------------------------------------------
+void IntServerConfigParam::writeProcess(ProcessType pt,
+                                        std::stringstream& stream) const
+{
+    const int* value = m_process_values.getProcess(pt);
+    if (!value)
+    {
+        write(stream);
+        return;
+    }
+    writeProcessValue(stream, m_param_name, m_comment, *value);
+}   // writeProcess
+
+// ----------------------------------------------------------------------------
+void IntServerConfigParam::findProcessDataInAChildOf(ProcessType pt,
+                                                     const XMLNode* node)
+{
+    int* value = m_process_values.getProcess(pt);
+    const XMLNode* child = node->getNode(m_param_name);
+    if (!value || !child)
+        return;
+
+    child->get("value", value);
+}   // findProcessDataInAChildOf
+
 // ============================================================================
 BoolServerConfigParam::BoolServerConfigParam(bool default_value,
                                              const char* param_name,
@@ -88,8 +160,45 @@ BoolServerConfigParam::BoolServerConfigParam(bool default_value,
     m_value = default_value;
     m_default_value = default_value;
     g_server_params.push_back(this);
+    g_process_params.push_back(this);
 }   // BoolServerConfigParam
 
+// ----------------------------------------------------------------------------
+void BoolServerConfigParam::writeProcess(ProcessType pt,
+                                         std::stringstream& stream) const
+{
+    const bool* value = m_process_values.getProcess(pt);
+    if (!value)
+    {
+        write(stream);
+        return;
+    }
+    writeProcessValue(stream, m_param_name, m_comment,
+                      *value ? "true" : "false");
+}   // writeProcess
+
+// ----------------------------------------------------------------------------
+void BoolServerConfigParam::findProcessDataInAChildOf(ProcessType pt,
+                                                      const XMLNode* node)
+{
+    bool* value = m_process_values.getProcess(pt);
+    const XMLNode* child = node->getNode(m_param_name);
+    if (!value || !child)
+        return;
+
+    std::string text_value;
+    child->get("value", &text_value);
+    if (text_value == "true")
+        *value = true;
+    else if (text_value == "false")
+        *value = false;
+    else
+    {
+        Log::error("ServerConfig", "Unknown value for %s; expected true or "
+            "false", m_param_name.c_str());
+    }
+}   // findProcessDataInAChildOf
+
 // ============================================================================
 StringServerConfigParam::StringServerConfigParam(std::string default_value,
                                                  const char* param_name,
@@ -100,8 +209,34 @@ StringServerConfigParam::StringServerConfigParam(std::string default_value,
     m_value = default_value;
     m_default_value = default_value;
     g_server_params.push_back(this);
+    g_process_params.push_back(this);
 }   // StringServerConfigParam
 
+// ----------------------------------------------------------------------------
+void StringServerConfigParam::writeProcess(ProcessType pt,
+                                           std::stringstream& stream) const
+{
+    const std::string* value = m_process_values.getProcess(pt);
+    if (!value)
+    {
+        write(stream);
+        return;
+    }
+    writeProcessValue(stream, m_param_name, m_comment, value->c_str());
+}   // writeProcess
+
+// ----------------------------------------------------------------------------
+void StringServerConfigParam::findProcessDataInAChildOf(ProcessType pt,
+                                                        const XMLNode* node)
+{
+    std::string* value = m_process_values.getProcess(pt);
+    const XMLNode* child = node->getNode(m_param_name);
+    if (!value || !child)
+        return;
+
+    child->get("value", value);
+}   // findProcessDataInAChildOf
+
 // ============================================================================
 template<typename T, typename U>
 MapServerConfigParam<T, U>::MapServerConfigParam(const char* param_name,
@@ -115,26 +250,89 @@ MapServerConfigParam<T, U>::MapServerConfigParam(const char* param_name,
 }   // MapServerConfigParam
 
 // ============================================================================
+/** Returns the config file of the current process. */
+const std::string& getServerConfigPath()
+{
+    const std::string& path = g_server_config_path[STKProcess::getType()];
+    return path.empty() ? g_server_config_path[PT_MAIN] : path;
+}   // getServerConfigPath
+
+// ----------------------------------------------------------------------------
+/** Server uid of the current process, extracted from its config file name
+ *  with .xml removed. */
+const std::string& getServerUid()
+{
+    const std::string& uid = g_server_uid[STKProcess::getType()];
+    return uid.empty() ? g_server_uid[PT_MAIN] : uid;
+}   // getServerUid
+
+// ----------------------------------------------------------------------------
 void loadServerConfig(const std::string& path)
 {
     bool default_config = false;
     if (path.empty())
     {
         default_config = true;
-        g_server_config_path =
+        g_server_config_path[PT_MAIN] =
             file_manager->getUserConfigFile("server_config.xml");
     }
     else
     {
-        g_server_config_path = file_manager->getFileSystem()
+        g_server_config_path[PT_MAIN] = file_manager->getFileSystem()
             ->getAbsolutePath(path.c_str()).c_str();
     }
-    m_server_uid = StringUtils::removeExtension(
-        StringUtils::getBasename(g_server_config_path));
-    const XMLNode* root = file_manager->createXMLTree(g_server_config_path);
+    g_server_uid[PT_MAIN] = StringUtils::removeExtension(
+        StringUtils::getBasename(g_server_config_path[PT_MAIN]));
+    const XMLNode* root =
+        file_manager->createXMLTree(g_server_config_path[PT_MAIN]);
     loadServerConfigXML(root, default_config);
 }   // loadServerConfig
 
+// ----------------------------------------------------------------------------
+/** Gives a room its own copy of the current values, and replaces them with
+ *  the values found in the room config. The normal values used by the main
+ *  process and the other rooms are never changed.
+ */
+static void loadRoomConfigXML(ProcessType pt, const XMLNode* root)
+{
+    for (ProcessServerConfigParam* param : g_process_params)
+    {
+        param->copyToProcess(pt);
+        param->findProcessDataInAChildOf(pt, root);
+    }
+}   // loadRoomConfigXML
+
+// ----------------------------------------------------------------------------
+/** Loads the config of a room of a server which hosts several lobbies in one
+ *  process. The room starts with the values of the main config, which are
+ *  replaced by all values found in the room file, so that a room file only
+ *  needs to list what is different. Must be called before the room starts.
+ *  \param pt The process type of the room.
+ *  \param path Path of the room config file.
+ *  \return False if the file can not be read.
+ */
+bool loadRoomConfig(ProcessType pt, const std::string& path)
+{
+    assert(STKProcess::isRoom(pt));
+    std::string full_path = file_manager->getFileSystem()
+        ->getAbsolutePath(path.c_str()).c_str();
+    const XMLNode* root = file_manager->createXMLTree(full_path);
+    if (!root || root->getName() != "server-config")
+    {
+        Log::error("ServerConfig", "Could not read room config file '%s'.",
+            full_path.c_str());
+        delete root;
+        return false;
+    }
+    g_server_config_path[pt] = full_path;
+    g_server_uid[pt] = StringUtils::removeExtension(
+        StringUtils::getBasename(full_path));
+
+    loadRoomConfigXML(pt, root);
+    delete root;
+    return true;
+}   // loadRoomConfig
+
 // ----------------------------------------------------------------------------
 void loadServerConfigXML(const XMLNode* root, bool default_config)
 {
@@ -142,7 +340,7 @@ void loadServerConfigXML(const XMLNode* root, bool default_config)
     {
         Log::info("ServerConfig",
             "Could not read server config file '%s'. "
-            "A new file will be created.", g_server_config_path.c_str());
+            "A new file will be created.", getServerConfigPath().c_str());
         if (root)
             delete root;
         writeServerConfigToDisk();
@@ -175,8 +373,16 @@ std::string getServerConfigXML()
     ss << "<?xml version=\"1.0\"?>\n";
     ss << "<server-config version=\"" << m_server_version << "\" >\n\n";
 
+    ProcessType pt = STKProcess::getType();
     for (unsigned i = 0; i < g_server_params.size(); i++)
-        g_server_params[i]->write(ss);
+    {
+        ProcessServerConfigParam* process_param =
+            dynamic_cast<ProcessServerConfigParam*>(g_server_params[i]);
+        if (STKProcess::isRoom(pt) && process_param)
+            process_param->writeProcess(pt, ss);
+        else
+            g_server_params[i]->write(ss);
+    }
 
     ss << "</server-config>\n";
     return ss.str();
@@ -186,20 +392,21 @@ std::string getServerConfigXML()
 void writeServerConfigToDisk()
 {
     const std::string& config_xml = getServerConfigXML();
+    const std::string& config_path = getServerConfigPath();
     try
     {
         // Save to a new file and rename later to avoid disk space problem, see #4709
         std::ofstream configfile(FileUtils::getPortableWritingPath(
-            g_server_config_path + "new"), std::ofstream::out);
+            config_path + "new"), std::ofstream::out);
         configfile << config_xml;
         configfile.close();
-        file_manager->removeFile(g_server_config_path);
-        FileUtils::renameU8Path(g_server_config_path + "new", g_server_config_path);
+        file_manager->removeFile(config_path);
+        FileUtils::renameU8Path(config_path + "new", config_path);
     }
     catch (std::runtime_error& e)
     {
         Log::error("ServerConfig", "Failed to write server config to %s, "
-            "because %s", g_server_config_path.c_str(), e.what());
+            "because %s", config_path.c_str(), e.what());
     }
 }   // writeServerConfigToDisk
 
@@ -411,8 +618,61 @@ void loadServerLobbyFromConfig()
 // ----------------------------------------------------------------------------
 std::string getConfigDirectory()
 {
-    return StringUtils::getPath(g_server_config_path);
+    return StringUtils::getPath(getServerConfigPath());
 }   // getConfigDirectory
 
+// ----------------------------------------------------------------------------
+/** Tests that the values of a room are loaded and written without changing
+ *  the normal values of the main process. */
+void unitTesting()
+{
+    const ProcessType room = PT_FIRST_ROOM;
+    const int max_players = m_server_max_players;
+    const std::string motd = m_motd;
+    const bool ranked = m_ranked;
+    m_server_max_players = 8;
+    m_motd = "main motd";
+    m_ranked = false;
+
+    XMLNode* root = file_manager->createXMLTreeFromString(
+        "<server-config version=\"6\">\n"
+        "    <server-max-players value=\"4\" />\n"
+        "    <ranked value=\"true\" />\n"
+        "</server-config>\n");
+    loadRoomConfigXML(room, root);
+    delete root;
+
+    if (m_server_max_players != 8 || m_ranked ||
+        m_motd.c_str() != std::string("main motd"))
+        Log::fatal("ServerConfig", "Room config changed the main values.");
+
+    STKProcess::init(room);
+    if (m_server_max_players != 4 || !m_ranked)
+        Log::fatal("ServerConfig", "Room values were not loaded.");
+    if (m_motd.c_str() != std::string("main motd"))
+        Log::fatal("ServerConfig", "Room did not inherit the main value.");
+    m_motd = "room motd";
+    const std::string room_xml = getServerConfigXML();
+    STKProcess::init(PT_MAIN);
+
+    if (m_motd.c_str() != std::string("main motd"))
+        Log::fatal("ServerConfig", "Room value changed the main value.");
+    const std::string main_xml = getServerConfigXML();
+    if (room_xml.find("<server-max-players value=\"4\" />") ==
+        std::string::npos ||
+        room_xml.find("<ranked value=\"true\" />") == std::string::npos ||
+        room_xml.find("<motd value=\"room motd\" />") == std::string::npos)
+        Log::fatal("ServerConfig", "Room values were not written.");
+    if (main_xml.find("<server-max-players value=\"8\" />") ==
+        std::string::npos ||
+        main_xml.find("<ranked value=\"false\" />") == std::string::npos ||
+        main_xml.find("<motd value=\"main motd\" />") == std::string::npos)
+        Log::fatal("ServerConfig", "Main values were not written.");
+
+    m_server_max_players = max_players;
+    m_motd = motd;
+    m_ranked = ranked;
+}   // unitTesting
+
 }
 
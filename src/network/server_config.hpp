@@ -30,6 +30,10 @@
 #define SERVER_CFG_DEFAULT(X)
 #endif
 
+#include "utils/stk_process.hpp"
+
+#include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -38,36 +42,130 @@ class XMLNode;
 namespace ServerConfig
 {
     // ========================================================================
-    class FloatServerConfigParam : public FloatUserConfigParam
+    /** Interface of the parameters which can have a different value in each
+     *  room of a server hosting several lobbies in one process. */
+    class ProcessServerConfigParam
+    {
+    public:
+        virtual ~ProcessServerConfigParam() {}
+        /** Gives the process its own copy of the current value. */
+        virtual void copyToProcess(ProcessType pt) = 0;
+        /** Writes the value of the process in the same format as write(). */
+        virtual void writeProcess(ProcessType pt,
+                                  std::stringstream& stream) const = 0;
+        /** Reads the value of the process from a child of the node, the
+         *  normal value is not changed. */
+        virtual void findProcessDataInAChildOf(ProcessType pt,
+                                               const XMLNode* node) = 0;
+    };
+    // ========================================================================
+    /** The values of a parameter for the processes which have their own
+     *  value, all other processes use the normal value. */
+    template<typename T>
+    class ProcessValues
+    {
+    private:
+        std::unique_ptr<T> m_values[PT_COUNT];
+    public:
+        T& get(T& value)
+        {
+            std::unique_ptr<T>& v = m_values[STKProcess::getType()];
+            return v ? *v : value;
+        }
+        // --------------------------------------------------------------------
+        const T& get(const T& value) const
+        {
+            const std::unique_ptr<T>& v = m_values[STKProcess::getType()];
+            return v ? *v : value;
+        }
+        // --------------------------------------------------------------------
+        /** Returns the value of a process, or NULL if it uses the normal
+         *  value. */
+        T* getProcess(ProcessType pt)             { return m_values[pt].get(); }
+        // --------------------------------------------------------------------
+        const T* getProcess(ProcessType pt) const { return m_values[pt].get(); }
+        // --------------------------------------------------------------------
+        void copy(ProcessType pt, const T& value)
+                                           { m_values[pt].reset(new T(value)); }
+    };
+    // ========================================================================
+    class FloatServerConfigParam : public FloatUserConfigParam,
+                                   public ProcessServerConfigParam
     {
+    private:
+        ProcessValues<float> m_process_values;
     public:
         FloatServerConfigParam(float default_value, const char* param_name,
                                const char* comment);
-        using FloatUserConfigParam::operator=;
+        void copyToProcess(ProcessType pt)
+                                     { m_process_values.copy(pt, m_value); }
+        void writeProcess(ProcessType pt, std::stringstream& stream) const;
+        void findProcessDataInAChildOf(ProcessType pt, const XMLNode* node);
+        void revertToDefaults()
+                        { m_process_values.get(m_value) = m_default_value; }
+        operator float() const   { return m_process_values.get(m_value); }
+        float& operator=(const float& v)
+                                  { return m_process_values.get(m_value) = v; }
     };
     // ========================================================================
-    class IntServerConfigParam : public IntUserConfigParam
+    class IntServerConfigParam : public IntUserConfigParam,
+                                 public ProcessServerConfigParam
     {
+    private:
+        ProcessValues<int> m_process_values;
     public:
         IntServerConfigParam(int default_value, const char* param_name,
                              const char* comment);
-        using IntUserConfigParam::operator=;
+        void copyToProcess(ProcessType pt)
+                                     { m_process_values.copy(pt, m_value); }
+        void writeProcess(ProcessType pt, std::stringstream& stream) const;
+        void findProcessDataInAChildOf(ProcessType pt, const XMLNode* node);
+        void revertToDefaults()
+                        { m_process_values.get(m_value) = m_default_value; }
+        operator int() const     { return m_process_values.get(m_value); }
+        int& operator=(const int& v)
+                                  { return m_process_values.get(m_value) = v; }
     };
     // ========================================================================
-    class BoolServerConfigParam : public BoolUserConfigParam
+    class BoolServerConfigParam : public BoolUserConfigParam,
+                                  public ProcessServerConfigParam
     {
+    private:
+        ProcessValues<bool> m_process_values;
     public:
         BoolServerConfigParam(bool default_value, const char* param_name,
                               const char* comment);
-        using BoolUserConfigParam::operator=;
+        void copyToProcess(ProcessType pt)
+                                     { m_process_values.copy(pt, m_value); }
+        void writeProcess(ProcessType pt, std::stringstream& stream) const;
+        void findProcessDataInAChildOf(ProcessType pt, const XMLNode* node);
+        void revertToDefaults()
+                        { m_process_values.get(m_value) = m_default_value; }
+        operator bool() const    { return m_process_values.get(m_value); }
+        bool& operator=(const bool& v)
+                                  { return m_process_values.get(m_value) = v; }
     };
     // ========================================================================
-    class StringServerConfigParam : public StringUserConfigParam
+    class StringServerConfigParam : public StringUserConfigParam,
+                                    public ProcessServerConfigParam
     {
+    private:
+        ProcessValues<std::string> m_process_values;
     public:
         StringServerConfigParam(std::string default_value,
                                 const char* param_name, const char* comment);
-        using StringUserConfigParam::operator=;
+        void copyToProcess(ProcessType pt)
+                                     { m_process_values.copy(pt, m_value); }
+        void writeProcess(ProcessType pt, std::stringstream& stream) const;
+        void findProcessDataInAChildOf(ProcessType pt, const XMLNode* node);
+        void revertToDefaults()
+                        { m_process_values.get(m_value) = m_default_value; }
+        operator std::string() const
+                                     { return m_process_values.get(m_value); }
+        std::string& operator=(const std::string& v)
+                                  { return m_process_values.get(m_value) = v; }
+        const char* c_str() const
+                             { return m_process_values.get(m_value).c_str(); }
     };
     // ========================================================================
     template<typename T, typename U>
@@ -457,15 +555,18 @@ namespace ServerConfig
      *  changes. */
     static const uint32_t m_server_db_version = 1;
     // ========================================================================
-    /** Server uid, extracted from server_config.xml file with .xml removed. */
-    extern std::string m_server_uid;
-    // ========================================================================
     void loadServerConfig(const std::string& path = "");
     // ------------------------------------------------------------------------
+    bool loadRoomConfig(ProcessType pt, const std::string& path);
+    // ------------------------------------------------------------------------
+    const std::string& getServerUid();
+    // ------------------------------------------------------------------------
     void loadServerConfigXML(const XMLNode* root, bool default_config = false);
     // ------------------------------------------------------------------------
     std::string getServerConfigXML();
     // ------------------------------------------------------------------------
+    void unitTesting();
+    // ------------------------------------------------------------------------
     void writeServerConfigToDisk();
     // ------------------------------------------------------------------------
     std::pair<RaceManager::MinorRaceModeType, RaceManager::MajorRaceModeType>
@@ -0,0 +1,117 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/server_rooms.hpp"
+
+#include "io/file_manager.hpp"
+#include "io/xml_node.hpp"
+#include "network/child_loop.hpp"
+#include "network/network_config.hpp"
+#include "network/server_config.hpp"
+#include "utils/log.hpp"
+#include "utils/stk_process.hpp"
+#include "utils/string_utils.hpp"
+
+#include <memory>
+
+std::string              ServerRooms::m_rooms_file;
+std::vector<ChildLoop*>  ServerRooms::m_rooms;
+std::vector<std::thread> ServerRooms::m_threads;
+
+// ----------------------------------------------------------------------------
+/** Loads the config of all rooms and starts them. This is called in the
+ *  main process instead of creating its own server lobby, after the server
+ *  config of the main process is loaded (including all command line
+ *  options), since the rooms use it for all values missing in their config.
+ *  \param lan_server True if all rooms are LAN servers, otherwise they
+ *         are WAN servers which use the online account of the main process.
+ *  \return True if at least one room was started.
+ */
+bool ServerRooms::start(bool lan_server)
+{
+    std::unique_ptr<XMLNode> root(file_manager->createXMLTree(m_rooms_file));
+    if (!root || root->getName() != "server-rooms")
+    {
+        Log::error("ServerRooms", "Can't read rooms file '%s'.",
+                   m_rooms_file.c_str());
+        return false;
+    }
+    const std::string dir = StringUtils::getPath(m_rooms_file);
+
+    ChildLoopConfig clc;
+    clc.m_lan_server = lan_server;
+    clc.m_login_id = NetworkConfig::get()->getCurrentUserId();
+    clc.m_token = NetworkConfig::get()->getCurrentUserToken();
+    clc.m_server_ai = NetworkConfig::get()->getNumFixedAI();
+
+    for (unsigned i = 0; i < root->getNumNodes(); i++)
+    {
+        const XMLNode* node = root->getNode(i);
+        std::string config;
+        if (node->getName() != "room" || !node->get("config", &config))
+        {
+            Log::warn("ServerRooms", "Ignoring invalid entry %d in '%s'.",
+                      i, m_rooms_file.c_str());
+            continue;
+        }
+        if (m_rooms.size() == PT_COUNT - PT_FIRST_ROOM)
+        {
+            Log::error("ServerRooms", "Only %d rooms are supported.",
+                       PT_COUNT - PT_FIRST_ROOM);
+            break;
+        }
+        if (!dir.empty() && !StringUtils::startsWith(config, "/"))
+            config = dir + "/" + config;
+        clc.m_process_type = ProcessType(PT_FIRST_ROOM + m_rooms.size());
+        if (!ServerConfig::loadRoomConfig(clc.m_process_type, config))
+            continue;
+
+        ChildLoop* cl = new ChildLoop(clc);
+        m_rooms.push_back(cl);
+        m_threads.emplace_back(&ChildLoop::run, cl);
+        Log::info("ServerRooms", "Started room %d with '%s'.",
+                  (int)m_rooms.size() - 1, config.c_str());
+    }
+    return !m_rooms.empty();
+}   // start
+
+// ----------------------------------------------------------------------------
+/** Returns true as long as any room is running. */
+bool ServerRooms::isRunning()
+{
+    for (ChildLoop* cl : m_rooms)
+    {
+        if (!cl->isStopped())
+            return true;
+    }
+    return false;
+}   // isRunning
+
+// ----------------------------------------------------------------------------
+/** Stops all rooms and waits for their threads to end. */
+void ServerRooms::stop()
+{
+    for (ChildLoop* cl : m_rooms)
+        cl->abort();
+    for (std::thread& t : m_threads)
+        t.join();
+    for (ChildLoop* cl : m_rooms)
+        delete cl;
+    m_rooms.clear();
+    m_threads.clear();
+}   // stop
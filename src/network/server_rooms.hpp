@@ -0,0 +1,68 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_SERVER_ROOMS_HPP
+#define HEADER_SERVER_ROOMS_HPP
+
+#include <string>
+#include <thread>
+#include <vector>
+
+class ChildLoop;
+
+/** \ingroup network
+ *  Hosts several independent lobbies (rooms) in one server process. Each
+ *  room runs a ChildLoop in its own thread with its own ProcessType, so it
+ *  has its own STKHost (listening on its own port), ProtocolManager,
+ *  RaceManager, World and so on, while karts, tracks, textures and the
+ *  worker pool are shared. The rooms are listed in an xml file, started
+ *  with --server-rooms=file:
+ *
+ *  <server-rooms>
+ *      <room config="room1.xml"/>
+ *      <room config="room2.xml"/>
+ *  </server-rooms>
+ *
+ *  The config file of each room (relative to the rooms file) is a normal
+ *  server config, but all values which are not in it are taken from the
+ *  server config of the main process.
+ */
+class ServerRooms
+{
+private:
+    /** The rooms file, empty if the server has only one lobby. */
+    static std::string m_rooms_file;
+
+    static std::vector<ChildLoop*> m_rooms;
+
+    static std::vector<std::thread> m_threads;
+
+public:
+    static bool start(bool lan_server);
+    // ------------------------------------------------------------------------
+    static bool isRunning();
+    // ------------------------------------------------------------------------
+    static void stop();
+    // ------------------------------------------------------------------------
+    static void setRoomsFile(const std::string& filename)
+                                                 { m_rooms_file = filename; }
+    // ------------------------------------------------------------------------
+    static bool isEnabled()                { return !m_rooms_file.empty(); }
+};   // ServerRooms
+
+#endif
@@ -34,12 +34,14 @@
 #include "network/protocol_manager.hpp"
 #include "network/server_config.hpp"
 #include "network/child_loop.hpp"
+#include "network/crypto.hpp"
 #include "network/stk_ipv6.hpp"
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/time.hpp"
 #include "utils/vs.hpp"
+#include "utils/worker_pool.hpp"
 
 #include <string.h>
 #if defined(WIN32)
@@ -334,8 +336,9 @@ void STKHost::init()
     Network::openLog();  // Open packet log file
     ProtocolManager::createInstance();
 
-    // Optional: start the network console
-    if (m_enable_console)
+    // Optional: start the network console, the rooms of a multi room
+    // server don't read from stdin
+    if (m_enable_console && !STKProcess::isRoom())
     {
         m_network_console = std::thread(std::bind(&NetworkConsole::mainLoop,
             this));
@@ -370,6 +373,12 @@ STKHost::~STKHost()
             ENetPacket* packet = std::get<1>(p);
             enet_packet_destroy(packet);
         }
+        else if (std::get<3>(p) == ECT_RELEASE_PACKET)
+        {
+            ENetPacket* packet = std::get<1>(p);
+            if (--packet->referenceCount == 0)
+                enet_packet_destroy(packet);
+        }
     }
     delete m_network;
     enet_deinitialize();
@@ -792,9 +801,7 @@ void STKHost::stopListening()
  */
 void STKHost::mainLoop(ProcessType pt)
 {
-    std::string thread_name = "STKHost";
-    if (pt == PT_CHILD)
-        thread_name += "_child";
+    std::string thread_name = "STKHost" + STKProcess::getThreadNameSuffix(pt);
     VS::setThreadName(thread_name.c_str());
 
     STKProcess::init(pt);
@@ -1003,8 +1010,15 @@ void STKHost::mainLoop(ProcessType pt)
         {
             ENetPeer* peer = std::get<0>(p);
             ENetAddress& ea = std::get<4>(p);
-            ENetAddress& ea_peer_now = peer->address;
             ENetPacket* packet = std::get<1>(p);
+            if (std::get<3>(p) == ECT_RELEASE_PACKET)
+            {
+                // All sends of this shared packet are done (or dropped)
+                if (--packet->referenceCount == 0)
+                    enet_packet_destroy(packet);
+                continue;
+            }
+            ENetAddress& ea_peer_now = peer->address;
             // Enet will reuse a disconnected peer so we check here to avoid
             // sending to wrong peer
             if (peer->state != ENET_PEER_STATE_CONNECTED ||
@@ -1015,13 +1029,19 @@ void STKHost::mainLoop(ProcessType pt)
                 (ea_peer_now.host != ea.host && ea_peer_now.port != ea.port))
 #endif
             {
-                if (packet != NULL)
+                if (packet != NULL && std::get<3>(p) != ECT_SEND_SHARED_PACKET)
                     enet_packet_destroy(packet);
                 continue;
             }
 
             switch (std::get<3>(p))
             {
+            case ECT_SEND_SHARED_PACKET:
+                // The packet is kept alive until ECT_RELEASE_PACKET
+                enet_peer_send(peer, (uint8_t)std::get<2>(p), packet);
+                break;
+            case ECT_RELEASE_PACKET:
+                break;
             case ECT_SEND_PACKET:
             {
                 // If enet_peer_send failed, destroy the packet to
@@ -1340,11 +1360,13 @@ std::shared_ptr<STKPeer> STKHost::getServerPeerForClient() const
 void STKHost::sendPacketToAllPeersInServer(NetworkString *data, bool reliable)
 {
     std::lock_guard<std::mutex> lock(m_peers_mutex);
+    std::vector<std::pair<STKPeer*, NetworkString*> > messages;
     for (auto p : m_peers)
     {
         if (p.second->isValidated())
-            p.second->sendPacket(data, reliable);
+            messages.emplace_back(p.second.get(), data);
     }
+    sendPackets(messages, reliable);
 }   // sendPacketToAllPeersInServer
 
 //-----------------------------------------------------------------------------
@@ -1355,11 +1377,13 @@ void STKHost::sendPacketToAllPeersInServer(NetworkString *data, bool reliable)
 void STKHost::sendPacketToAllPeers(NetworkString *data, bool reliable)
 {
     std::lock_guard<std::mutex> lock(m_peers_mutex);
+    std::vector<std::pair<STKPeer*, NetworkString*> > messages;
     for (auto p : m_peers)
     {
         if (p.second->isValidated() && !p.second->isWaitingForGame())
-            p.second->sendPacket(data, reliable);
+            messages.emplace_back(p.second.get(), data);
     }
+    sendPackets(messages, reliable);
 }   // sendPacketToAllPeers
 
 //-----------------------------------------------------------------------------
@@ -1372,15 +1396,17 @@ void STKHost::sendPacketExcept(STKPeer* peer, NetworkString *data,
                                bool reliable)
 {
     std::lock_guard<std::mutex> lock(m_peers_mutex);
+    std::vector<std::pair<STKPeer*, NetworkString*> > messages;
     for (auto p : m_peers)
     {
         STKPeer* stk_peer = p.second.get();
         if (!stk_peer->isSamePeer(peer) && p.second->isValidated() &&
             !p.second->isWaitingForGame())
         {
-            stk_peer->sendPacket(data, reliable);
+            messages.emplace_back(stk_peer, data);
         }
     }
+    sendPackets(messages, reliable);
 }   // sendPacketExcept
 
 //-----------------------------------------------------------------------------
@@ -1393,16 +1419,210 @@ void STKHost::sendPacketToAllPeersWith(std::function<bool(STKPeer*)> predicate,
                                        NetworkString* data, bool reliable)
 {
     std::lock_guard<std::mutex> lock(m_peers_mutex);
+    std::vector<std::pair<STKPeer*, NetworkString*> > messages;
     for (auto p : m_peers)
     {
         STKPeer* stk_peer = p.second.get();
         if (!stk_peer->isValidated())
             continue;
         if (predicate(stk_peer))
-            stk_peer->sendPacket(data, reliable);
+            messages.emplace_back(stk_peer, data);
     }
+    sendPackets(messages, reliable);
 }   // sendPacketToAllPeersWith
 
+//-----------------------------------------------------------------------------
+/** Sends a message to each of several peers (usually the same message to all
+ *  of them). The messages for peers with encryption are encrypted in
+ *  parallel, and peers without encryption which get the same message share
+ *  one ENet packet. The caller must keep the peers alive during this call.
+ *  \param messages The peers and the message for each peer.
+ *  \param reliable If the data should be sent reliable or not.
+ */
+void STKHost::sendPackets(const std::vector<std::pair<STKPeer*,
+                          NetworkString*> >& messages, bool reliable)
+{
+    std::vector<std::pair<Crypto*, NetworkString*> > to_encrypt;
+    to_encrypt.reserve(messages.size());
+    for (auto& m : messages)
+    {
+        to_encrypt.emplace_back(m.first->isDisconnected() ?
+            NULL : m.first->getCrypto(), m.second);
+    }
+    std::vector<ENetPacket*> packets;
+    encryptPackets(to_encrypt, reliable, &packets);
+
+    // One packet for each different unencrypted message
+    std::vector<std::pair<NetworkString*, ENetPacket*> > shared;
+    std::lock_guard<std::mutex> lock(m_enet_cmd_mutex);
+    for (unsigned i = 0; i < messages.size(); i++)
+    {
+        STKPeer* peer = messages[i].first;
+        if (peer->isDisconnected())
+        {
+            // The peer can be disconnected after its packet was encrypted
+            if (packets[i])
+                enet_packet_destroy(packets[i]);
+            continue;
+        }
+        ENetPacket* packet = packets[i];
+        ENetCommandType ect = ECT_SEND_PACKET;
+        if (!peer->getCrypto())
+        {
+            NetworkString* data = messages[i].second;
+            auto it = std::find_if(shared.begin(), shared.end(),
+                [data](const std::pair<NetworkString*, ENetPacket*>& s)
+                {
+                    return s.first == data;
+                });
+            if (it == shared.end())
+            {
+                packet = enet_packet_create(data->getData(),
+                    data->getTotalSize(), (reliable ?
+                    ENET_PACKET_FLAG_RELIABLE :
+                    (ENET_PACKET_FLAG_UNSEQUENCED |
+                    ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT)));
+                if (packet == NULL)
+                    continue;
+                // Released by the ECT_RELEASE_PACKET command below
+                packet->referenceCount = 1;
+                shared.emplace_back(data, packet);
+            }
+            else
+                packet = it->second;
+            ect = ECT_SEND_SHARED_PACKET;
+        }
+        if (packet == NULL)
+            continue;
+        if (Network::m_connection_debug)
+        {
+            Log::verbose("STKPeer", "sending packet of size %d to %s at %lf",
+                packet->dataLength, peer->getAddress().toString().c_str(),
+                StkTime::getRealTime());
+        }
+        m_enet_cmd.emplace_back(peer->getENetPeer(), packet,
+            EVENT_CHANNEL_NORMAL, ect, peer->getENetAddress());
+    }
+    ENetAddress no_address = {};
+    for (auto& s : shared)
+    {
+        m_enet_cmd.emplace_back((ENetPeer*)NULL, s.second, 0,
+            ECT_RELEASE_PACKET, no_address);
+    }
+}   // sendPackets
+
+//-----------------------------------------------------------------------------
+/** Encrypts messages, in parallel if there are enough of them.
+ *  \param messages The crypto object and message for each packet. If the
+ *         crypto object is NULL, no packet is created.
+ *  \param reliable If the packets should be sent reliable or not.
+ *  \param packets On return the packet for each message, or NULL.
+ */
+void STKHost::encryptPackets(
+    const std::vector<std::pair<Crypto*, NetworkString*> >& messages,
+    bool reliable, std::vector<ENetPacket*>* packets)
+{
+    packets->assign(messages.size(), NULL);
+    unsigned count = 0;
+    for (auto& m : messages)
+    {
+        if (m.first)
+            count++;
+    }
+    auto encrypt = [&messages, reliable, packets](unsigned i)
+        {
+            if (messages[i].first)
+            {
+                (*packets)[i] = messages[i].first->encryptSend(
+                    *messages[i].second, reliable);
+            }
+        };
+    // Below this the thread handover costs more than the encryption
+    if (count < 4)
+    {
+        for (unsigned i = 0; i < messages.size(); i++)
+            encrypt(i);
+    }
+    else
+        WorkerPool::get()->parallelFor((unsigned)messages.size(), encrypt);
+}   // encryptPackets
+
+//-----------------------------------------------------------------------------
+/** Measures the cost of sending one game state to an increasing number of
+ *  peers: encrypting the message for each peer one after the other (as
+ *  STKPeer::sendPacket does) compared with encryptPackets, and creating one
+ *  unencrypted packet per peer compared with one shared packet.
+ */
+void STKHost::benchmarkBroadcast()
+{
+    // About the size of a game state with a few karts
+    NetworkString state(PROTOCOL_CONTROLLER_EVENTS, 1200);
+    for (int i = 0; i < 1200; i++)
+        state.addUInt8((uint8_t)i);
+    const int rounds = 2000;
+    Log::info("STKHost", "Broadcast of %d bytes, %d rounds, %u threads:",
+        state.getTotalSize(), rounds, WorkerPool::get()->getNumThreads());
+
+    std::vector<uint8_t> key(16), iv(12);
+    std::mt19937 g(42);
+    for (unsigned peers = 1; peers <= 128; peers *= 2)
+    {
+        std::vector<std::unique_ptr<Crypto> > cryptos;
+        std::vector<std::pair<Crypto*, NetworkString*> > messages;
+        for (unsigned i = 0; i < peers; i++)
+        {
+            for (uint8_t& k : key)
+                k = (uint8_t)g();
+            for (uint8_t& v : iv)
+                v = (uint8_t)g();
+            cryptos.emplace_back(new Crypto(key, iv));
+            messages.emplace_back(cryptos.back().get(), &state);
+        }
+        std::vector<ENetPacket*> packets;
+
+        double start = StkTime::getRealTime();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (auto& c : cryptos)
+                enet_packet_destroy(c->encryptSend(state, false));
+        }
+        double sequential = StkTime::getRealTime() - start;
+
+        start = StkTime::getRealTime();
+        for (int r = 0; r < rounds; r++)
+        {
+            encryptPackets(messages, false, &packets);
+            for (ENetPacket* p : packets)
+                enet_packet_destroy(p);
+        }
+        double parallel = StkTime::getRealTime() - start;
+
+        start = StkTime::getRealTime();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (unsigned i = 0; i < peers; i++)
+            {
+                enet_packet_destroy(enet_packet_create(state.getData(),
+                    state.getTotalSize(), ENET_PACKET_FLAG_UNSEQUENCED));
+            }
+        }
+        double copied = StkTime::getRealTime() - start;
+
+        start = StkTime::getRealTime();
+        for (int r = 0; r < rounds; r++)
+        {
+            enet_packet_destroy(enet_packet_create(state.getData(),
+                state.getTotalSize(), ENET_PACKET_FLAG_UNSEQUENCED));
+        }
+        double shared = StkTime::getRealTime() - start;
+
+        Log::info("STKHost", "%3u peers: encrypted %8.2lf us -> %8.2lf us, "
+            "unencrypted %7.2lf us -> %5.2lf us per broadcast.", peers,
+            sequential * 1e6 / rounds, parallel * 1e6 / rounds,
+            copied * 1e6 / rounds, shared * 1e6 / rounds);
+    }
+}   // benchmarkBroadcast
+
 //-----------------------------------------------------------------------------
 /** Sends a message from a client to the server. */
 void STKHost::sendToServer(NetworkString *data, bool reliable)
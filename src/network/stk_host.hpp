@@ -48,6 +48,7 @@
 #include <vector>
 
 class BareNetworkString;
+class Crypto;
 class GameSetup;
 class LobbyProtocol;
 class Network;
@@ -66,7 +67,12 @@ enum ENetCommandType : unsigned int
 {
     ECT_SEND_PACKET = 0,
     ECT_DISCONNECT = 1,
-    ECT_RESET = 2
+    ECT_RESET = 2,
+    /** Sends a packet which is also sent to other peers, and which is only
+     *  destroyed by the following ECT_RELEASE_PACKET. */
+    ECT_SEND_SHARED_PACKET = 3,
+    /** Releases the reference to a shared packet (the peer is NULL). */
+    ECT_RELEASE_PACKET = 4
 };
 
 class STKHost
@@ -251,6 +257,15 @@ public:
     void sendPacketToAllPeersWith(std::function<bool(STKPeer*)> predicate,
                                   NetworkString* data, bool reliable = true);
     // ------------------------------------------------------------------------
+    void sendPackets(const std::vector<std::pair<STKPeer*, NetworkString*> >&
+                     messages, bool reliable = true);
+    // ------------------------------------------------------------------------
+    static void encryptPackets(
+        const std::vector<std::pair<Crypto*, NetworkString*> >& messages,
+        bool reliable, std::vector<ENetPacket*>* packets);
+    // ------------------------------------------------------------------------
+    static void benchmarkBroadcast();
+    // ------------------------------------------------------------------------
     /** Returns true if this client instance is allowed to control the server.
      *  It will auto transfer ownership if previous server owner disconnected.
      */
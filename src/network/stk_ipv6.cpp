@@ -444,13 +444,26 @@ extern "C" int64_t upperIPv6(const char* ipv6)
 }
 
 // ----------------------------------------------------------------------------
-extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
+extern "C" int parseIPv6(const char* ipv6, unsigned char* result)
 {
-    const char* mask_location = strchr(ipv6_cidr, '/');
-    if (mask_location == NULL)
-        return 0;
     struct in6_addr v6_in;
-    if (stk_inet_pton6(ipv6_in, &v6_in) != 1)
+    if (stk_inet_pton6(ipv6, &v6_in) != 1)
+        return 0;
+    memcpy(result, v6_in.s6_addr, 16);
+    return 1;
+}   // parseIPv6
+
+// ----------------------------------------------------------------------------
+/** Parses an IPv6 CIDR block like 2001::/64 into its 16 byte prefix, with all
+ *  bits after the mask length cleared, and the mask length.
+ *  \return 1 if the CIDR block is valid, 0 otherwise.
+ */
+extern "C" int parseIPv6CIDR(const char* ipv6_cidr, unsigned char* prefix,
+                             int* mask_length)
+{
+    const char* mask_location = strchr(ipv6_cidr, '/');
+    if (mask_location == NULL ||
+        mask_location - ipv6_cidr >= INET6_ADDRSTRLEN)
         return 0;
 
     char ipv6[INET6_ADDRSTRLEN] = {};
@@ -459,12 +472,12 @@ extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
     if (stk_inet_pton6(ipv6, &cidr) != 1)
         return 0;
 
-    int mask_length = atoi(mask_location + 1);
-    if (mask_length > 128 || mask_length <= 0)
+    int length = atoi(mask_location + 1);
+    if (length > 128 || length <= 0)
         return 0;
 
     struct in6_addr mask = {};
-    for (int i = mask_length, j = 0; i > 0; i -= 8, j++)
+    for (int i = length, j = 0; i > 0; i -= 8, j++)
     {
         if (i >= 8)
             mask.s6_addr[j] = 0xff;
@@ -473,14 +486,31 @@ extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
     }
 
     andIPv6(&cidr, &mask);
-    andIPv6(&v6_in, &mask);
-    for (unsigned i = 0; i < sizeof(struct in6_addr); i++)
+    memcpy(prefix, cidr.s6_addr, 16);
+    *mask_length = length;
+    return 1;
+}   // parseIPv6CIDR
+
+// ----------------------------------------------------------------------------
+extern "C" int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in)
+{
+    unsigned char cidr[16];
+    int mask_length;
+    if (parseIPv6CIDR(ipv6_cidr, cidr, &mask_length) != 1)
+        return 0;
+    unsigned char v6_in[16];
+    if (parseIPv6(ipv6_in, v6_in) != 1)
+        return 0;
+
+    for (int i = 0; i < 16 && mask_length > 0; i++, mask_length -= 8)
     {
-        if (cidr.s6_addr[i] != v6_in.s6_addr[i])
+        unsigned char mask = mask_length >= 8 ?
+            0xff : (unsigned char)(0xffU << (8 - mask_length));
+        if ((cidr[i] & mask) != (v6_in[i] & mask))
             return 0;
     }
     return 1;
-}   // andIPv6
+}   // insideIPv6CIDR
 
 #ifndef ENABLE_IPV6
 // ----------------------------------------------------------------------------
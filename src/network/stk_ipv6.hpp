@@ -27,6 +27,9 @@ int getaddrinfo_compat(const char* hostname, const char* servname,
                        const struct addrinfo* hints, struct addrinfo** res);
 int64_t upperIPv6(const char* ipv6);
 int insideIPv6CIDR(const char* ipv6_cidr, const char* ipv6_in);
+int parseIPv6(const char* ipv6, unsigned char* result);
+int parseIPv6CIDR(const char* ipv6_cidr, unsigned char* prefix,
+                  int* mask_length);
 #ifdef __cplusplus
 }
 #endif
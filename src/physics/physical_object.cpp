@@ -838,14 +838,14 @@ void PhysicalObject::computeError()
 }   // computeError
 
 // ----------------------------------------------------------------------------
-BareNetworkString* PhysicalObject::saveState(std::vector<std::string>* ru)
+bool PhysicalObject::saveState(BareNetworkString* buffer,
+                               std::vector<std::string>* ru)
 {
     bool has_live_join = false;
 
     if (auto sl = LobbyProtocol::get<LobbyProtocol>())
         has_live_join = sl->hasLiveJoiningRecently();
 
-    BareNetworkString* buffer = new BareNetworkString();
     // This will compress and round down values of body, use the rounded
     // down value to test if sending state is needed
     // If any client live-joined always send new state for this object
@@ -859,15 +859,14 @@ BareNetworkString* PhysicalObject::saveState(std::vector<std::string>* ru)
         (current_lv - m_last_lv).length() < 0.01f &&
         (current_av - m_last_av).length() < 0.01f && !has_live_join)
     {
-        delete buffer;
-        return nullptr;
+        return false;
     }
 
     ru->push_back(getUniqueIdentity());
     m_last_transform = cur_transform;
     m_last_lv = current_lv;
     m_last_av = current_av;
-    return buffer;
+    return true;
 }   // saveState
 
 // ----------------------------------------------------------------------------
@@ -1055,7 +1054,7 @@ void PhysicalObject::copyFromMainProcess(TrackObject* track_obj)
     {
         const TriangleMesh& old_tm = *m_triangle_mesh;
         m_triangle_mesh = new TriangleMesh(/*can_be_transformed*/true);
-        m_triangle_mesh->copyFrom(old_tm);
+        m_triangle_mesh->shareFrom(old_tm);
     }
     // At the moment no bullet collision shape here has pointer in used in
     // their member values, so we can use copy constructor directly
@@ -284,13 +284,20 @@ public:
     void addForRewind();
     virtual void saveTransform();
     virtual void computeError();
-    virtual BareNetworkString* saveState(std::vector<std::string>* ru);
+    virtual bool saveState(BareNetworkString* buffer,
+                           std::vector<std::string>* ru);
     virtual void undoEvent(BareNetworkString *buffer) {}
     virtual void rewindToEvent(BareNetworkString *buffer) {}
     virtual void restoreState(BareNetworkString *buffer, int count);
     virtual void undoState(BareNetworkString *buffer) {}
     virtual std::function<void()> getLocalStateRestoreFunction();
+    virtual bool getRewindPosition(Vec3* xyz) const
+    {
+        *xyz = m_body->getWorldTransform().getOrigin();
+        return true;
+    }
     bool hasTriangleMesh() const { return m_triangle_mesh != NULL; }
+    const TriangleMesh* getTriangleMesh() const { return m_triangle_mesh; }
     void joinToMainTrack();
     std::shared_ptr<PhysicalObject> clone(TrackObject* track_obj)
     {
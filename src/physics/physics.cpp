@@ -209,8 +209,8 @@ void Physics::update(int ticks)
     // other object. So only a flag is set in the flyables, the actual
     // clean up is then done later in the projectile manager.
     std::vector<CollisionPair>::iterator p;
-    // Child process currently has no scripting engine
-    bool is_child = STKProcess::getType() == PT_CHILD;
+    // Only the main process has a scripting engine
+    bool is_child = STKProcess::getType() != PT_MAIN;
     for(p=m_all_collisions.begin(); p!=m_all_collisions.end(); ++p)
     {
         // Kart-kart collision
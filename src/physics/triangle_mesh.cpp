@@ -19,30 +19,93 @@
 #include "physics/triangle_mesh.hpp"
 
 #include "config/stk_config.hpp"
+#include "config/user_config.hpp"
+#include "io/file_manager.hpp"
 #include "main_loop.hpp"
+#include "network/crypto.hpp"
 #include "physics/physics.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
+#include "utils/stk_process.hpp"
+#include "utils/string_utils.hpp"
 #include "utils/time.hpp"
 
 #include "btBulletDynamicsCommon.h"
 
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    /** Header of a cached bvh file, followed by the bvh as serialized by
+     *  btOptimizedBvh::serializeInPlace. */
+    struct BvhCacheHeader
+    {
+        char     m_magic[4];
+        uint32_t m_version;
+        uint32_t m_num_triangles;
+        uint32_t m_size;
+    };
+    const char     BVH_CACHE_MAGIC[4] = { 'S', 'T', 'K', 'B' };
+    const uint32_t BVH_CACHE_VERSION  = 1;
+    /** Building the bvh of smaller meshes is faster than reading a file. */
+    const int      MIN_CACHED_TRIANGLES = 1000;
+
+    /** The geometries which server rooms can share, by getSharingKey(). */
+    std::map<std::string, std::weak_ptr<void> > g_shared_geometries;
+    std::mutex g_shared_geometries_mutex;
+}   // namespace
+
+// -----------------------------------------------------------------------------
+/** Frees the collision shape and a bvh loaded from the cache, the triangles
+ *  are kept.
+ */
+void TriangleMesh::Geometry::freeCollisionShape()
+{
+    delete m_shape;
+    m_shape = NULL;
+    // The shape does not own a bvh which was loaded from the cache
+    if (!m_bvh_buffer)
+        return;
+    ((btOptimizedBvh*)m_bvh_buffer)->~btOptimizedBvh();
+    btAlignedFree(m_bvh_buffer);
+    m_bvh_buffer = NULL;
+}   // freeCollisionShape
+
+// -----------------------------------------------------------------------------
+/** Returns the (approximate) memory used by the triangles, normals and the
+ *  bvh of the collision shape in bytes.
+ */
+size_t TriangleMesh::Geometry::getMemoryUsage() const
+{
+    size_t size = m_materials.capacity() * sizeof(const Material*) +
+                  m_normals.capacity()   * sizeof(btVector3)       +
+                  m_p1p2p3.capacity()    * sizeof(float);
+    // Three vertices for each triangle, and the 32 bit indices
+    size += m_mesh.getNumTriangles() * 3 * (sizeof(btVector3) + sizeof(int));
+    btBvhTriangleMeshShape *shape =
+        dynamic_cast<btBvhTriangleMeshShape*>(m_shape);
+    if (shape && shape->getOptimizedBvh())
+    {
+        size += sizeof(btBvhTriangleMeshShape) +
+            shape->getOptimizedBvh()->calculateSerializeBufferSize();
+    }
+    return size;
+}   // getMemoryUsage
 
 // -----------------------------------------------------------------------------
 /** Constructor: Initialises all data structures with zero.
  */
-TriangleMesh::TriangleMesh(bool can_be_transformed) : m_mesh()
+TriangleMesh::TriangleMesh(bool can_be_transformed)
 {
+    m_geometry           = std::make_shared<Geometry>();
     m_body               = NULL;
     m_free_body          = true;
     m_motion_state       = NULL;
     m_can_be_transformed = can_be_transformed;
-    // FIXME: on VS in release mode this statement actually overwrites
-    // part of the data of m_mesh, causing a crash later. Debugging
-    // shows that apparently m_collision_shape is at the same address
-    // as m_mesh->m_use32bitIndices and m_use4componentVertices
-    // (and m_mesh->m_weldingThreshold at m_normals
     m_collision_shape  = NULL;
     m_collision_object = NULL;
     m_user_pointer.set(this);
@@ -69,94 +132,386 @@ void TriangleMesh::addTriangle(const btVector3 &t1, const btVector3 &t2,
                                const btVector3 &n3,
                                const Material* m)
 {
-    m_triangleIndex2Material.push_back(m);
+    // A shared geometry must not change, so continue with a copy of it
+    if (m_geometry->m_shared)
+    {
+        std::shared_ptr<Geometry> shared = m_geometry;
+        m_geometry = std::make_shared<Geometry>();
+        copyGeometry(*shared);
+    }
+    Geometry &g = *m_geometry;
+    g.m_materials.push_back(m);
 
     btVector3 normal = (t2-t1).cross(t3-t1);
     normal.normalize();
-    m_normals.push_back( normal.angle(n1)>stk_config->m_smooth_angle_limit
-                         ? normal : n1                                     );
-    m_normals.push_back( normal.angle(n2)>stk_config->m_smooth_angle_limit
-                         ? normal : n2                                     );
-    m_normals.push_back( normal.angle(n3)>stk_config->m_smooth_angle_limit
-                         ? normal : n3                                     );
-    m_mesh.addTriangle(t1, t2, t3);
+    g.m_normals.push_back( normal.angle(n1)>stk_config->m_smooth_angle_limit
+                           ? normal : n1                                     );
+    g.m_normals.push_back( normal.angle(n2)>stk_config->m_smooth_angle_limit
+                           ? normal : n2                                     );
+    g.m_normals.push_back( normal.angle(n3)>stk_config->m_smooth_angle_limit
+                           ? normal : n3                                     );
+    g.m_mesh.addTriangle(t1, t2, t3);
 
     // Area of triangle ABC
     btVector3 edge1 = t2 - t1;
     btVector3 edge2 = t3 - t1;
-    m_p1p2p3.push_back(edge1.cross(edge2).length2());
+    g.m_p1p2p3.push_back(edge1.cross(edge2).length2());
 }   // addTriangle
 
 // -----------------------------------------------------------------------------
-/** Creates a collision body only, which can be used for raycasting, but
- *  has no physical properties.
- *  @param serialized_bhv if non-null, load the serialized bhv from file instead
- *                        of builing it on the fly
+/** Appends all triangles of the given geometry (with their materials and
+ *  normals) to the geometry of this mesh.
  */
-void TriangleMesh::createCollisionShape(bool create_collision_object, const char* serialized_bhv)
+void TriangleMesh::copyGeometry(const Geometry &g)
 {
-    if(m_triangleIndex2Material.size()==0)
+    Geometry &dst = *m_geometry;
+    const size_t n = g.m_materials.size();
+    if (n == 0)
+        return;
+    const IndexedMeshArray &m = g.m_mesh.getIndexedMeshArray();
+    const btVector3 *p = (const btVector3*)m[0].m_vertexBase;
+    for (size_t i = 0; i < n; i++)
     {
-        m_collision_shape  = NULL;
-        m_motion_state     = NULL;
-        m_body             = NULL;
-        m_collision_object = NULL;
+        dst.m_mesh.addTriangle(p[3 * i], p[3 * i + 1], p[3 * i + 2]);
+        dst.m_materials.push_back(g.m_materials[i]);
+        dst.m_normals.push_back(g.m_normals[3 * i    ]);
+        dst.m_normals.push_back(g.m_normals[3 * i + 1]);
+        dst.m_normals.push_back(g.m_normals[3 * i + 2]);
+        dst.m_p1p2p3.push_back(g.m_p1p2p3[i]);
+    }
+}   // copyGeometry
+
+// -----------------------------------------------------------------------------
+/** Adds all triangles of the given mesh to this mesh.
+ */
+void TriangleMesh::copyFrom(const TriangleMesh &tm)
+{
+    if (m_geometry->m_shared)
+    {
+        std::shared_ptr<Geometry> shared = m_geometry;
+        m_geometry = std::make_shared<Geometry>();
+        copyGeometry(*shared);
+    }
+    copyGeometry(*tm.m_geometry);
+}   // copyFrom
+
+// -----------------------------------------------------------------------------
+/** Lets this (empty) mesh use the triangles and the collision shape of the
+ *  given mesh instead of a copy. This is used for the meshes of a track
+ *  which is used by more than one world. If the given mesh has no collision
+ *  shape yet its triangles are copied, since they can still change.
+ */
+void TriangleMesh::shareFrom(const TriangleMesh &tm)
+{
+    assert(getNumTriangles() == 0 && !m_collision_shape);
+    if (!tm.m_geometry->m_shape)
+    {
+        copyFrom(tm);
         return;
     }
-    // Now convert the triangle mesh into a static rigid body
-    btBvhTriangleMeshShape* bhv_triangle_mesh;
+    std::lock_guard<std::mutex> lock(g_shared_geometries_mutex);
+    tm.m_geometry->m_shared = true;
+    m_geometry = tm.m_geometry;
+}   // shareFrom
+
+// -----------------------------------------------------------------------------
+/** Returns the x, y and z coordinates of all vertices.
+ */
+std::string TriangleMesh::getVertexData() const
+{
+    const IndexedMeshArray &m = m_geometry->m_mesh.getIndexedMeshArray();
+    const size_t num_vertices = (size_t)m[0].m_numVertices;
+    std::string data(num_vertices * 3 * sizeof(btScalar), '\0');
+    char *out = &data[0];
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        // Only x, y and z, the fourth component is undefined
+        const btScalar *v = (const btScalar*)(m[0].m_vertexBase +
+                                              i * m[0].m_vertexStride);
+        memcpy(out, v, 3 * sizeof(btScalar));
+        out += 3 * sizeof(btScalar);
+    }
+    return data;
+}   // getVertexData
 
-    if (serialized_bhv != NULL)
+// -----------------------------------------------------------------------------
+/** Returns the name of the file the bvh of this mesh is cached in. The name
+ *  is the hash of all vertices, so the same geometry (e.g. a physical
+ *  object used in several tracks) shares one cache file, and any change of
+ *  a track results in a new file. The bullet version and the memory layout
+ *  of the bvh are part of the hash, since the bvh is stored as is.
+ */
+std::string TriangleMesh::getBvhCacheFileName() const
+{
+    std::string data = "bvh" + StringUtils::toString(BVH_CACHE_VERSION) +
+        " bullet" + StringUtils::toString(BT_BULLET_VERSION) +
+        " ptr" + StringUtils::toString(sizeof(void*)) +
+        " node" + StringUtils::toString(sizeof(btOptimizedBvhNode)) +
+        " triangles" + StringUtils::toString(getNumTriangles()) + " ";
+    data += getVertexData();
+
+    auto hash = Crypto::sha256(data);
+    std::string name = file_manager->getCachedDataDir() + "collision-";
+    for (uint8_t c : hash)
     {
-        FILE *f = fopen(serialized_bhv, "rb");
-        fseek(f, 0, SEEK_END);
-        long pos = ftell(f);
-        assert(pos != -1L);
-        fseek(f, 0, SEEK_SET);
+        char hex[3];
+        snprintf(hex, sizeof(hex), "%02x", c);
+        name += hex;
+    }
+    return name + ".bvh";
+}   // getBvhCacheFileName
 
-        void* bytes = btAlignedAlloc(pos, 16);
-        fread(bytes, pos, 1, f);
-        fclose(f);
+// -----------------------------------------------------------------------------
+/** Returns the key of this mesh in the table of shared geometries, a hash
+ *  of the vertices, normals and materials of all triangles. The materials
+ *  are compared by address, so only meshes using the same material objects
+ *  are shared.
+ */
+std::string TriangleMesh::getSharingKey() const
+{
+    const Geometry &g = *m_geometry;
+    std::string data = getVertexData();
+    size_t offset = data.size();
+    data.resize(offset + g.m_normals.size() * 3 * sizeof(btScalar) +
+                g.m_materials.size() * sizeof(const Material*));
+    for (unsigned i = 0; i < g.m_normals.size(); i++)
+    {
+        memcpy(&data[offset], (const btScalar*)g.m_normals[i],
+               3 * sizeof(btScalar));
+        offset += 3 * sizeof(btScalar);
+    }
+    memcpy(&data[offset], g.m_materials.data(),
+           g.m_materials.size() * sizeof(const Material*));
+    auto hash = Crypto::sha256(data);
+    return std::string((const char*)hash.data(), hash.size());
+}   // getSharingKey
 
-        btOptimizedBvh* bhv = btOptimizedBvh::deSerializeInPlace(bytes, pos, !IS_LITTLE_ENDIAN);
-        if (bhv == NULL)
+// -----------------------------------------------------------------------------
+/** Replaces the geometry of this mesh with an identical shared one if
+ *  another mesh added it with addSharedGeometry.
+ *  \return True if a shared geometry is used now.
+ */
+bool TriangleMesh::useSharedGeometry(const std::string &key)
+{
+    std::shared_ptr<Geometry> shared;
+    {
+        std::lock_guard<std::mutex> lock(g_shared_geometries_mutex);
+        auto it = g_shared_geometries.find(key);
+        if (it != g_shared_geometries.end())
         {
-            Log::warn("TriangleMesh", "Failed to load serialized BHV");
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
+            shared = std::static_pointer_cast<Geometry>(it->second.lock());
         }
+    }
+    if (!shared)
+        return false;
+    // Frees the own copy of the triangles
+    m_geometry = shared;
+    return true;
+}   // useSharedGeometry
+
+// -----------------------------------------------------------------------------
+/** Adds the geometry of this mesh (which must have a collision shape) to the
+ *  table of shared geometries. Its triangles can't be changed afterwards.
+ */
+void TriangleMesh::addSharedGeometry(const std::string &key)
+{
+    assert(m_geometry->m_shape);
+    std::lock_guard<std::mutex> lock(g_shared_geometries_mutex);
+    for (auto it = g_shared_geometries.begin();
+         it != g_shared_geometries.end();)
+    {
+        if (it->second.expired())
+            it = g_shared_geometries.erase(it);
         else
+            it++;
+    }
+    m_geometry->m_shared = true;
+    m_geometry->m_key = key;
+    g_shared_geometries[key] = m_geometry;
+}   // addSharedGeometry
+
+// -----------------------------------------------------------------------------
+/** Makes a shared geometry of this mesh changeable again, which is only
+ *  possible if no other mesh uses it.
+ *  \return True if the geometry is not shared anymore.
+ */
+bool TriangleMesh::unshareGeometry()
+{
+    if (!m_geometry->m_shared)
+        return true;
+    std::lock_guard<std::mutex> lock(g_shared_geometries_mutex);
+    // Other meshes can only get this geometry while the mutex is locked
+    if (m_geometry.use_count() > 1)
+        return false;
+    auto it = g_shared_geometries.find(m_geometry->m_key);
+    if (it != g_shared_geometries.end() && it->second.lock() == m_geometry)
+        g_shared_geometries.erase(it);
+    m_geometry->m_key.clear();
+    m_geometry->m_shared = false;
+    return true;
+}   // unshareGeometry
+
+// -----------------------------------------------------------------------------
+/** Loads a bvh written by saveBvh. The bvh is created in place in the
+ *  buffer the file is read into, which is kept in m_bvh_buffer.
+ *  \return The bvh, or NULL if the file does not exist or does not match
+ *          this mesh.
+ */
+btOptimizedBvh* TriangleMesh::loadBvh(const std::string &filename)
+{
+    Geometry &g = *m_geometry;
+    assert(!g.m_bvh_buffer);
+    std::ifstream f(filename, std::ios::binary);
+    if (!f.is_open())
+        return NULL;
+
+    BvhCacheHeader header;
+    if (!f.read((char*)&header, sizeof(header)) ||
+        memcmp(header.m_magic, BVH_CACHE_MAGIC, sizeof(BVH_CACHE_MAGIC)) != 0 ||
+        header.m_version != BVH_CACHE_VERSION ||
+        header.m_num_triangles != getNumTriangles() ||
+        header.m_size == 0)
+    {
+        Log::warn("TriangleMesh", "Ignoring invalid cache file '%s'.",
+                  filename.c_str());
+        return NULL;
+    }
+
+    g.m_bvh_buffer = btAlignedAlloc(header.m_size, 16);
+    btOptimizedBvh *bvh = NULL;
+    if (f.read((char*)g.m_bvh_buffer, header.m_size))
+    {
+        bvh = (btOptimizedBvh*)btOptimizedBvh::deSerializeInPlace(
+            g.m_bvh_buffer, header.m_size, !IS_LITTLE_ENDIAN);
+    }
+    if (!bvh)
+    {
+        Log::warn("TriangleMesh", "Ignoring invalid cache file '%s'.",
+                  filename.c_str());
+        btAlignedFree(g.m_bvh_buffer);
+        g.m_bvh_buffer = NULL;
+    }
+    return bvh;
+}   // loadBvh
+
+// -----------------------------------------------------------------------------
+/** Writes the bvh to a cache file. The data is written to a temporary file
+ *  first, so a different process loading the same track never sees a
+ *  partially written file.
+ */
+void TriangleMesh::saveBvh(const btOptimizedBvh *bvh,
+                           const std::string &filename) const
+{
+    BvhCacheHeader header;
+    memcpy(header.m_magic, BVH_CACHE_MAGIC, sizeof(BVH_CACHE_MAGIC));
+    header.m_version = BVH_CACHE_VERSION;
+    header.m_num_triangles = getNumTriangles();
+    header.m_size = bvh->calculateSerializeBufferSize();
+
+    void *buffer = btAlignedAlloc(header.m_size, 16);
+    if (!bvh->serializeInPlace(buffer, header.m_size, !IS_LITTLE_ENDIAN))
+    {
+        btAlignedFree(buffer);
+        return;
+    }
+
+    const std::string tmp_name = filename + ".tmp" +
+        StringUtils::toString(StkTime::getMonoTimeMs());
+    bool ok;
+    {
+        std::ofstream f(tmp_name, std::ios::binary);
+        if (!f.is_open())
         {
-            bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */,
-                                                           false /* buildBvh */);
-            bhv_triangle_mesh->setOptimizedBvh( bhv );
+            Log::warn("TriangleMesh", "Can't write cache file '%s'.",
+                      tmp_name.c_str());
+            btAlignedFree(buffer);
+            return;
         }
-        // Do *NOT* free the bytes, 'deSerializeInPlace' makes the btOptimizedBvh object
-        // directly at this memory location
-        //free(bytes);
-
+        f.write((const char*)&header, sizeof(header));
+        f.write((const char*)buffer, header.m_size);
+        ok = (bool)f;
     }
-    else
+    btAlignedFree(buffer);
+    if (!ok)
     {
-        bhv_triangle_mesh = new btBvhTriangleMeshShape(&m_mesh, false /* useQuantizedAabbCompression */);
+        file_manager->removeFile(tmp_name);
+        return;
+    }
+    // rename fails on windows if the destination exists
+    file_manager->removeFile(filename);
+    if (rename(tmp_name.c_str(), filename.c_str()) != 0)
+        file_manager->removeFile(tmp_name);
+}   // saveBvh
 
-        /*
-         // code to serialize triangle mesh
-        btOptimizedBvh* bvh = bhv_triangle_mesh->getOptimizedBvh();
-        unsigned int ssize = bvh->calculateSerializeBufferSize();
-        char* buffer = (char*)btAlignedAlloc(ssize, 16);
-        bool success = bvh->serialize(buffer, ssize, !IS_LITTLE_ENDIAN);
-        printf("serialization success = %i\n", success);
+// -----------------------------------------------------------------------------
+/** Creates a collision body only, which can be used for raycasting, but
+ *  has no physical properties. For larger meshes the bvh is loaded from
+ *  the cache if possible (and written to it otherwise), since building it
+ *  is a large part of the track loading time. Server rooms share identical
+ *  meshes (with their collision shape) instead, see getSharingKey().
+ */
+void TriangleMesh::createCollisionShape(bool create_collision_object)
+{
+    if(getNumTriangles()==0)
+    {
+        m_collision_shape  = NULL;
+        m_motion_state     = NULL;
+        m_body             = NULL;
+        m_collision_object = NULL;
+        return;
+    }
 
-        std::ofstream fileout("/tmp/btOptimizedBvh");
-        fileout.write(buffer, ssize);
-        fileout.close();
+    std::string key;
+    if (!m_geometry->m_shape && STKProcess::isRoom())
+    {
+        key = getSharingKey();
+        if (useSharedGeometry(key))
+            key.clear();
+    }
 
-        btAlignedFree(buffer);
-         */
+    if (!m_geometry->m_shape)
+    {
+        Geometry &g = *m_geometry;
+        // Now convert the triangle mesh into a static rigid body
+        btBvhTriangleMeshShape* bhv_triangle_mesh;
+
+        std::string cache_file;
+        if (UserConfigParams::m_cache_collision_bvh &&
+            g.m_mesh.getNumTriangles() >= MIN_CACHED_TRIANGLES)
+            cache_file = getBvhCacheFileName();
+
+        const double start = StkTime::getRealTime();
+        btOptimizedBvh *bvh = cache_file.empty() ? NULL : loadBvh(cache_file);
+        if (bvh)
+        {
+            bhv_triangle_mesh =
+                new btBvhTriangleMeshShape(&g.m_mesh,
+                                     false /* useQuantizedAabbCompression */,
+                                     false /* buildBvh */);
+            bhv_triangle_mesh->setOptimizedBvh(bvh);
+        }
+        else
+        {
+            bhv_triangle_mesh =
+                new btBvhTriangleMeshShape(&g.m_mesh,
+                                     false /* useQuantizedAabbCompression */);
+            if (!cache_file.empty())
+                saveBvh(bhv_triangle_mesh->getOptimizedBvh(), cache_file);
+        }
+        if (!cache_file.empty())
+        {
+            Log::debug("TriangleMesh", "%s bvh of %d triangles in %lf s.",
+                       bvh ? "Loaded" : "Built", g.m_mesh.getNumTriangles(),
+                       StkTime::getRealTime() - start);
+        }
+        // The shape has no user pointer, since it can be shared by meshes
+        // of different worlds
+        g.m_shape = bhv_triangle_mesh;
+        if (!key.empty())
+            addSharedGeometry(key);
     }
 
-    m_collision_shape = bhv_triangle_mesh;
-    m_collision_shape->setUserPointer(&m_user_pointer);
+    m_collision_shape = m_geometry->m_shape;
     if(create_collision_object)
     {
         m_collision_object = new btCollisionObject();
@@ -179,16 +534,13 @@ void TriangleMesh::createCollisionShape(bool create_collision_object, const char
  *  for height of terrain detection).
  *  \param friction Friction to be used for this TriangleMesh.
  *  \param flags Additional collision flags (default 0).
- *  \param serializedBhv if non-NULL, the bhv is deserialized instead of
- *                       being calculated on the fly
  */
 void TriangleMesh::createPhysicalBody(float friction,
-                                      btCollisionObject::CollisionFlags flags,
-                                      const char* serializedBhv)
+                                      btCollisionObject::CollisionFlags flags)
 {
     // We need the collision shape, but not the collision object (since
     // this will be created when the dynamics body is anyway).
-    createCollisionShape(/*create_collision_object*/false, serializedBhv);
+    createCollisionShape(/*create_collision_object*/false);
     main_loop->renderGUI(5583);
 
     btTransform startTransform;
@@ -231,8 +583,11 @@ void TriangleMesh::removeAll()
         delete m_collision_object;
         m_collision_object = NULL;
     }
-    delete m_collision_shape;
     m_collision_shape = NULL;
+    // The collision shape is rebuilt when triangles are added, but a shared
+    // one is kept for the other meshes using it
+    if (unshareGeometry())
+        m_geometry->freeCollisionShape();
 }   // removeAll
 
 // -----------------------------------------------------------------------------
@@ -384,7 +739,7 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
     {
         *xyz      = ray_callback.m_hitPointWorld;
         xyz->setW(0.0f);
-        *material = m_triangleIndex2Material[index];
+        *material = m_geometry->m_materials[index];
 
         if(normal)
         {
@@ -408,3 +763,143 @@ bool TriangleMesh::castRay(const btVector3 &from, const btVector3 &to,
     return ray_callback.hasHit();
 
 }   // castRay
+
+// ----------------------------------------------------------------------------
+/** Compares building the bvh with loading it from the cache for meshes with
+ *  about as many triangles as small, medium and large tracks, and checks
+ *  that raycasts give the same results with the loaded bvh.
+ */
+void TriangleMesh::unitTesting()
+{
+    const bool saved_cache = UserConfigParams::m_cache_collision_bvh;
+    int error_count = 0;
+    // 2*n*n triangles
+    const unsigned sizes[] = { 40, 120, 300 };
+    for (unsigned n : sizes)
+    {
+        // A bumpy terrain, so that the bvh is not trivial
+        auto point = [](unsigned x, unsigned z)
+        {
+            return btVector3((float)x, sinf(x * 0.3f) * cosf(z * 0.2f) * 5.0f,
+                             (float)z);
+        };
+        const btVector3 up(0.0f, 1.0f, 0.0f);
+        TriangleMesh built(false), loaded(false);
+        for (unsigned x = 0; x < n; x++)
+        {
+            for (unsigned z = 0; z < n; z++)
+            {
+                btVector3 p00 = point(x, z), p10 = point(x + 1, z);
+                btVector3 p01 = point(x, z + 1), p11 = point(x + 1, z + 1);
+                built.addTriangle(p00, p10, p11, up, up, up, NULL);
+                built.addTriangle(p00, p11, p01, up, up, up, NULL);
+                loaded.addTriangle(p00, p10, p11, up, up, up, NULL);
+                loaded.addTriangle(p00, p11, p01, up, up, up, NULL);
+            }
+        }
+
+        UserConfigParams::m_cache_collision_bvh = false;
+        double start = StkTime::getRealTime();
+        built.createCollisionShape();
+        double build_time = StkTime::getRealTime() - start;
+
+        const std::string cache_file = built.getBvhCacheFileName();
+        btBvhTriangleMeshShape *shape =
+            (btBvhTriangleMeshShape*)built.m_collision_shape;
+        built.saveBvh(shape->getOptimizedBvh(), cache_file);
+
+        UserConfigParams::m_cache_collision_bvh = true;
+        start = StkTime::getRealTime();
+        loaded.createCollisionShape();
+        double load_time = StkTime::getRealTime() - start;
+        if (!loaded.m_geometry->m_bvh_buffer)
+        {
+            Log::error("TriangleMesh", "Bvh of %u triangles was not loaded "
+                       "from '%s'.", 2 * n * n, cache_file.c_str());
+            error_count++;
+        }
+
+        for (unsigned i = 0; i < 1000; i++)
+        {
+            // Some rays hit the terrain, some miss it
+            float x = (i * 7919 % 10007) / 10007.0f * (n + 20.0f) - 10.0f;
+            float z = (i * 104729 % 10007) / 10007.0f * (n + 20.0f) - 10.0f;
+            btVector3 from(x, 10.0f, z), to(x + 3.0f, -10.0f, z - 2.0f);
+            btVector3 xyz1, xyz2;
+            const Material *m;
+            bool hit1 = built.castRay(from, to, &xyz1, &m);
+            bool hit2 = loaded.castRay(from, to, &xyz2, &m);
+            if (hit1 != hit2 || (hit1 && xyz1 != xyz2))
+            {
+                if (error_count < 20)
+                {
+                    Log::error("TriangleMesh", "Ray from %f %f %f differs "
+                               "with the cached bvh.", x, 10.0f, z);
+                }
+                error_count++;
+            }
+        }
+        Log::info("TriangleMesh", "%u triangles: building bvh %lf s, "
+                  "loading bvh %lf s.", 2 * n * n, build_time, load_time);
+        built.removeAll();
+        loaded.removeAll();
+        file_manager->removeFile(cache_file);
+    }
+    UserConfigParams::m_cache_collision_bvh = false;
+
+    // Two server rooms loading the same track: the second room must use the
+    // triangles and collision shape of the first one
+    const unsigned n = 120;
+    TriangleMesh *room_mesh[2];
+    for (unsigned room = 0; room < 2; room++)
+    {
+        STKProcess::init(ProcessType(PT_FIRST_ROOM + room));
+        room_mesh[room] = new TriangleMesh(false);
+        for (unsigned x = 0; x < n; x++)
+        {
+            for (unsigned z = 0; z < n; z++)
+            {
+                btVector3 p0((float)x, (float)(x % 3), (float)z);
+                btVector3 p1((float)x + 1, (float)(x % 5), (float)z);
+                btVector3 p2((float)x, (float)(z % 7), (float)z + 1);
+                room_mesh[room]->addTriangle(p0, p1, p2, p0, p0, p0, NULL);
+            }
+        }
+        room_mesh[room]->createCollisionShape();
+    }
+    STKProcess::init(PT_MAIN);
+    if (!room_mesh[1]->isShared() ||
+        &room_mesh[0]->getCollisionShape() !=
+        &room_mesh[1]->getCollisionShape())
+    {
+        Log::error("TriangleMesh", "Identical meshes of two rooms are not "
+                   "shared.");
+        error_count++;
+    }
+    // The shared collision shape must stay usable after the first room
+    // is deleted, and the child process copy shares it too
+    const size_t bytes = room_mesh[0]->getMemoryUsage();
+    delete room_mesh[0];
+    TriangleMesh child(false);
+    child.shareFrom(*room_mesh[1]);
+    child.createCollisionShape();
+    btVector3 xyz;
+    const Material *m;
+    if (!child.castRay(btVector3(10.5f, 20.0f, 10.2f),
+                       btVector3(10.5f, -20.0f, 10.2f), &xyz, &m))
+    {
+        Log::error("TriangleMesh", "Raycast on a shared mesh failed.");
+        error_count++;
+    }
+    Log::info("TriangleMesh", "%u triangles with bvh use %zu bytes in each "
+              "world if copied, and %zu bytes in total if shared.", n * n,
+              bytes, bytes);
+    delete room_mesh[1];
+    UserConfigParams::m_cache_collision_bvh = saved_cache;
+
+    if (error_count > 0)
+    {
+        Log::fatal("TriangleMesh", "%d errors with cached or shared bvhs.",
+                   error_count);
+    }
+}   // unitTesting
@@ -19,6 +19,8 @@
 #ifndef HEADER_TRIANGLE_MESH_HPP
 #define HEADER_TRIANGLE_MESH_HPP
 
+#include <memory>
+#include <string>
 #include <vector>
 #include "btBulletDynamicsCommon.h"
 
@@ -34,29 +36,68 @@ class Material;
 class TriangleMesh
 {
 private:
+    /** The triangles of a mesh with their materials and normals, and the
+     *  collision shape built from them. Once the collision shape exists the
+     *  geometry can be shared (see m_shared) by the meshes of several worlds
+     *  which use the same track, e.g. the child process or server rooms. */
+    struct Geometry
+    {
+        std::vector<const Material*> m_materials;
+        btTriangleMesh               m_mesh;
+        /** The three normals for each triangle. */
+        AlignedArray<btVector3>      m_normals;
+        /** Pre-compute value used in smoothing. */
+        AlignedArray<float>          m_p1p2p3;
+        btCollisionShape            *m_shape;
+        /** If the bvh of the collision shape was loaded from the cache, this
+         *  is the buffer it was loaded into (the btOptimizedBvh object lives
+         *  at the start of this buffer). NULL if the bvh was built. */
+        void                        *m_bvh_buffer;
+        /** If set the geometry is (or was) used by more than one mesh and
+         *  must not be changed anymore. */
+        bool                         m_shared;
+        /** Key of this geometry in the table of shared geometries, empty if
+         *  it is not in the table. */
+        std::string                  m_key;
+        // --------------------------------------------------------------------
+        Geometry() : m_shape(NULL), m_bvh_buffer(NULL), m_shared(false) {}
+        // --------------------------------------------------------------------
+        ~Geometry() { freeCollisionShape(); }
+        // --------------------------------------------------------------------
+        void freeCollisionShape();
+        // --------------------------------------------------------------------
+        size_t getMemoryUsage() const;
+    };
+
     UserPointer                  m_user_pointer;
-    std::vector<const Material*> m_triangleIndex2Material;
+    std::shared_ptr<Geometry>    m_geometry;
     btRigidBody                 *m_body;
     /** Keep track if the physical body was created here or not. */
     bool                         m_free_body;
 
     btCollisionObject           *m_collision_object;
-    btTriangleMesh               m_mesh;
     btVector3 dummy1, dummy2;
     btDefaultMotionState        *m_motion_state;
+    /** The collision shape of m_geometry while this mesh uses it, i.e.
+     *  between creating the collision shape and removeAll(). */
     btCollisionShape            *m_collision_shape;
 
-    /** The three normals for each triangle. */
-    AlignedArray<btVector3>      m_normals;
-
-    /** Pre-compute value used in smoothing. */
-    AlignedArray<float>          m_p1p2p3;
-
     /** If the rigid body can be transformed (which means that normalising
      *  the normals need to update the vertices and normals used according
      *  to the current transform of the body. */
     bool m_can_be_transformed;
 
+    std::string getVertexData() const;
+    std::string getBvhCacheFileName() const;
+    std::string getSharingKey() const;
+    btOptimizedBvh* loadBvh(const std::string &filename);
+    void saveBvh(const btOptimizedBvh *bvh,
+                 const std::string &filename) const;
+    bool useSharedGeometry(const std::string &key);
+    void addSharedGeometry(const std::string &key);
+    bool unshareGeometry();
+    void copyGeometry(const Geometry &g);
+
 public:
     class RigidBodyTriangleMesh : public btRigidBody
     {
@@ -76,15 +117,17 @@ public:
                      const btVector3 &t3, const btVector3 &n1,
                      const btVector3 &n2, const btVector3 &n3,
                      const Material* m);
-    void createCollisionShape(bool create_collision_object=true, const char* serialized_bhv=NULL);
+    void createCollisionShape(bool create_collision_object=true);
     void createPhysicalBody(float friction,
                             btCollisionObject::CollisionFlags flags=
-                               (btCollisionObject::CollisionFlags)0,
-                            const char* serializedBhv = NULL);
+                               (btCollisionObject::CollisionFlags)0);
     void removeAll();
     void removeCollisionObject();
+    void shareFrom(const TriangleMesh &tm);
+    void copyFrom(const TriangleMesh &tm);
     btVector3 getInterpolatedNormal(unsigned int index,
                                     const btVector3 &position) const;
+    static void unitTesting();
     // ------------------------------------------------------------------------
     /** In case of physical objects of shape 'exact', the physical body is
      *  created outside of the mesh. Since raycasts need the body's world
@@ -102,7 +145,7 @@ public:
     const btRigidBody *getBody() const { return m_body; }
     // ------------------------------------------------------------------------
     const Material* getMaterial(int n) const
-                                          {return m_triangleIndex2Material[n];}
+                                         {return m_geometry->m_materials[n];}
     // ------------------------------------------------------------------------
     const btCollisionShape &getCollisionShape() const
                                           { return *m_collision_shape; }
@@ -119,7 +162,8 @@ public:
     void getTriangle(unsigned int indx, btVector3 *p1, btVector3 *p2,
                      btVector3 *p3) const
     {
-        const IndexedMeshArray &m = m_mesh.getIndexedMeshArray();
+        const IndexedMeshArray &m =
+            m_geometry->m_mesh.getIndexedMeshArray();
         btVector3 *p = &(((btVector3*)(m[0].m_vertexBase))[3*indx]);
         *p1 = p[0];
         *p2 = p[1];
@@ -132,32 +176,32 @@ public:
     void getNormals(unsigned int indx, btVector3 *n1, 
                     btVector3 *n2, btVector3 *n3) const
     {
-        assert(indx < m_triangleIndex2Material.size());
+        assert(indx < m_geometry->m_materials.size());
         unsigned int n = indx*3;
-        *n1 = m_normals[n  ];
-        *n2 = m_normals[n+1];
-        *n3 = m_normals[n+2];
+        *n1 = m_geometry->m_normals[n  ];
+        *n2 = m_geometry->m_normals[n+1];
+        *n3 = m_geometry->m_normals[n+2];
     }   // getNormals
     // ------------------------------------------------------------------------
     /** Returns basically the area of the triangle, which is needed when
      *  smoothing the normals. */
     float getP1P2P3(unsigned int indx) const
     {
-        assert(indx < m_p1p2p3.size());
-        return m_p1p2p3[indx];
+        assert(indx < m_geometry->m_p1p2p3.size());
+        return m_geometry->m_p1p2p3[indx];
     }
     // ------------------------------------------------------------------------
-    void copyFrom(const TriangleMesh& tm)
-    {
-        for (int i = 0; i < tm.m_mesh.getNumTriangles(); i++)
-        {
-            btVector3 v[6];
-            tm.getTriangle(i, v, v + 1, v + 2);
-            tm.getNormals(i, v + 3, v + 4, v + 5);
-            const Material* m = tm.getMaterial(i);
-            addTriangle(v[0], v[1], v[2], v[3], v[4], v[5], m);
-        }
-    }
+    /** Returns the number of triangles of this mesh. */
+    unsigned int getNumTriangles() const
+                       { return (unsigned int)m_geometry->m_materials.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns true if the triangles and collision shape of this mesh are
+     *  shared with other meshes. */
+    bool isShared() const                   { return m_geometry->m_shared; }
+    // ------------------------------------------------------------------------
+    /** Returns the memory used by the triangles and the collision shape
+     *  of this mesh in bytes, which is shared if isShared() is true. */
+    size_t getMemoryUsage() const     { return m_geometry->getMemoryUsage(); }
 };
 #endif
 /* EOF */
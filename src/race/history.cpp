@@ -18,41 +18,110 @@
 
 #include "race/history.hpp"
 
-#include <stdio.h>
-
+#include "config/stk_config.hpp"
 #include "io/file_manager.hpp"
+#include "items/item_manager.hpp"
+#include "items/projectile_manager.hpp"
 #include "modes/world.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
+#include "karts/controller/player_controller.hpp"
 #include "network/network_config.hpp"
 #include "network/rewind_manager.hpp"
+#include "network/rewinder.hpp"
 #include "physics/physics.hpp"
 #include "race/race_manager.hpp"
+#include "tracks/check_manager.hpp"
 #include "tracks/track.hpp"
 #include "utils/constants.hpp"
 #include "utils/file_utils.hpp"
+#include "utils/stk_process.hpp"
+
+#include <stdexcept>
+#include <string.h>
 
 History* history = 0;
 bool History::m_online_history_replay = false;
+
+/** The first bytes of a binary history file. */
+static const char HISTORY_MAGIC[4] = { 'S', 'T', 'K', 'H' };
+
+/** Set in the action of an event received from a client. */
+static const uint8_t NETWORK_EVENT = 0x80;
+
+//-----------------------------------------------------------------------------
+/** Maps a signed value to an unsigned one, with small absolute values
+ *  giving small results, so it can be stored with addVarUInt. */
+static uint32_t encodeSigned(int value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value < 0 ? -1 : 0);
+}   // encodeSigned
+
+//-----------------------------------------------------------------------------
+static int decodeSigned(uint32_t value)
+{
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}   // decodeSigned
+
 //-----------------------------------------------------------------------------
 /** Initialises the history object and sets the mode to none.
  */
 History::History()
 {
-    m_replay_history = false;
+    m_replay_history      = false;
+    m_stream_history      = false;
+    m_stream              = NULL;
+    m_event_index         = 0;
+    m_streamed_events     = 0;
+    m_last_snapshot_ticks = 0;
+    m_snapshot_interval   = 0;
+    m_snapshot_states     = 0;
+    m_seek_ticks          = -1;
 }   // History
 
+//-----------------------------------------------------------------------------
+History::~History()
+{
+    closeStream();
+}   // ~History
+
 //-----------------------------------------------------------------------------
 /** Initialise the history for a new recording. It especially allocates memory
- *  to store the history.
+ *  to store the history. If the history is streamed, the file is (re)started
+ *  with the header of the new race.
  */
 void History::initRecording()
 {
     allocateMemory();
     m_event_index = 0;
     m_all_input_events.clear();
+
+    // Server rooms run their own worlds in other threads, only the main
+    // process writes to the history file.
+    if (STKProcess::getType() != PT_MAIN)
+        return;
+
+    closeStream();
+    m_streamed_events     = 0;
+    m_snapshot_interval   = stk_config->time2Ticks(5.0f);
+    m_last_snapshot_ticks = -m_snapshot_interval;
+    if (!m_stream_history)
+        return;
+    m_stream = openFile("wb");
+    if (m_stream)
+        writeHeader(m_stream);
 }   // initRecording
 
+//-----------------------------------------------------------------------------
+/** Called when a race is finished. Writes the remaining events to a streamed
+ *  history and closes the file.
+ */
+void History::stopRecording()
+{
+    if (STKProcess::getType() == PT_MAIN)
+        closeStream();
+}   // stopRecording
+
 //-----------------------------------------------------------------------------
 /** Allocates memory for the history. This is used when recording as well
  *  as when replaying (since in replay the data is read into memory first).
@@ -64,7 +133,7 @@ void History::allocateMemory(int size)
     if(size<0)
         m_all_input_events.reserve(1024);
     else
-        m_all_input_events.resize(size);
+        m_all_input_events.reserve(size);
 }   // allocateMemory
 
 //-----------------------------------------------------------------------------
@@ -80,13 +149,119 @@ void History::addEvent(int kart_id, PlayerAction pa, int value)
     InputEvent ie;
     // The event is added before m_current is increased. So in order to
     // save the right index for this event, we need to use m_current+1.
-    ie.m_world_ticks = World::getWorld()->getTicksSinceStart();
-    ie.m_action      = pa;
-    ie.m_value       = value;
-    ie.m_kart_index  = kart_id;
-    m_all_input_events.emplace_back(ie);
+    ie.m_world_ticks  = World::getWorld()->getTicksSinceStart();
+    ie.m_action       = pa;
+    ie.m_value        = value;
+    ie.m_value_l      = 0;
+    ie.m_value_r      = 0;
+    ie.m_kart_index   = kart_id;
+    ie.m_from_network = false;
+    addInputEvent(ie);
 }   // addEvent
 
+//-----------------------------------------------------------------------------
+/** Stores an input event received by the server from a client. The steering
+ *  values are stored too, so that the replay is the same as in the race.
+ *  \param kart_id The kart index which triggered the event.
+ *  \param pa      The action.
+ *  \param value   Value of the action.
+ *  \param value_l Left steering value of the client.
+ *  \param value_r Right steering value of the client.
+ */
+void History::addNetworkEvent(int kart_id, PlayerAction pa, int value,
+                              int value_l, int value_r)
+{
+    InputEvent ie;
+    ie.m_world_ticks  = World::getWorld()->getTicksSinceStart();
+    ie.m_action       = pa;
+    ie.m_value        = value;
+    ie.m_value_l      = value_l;
+    ie.m_value_r      = value_r;
+    ie.m_kart_index   = kart_id;
+    ie.m_from_network = true;
+    addInputEvent(ie);
+}   // addNetworkEvent
+
+//-----------------------------------------------------------------------------
+/** Adds an event to the history, and writes the events to a streamed
+ *  history if enough events were collected.
+ */
+void History::addInputEvent(const InputEvent &ie)
+{
+    m_all_input_events.emplace_back(ie);
+
+    // Write the events in chunks, but at least once per snapshot interval
+    // in case that there are only a few events.
+    if (m_stream &&
+        (m_all_input_events.size() - m_streamed_events >= EVENTS_PER_CHUNK ||
+         ie.m_world_ticks -
+             m_all_input_events[m_streamed_events].m_world_ticks >=
+             m_snapshot_interval))
+    {
+        writeEvents(m_stream, m_streamed_events);
+        m_streamed_events = (unsigned int)m_all_input_events.size();
+    }
+}   // addInputEvent
+
+//-----------------------------------------------------------------------------
+/** Called by the RewindManager before it saves a state. Returns true if this
+ *  state should also be stored as a snapshot in the streamed history, in
+ *  which case addSnapshotState() is called for each rewinder state, and
+ *  finishSnapshot() at the end.
+ *  \param world_ticks Time of the state.
+ */
+bool History::isSnapshotDue(int world_ticks)
+{
+    if (!m_stream || m_replay_history ||
+        STKProcess::getType() != PT_MAIN ||
+        world_ticks - m_last_snapshot_ticks < m_snapshot_interval)
+        return false;
+
+    m_last_snapshot_ticks = world_ticks;
+    m_snapshot.getBuffer().clear();
+    m_snapshot.reset();
+    // The number of states is set in finishSnapshot
+    m_snapshot.addUInt32(world_ticks).addUInt8(0);
+    m_snapshot_states = 0;
+    return true;
+}   // isSnapshotDue
+
+//-----------------------------------------------------------------------------
+/** Adds the state of one rewinder to the current snapshot.
+ *  \param name Unique identity of the rewinder.
+ *  \param state The state as saved by the rewinder.
+ */
+void History::addSnapshotState(const std::string &name,
+                               const BareNetworkString &state)
+{
+    m_snapshot.encodeString(name).addUInt16((uint16_t)state.size());
+    m_snapshot.getBuffer().insert(m_snapshot.getBuffer().end(),
+                                  state.getCurrentData(),
+                                  state.getCurrentData() + state.size());
+    m_snapshot_states++;
+}   // addSnapshotState
+
+//-----------------------------------------------------------------------------
+/** Writes the current snapshot to the streamed history. All events before
+ *  the snapshot are written first, so the file is in time order.
+ */
+void History::finishSnapshot()
+{
+    if (!m_stream)
+        return;
+    // There can't be more than 255 rewinders (see RewindManager)
+    m_snapshot.getBuffer()[4] = (uint8_t)m_snapshot_states;
+    // The item manager is only a rewinder in networked races, and its
+    // network state only has the item events, so all items are saved
+    Track::getCurrentTrack()->getItemManager()->saveCompleteState(&m_snapshot);
+    if (m_streamed_events < m_all_input_events.size())
+    {
+        writeEvents(m_stream, m_streamed_events);
+        m_streamed_events = (unsigned int)m_all_input_events.size();
+    }
+    writeChunk(m_stream, CT_SNAPSHOT, m_snapshot);
+}   // finishSnapshot
+
 //-----------------------------------------------------------------------------
 /** Sets the kart position and controls to the recorded history value.
  *  \param world_ticks WOrld time in ticks.
@@ -96,6 +271,16 @@ void History::updateReplay(int world_ticks)
 {
     World *world = World::getWorld();
 
+    if (m_seek_ticks >= 0)
+    {
+        int ticks = m_seek_ticks;
+        m_seek_ticks = -1;
+        seekTo(ticks);
+        // The events at the time reached are applied below, before the
+        // world is updated, as in a normal replay
+        world_ticks = world->getTicksSinceStart();
+    }
+
     while (m_event_index < m_all_input_events.size() &&
         m_all_input_events[m_event_index].m_world_ticks <= world_ticks)
     {
@@ -104,7 +289,15 @@ void History::updateReplay(int world_ticks)
         Log::verbose("history", "time %d event-time %d action %d %d",
             world->getTicksSinceStart(), ie.m_world_ticks, ie.m_action,
             ie.m_value);
-        kart->getController()->action(ie.m_action, ie.m_value);
+        PlayerController *pc =
+            dynamic_cast<PlayerController*>(kart->getController());
+        if (ie.m_from_network && pc)
+        {
+            pc->actionFromNetwork(ie.m_action, ie.m_value, ie.m_value_l,
+                                  ie.m_value_r);
+        }
+        else
+            kart->getController()->action(ie.m_action, ie.m_value);
         m_event_index++;
     }   // while we have events for current time step.
 
@@ -127,187 +320,432 @@ void History::updateReplay(int world_ticks)
 }   // updateReplay
 
 //-----------------------------------------------------------------------------
-/** Saves the history stored in the internal data structures into a file called
- *  history.dat.
+/** Moves a replayed history to the specified time. The last snapshot at or
+ *  before this time is restored (or the race is restarted if there is no
+ *  snapshot), and then the race is simulated with the recorded events till
+ *  the requested time is reached.
+ *  \param world_ticks The time to seek to.
  */
-void History::Save()
+void History::seekTo(int world_ticks)
 {
-    World *world   = World::getWorld();
-    if (!world)
+    World *world = World::getWorld();
+    if (!world || !m_replay_history)
         return;
-    FILE *fd = fopen("history.dat","w");
-    if(fd)
-        Log::info("History", "Saved in ./history.dat.");
-    else
+
+    const SnapshotInfo *snapshot = NULL;
+    if (RewindManager::isEnabled())
     {
-        std::string fn = file_manager->getUserConfigFile("history.dat");
-        fd = FileUtils::fopenU8Path(fn, "w");
-        if(fd)
-            Log::info("History", "Saved in '%s'.", fn.c_str());
+        for (const SnapshotInfo &si : m_all_snapshots)
+        {
+            if (si.m_world_ticks > world_ticks)
+                break;
+            snapshot = &si;
+        }
     }
-    if(!fd)
+
+    // A snapshot is only used if it is closer than the current time
+    const int now = world->getTicksSinceStart();
+    if (snapshot && (snapshot->m_world_ticks > now || world_ticks < now) &&
+        restoreSnapshot(*snapshot))
     {
-        Log::info("History", "Can't open history.dat file for writing - can't save history.");
-        Log::info("History", "Make sure history.dat in the current directory "
-                             "or the config directory is writable.");
-        return;
+        Log::info("History", "Restored snapshot at ticks %d.",
+                  snapshot->m_world_ticks);
     }
-
-    const int num_karts = world->getNumKarts();
-    fprintf(fd, "STK-version:      %s\n",   STK_VERSION);
-    fprintf(fd, "History-version:  %d\n",   1);
-    fprintf(fd, "numkarts:         %d\n",   num_karts);
-    fprintf(fd, "numplayers:       %d\n", RaceManager::get()->getNumPlayers());
-    fprintf(fd, "difficulty:       %d\n", RaceManager::get()->getDifficulty());
-    fprintf(fd, "reverse: %c\n", RaceManager::get()->getReverseTrack() ? 'y' : 'n');
-
-    fprintf(fd, "track: %s\n", Track::getCurrentTrack()->getIdent().c_str());
-
-    assert(num_karts > 0);
-
-    int k;
-    for(k=0; k<num_karts; k++)
+    else if (world_ticks < now)
     {
-        fprintf(fd, "model %d: %s\n",k, world->getKart(k)->getIdent().c_str());
+        world->reset();
     }
-    fprintf(fd, "count:     %zu\n", m_all_input_events.size());
 
-    for (unsigned int i = 0; i < m_all_input_events.size(); i++)
+    // The events at the current time are applied in updateReplay before
+    // the world is updated, as in a normal replay.
+    m_event_index = 0;
+    while (m_event_index < m_all_input_events.size() &&
+           m_all_input_events[m_event_index].m_world_ticks <
+                                                world->getTicksSinceStart())
+        m_event_index++;
+
+    // Stop at the end of the events, otherwise updateReplay would restart
+    // the race.
+    while (world->getTicksSinceStart() < world_ticks &&
+           m_event_index < m_all_input_events.size())
     {
-        fprintf(fd, "%d %d %d %d\n",
-                m_all_input_events[i].m_world_ticks,
-                m_all_input_events[i].m_kart_index,
-                m_all_input_events[i].m_action,
-                m_all_input_events[i].m_value      );
-    }   // for i
-
-    fprintf(fd, "History file end.\n");
-    fclose(fd);
-}   // Save
+        updateReplay(world->getTicksSinceStart());
+        world->updateWorld(1);
+        world->updateTime(1);
+    }
+    Log::info("History", "Replay continues at ticks %d.", world_ticks);
+}   // seekTo
 
 //-----------------------------------------------------------------------------
-/** Loads a history from history.dat in the current directory.
+/** Reads a snapshot from the history file and restores the state of all
+ *  rewinders, like a network state in a rewind.
+ *  \param si Position of the snapshot in the history file.
+ *  \return True if the snapshot was restored.
  */
-void History::Load()
+bool History::restoreSnapshot(const SnapshotInfo &si)
 {
-    char s[1024], s1[1024];
-    int  n;
-
-    FILE *fd = fopen("history.dat","r");
-    if(fd)
-        Log::info("History", "Reading ./history.dat");
-    else
+    FILE *fd = FileUtils::fopenU8Path(m_filename, "rb");
+    if (!fd)
+        return false;
+    BareNetworkString data(si.m_size);
+    data.getBuffer().resize(si.m_size);
+    bool ok = fseek(fd, si.m_offset, SEEK_SET) == 0 &&
+              fread(data.getData(), 1, si.m_size, fd) == si.m_size;
+    fclose(fd);
+    if (!ok)
     {
-        std::string fn = file_manager->getUserConfigFile("history.dat");
-        fd = FileUtils::fopenU8Path(fn, "r");
-        if(fd)
-            Log::info("History", "Reading '%s'.", fn.c_str());
+        Log::error("History", "Can't read snapshot at ticks %d.",
+                   si.m_world_ticks);
+        return false;
     }
-    if(!fd)
-        Log::fatal("History", "Could not open history.dat");
 
-    if (fgets(s, 1023, fd) == NULL)
-        Log::fatal("History", "Could not read history.dat.");
+    World *world = World::getWorld();
+    RewindManager *rm = RewindManager::get();
+    const std::string item_manager(1, RN_ITEM_MANAGER);
+    try
+    {
+        // Snapshots of older histories don't contain the items after the
+        // rewinder states, the items would not match the recording then
+        data.getUInt32();
+        unsigned int count = data.getUInt8();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            std::string name;
+            data.decodeString(&name);
+            data.skip(data.getUInt16());
+        }
+        if (data.size() == 0)
+        {
+            Log::warn("History", "Snapshot at ticks %d has no items.",
+                      si.m_world_ticks);
+            return false;
+        }
+        data.reset();
+
+        int ticks = data.getUInt32();
+        world->setTicksForRewind(ticks);
+        // As in a rewind, the index has the positions before the seek
+        world->invalidateProximityIndex();
+        count = data.getUInt8();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            std::string name;
+            data.decodeString(&name);
+            uint16_t size = data.getUInt16();
+            std::shared_ptr<Rewinder> r = rm->getRewinder(name);
+            if (!r && name == item_manager)
+            {
+                // Restored from the complete item state below
+                data.skip(size);
+                continue;
+            }
+            if (!r)
+                r = ProjectileManager::get()->addRewinderFromNetworkState(name);
+            if (!r)
+            {
+                Log::warn("History", "Missing rewinder %s.", name.c_str());
+                data.skip(size);
+                continue;
+            }
+            r->restoreState(&data, size);
+        }
+        Track::getCurrentTrack()->getItemManager()->restoreAllItems(data);
+    }
+    catch (std::exception& e)
+    {
+        Log::error("History", "Invalid snapshot at ticks %d: %s",
+                   si.m_world_ticks, e.what());
+        return false;
+    }
+    // Update check lines, like after a rewind
+    Track::getCurrentTrack()->getCheckManager()->resetAfterRewind();
+    return true;
+}   // restoreSnapshot
 
-    // Check for unsupported hsitory file formats:
-    if (sscanf(s, "Version-2: %1023s", s1) == 1 ||
-        sscanf(s, "Version-1: %1023s", s1) == 1)
+//-----------------------------------------------------------------------------
+/** Opens history.dat, either in the current directory, or in the config
+ *  directory.
+ *  \param mode The fopen mode.
+ */
+FILE* History::openFile(const char *mode)
+{
+    m_filename = "history.dat";
+    FILE *fd = FileUtils::fopenU8Path(m_filename, mode);
+    if (!fd)
     {
-        Log::fatal("History",
-                   "Old history file format is not supported anymore.");
+        m_filename = file_manager->getUserConfigFile("history.dat");
+        fd = FileUtils::fopenU8Path(m_filename, mode);
     }
+    if (fd)
+        Log::info("History", "Using '%s'.", m_filename.c_str());
+    return fd;
+}   // openFile
 
-    if (sscanf(s,"STK-version: %1023s",s1)!=1)
-        Log::fatal("History", "No Version information found in history "
-                              "file (bogus history file).");
-    if (strcmp(s1,STK_VERSION))
-        Log::warn("History", "History is version '%s', STK version is '%s'.",
-                  s1, STK_VERSION);
+//-----------------------------------------------------------------------------
+/** Writes one chunk to a history file.
+ *  \param fd The file to write to.
+ *  \param type Type of the chunk.
+ *  \param data The content of the chunk.
+ */
+void History::writeChunk(FILE *fd, ChunkType type,
+                         const BareNetworkString &data)
+{
+    BareNetworkString header(5);
+    header.addUInt8(type).addUInt32(data.size());
+    fwrite(header.getData(), 1, header.size(), fd);
+    fwrite(data.getCurrentData(), 1, data.size(), fd);
+}   // writeChunk
 
-    if (fgets(s, 1023, fd) == NULL)
-        Log::fatal("History", "Could not read history.dat.");
+//-----------------------------------------------------------------------------
+/** Writes the file identification and the race setup.
+ */
+void History::writeHeader(FILE *fd)
+{
+    World *world = World::getWorld();
+    const int num_karts = world->getNumKarts();
+    assert(num_karts > 0);
 
-    int version;
-    if (sscanf(s, "History-version: %1023d", &version) != 1)
-        Log::fatal("Invalid version number found: '%s'", s);
+    fwrite(HISTORY_MAGIC, 1, sizeof(HISTORY_MAGIC), fd);
+    fputc(HISTORY_VERSION, fd);
+
+    BareNetworkString data;
+    data.encodeString(std::string(STK_VERSION))
+        .addUInt8(num_karts)
+        .addUInt8(RaceManager::get()->getNumPlayers())
+        .addUInt8(RaceManager::get()->getDifficulty())
+        .addUInt8(RaceManager::get()->getReverseTrack() ? 1 : 0)
+        .encodeString(Track::getCurrentTrack()->getIdent());
+    for (int k = 0; k < num_karts; k++)
+        data.encodeString(world->getKart(k)->getIdent());
+    writeChunk(fd, CT_HEADER, data);
+}   // writeHeader
 
-    if (version != 1)
-        Log::fatal("History",
-                   "Old-style history files are not supported anymore.");
+//-----------------------------------------------------------------------------
+/** Writes all events starting with the specified index as one chunk. The
+ *  values are stored as variable length integers, which needs only 3 to 9
+ *  bytes for most events. The action of events received from a client has
+ *  the highest bit set, and is followed by the steering values.
+ *  \param fd The file to write to.
+ *  \param from Index of the first event to write.
+ */
+void History::writeEvents(FILE *fd, unsigned int from)
+{
+    const unsigned int count = (unsigned int)m_all_input_events.size() - from;
+    if (count == 0)
+        return;
+    BareNetworkString data(count * 8 + 4);
+    data.addVarUInt(count);
+    for (unsigned int i = from; i < m_all_input_events.size(); i++)
+    {
+        const InputEvent &ie = m_all_input_events[i];
+        data.addVarUInt(ie.m_world_ticks).addUInt8(ie.m_kart_index)
+            .addUInt8(ie.m_action | (ie.m_from_network ? NETWORK_EVENT : 0))
+            .addVarUInt(ie.m_value);
+        if (ie.m_from_network)
+        {
+            data.addVarUInt(encodeSigned(ie.m_value_l))
+                .addVarUInt(encodeSigned(ie.m_value_r));
+        }
+    }
+    writeChunk(fd, CT_EVENTS, data);
+}   // writeEvents
 
-    if (fgets(s, 1023, fd) == NULL)
-        Log::fatal("History", "Could not read history.dat.");
+//-----------------------------------------------------------------------------
+/** Writes all events which are not written yet to the streamed history,
+ *  and closes the file.
+ */
+void History::closeStream()
+{
+    if (!m_stream)
+        return;
+    writeEvents(m_stream, m_streamed_events);
+    m_streamed_events = (unsigned int)m_all_input_events.size();
+    writeChunk(m_stream, CT_END, BareNetworkString());
+    fclose(m_stream);
+    m_stream = NULL;
+    Log::info("History", "Saved in '%s'.", m_filename.c_str());
+}   // closeStream
 
-    unsigned int num_karts;
-    if(sscanf(s, "numkarts: %u", &num_karts)!=1)
-        Log::fatal("History", "No number of karts found in history file.");
-    RaceManager::get()->setNumKarts(num_karts);
+//-----------------------------------------------------------------------------
+/** Saves the history stored in the internal data structures into a file called
+ *  history.dat. If the history is streamed, only the events not written so
+ *  far are written.
+ */
+void History::Save()
+{
+    World *world   = World::getWorld();
+    if (!world)
+        return;
 
-    fgets(s, 1023, fd);
-    if(sscanf(s, "numplayers: %d",&n)!=1)
-        Log::fatal("History", "No number of players found in history file.");
-    RaceManager::get()->setNumPlayers(n);
+    if (m_stream)
+    {
+        writeEvents(m_stream, m_streamed_events);
+        m_streamed_events = (unsigned int)m_all_input_events.size();
+        fflush(m_stream);
+        Log::info("History", "Saved in '%s'.", m_filename.c_str());
+        return;
+    }
 
-    fgets(s, 1023, fd);
-    if(sscanf(s, "difficulty: %d",&n)!=1)
-        Log::fatal("History", "No difficulty found in history file.");
-    RaceManager::get()->setDifficulty((RaceManager::Difficulty)n);
+    FILE *fd = openFile("wb");
+    if(!fd)
+    {
+        Log::info("History", "Can't open history.dat file for writing - can't save history.");
+        Log::info("History", "Make sure history.dat in the current directory "
+                             "or the config directory is writable.");
+        return;
+    }
 
+    writeHeader(fd);
+    writeEvents(fd, 0);
+    writeChunk(fd, CT_END, BareNetworkString());
+    fclose(fd);
+    Log::info("History", "Saved in '%s'.", m_filename.c_str());
+}   // Save
 
-    fgets(s, 1023, fd);
-    char r;
-    if (sscanf(s, "reverse: %c", &r) != 1)
-        Log::fatal("History", "Could not read reverse information: '%s'", s);
-    RaceManager::get()->setReverseTrack(r == 'y');
+//-----------------------------------------------------------------------------
+/** Reads the header chunk and sets up the race manager.
+ *  \param data Content of the chunk.
+ */
+void History::readHeader(const BareNetworkString &data)
+{
+    std::string s;
+    data.decodeString(&s);
+    if (s != STK_VERSION)
+        Log::warn("History", "History is version '%s', STK version is '%s'.",
+                  s.c_str(), STK_VERSION);
 
-    fgets(s, 1023, fd);
-    if(sscanf(s, "track: %1023s",s1)!=1)
-        Log::warn("History", "Track not found in history file.");
-    RaceManager::get()->setTrack(s1);
+    unsigned int num_karts = data.getUInt8();
+    RaceManager::get()->setNumKarts(num_karts);
+    RaceManager::get()->setNumPlayers(data.getUInt8());
+    RaceManager::get()->setDifficulty(
+                                   (RaceManager::Difficulty)data.getUInt8());
+    RaceManager::get()->setReverseTrack(data.getUInt8() == 1);
+    data.decodeString(&s);
+    RaceManager::get()->setTrack(s);
     // This value doesn't really matter, but should be defined, otherwise
     // the racing phase can switch to 'ending'
     RaceManager::get()->setNumLaps(100);
 
-    for(unsigned int i=0; i<num_karts; i++)
+    m_kart_ident.clear();
+    for (unsigned int i = 0; i < num_karts; i++)
     {
-        fgets(s, 1023, fd);
-        if(sscanf(s, "model %d: %1023s",&n, s1) != 2)
-            Log::fatal("History", "No model information for kart %d found.", i);
-        m_kart_ident.push_back(s1);
-        if(i<RaceManager::get()->getNumPlayers() && !m_online_history_replay)
+        data.decodeString(&s);
+        m_kart_ident.push_back(s);
+        if (i < RaceManager::get()->getNumPlayers() &&
+            !m_online_history_replay)
         {
-            RaceManager::get()->setPlayerKart(i, s1);
+            RaceManager::get()->setPlayerKart(i, s);
         }
     }   // for i<nKarts
-    // FIXME: The model information is currently ignored
+}   // readHeader
+
+//-----------------------------------------------------------------------------
+/** Reads a chunk of input events.
+ *  \param data Content of the chunk.
+ */
+void History::readEvents(const BareNetworkString &data)
+{
+    unsigned int count = data.getVarUInt();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        InputEvent ie;
+        ie.m_world_ticks  = data.getVarUInt();
+        ie.m_kart_index   = data.getUInt8();
+        const uint8_t action = data.getUInt8();
+        ie.m_action       = (PlayerAction)(action & ~NETWORK_EVENT);
+        ie.m_value        = data.getVarUInt();
+        ie.m_from_network = (action & NETWORK_EVENT) != 0;
+        ie.m_value_l      = 0;
+        ie.m_value_r      = 0;
+        if (ie.m_from_network)
+        {
+            ie.m_value_l = decodeSigned(data.getVarUInt());
+            ie.m_value_r = decodeSigned(data.getVarUInt());
+        }
+        m_all_input_events.push_back(ie);
+    }
+}   // readEvents
 
-    fgets(s, 1023, fd);
-    int count;
-    if(sscanf(s,"count: %d",&count)!=1)
-        Log::fatal("History", "Number of records not found in history file.");
+//-----------------------------------------------------------------------------
+/** Loads a history from history.dat in the current directory. The events
+ *  are read into memory, of the snapshots only the position in the file is
+ *  stored (they are read when seeking).
+ */
+void History::Load()
+{
+    FILE *fd = openFile("rb");
+    if(!fd)
+        Log::fatal("History", "Could not open history.dat");
 
-    allocateMemory(count);
-    m_event_index = 0;
+    char magic[sizeof(HISTORY_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), fd) != sizeof(magic))
+        Log::fatal("History", "Could not read history.dat.");
+    if (memcmp(magic, "STK-", 4) == 0 || memcmp(magic, "Vers", 4) == 0)
+    {
+        Log::fatal("History",
+                   "Text history files are not supported anymore.");
+    }
+    if (memcmp(magic, HISTORY_MAGIC, sizeof(magic)) != 0)
+        Log::fatal("History", "Bogus history file.");
+    int version = fgetc(fd);
+    if (version != HISTORY_VERSION)
+        Log::fatal("History", "Unsupported history version %d.", version);
 
-    // We need to disable the rewind manager here (otherwise setting the
-    // KartControl data would access the rewind manager).
-    bool rewind_manager_was_enabled = RewindManager::isEnabled();
-    RewindManager::setEnable(false);
+    allocateMemory();
+    m_all_snapshots.clear();
+    m_event_index = 0;
 
-    for (int i=0; i<count; i++)
+    bool has_header = false;
+    int type;
+    BareNetworkString chunk;
+    while ((type = fgetc(fd)) != EOF && type != CT_END)
     {
-        fgets(s, 1023, fd);
-        InputEvent &ie = m_all_input_events[i];
-        int action = 0;
-        if (sscanf(s, "%d %d %d %d\n", &ie.m_world_ticks, &ie.m_kart_index,
-            &action, &ie.m_value) != 4)
+        uint8_t size_bytes[4];
+        if (fread(size_bytes, 1, 4, fd) != 4)
+            break;
+        BareNetworkString size_data((char*)size_bytes, 4);
+        uint32_t size = size_data.getUInt32();
+        if (type == CT_SNAPSHOT)
         {
-            Log::warn("History", "Problems reading event: '%s'", s);
+            // Only the position is stored, the ticks are the first value
+            SnapshotInfo si;
+            si.m_offset = ftell(fd);
+            si.m_size   = size;
+            uint8_t ticks[4];
+            if (size < 4 || fread(ticks, 1, 4, fd) != 4 ||
+                fseek(fd, size - 4, SEEK_CUR) != 0)
+                break;
+            si.m_world_ticks = BareNetworkString((char*)ticks, 4).getUInt32();
+            m_all_snapshots.push_back(si);
+            continue;
         }
-        ie.m_action = (PlayerAction)action;
-    }   // for i
-    RewindManager::setEnable(rewind_manager_was_enabled);
-
+        chunk.getBuffer().resize(size);
+        chunk.reset();
+        if (fread(chunk.getData(), 1, size, fd) != size)
+            break;
+        try
+        {
+            if (type == CT_HEADER)
+            {
+                readHeader(chunk);
+                has_header = true;
+            }
+            else if (type == CT_EVENTS)
+                readEvents(chunk);
+            else
+                Log::warn("History", "Unknown chunk type %d.", type);
+        }
+        catch (std::exception& e)
+        {
+            Log::fatal("History", "Invalid history file: %s", e.what());
+        }
+    }   // while type != CT_END
+    if (type != CT_END)
+        Log::warn("History", "History file is incomplete.");
+    if (!has_header)
+        Log::fatal("History", "No race information found in history file.");
+
+    Log::info("History", "Read %d events and %d snapshots.",
+              (int)m_all_input_events.size(), (int)m_all_snapshots.size());
     fclose(fd);
 }   // Load
-
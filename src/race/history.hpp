@@ -22,7 +22,9 @@
 
 #include "input/input.hpp"
 #include "karts/controller/kart_control.hpp"
+#include "network/network_string.hpp"
 
+#include <stdio.h>
 #include <string>
 #include <vector>
 
@@ -30,13 +32,44 @@ class Kart;
 
 /**
   * \ingroup race
+  * Records the input events of a race, and replays them (--history).
+  * The history is stored in history.dat in a binary format, which is a
+  * sequence of chunks (each a type byte, a 32 bit size and the data): a
+  * header with the race setup, chunks of input events and snapshots of the
+  * world. With --record-history the chunks are written while the race is
+  * running, so there is no big write when the race ends (otherwise the
+  * history is only kept in memory and written by Save()). The snapshots
+  * contain the state of all rewinders (as saved by RewindManager::saveState
+  * for the network states) and of all items, so they are only available in
+  * networked races. A replay can be started at any tick (--history-seek):
+  * the last snapshot before that tick is restored, and the race is
+  * simulated from there. Snapshots without the items are not used, the
+  * race is simulated from the start instead.
   */
 class History
 {
 private:
+    /** The type of a chunk in a history file. */
+    enum ChunkType : uint8_t
+    {
+        CT_HEADER   = 1,
+        CT_EVENTS   = 2,
+        CT_SNAPSHOT = 3,
+        CT_END      = 4
+    };
+
+    /** Version of the binary history format. */
+    static const uint8_t HISTORY_VERSION = 2;
+
+    /** Number of events after which an event chunk is written. */
+    static const unsigned EVENTS_PER_CHUNK = 256;
+
     /** True if a history should be replayed, */
     bool m_replay_history;
 
+    /** True if the history is written while the race is running. */
+    bool m_stream_history;
+
     /** Points to the last used input event index. */
     unsigned int m_event_index;
 
@@ -54,21 +87,81 @@ private:
         PlayerAction m_action;
         /** The value to use. */
         int m_value;
+        /** The steering values of an action received from a client, which
+         *  are replayed with PlayerController::actionFromNetwork. */
+        int m_value_l;
+        int m_value_r;
+        /** True if the action was received from a client. */
+        bool m_from_network;
     };   // InputEvent
     // ------------------------------------------------------------------------
+    /** Where a snapshot was found in the loaded history file. */
+    struct SnapshotInfo
+    {
+        int      m_world_ticks;
+        long     m_offset;
+        uint32_t m_size;
+    };   // SnapshotInfo
+    // ------------------------------------------------------------------------
 
     /** All input events. */
     std::vector<InputEvent> m_all_input_events;
 
+    /** All snapshots of the loaded history, sorted by time. */
+    std::vector<SnapshotInfo> m_all_snapshots;
+
+    /** The file the history is streamed to, or NULL. */
+    FILE *m_stream;
+
+    /** Name of the file the history is written to or read from. */
+    std::string m_filename;
+
+    /** Index of the first event which is not written to m_stream yet. */
+    unsigned int m_streamed_events;
+
+    /** Ticks of the last snapshot taken while recording. */
+    int m_last_snapshot_ticks;
+
+    /** Minimum number of ticks between two snapshots. */
+    int m_snapshot_interval;
+
+    /** The snapshot being taken (between isSnapshotDue and
+     *  finishSnapshot). */
+    BareNetworkString m_snapshot;
+
+    /** Number of rewinder states in m_snapshot. */
+    unsigned int m_snapshot_states;
+
+    /** The tick at which a replay should start, or -1. */
+    int m_seek_ticks;
+
     void  allocateMemory(int size=-1);
+    void  addInputEvent(const InputEvent &ie);
+    FILE* openFile(const char *mode);
+    void  writeChunk(FILE *fd, ChunkType type, const BareNetworkString &data);
+    void  writeHeader(FILE *fd);
+    void  writeEvents(FILE *fd, unsigned int from);
+    void  closeStream();
+    void  readHeader(const BareNetworkString &data);
+    void  readEvents(const BareNetworkString &data);
+    bool  restoreSnapshot(const SnapshotInfo &si);
 public:
     static bool m_online_history_replay;
           History        ();
+         ~History        ();
     void  initRecording  ();
+    void  stopRecording  ();
     void  Save           ();
     void  Load           ();
     void  updateReplay(int world_ticks);
     void  addEvent(int kart_id, PlayerAction pa, int value);
+    void  addNetworkEvent(int kart_id, PlayerAction pa, int value,
+                          int value_l, int value_r);
+    bool  isSnapshotDue(int world_ticks);
+    void  addSnapshotState(const std::string &name,
+                           const BareNetworkString &state);
+    void  finishSnapshot();
+    void  seekTo(int world_ticks);
 
     // -------------------I-----------------------------------------------------
     /** Returns the identifier of the n-th kart. */
@@ -82,6 +175,15 @@ public:
     // ------------------------------------------------------------------------
     /** Set if replay is enabled or not. */
     void  setReplayHistory(bool b) { m_replay_history=b;  }
+    // ------------------------------------------------------------------------
+    /** Enables writing the history while the race is running. */
+    void  setStreamHistory(bool b) { m_stream_history = b; }
+    // ------------------------------------------------------------------------
+    /** Sets the tick at which a replayed history starts. */
+    void  setSeekTicks(int ticks)  { m_seek_ticks = ticks; }
+    // ------------------------------------------------------------------------
+    /** Returns true if the loaded history contains snapshots of the world. */
+    bool  hasSnapshots() const     { return !m_all_snapshots.empty(); }
 };
 
 extern History* history;
@@ -62,6 +62,7 @@
 #include "tracks/track_manager.hpp"
 #include "utils/profiler.hpp"
 #include "utils/ptr_vector.hpp"
+#include "utils/random_generator.hpp"
 #include "utils/stk_process.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
@@ -608,7 +609,9 @@ void RaceManager::startNextRace()
         {
             if (random_pos_available)
             {
-                unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+                unsigned seed = RandomGenerator::hasSeed() ?
+                    RandomGenerator::getSeed() :
+                    std::chrono::system_clock::now().time_since_epoch().count();
                 std::shuffle(m_kart_status.begin() + offset, m_kart_status.end(),
                     std::default_random_engine(seed));
             }
@@ -18,14 +18,113 @@
 #include "replay/replay_base.hpp"
 
 #include "io/file_manager.hpp"
+#include "network/network_string.hpp"
 #include "utils/file_utils.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+
+#include <cinttypes>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    /** The first bytes of a binary replay file. Text replays always start
+     *  with "version:". */
+    const char     BINARY_MAGIC[4] = { 'S', 'T', 'K', 'R' };
+
+    /** Version of the binary file layout. The recorded data itself always
+     *  has the current replay version. */
+    const uint16_t BINARY_FORMAT_VERSION = 1;
+
+    /** Headers are usually less than 1 KB, anything much bigger is a
+     *  broken file. */
+    const uint32_t MAX_BINARY_HEADER_SIZE = 65536;
+
+    // ------------------------------------------------------------------------
+    /** Reads one line of a text replay and removes the line end, so that
+     *  files with windows line ends can be read, too.
+     *  \return False at the end of the file.
+     */
+    bool readLine(FILE *fd, char *s)
+    {
+        if (fgets(s, 1023, fd) == NULL)
+            return false;
+        size_t len = strlen(s);
+        while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r'))
+            s[--len] = '\0';
+        return true;
+    }   // readLine
+
+    // ------------------------------------------------------------------------
+    /** Adds the difference of value to the previous value of the same
+     *  stream, zigzag encoded so that small negative differences need few
+     *  bytes, too. */
+    void addDelta(BareNetworkString *out, int32_t value, int32_t *prev)
+    {
+        int32_t delta = (int32_t)((uint32_t)value - (uint32_t)*prev);
+        out->addVarUInt(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+        *prev = value;
+    }   // addDelta
+
+    // ------------------------------------------------------------------------
+    /** Floats are delta encoded using their bit pattern, so they are stored
+     *  without any loss of precision. Slowly changing values have close bit
+     *  patterns and need only a few bytes. */
+    void addDelta(BareNetworkString *out, float value, int32_t *prev)
+    {
+        int32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        addDelta(out, bits, prev);
+    }   // addDelta
+
+    // ------------------------------------------------------------------------
+    int32_t getIntDelta(const BareNetworkString &in, int32_t *prev)
+    {
+        uint32_t zigzag = in.getVarUInt();
+        uint32_t delta = (zigzag >> 1) ^ (0u - (zigzag & 1));
+        *prev = (int32_t)((uint32_t)*prev + delta);
+        return *prev;
+    }   // getIntDelta
+
+    // ------------------------------------------------------------------------
+    float getFloatDelta(const BareNetworkString &in, int32_t *prev)
+    {
+        int32_t bits = getIntDelta(in, prev);
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }   // getFloatDelta
+
+    // ------------------------------------------------------------------------
+    /** Appends a stream to the body, prefixed with its size so that a
+     *  reader can skip streams it does not need. */
+    void addStream(BareNetworkString *body, const BareNetworkString &stream)
+    {
+        body->addVarUInt(stream.size());
+        *body += stream;
+    }   // addStream
+
+    // ------------------------------------------------------------------------
+    BareNetworkString getStream(BareNetworkString &body)
+    {
+        uint32_t size = body.getVarUInt();
+        if (size > body.size())
+            throw std::out_of_range("Replay stream too long.");
+        BareNetworkString stream(body.getCurrentData(), (int)size);
+        body.skip((int)size);
+        return stream;
+    }   // getStream
+}   // namespace
 
 // -----------------------------------------------------------------------------
 ReplayBase::ReplayBase()
 {
 }   // ReplayBaese
 // -----------------------------------------------------------------------------
-/** Opens a replay file which is determined by sub classes.
+/** Opens a replay file which is determined by sub classes. The file is
+ *  always opened in binary mode, text replays are read line by line with
+ *  any kind of line end.
  *  \param writeable True if the file should be opened for writing.
  *  \param full_path True if the file is full path.
  *  \return A FILE *, or NULL if the file could not be opened.
@@ -34,7 +133,7 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path, int replay_file
 {
     FILE* fd = FileUtils::fopenU8Path(full_path ? getReplayFilename(replay_file_number) :
         file_manager->getReplayDir() + getReplayFilename(replay_file_number),
-        writeable ? "w" : "r");
+        writeable ? "wb" : "rb");
     if (!fd)
     {
         return NULL;
@@ -42,3 +141,720 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path, int replay_file
     return fd;
 
 }   // openReplayFile
+
+// -----------------------------------------------------------------------------
+/** Reads the header of a text or binary replay file. Afterwards the file is
+ *  positioned at the start of the recorded events, which can be read with
+ *  readEvents() - but this is not necessary to list the replay.
+ *  \param fd The replay file, opened at its start.
+ *  \param header The header information.
+ *  \param fn Name of the file, used in error messages.
+ *  \return False if the file can not be used.
+ */
+bool ReplayBase::readHeader(FILE *fd, ReplayHeader *header,
+                            const std::string &fn)
+{
+    char magic[sizeof(BINARY_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), fd) == sizeof(magic) &&
+        memcmp(magic, BINARY_MAGIC, sizeof(magic)) == 0)
+    {
+        header->m_binary_format = true;
+        return readBinaryHeader(fd, header, fn);
+    }
+    rewind(fd);
+    header->m_binary_format = false;
+    return readTextHeader(fd, header, fn);
+}   // readHeader
+
+// -----------------------------------------------------------------------------
+/** Reads all recorded events of a replay file, one KartEvents entry for each
+ *  kart. readHeader() must have been called before with the same file.
+ *  \return False if the events could not be read.
+ */
+bool ReplayBase::readEvents(FILE *fd, const ReplayHeader &header,
+                            std::vector<KartEvents> *events)
+{
+    events->clear();
+    if (header.m_binary_format)
+        return readBinaryEvents(fd, header, events);
+    return readTextEvents(fd, header, events);
+}   // readEvents
+
+// -----------------------------------------------------------------------------
+/** Writes a complete replay file.
+ *  \param binary True to write the binary format, false for text.
+ *  \return False if the file could not be written.
+ */
+bool ReplayBase::writeReplay(FILE *fd, const ReplayHeader &header,
+                             const std::vector<KartEvents> &events,
+                             bool binary)
+{
+    if (binary)
+        return writeBinaryReplay(fd, header, events);
+    return writeTextReplay(fd, header, events);
+}   // writeReplay
+
+// -----------------------------------------------------------------------------
+bool ReplayBase::readTextHeader(FILE *fd, ReplayHeader *header,
+                                const std::string &fn)
+{
+    char s[1024], s1[1024];
+
+    readLine(fd, s);
+    unsigned int version;
+    if (sscanf(s,"version: %u", &version) != 1)
+    {
+        Log::warn("Replay", "No Version information "
+                  "found in replay file (bogus replay file).");
+        return false;
+    }
+    if ( version < getMinSupportedReplayVersion() )
+    {
+        Log::warn("Replay", "Replay is version '%d', Minimum supported replay version is '%d', skipped '%s'",
+                  version, getMinSupportedReplayVersion(), fn.c_str());
+        return false;
+    }
+    else if (version > getCurrentReplayVersion())
+    {
+        Log::warn("Replay", "Replay is version '%d', STK replay version is '%d', skipped '%s'",
+                  version, getCurrentReplayVersion(), fn.c_str());
+        return false;
+    }
+
+    header->m_replay_version = version;
+
+    if (version >= 4)
+    {
+        readLine(fd, s);
+        if(sscanf(s, "stk_version: %1023s", s1) != 1)
+        {
+            Log::warn("Replay", "No STK release version found in replay file, '%s'.", fn.c_str());
+            return false;
+        }
+        header->m_stk_version = s1;
+    }
+    else
+        header->m_stk_version = "";
+
+    while(true)
+    {
+        if (!readLine(fd, s))
+        {
+            Log::warn("Replay", "No end of kart list found in replay file, '%s'.", fn.c_str());
+            return false;
+        }
+        core::stringc is_end(s);
+        is_end.trim();
+        if (is_end == "kart_list_end") break;
+        char display_name_encoded[1024];
+
+        int scanned = sscanf(s,"kart: %1023s %1023[^\n]", s1, display_name_encoded);
+        if (scanned < 1)
+        {
+            Log::warn("Replay", "Could not read ghost karts info!");
+            break;
+        }
+
+        header->m_kart_list.push_back(std::string(s1));
+        if (scanned == 2)
+        {
+            // If username of kart is present, use it
+            header->m_name_list.push_back(StringUtils::xmlDecode(std::string(display_name_encoded)));
+            if (header->m_name_list.size() == 1)
+            {
+                // First user is the game master and the "owner" of this replay file
+                header->m_user_name = header->m_name_list[0];
+            }
+        } else
+        { // scanned == 1
+            // If username is not present, kart display name will default to kart name
+            // (see GhostController::getName)
+            header->m_name_list.push_back("");
+        }
+
+        // Read kart color data
+        if (version >= 4)
+        {
+            float f = 0;
+            readLine(fd, s);
+            if(sscanf(s, "kart_color: %f", &f) != 1)
+            {
+                Log::warn("Replay", "Kart color missing in replay file, '%s'.", fn.c_str());
+                return false;
+            }
+            header->m_kart_color.push_back(f);
+        }
+        else
+            header->m_kart_color.push_back(0.0f); // Use default kart color
+    }
+
+    int reverse = 0;
+    readLine(fd, s);
+    if(sscanf(s, "reverse: %d", &reverse) != 1)
+    {
+        Log::warn("Replay", "No reverse info found in replay file, '%s'.", fn.c_str());
+        return false;
+    }
+    header->m_reverse = reverse != 0;
+
+    readLine(fd, s);
+    if (sscanf(s, "difficulty: %u", &header->m_difficulty) != 1)
+    {
+        Log::warn("Replay", " No difficulty found in replay file, '%s'.", fn.c_str());
+        return false;
+    }
+
+    if (version >= 4)
+    {
+        readLine(fd, s);
+        if (sscanf(s, "mode: %1023s", s1) != 1)
+        {
+            Log::warn("Replay", "Replay mode not found in replay file, '%s'.", fn.c_str());
+            return false;
+        }
+        header->m_minor_mode = s1;
+    }
+    // Assume time-trial mode for old replays
+    else
+        header->m_minor_mode = "time-trial";
+
+    // sscanf always stops at whitespaces, but a track name may contain a whitespace
+    // Official tracks should avoid whitespaces in their name, but it
+    // unavoidably occurs with some addons or WIP tracks.
+    readLine(fd, s);
+    if (std::strncmp(s, "track: ", 7) == 0)
+    {
+        if (s[7] != '\0')
+        {
+            header->m_track_name = std::string(s + 7);
+        }
+        else
+        {
+            Log::warn("Replay", "Track name is empty in replay file, '%s'.", fn.c_str());
+            return false;
+        }
+    }
+    else
+    {
+        Log::warn("Replay", "Track info not found in replay file, '%s'.", fn.c_str());
+        return false;
+    }
+
+    header->m_info = "";
+    readLine(fd, s);
+    if (sscanf(s, "info: %1023s", s1) == 1)
+    {
+        header->m_info = s + 6;
+        readLine(fd, s);
+    }
+    if (sscanf(s, "laps: %u", &header->m_laps) != 1)
+    {
+        Log::warn("Replay", "No number of laps found in replay file, '%s'.", fn.c_str());
+        return false;
+    }
+
+    readLine(fd, s);
+    if (sscanf(s, "min_time: %f", &header->m_min_time) != 1)
+    {
+        Log::warn("Replay", "Finish time not found in replay file, '%s'.", fn.c_str());
+        return false;
+    }
+
+    if (version >= 4)
+    {
+        readLine(fd, s);
+        if (sscanf(s, "replay_uid: %" PRIu64, &header->m_replay_uid) != 1)
+        {
+            Log::warn("Replay", "Replay UID not found in replay file, '%s'.", fn.c_str());
+            return false;
+        }
+    }
+    // No UID in old replay format, set by the caller
+    else
+        header->m_replay_uid = 0;
+
+    return true;
+}   // readTextHeader
+
+// -----------------------------------------------------------------------------
+/** Reads the header of a binary replay. The magic bytes have already been
+ *  read. Only the header is read from the file, the size of it is stored
+ *  in front of it.
+ */
+bool ReplayBase::readBinaryHeader(FILE *fd, ReplayHeader *header,
+                                  const std::string &fn)
+{
+    char prefix[6];
+    if (fread(prefix, 1, sizeof(prefix), fd) != sizeof(prefix))
+    {
+        Log::warn("Replay", "Binary replay '%s' is too short.", fn.c_str());
+        return false;
+    }
+    BareNetworkString p(prefix, (int)sizeof(prefix));
+    uint16_t format_version = p.getUInt16();
+    uint32_t header_size = p.getUInt32();
+    if (format_version > BINARY_FORMAT_VERSION)
+    {
+        Log::warn("Replay", "Binary replay format is version '%d', STK "
+                  "supports version '%d', skipped '%s'", format_version,
+                  BINARY_FORMAT_VERSION, fn.c_str());
+        return false;
+    }
+    if (header_size > MAX_BINARY_HEADER_SIZE)
+    {
+        Log::warn("Replay", "Invalid header size in replay file, '%s'.",
+                  fn.c_str());
+        return false;
+    }
+
+    std::vector<char> data(header_size);
+    if (header_size > 0 && fread(data.data(), 1, header_size, fd) != header_size)
+    {
+        Log::warn("Replay", "Binary replay '%s' is too short.", fn.c_str());
+        return false;
+    }
+
+    try
+    {
+        BareNetworkString h(data.data(), (int)header_size);
+        h.decodeString16(&header->m_stk_version);
+        unsigned int num_karts = h.getVarUInt();
+        if (num_karts > h.size())
+            throw std::out_of_range("Too many karts.");
+        for (unsigned int i = 0; i < num_karts; i++)
+        {
+            std::string kart;
+            core::stringw name;
+            h.decodeString(&kart);
+            h.decodeString16(&name);
+            header->m_kart_list.push_back(kart);
+            header->m_name_list.push_back(name);
+            header->m_kart_color.push_back(h.getFloat());
+        }
+        if (num_karts > 0)
+            header->m_user_name = header->m_name_list[0];
+        header->m_reverse = h.getUInt8() != 0;
+        header->m_difficulty = h.getUInt8();
+        h.decodeString(&header->m_minor_mode);
+        h.decodeString(&header->m_track_name);
+        h.decodeString16(&header->m_info);
+        header->m_laps = h.getVarUInt();
+        header->m_min_time = h.getFloat();
+        header->m_replay_uid = h.getUInt64();
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("Replay", "Invalid header in replay file '%s': %s.",
+                  fn.c_str(), e.what());
+        return false;
+    }
+    if (header->m_track_name.empty())
+    {
+        Log::warn("Replay", "Track name is empty in replay file, '%s'.", fn.c_str());
+        return false;
+    }
+    header->m_replay_version = getCurrentReplayVersion();
+    return true;
+}   // readBinaryHeader
+
+// -----------------------------------------------------------------------------
+bool ReplayBase::readTextEvents(FILE *fd, const ReplayHeader &header,
+                                std::vector<KartEvents> *events)
+{
+    char s[1024];
+    while (readLine(fd, s))
+    {
+        unsigned int size;
+        if (sscanf(s, "size: %u", &size) != 1)
+        {
+            Log::warn("Replay", "Number of records not found in replay file "
+                      "for kart %d.", (int)events->size());
+            return false;
+        }
+
+        events->push_back(KartEvents());
+        KartEvents &ke = events->back();
+        for (unsigned int i = 0; i < size; i++)
+        {
+            if (!readLine(fd, s))
+            {
+                Log::warn("Replay", "Replay data of kart %d is incomplete.",
+                          (int)events->size() - 1);
+                return false;
+            }
+            float x, y, z, rx, ry, rz, rw, time, speed, steer, w1, w2, w3, w4,
+                  nitro_amount = 0.0f, distance = 0.0f;
+            // Values not saved in version 3 replays stay 0
+            int skidding_state = 0, attachment = 0, item_amount = 0,
+                item_type = 0, special_value = 0, nitro, zipper, skidding,
+                red_skidding, jumping;
+
+            bool valid;
+            // Up to STK 0.9.3 replays
+            if (header.m_replay_version == 3)
+            {
+                valid = sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
+                    &time,
+                    &x, &y, &z,
+                    &rx, &ry, &rz, &rw,
+                    &speed, &steer, &w1, &w2, &w3, &w4,
+                    &nitro, &zipper, &skidding, &red_skidding, &jumping
+                    )==19;
+            }
+            //version 4 replays (STK 0.9.4 and higher)
+            else
+            {
+                valid = sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
+                    &time,
+                    &x, &y, &z,
+                    &rx, &ry, &rz, &rw,
+                    &speed, &steer, &w1, &w2, &w3, &w4, &skidding_state,
+                    &attachment, &nitro_amount, &item_amount, &item_type, &special_value,
+                    &distance, &nitro, &zipper, &skidding, &red_skidding, &jumping
+                    )==26;
+            }
+            if (!valid)
+            {
+                // Invalid record found
+                // ---------------------
+                Log::warn("Replay", "Can't read replay data line %d:", i);
+                Log::warn("Replay", "%s", s);
+                Log::warn("Replay", "Ignored.");
+                continue;
+            }
+
+            TransformEvent te;
+            PhysicInfo pi             = {0};
+            BonusInfo bi              = {0};
+            KartReplayEvent kre       = {0};
+
+            te.m_time                 = time;
+            te.m_transform = btTransform(btQuaternion(rx, ry, rz, rw),
+                                         btVector3(x, y, z));
+            pi.m_speed                = speed;
+            pi.m_steer                = steer;
+            pi.m_suspension_length[0] = w1;
+            pi.m_suspension_length[1] = w2;
+            pi.m_suspension_length[2] = w3;
+            pi.m_suspension_length[3] = w4;
+            pi.m_skidding_state       = skidding_state;
+            bi.m_attachment           = attachment;
+            bi.m_nitro_amount         = nitro_amount;
+            bi.m_item_amount          = item_amount;
+            bi.m_item_type            = item_type;
+            bi.m_special_value        = special_value;
+            kre.m_distance            = distance;
+            kre.m_nitro_usage         = nitro;
+            kre.m_zipper_usage        = zipper!=0;
+            kre.m_skidding_effect     = skidding;
+            kre.m_red_skidding        = red_skidding!=0;
+            kre.m_jumping             = jumping != 0;
+            ke.m_transform_events.push_back(te);
+            ke.m_physic_info.push_back(pi);
+            ke.m_bonus_info.push_back(bi);
+            ke.m_kart_replay_event.push_back(kre);
+        }   // for i
+    }
+    return true;
+}   // readTextEvents
+
+// -----------------------------------------------------------------------------
+/** Reads the events of a binary replay. For each kart the number of events
+ *  is followed by four streams (transforms, physic info, bonus info and
+ *  other events), in which each value is stored as the difference to the
+ *  same value of the previous event.
+ */
+bool ReplayBase::readBinaryEvents(FILE *fd, const ReplayHeader &header,
+                                  std::vector<KartEvents> *events)
+{
+    std::vector<char> data;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fd)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+
+    try
+    {
+        BareNetworkString body(data.data(), (int)data.size());
+        for (unsigned int k = 0; k < header.m_kart_list.size(); k++)
+        {
+            const unsigned int count = body.getVarUInt();
+            // Each event needs at least one byte in each stream
+            if (count > body.size())
+                throw std::out_of_range("Too many events.");
+            events->push_back(KartEvents());
+            KartEvents &ke = events->back();
+            ke.m_transform_events.resize(count);
+            ke.m_physic_info.resize(count);
+            ke.m_bonus_info.resize(count);
+            ke.m_kart_replay_event.resize(count);
+
+            BareNetworkString transforms = getStream(body);
+            int32_t prev[8] = { 0 };
+            for (TransformEvent &te : ke.m_transform_events)
+            {
+                te.m_time = getFloatDelta(transforms, &prev[0]);
+                btVector3 xyz;
+                xyz.setX(getFloatDelta(transforms, &prev[1]));
+                xyz.setY(getFloatDelta(transforms, &prev[2]));
+                xyz.setZ(getFloatDelta(transforms, &prev[3]));
+                btQuaternion q;
+                q.setX(getFloatDelta(transforms, &prev[4]));
+                q.setY(getFloatDelta(transforms, &prev[5]));
+                q.setZ(getFloatDelta(transforms, &prev[6]));
+                q.setW(getFloatDelta(transforms, &prev[7]));
+                te.m_transform = btTransform(q, xyz);
+            }
+
+            BareNetworkString physics = getStream(body);
+            memset(prev, 0, sizeof(prev));
+            for (PhysicInfo &pi : ke.m_physic_info)
+            {
+                pi.m_speed = getFloatDelta(physics, &prev[0]);
+                pi.m_steer = getFloatDelta(physics, &prev[1]);
+                for (unsigned int j = 0; j < 4; j++)
+                {
+                    pi.m_suspension_length[j] =
+                        getFloatDelta(physics, &prev[2 + j]);
+                }
+                pi.m_skidding_state = getIntDelta(physics, &prev[6]);
+            }
+
+            BareNetworkString bonus = getStream(body);
+            memset(prev, 0, sizeof(prev));
+            for (BonusInfo &bi : ke.m_bonus_info)
+            {
+                bi.m_attachment    = getIntDelta(bonus, &prev[0]);
+                bi.m_nitro_amount  = getFloatDelta(bonus, &prev[1]);
+                bi.m_item_amount   = getIntDelta(bonus, &prev[2]);
+                bi.m_item_type     = getIntDelta(bonus, &prev[3]);
+                bi.m_special_value = getIntDelta(bonus, &prev[4]);
+            }
+
+            BareNetworkString other = getStream(body);
+            memset(prev, 0, sizeof(prev));
+            for (KartReplayEvent &kre : ke.m_kart_replay_event)
+            {
+                kre.m_distance        = getFloatDelta(other, &prev[0]);
+                kre.m_nitro_usage     = getIntDelta(other, &prev[1]);
+                kre.m_skidding_effect = getIntDelta(other, &prev[2]);
+                uint8_t flags         = other.getUInt8();
+                kre.m_zipper_usage    = (flags & 1) != 0;
+                kre.m_red_skidding    = (flags & 2) != 0;
+                kre.m_jumping         = (flags & 4) != 0;
+            }
+        }
+    }
+    catch (std::exception& e)
+    {
+        Log::warn("Replay", "Invalid replay data: %s.", e.what());
+        return false;
+    }
+    return true;
+}   // readBinaryEvents
+
+// -----------------------------------------------------------------------------
+bool ReplayBase::writeTextReplay(FILE *fd, const ReplayHeader &header,
+                                 const std::vector<KartEvents> &events)
+{
+    fprintf(fd, "version: %d\n", getCurrentReplayVersion());
+    fprintf(fd, "stk_version: %s\n",
+            StringUtils::wideToUtf8(header.m_stk_version).c_str());
+
+    for (unsigned int k = 0; k < header.m_kart_list.size(); k++)
+    {
+        // XML encode the username to handle Unicode
+        fprintf(fd, "kart: %s %s\n", header.m_kart_list[k].c_str(),
+                StringUtils::xmlEncode(header.m_name_list[k]).c_str());
+        fprintf(fd, "kart_color: %f\n", header.m_kart_color[k]);
+    }
+
+    fprintf(fd, "kart_list_end\n");
+    fprintf(fd, "reverse: %d\n",    (int)header.m_reverse);
+    fprintf(fd, "difficulty: %d\n", header.m_difficulty);
+    fprintf(fd, "mode: %s\n",       header.m_minor_mode.c_str());
+    fprintf(fd, "track: %s\n",      header.m_track_name.c_str());
+    if (!header.m_info.empty())
+    {
+        fprintf(fd, "info: %s\n",
+                StringUtils::wideToUtf8(header.m_info).c_str());
+    }
+    fprintf(fd, "laps: %d\n",       header.m_laps);
+    fprintf(fd, "min_time: %f\n",   header.m_min_time);
+    fprintf(fd, "replay_uid: %" PRIu64 "\n", header.m_replay_uid);
+
+    for (const KartEvents &ke : events)
+    {
+        const unsigned int num_transforms =
+            (unsigned int)ke.m_transform_events.size();
+        fprintf(fd, "size:     %d\n", num_transforms);
+
+        for (unsigned int i = 0; i < num_transforms; i++)
+        {
+            const TransformEvent *p  = &(ke.m_transform_events[i]);
+            const PhysicInfo *q      = &(ke.m_physic_info[i]);
+            const BonusInfo *b       = &(ke.m_bonus_info[i]);
+            const KartReplayEvent *r = &(ke.m_kart_replay_event[i]);
+            fprintf(fd, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
+                    p->m_time,
+                    p->m_transform.getOrigin().getX(),
+                    p->m_transform.getOrigin().getY(),
+                    p->m_transform.getOrigin().getZ(),
+                    p->m_transform.getRotation().getX(),
+                    p->m_transform.getRotation().getY(),
+                    p->m_transform.getRotation().getZ(),
+                    p->m_transform.getRotation().getW(),
+                    q->m_speed,
+                    q->m_steer,
+                    q->m_suspension_length[0],
+                    q->m_suspension_length[1],
+                    q->m_suspension_length[2],
+                    q->m_suspension_length[3],
+                    q->m_skidding_state,
+                    b->m_attachment,
+                    b->m_nitro_amount,
+                    b->m_item_amount,
+                    b->m_item_type,
+                    b->m_special_value,
+                    r->m_distance,
+                    r->m_nitro_usage,
+                    (int)r->m_zipper_usage,
+                    r->m_skidding_effect,
+                    (int)r->m_red_skidding,
+                    (int)r->m_jumping
+                );
+        }   // for i
+    }
+    return ferror(fd) == 0;
+}   // writeTextReplay
+
+// -----------------------------------------------------------------------------
+/** Writes a binary replay: the magic bytes, the format version and the size
+ *  of the header, followed by the header and the delta encoded events of
+ *  each kart (see readBinaryEvents()).
+ */
+bool ReplayBase::writeBinaryReplay(FILE *fd, const ReplayHeader &header,
+                                   const std::vector<KartEvents> &events)
+{
+    BareNetworkString h(1024);
+    h.encodeString16(header.m_stk_version);
+    h.addVarUInt((uint32_t)header.m_kart_list.size());
+    for (unsigned int k = 0; k < header.m_kart_list.size(); k++)
+    {
+        h.encodeString(header.m_kart_list[k]);
+        h.encodeString16(header.m_name_list[k]);
+        h.addFloat(header.m_kart_color[k]);
+    }
+    h.addUInt8(header.m_reverse ? 1 : 0).addUInt8(header.m_difficulty);
+    h.encodeString(header.m_minor_mode).encodeString(header.m_track_name);
+    h.encodeString16(header.m_info);
+    h.addVarUInt(header.m_laps).addFloat(header.m_min_time)
+     .addUInt64(header.m_replay_uid);
+
+    BareNetworkString body(64 * 1024);
+    for (const KartEvents &ke : events)
+    {
+        body.addVarUInt((uint32_t)ke.m_transform_events.size());
+
+        BareNetworkString transforms((int)(32 * ke.m_transform_events.size()));
+        int32_t prev[8] = { 0 };
+        for (const TransformEvent &te : ke.m_transform_events)
+        {
+            const btVector3 &xyz = te.m_transform.getOrigin();
+            const btQuaternion q = te.m_transform.getRotation();
+            addDelta(&transforms, te.m_time, &prev[0]);
+            addDelta(&transforms, (float)xyz.getX(), &prev[1]);
+            addDelta(&transforms, (float)xyz.getY(), &prev[2]);
+            addDelta(&transforms, (float)xyz.getZ(), &prev[3]);
+            addDelta(&transforms, (float)q.getX(), &prev[4]);
+            addDelta(&transforms, (float)q.getY(), &prev[5]);
+            addDelta(&transforms, (float)q.getZ(), &prev[6]);
+            addDelta(&transforms, (float)q.getW(), &prev[7]);
+        }
+        addStream(&body, transforms);
+
+        BareNetworkString physics((int)(16 * ke.m_physic_info.size()));
+        memset(prev, 0, sizeof(prev));
+        for (const PhysicInfo &pi : ke.m_physic_info)
+        {
+            addDelta(&physics, pi.m_speed, &prev[0]);
+            addDelta(&physics, pi.m_steer, &prev[1]);
+            for (unsigned int j = 0; j < 4; j++)
+                addDelta(&physics, pi.m_suspension_length[j], &prev[2 + j]);
+            addDelta(&physics, (int32_t)pi.m_skidding_state, &prev[6]);
+        }
+        addStream(&body, physics);
+
+        BareNetworkString bonus((int)(8 * ke.m_bonus_info.size()));
+        memset(prev, 0, sizeof(prev));
+        for (const BonusInfo &bi : ke.m_bonus_info)
+        {
+            addDelta(&bonus, (int32_t)bi.m_attachment, &prev[0]);
+            addDelta(&bonus, bi.m_nitro_amount, &prev[1]);
+            addDelta(&bonus, (int32_t)bi.m_item_amount, &prev[2]);
+            addDelta(&bonus, (int32_t)bi.m_item_type, &prev[3]);
+            addDelta(&bonus, (int32_t)bi.m_special_value, &prev[4]);
+        }
+        addStream(&body, bonus);
+
+        BareNetworkString other((int)(8 * ke.m_kart_replay_event.size()));
+        memset(prev, 0, sizeof(prev));
+        for (const KartReplayEvent &kre : ke.m_kart_replay_event)
+        {
+            addDelta(&other, kre.m_distance, &prev[0]);
+            addDelta(&other, (int32_t)kre.m_nitro_usage, &prev[1]);
+            addDelta(&other, (int32_t)kre.m_skidding_effect, &prev[2]);
+            other.addUInt8((kre.m_zipper_usage ? 1 : 0) |
+                           (kre.m_red_skidding ? 2 : 0) |
+                           (kre.m_jumping      ? 4 : 0));
+        }
+        addStream(&body, other);
+    }
+
+    BareNetworkString prefix(6);
+    prefix.addUInt16(BINARY_FORMAT_VERSION).addUInt32(h.getTotalSize());
+    fwrite(BINARY_MAGIC, 1, sizeof(BINARY_MAGIC), fd);
+    fwrite(prefix.getData(), 1, prefix.getTotalSize(), fd);
+    fwrite(h.getData(), 1, h.getTotalSize(), fd);
+    fwrite(body.getData(), 1, body.getTotalSize(), fd);
+    return ferror(fd) == 0;
+}   // writeBinaryReplay
+
+// -----------------------------------------------------------------------------
+/** Converts a text replay into a binary replay or the other way round. The
+ *  converted file is written next to the original one, with ".text" or
+ *  ".binary" added before the extension.
+ *  \param filename Full path of the replay to convert.
+ *  \param converted_filename On success the name of the written file.
+ *  \return True if the replay was converted.
+ */
+bool ReplayBase::convertReplayFile(const std::string &filename,
+                                   std::string *converted_filename)
+{
+    FILE *fd = FileUtils::fopenU8Path(filename, "rb");
+    if (!fd)
+    {
+        Log::error("Replay", "Can't open '%s'.", filename.c_str());
+        return false;
+    }
+    ReplayHeader header;
+    std::vector<KartEvents> events;
+    bool ok = readHeader(fd, &header, filename) &&
+              readEvents(fd, header, &events);
+    fclose(fd);
+    if (!ok)
+        return false;
+
+    *converted_filename = StringUtils::removeExtension(filename) +
+        (header.m_binary_format ? ".text.replay" : ".binary.replay");
+    fd = FileUtils::fopenU8Path(*converted_filename, "wb");
+    if (!fd)
+    {
+        Log::error("Replay", "Can't open '%s' for writing.",
+                   converted_filename->c_str());
+        return false;
+    }
+    ok = writeReplay(fd, header, events, !header.m_binary_format);
+    fclose(fd);
+    return ok;
+}   // convertReplayFile
@@ -22,10 +22,14 @@
 #include "LinearMath/btTransform.h"
 #include "utils/no_copy.hpp"
 
+#include "irrString.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <string>
 #include <vector>
 
+using namespace irr;
+
 /**
   * \ingroup race
   */
@@ -34,6 +38,32 @@ class ReplayBase : public NoCopy
     // Needs access to KartReplayEvent
     friend class GhostKart;
 
+public:
+    /** The information stored at the start of a replay file. This is all
+     *  that is needed to list a replay, and it can be read without reading
+     *  the recorded events. */
+    struct ReplayHeader
+    {
+        core::stringw              m_stk_version;
+        core::stringw              m_user_name;
+        core::stringw              m_info;
+        std::string                m_track_name;
+        std::string                m_minor_mode;
+        std::vector<std::string>   m_kart_list;
+        std::vector<core::stringw> m_name_list;
+        std::vector<float>         m_kart_color;
+        bool                       m_reverse;
+        /** True if the file uses the binary format, false for text. */
+        bool                       m_binary_format;
+        unsigned int               m_difficulty;
+        unsigned int               m_laps;
+        /** Version of the recorded data, binary replays always store the
+         *  data of the current replay version. */
+        unsigned int               m_replay_version;
+        uint64_t                   m_replay_uid;
+        float                      m_min_time;
+    };   // ReplayHeader
+
 protected:
     /** Stores a transform event, i.e. a position and rotation of a kart
      *  at a certain time. */
@@ -97,24 +127,63 @@ protected:
         bool        m_jumping;
     };   // KartReplayEvent
 
+    // ------------------------------------------------------------------------
+    /** All events recorded for one kart, the four vectors have the same
+     *  size. */
+    struct KartEvents
+    {
+        std::vector<TransformEvent>  m_transform_events;
+        std::vector<PhysicInfo>      m_physic_info;
+        std::vector<BonusInfo>       m_bonus_info;
+        std::vector<KartReplayEvent> m_kart_replay_event;
+    };   // KartEvents
+
+private:
+    static bool readTextHeader(FILE *fd, ReplayHeader *header,
+                               const std::string &fn);
+    static bool readBinaryHeader(FILE *fd, ReplayHeader *header,
+                                 const std::string &fn);
+    static bool readTextEvents(FILE *fd, const ReplayHeader &header,
+                               std::vector<KartEvents> *events);
+    static bool readBinaryEvents(FILE *fd, const ReplayHeader &header,
+                                 std::vector<KartEvents> *events);
+    static bool writeTextReplay(FILE *fd, const ReplayHeader &header,
+                                const std::vector<KartEvents> &events);
+    static bool writeBinaryReplay(FILE *fd, const ReplayHeader &header,
+                                  const std::vector<KartEvents> &events);
+
+protected:
     // ------------------------------------------------------------------------
     FILE *openReplayFile(bool writeable, bool full_path = false, int replay_file_number=1);
     // ------------------------------------------------------------------------
+    static bool readHeader(FILE *fd, ReplayHeader *header,
+                           const std::string &fn);
+    // ------------------------------------------------------------------------
+    static bool readEvents(FILE *fd, const ReplayHeader &header,
+                           std::vector<KartEvents> *events);
+    // ------------------------------------------------------------------------
+    static bool writeReplay(FILE *fd, const ReplayHeader &header,
+                            const std::vector<KartEvents> &events,
+                            bool binary);
+    // ------------------------------------------------------------------------
     /** Returns the filename that was opened. */
     virtual const std::string& getReplayFilename(int replay_file_number = 1) const = 0;
     // ------------------------------------------------------------------------
     /** Returns the version number of the replay file recorderd by this executable.
      *  This is also used as a maximum supported version by this exexcutable. */
-    unsigned int getCurrentReplayVersion() const { return 4; }
+    static unsigned int getCurrentReplayVersion() { return 4; }
 
     // ------------------------------------------------------------------------
     /** This is used to check that a loaded replay file can still
      *  be understood by this executable. */
-    unsigned int getMinSupportedReplayVersion() const { return 3; }
+    static unsigned int getMinSupportedReplayVersion() { return 3; }
 
 public:
              ReplayBase();
     virtual ~ReplayBase() {};
+    // ------------------------------------------------------------------------
+    static bool convertReplayFile(const std::string &filename,
+                                  std::string *converted_filename);
 };   // ReplayBase
 
 #endif
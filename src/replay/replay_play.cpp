@@ -106,11 +106,9 @@ void ReplayPlay::loadAllReplayFile()
 //-----------------------------------------------------------------------------
 bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int call_index)
 {
-
-    char s[1024], s1[1024];
     if (StringUtils::getExtension(fn) != "replay") return false;
     FILE* fd = FileUtils::fopenU8Path(custom_replay ? fn :
-        file_manager->getReplayDir() + fn, "r");
+        file_manager->getReplayDir() + fn, "rb");
     if (fd == NULL) return false;
     auto scoped = [&]() { fclose(fd); };
     MemUtils::deref<decltype(scoped)> cls(scoped); 
@@ -120,152 +118,14 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
     rd.m_custom_replay_file = custom_replay;
     rd.m_filename = fn;
 
-    fgets(s, 1023, fd);
-    unsigned int version;
-    if (sscanf(s,"version: %u", &version) != 1)
-    {
-        Log::warn("Replay", "No Version information "
-                  "found in replay file (bogus replay file).");
-        return false;
-    }
-    if ( version < getMinSupportedReplayVersion() )
-    {
-        Log::warn("Replay", "Replay is version '%d', Minimum supported replay version is '%d', skipped '%s'",
-                  version, getMinSupportedReplayVersion(), fn.c_str());
-        return false;
-    }
-    else if (version > getCurrentReplayVersion())
-    {
-        Log::warn("Replay", "Replay is version '%d', STK replay version is '%d', skipped '%s'",
-                  version, getCurrentReplayVersion(), fn.c_str());
-        return false;
-    }
-
-    rd.m_replay_version = version;
-
-    if (version >= 4)
-    {
-        fgets(s, 1023, fd);
-        if(sscanf(s, "stk_version: %1023s", s1) != 1)
-        {
-            Log::warn("Replay", "No STK release version found in replay file, '%s'.", fn.c_str());
-            return false;
-        }
-        rd.m_stk_version = s1;
-    }
-    else
-        rd.m_stk_version = "";
-
-    while(true)
-    {
-        fgets(s, 1023, fd);
-        core::stringc is_end(s);
-        is_end.trim();
-        if (is_end == "kart_list_end") break;
-        char s1[1024];
-        char display_name_encoded[1024];
-
-        int scanned = sscanf(s,"kart: %1023s %1023[^\n]", s1, display_name_encoded);
-        if (scanned < 1)
-        {
-            Log::warn("Replay", "Could not read ghost karts info!");
-            break;
-        }
-
-        rd.m_kart_list.push_back(std::string(s1));
-        if (scanned == 2)
-        {
-            // If username of kart is present, use it
-            rd.m_name_list.push_back(StringUtils::xmlDecode(std::string(display_name_encoded)));
-            if (rd.m_name_list.size() == 1)
-            {
-                // First user is the game master and the "owner" of this replay file
-                rd.m_user_name = rd.m_name_list[0];
-            }
-        } else
-        { // scanned == 1
-            // If username is not present, kart display name will default to kart name
-            // (see GhostController::getName)
-            rd.m_name_list.push_back("");
-        }
-
-        // Read kart color data
-        if (version >= 4)
-        {
-            float f = 0;
-            fgets(s, 1023, fd);
-            if(sscanf(s, "kart_color: %f", &f) != 1)
-            {
-                Log::warn("Replay", "Kart color missing in replay file, '%s'.", fn.c_str());
-                return false;
-            }
-            rd.m_kart_color.push_back(f);
-        }
-        else
-            rd.m_kart_color.push_back(0.0f); // Use default kart color
-    }
-
-    int reverse = 0;
-    fgets(s, 1023, fd);
-    if(sscanf(s, "reverse: %d", &reverse) != 1)
-    {
-        Log::warn("Replay", "No reverse info found in replay file, '%s'.", fn.c_str());
+    // Only the header is read, the events are loaded when the replay is
+    // used
+    if (!readHeader(fd, &rd, fn))
         return false;
-    }
-    rd.m_reverse = reverse != 0;
-
-    fgets(s, 1023, fd);
-    if (sscanf(s, "difficulty: %u", &rd.m_difficulty) != 1)
-    {
-        Log::warn("Replay", " No difficulty found in replay file, '%s'.", fn.c_str());
-        return false;
-    }
-
-    if (version >= 4)
-    {
-        fgets(s, 1023, fd);
-        if (sscanf(s, "mode: %1023s", s1) != 1)
-        {
-            Log::warn("Replay", "Replay mode not found in replay file, '%s'.", fn.c_str());
-            return false;
-        }
-        rd.m_minor_mode = s1;
-    }
-    // Assume time-trial mode for old replays
-    else
-        rd.m_minor_mode = "time-trial";
-
-    // sscanf always stops at whitespaces, but a track name may contain a whitespace
-    // Official tracks should avoid whitespaces in their name, but it
-    // unavoidably occurs with some addons or WIP tracks.
-    fgets(s, 1023, fd);
-    if (std::strncmp(s, "track: ", 7) == 0)
-    {
-        int i = 0;
-        for(i = 7; s[i] != '\0'; i++)
-        {
-            // Break when newline is reached
-            if (s[i] == '\n' || s[i] == '\r')
-                break;
-            s1[i-7] = s[i];
-        }
-        s1[i-7] = '\0';
 
-        if (i >= 8)
-        {
-            rd.m_track_name = std::string(s1);
-        }
-        else
-        {
-            Log::warn("Replay", "Track name is empty in replay file, '%s'.", fn.c_str());
-            return false;
-        }         
-    }
-    else
-    {
-        Log::warn("Replay", "Track info not found in replay file, '%s'.", fn.c_str());
-        return false;
-    }
+    // No UID in old replay format
+    if (rd.m_replay_version < 4)
+        rd.m_replay_uid = call_index;
 
     // If former official tracks are present as addons, show the matching replays.
     if (rd.m_track_name.compare("greenvalley") == 0)
@@ -283,43 +143,6 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay, int ca
 
     rd.m_track = t;
 
-    rd.m_info = "";
-    fgets(s, 1023, fd);
-    if (sscanf(s, "info: %1023s", s1) == 1)
-    {
-        int last = strlen(s);
-        if (s[last - 1] == '\n')
-            s[last - 1] = '\0';
-         
-        rd.m_info = s + 6;
-        fgets(s, 1023, fd);
-    }
-    if (sscanf(s, "laps: %u", &rd.m_laps) != 1)
-    {
-        Log::warn("Replay", "No number of laps found in replay file, '%s'.", fn.c_str());
-        return false;
-    }
-
-    fgets(s, 1023, fd);
-    if (sscanf(s, "min_time: %f", &rd.m_min_time) != 1)
-    {
-        Log::warn("Replay", "Finish time not found in replay file, '%s'.", fn.c_str());
-        return false;
-    }
-
-    if (version >= 4)
-    {
-        fgets(s, 1023, fd);
-        if (sscanf(s, "replay_uid: %" PRIu64, &rd.m_replay_uid) != 1)
-        {
-            Log::warn("Replay", "Replay UID not found in replay file, '%s'.", fn.c_str());
-            return false;
-        }
-    }
-    // No UID in old replay format
-    else
-        rd.m_replay_uid = call_index;
-
     m_replay_file_list.push_back(rd);
 
     assert(m_replay_file_list.size() > 0);
@@ -347,8 +170,6 @@ void ReplayPlay::load()
 //-----------------------------------------------------------------------------
 void ReplayPlay::loadFile(bool second_replay)
 {
-    char s[1024];
-
     int replay_index = second_replay ? m_second_replay_file : m_current_replay_file;
     int replay_file_number = second_replay ? 2 : 1;
 
@@ -366,36 +187,29 @@ void ReplayPlay::loadFile(bool second_replay)
     Log::info("Replay", "Reading replay file '%s'.",
                     getReplayFilename(replay_file_number).c_str());
 
-    ReplayData &rd = m_replay_file_list[replay_index];
-    unsigned int num_kart = (unsigned int)m_replay_file_list.at(replay_index)
-                                                            .m_kart_list.size();
-    unsigned int lines_to_skip = (rd.m_replay_version == 3) ? 7 : 10;
-    lines_to_skip += (rd.m_replay_version == 3) ? num_kart : 2*num_kart;
-    lines_to_skip += (rd.m_info != "") ? 1 : 0;
-
-    for (unsigned int i = 0; i < lines_to_skip; i++)
-        fgets(s, 1023, fd);
-
-    // eof actually doesn't trigger here, since it requires first to try
-    // reading behind eof, but still it's clearer this way.
-    while(!feof(fd))
+    // The header was read in addReplayFile, read it again to get to the
+    // start of the events
+    ReplayHeader header;
+    std::vector<KartEvents> events;
+    if (!readHeader(fd, &header, getReplayFilename(replay_file_number)) ||
+        !readEvents(fd, header, &events))
     {
-        if(fgets(s, 1023, fd)==NULL)  // eof reached
-            break;
-        readKartData(fd, s, second_replay);
+        Log::error("Replay", "Can't read replay data of '%s'.",
+                    getReplayFilename(replay_file_number).c_str());
     }
-
     fclose(fd);
+
+    for (const KartEvents &ke : events)
+        createGhostKart(ke, second_replay);
 }   // loadFile
 
 //-----------------------------------------------------------------------------
-/** Reads all data from a replay file for a specific kart.
- *  \param fd The file descriptor from which to read.
+/** Creates the ghost kart for the next kart of a replay file and adds all
+ *  its recorded events.
+ *  \param events The events recorded for this kart.
  */
-void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
+void ReplayPlay::createGhostKart(const KartEvents &events, bool second_replay)
 {
-    char s[1024];
-
     int replay_index = second_replay ? m_second_replay_file
                                      : m_current_replay_file;
 
@@ -415,120 +229,15 @@ void ReplayPlay::readKartData(FILE *fd, char *next_line, bool second_replay)
                                                  rd.m_name_list[kart_num-first_loaded_f_num]);
     getGhostKart(kart_num)->setController(controller);
 
-    unsigned int size;
-    if(sscanf(next_line,"size: %u",&size)!=1)
-        Log::fatal("Replay", "Number of records not found in replay file "
-            "for kart %d.", kart_num);
-
-    for(unsigned int i=0; i<size; i++)
+    for (unsigned int i = 0; i < events.m_transform_events.size(); i++)
     {
-        fgets(s, 1023, fd);
-        float x, y, z, rx, ry, rz, rw, time, speed, steer, w1, w2, w3, w4, nitro_amount, distance;
-        int skidding_state, attachment, item_amount, item_type, special_value,
-            nitro, zipper, skidding, red_skidding, jumping;
-
-        // Check for EV_TRANSFORM event:
-        // -----------------------------
-
-        // Up to STK 0.9.3 replays
-        if (rd.m_replay_version == 3)
-        {
-            if(sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
-                &time,
-                &x, &y, &z,
-                &rx, &ry, &rz, &rw,
-                &speed, &steer, &w1, &w2, &w3, &w4,
-                &nitro, &zipper, &skidding, &red_skidding, &jumping
-                )==19)
-            {
-                btQuaternion q(rx, ry, rz, rw);
-                btVector3 xyz(x, y, z);
-                PhysicInfo pi             = {0};
-                BonusInfo bi              = {0};
-                KartReplayEvent kre       = {0};
-
-                pi.m_speed                = speed;
-                pi.m_steer                = steer;
-                pi.m_suspension_length[0] = w1;
-                pi.m_suspension_length[1] = w2;
-                pi.m_suspension_length[2] = w3;
-                pi.m_suspension_length[3] = w4;
-                pi.m_skidding_state       = 0;    //not saved in version 3 replays
-                bi.m_attachment           = 0;    //not saved in version 3 replays
-                bi.m_nitro_amount         = 0;    //not saved in version 3 replays
-                bi.m_item_amount          = 0;    //not saved in version 3 replays
-                bi.m_item_type            = 0;    //not saved in version 3 replays
-                bi.m_special_value        = 0;    //not saved in version 3 replays
-                kre.m_distance            = 0.0f; //not saved in version 3 replays
-                kre.m_nitro_usage         = nitro;
-                kre.m_zipper_usage        = zipper!=0;
-                kre.m_skidding_effect     = skidding;
-                kre.m_red_skidding        = red_skidding!=0;
-                kre.m_jumping             = jumping != 0;
-                m_ghost_karts[kart_num]->addReplayEvent(time,
-                    btTransform(q, xyz), pi, bi, kre);
-            }
-            else
-            {
-                // Invalid record found
-                // ---------------------
-                Log::warn("Replay", "Can't read replay data line %d:", i);
-                Log::warn("Replay", "%s", s);
-                Log::warn("Replay", "Ignored.");
-            }
-        }
-
-        //version 4 replays (STK 0.9.4 and higher)
-        else
-        {
-            if(sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
-                &time,
-                &x, &y, &z,
-                &rx, &ry, &rz, &rw,
-                &speed, &steer, &w1, &w2, &w3, &w4, &skidding_state,
-                &attachment, &nitro_amount, &item_amount, &item_type, &special_value,
-                &distance, &nitro, &zipper, &skidding, &red_skidding, &jumping
-                )==26)
-            {
-                btQuaternion q(rx, ry, rz, rw);
-                btVector3 xyz(x, y, z);
-                PhysicInfo pi             = {0};
-                BonusInfo bi              = {0};
-                KartReplayEvent kre       = {0};
-
-                pi.m_speed                = speed;
-                pi.m_steer                = steer;
-                pi.m_suspension_length[0] = w1;
-                pi.m_suspension_length[1] = w2;
-                pi.m_suspension_length[2] = w3;
-                pi.m_suspension_length[3] = w4;
-                pi.m_skidding_state       = skidding_state;
-                bi.m_attachment           = attachment;
-                bi.m_nitro_amount         = nitro_amount;
-                bi.m_item_amount          = item_amount;
-                bi.m_item_type            = item_type;
-                bi.m_special_value        = special_value;
-                kre.m_distance            = distance;
-                kre.m_nitro_usage         = nitro;
-                kre.m_zipper_usage        = zipper!=0;
-                kre.m_skidding_effect     = skidding;
-                kre.m_red_skidding        = red_skidding!=0;
-                kre.m_jumping             = jumping != 0;
-                m_ghost_karts[kart_num]->addReplayEvent(time,
-                    btTransform(q, xyz), pi, bi, kre);
-            }
-            else
-            {
-                // Invalid record found
-                // ---------------------
-                Log::warn("Replay", "Can't read replay data line %d:", i);
-                Log::warn("Replay", "%s", s);
-                Log::warn("Replay", "Ignored.");
-            }
-        }
-    }   // for i
-
-}   // readKartData
+        m_ghost_karts[kart_num]->addReplayEvent(
+            events.m_transform_events[i].m_time,
+            events.m_transform_events[i].m_transform,
+            events.m_physic_info[i], events.m_bonus_info[i],
+            events.m_kart_replay_event[i]);
+    }
+}   // createGhostKart
 
 //-----------------------------------------------------------------------------
 /** call getReplayIdByUID and set the current replay file to the first one
@@ -19,6 +19,7 @@
 #include "replay/replay_recorder.hpp"
 
 #include "config/stk_config.hpp"
+#include "config/user_config.hpp"
 #include "io/file_manager.hpp"
 #include "items/attachment.hpp"
 #include "items/powerup.hpp"
@@ -69,10 +70,7 @@ void ReplayRecorder::reset()
 {
     m_complete_replay = false;
     m_incorrect_replay = false;
-    m_transform_events.clear();
-    m_physic_info.clear();
-    m_bonus_info.clear();
-    m_kart_replay_event.clear();
+    m_kart_events.clear();
     m_count_transforms.clear();
     m_last_saved_time.clear();
 
@@ -90,17 +88,14 @@ void ReplayRecorder::reset()
 void ReplayRecorder::init()
 {
     reset();
-    m_transform_events.resize(RaceManager::get()->getNumberOfKarts());
-    m_physic_info.resize(RaceManager::get()->getNumberOfKarts());
-    m_bonus_info.resize(RaceManager::get()->getNumberOfKarts());
-    m_kart_replay_event.resize(RaceManager::get()->getNumberOfKarts());
+    m_kart_events.resize(RaceManager::get()->getNumberOfKarts());
 
     for(unsigned int i=0; i<RaceManager::get()->getNumberOfKarts(); i++)
     {
-        m_transform_events[i].resize(m_max_frames);
-        m_physic_info[i].resize(m_max_frames);
-        m_bonus_info[i].resize(m_max_frames);
-        m_kart_replay_event[i].resize(m_max_frames);
+        m_kart_events[i].m_transform_events.reserve(m_max_frames);
+        m_kart_events[i].m_physic_info.reserve(m_max_frames);
+        m_kart_events[i].m_bonus_info.reserve(m_max_frames);
+        m_kart_events[i].m_kart_replay_event.reserve(m_max_frames);
     }
 
     m_count_transforms.resize(RaceManager::get()->getNumberOfKarts(), 0);
@@ -160,11 +155,14 @@ void ReplayRecorder::update(int ticks)
             return;
         }
 
-        if (m_count_transforms[i] >= 2)
+        KartEvents &events = m_kart_events[i];
+        const unsigned int num_events =
+            (unsigned int)events.m_transform_events.size();
+        if (num_events >= 2)
         {
-            BonusInfo *b_prev       = &(m_bonus_info[i][m_count_transforms[i]-1]);
-            BonusInfo *b_prev2      = &(m_bonus_info[i][m_count_transforms[i]-2]);
-            PhysicInfo *q_prev      = &(m_physic_info[i][m_count_transforms[i]-1]);
+            BonusInfo *b_prev       = &(events.m_bonus_info[num_events-1]);
+            BonusInfo *b_prev2      = &(events.m_bonus_info[num_events-2]);
+            PhysicInfo *q_prev      = &(events.m_physic_info[num_events-1]);
 
             // If the kart changes its steering
             if (fabsf(kart->getControls().getSteer() - m_previous_steer) >
@@ -249,10 +247,10 @@ void ReplayRecorder::update(int ticks)
         m_previous_steer = kart->getControls().getSteer();
         m_last_saved_time[i] = time;
         m_count_transforms[i]++;
-        if (m_count_transforms[i] >= m_transform_events[i].size())
+        if (m_count_transforms[i] >= m_max_frames)
         {
             // Only print this message once.
-            if (m_count_transforms[i] == m_transform_events[i].size())
+            if (m_count_transforms[i] == m_max_frames)
             {
                 Log::warn("ReplayRecorder", "Can't store more events for kart %s.",
                     kart->getIdent().c_str());
@@ -260,10 +258,14 @@ void ReplayRecorder::update(int ticks)
             }
             continue;
         }
-        TransformEvent *p      = &(m_transform_events[i][m_count_transforms[i]-1]);
-        PhysicInfo *q          = &(m_physic_info[i][m_count_transforms[i]-1]);
-        BonusInfo *b           = &(m_bonus_info[i][m_count_transforms[i]-1]);
-        KartReplayEvent *r     = &(m_kart_replay_event[i][m_count_transforms[i]-1]);
+        events.m_transform_events.emplace_back();
+        events.m_physic_info.emplace_back();
+        events.m_bonus_info.emplace_back();
+        events.m_kart_replay_event.emplace_back();
+        TransformEvent *p      = &(events.m_transform_events.back());
+        PhysicInfo *q          = &(events.m_physic_info.back());
+        BonusInfo *b           = &(events.m_bonus_info.back());
+        KartReplayEvent *r     = &(events.m_kart_replay_event.back());
 
         p->m_time              = World::getWorld()->getTime();
         p->m_transform.setOrigin(kart->getXYZ());
@@ -395,26 +397,25 @@ void ReplayRecorder::save()
         StringUtils::utf8ToWide(file_manager->getReplayDir() + getReplayFilename()));
     MessageQueue::add(MessageQueue::MT_GENERIC, msg);
 
-    fprintf(fd, "version: %d\n", getCurrentReplayVersion());
-    fprintf(fd, "stk_version: %s\n", STK_VERSION);
-
+    ReplayHeader header;
+    header.m_stk_version = STK_VERSION;
+    std::vector<KartEvents> events;
     unsigned int player_count = 0;
     for (unsigned int real_karts = 0; real_karts < num_karts; real_karts++)
     {
         const AbstractKart *kart = world->getKart(real_karts);
         if (kart->isGhostKart()) continue;
 
-        // XML encode the username to handle Unicode
-        fprintf(fd, "kart: %s %s\n", kart->getIdent().c_str(),
-                StringUtils::xmlEncode(kart->getController()->getName()).c_str());
-
+        header.m_kart_list.push_back(kart->getIdent());
+        header.m_name_list.push_back(kart->getController()->getName());
         if (kart->getController()->isPlayerController())
         {
-            fprintf(fd, "kart_color: %f\n", StateManager::get()->getActivePlayer(player_count)->getConstProfile()->getDefaultKartColor());
+            header.m_kart_color.push_back(StateManager::get()->getActivePlayer(player_count)->getConstProfile()->getDefaultKartColor());
             player_count++;
         }
         else
-            fprintf(fd, "kart_color: 0\n");
+            header.m_kart_color.push_back(0.0f);
+        events.push_back(m_kart_events[real_karts]);
     }
 
     m_last_uid = computeUID(min_time);
@@ -422,59 +423,20 @@ void ReplayRecorder::save()
     int num_laps = RaceManager::get()->getNumLaps();
     if (num_laps == 9999) num_laps = 0; // no lap in that race mode
 
-    fprintf(fd, "kart_list_end\n");
-    fprintf(fd, "reverse: %d\n",    (int)RaceManager::get()->getReverseTrack());
-    fprintf(fd, "difficulty: %d\n", RaceManager::get()->getDifficulty());
-    fprintf(fd, "mode: %s\n",       RaceManager::get()->getMinorModeName().c_str());
-    fprintf(fd, "track: %s\n",      Track::getCurrentTrack()->getIdent().c_str());
-    fprintf(fd, "laps: %d\n",       num_laps);
-    fprintf(fd, "min_time: %f\n",   min_time);
-    fprintf(fd, "replay_uid: %" PRIu64 "\n", m_last_uid);
-
-    for (unsigned int k = 0; k < num_karts; k++)
+    header.m_reverse        = RaceManager::get()->getReverseTrack();
+    header.m_difficulty     = RaceManager::get()->getDifficulty();
+    header.m_minor_mode     = RaceManager::get()->getMinorModeName();
+    header.m_track_name     = Track::getCurrentTrack()->getIdent();
+    header.m_laps           = num_laps;
+    header.m_min_time       = min_time;
+    header.m_replay_uid     = m_last_uid;
+    header.m_replay_version = getCurrentReplayVersion();
+
+    if (!writeReplay(fd, header, events,
+                     !UserConfigParams::m_save_text_replays))
     {
-        if (world->getKart(k)->isGhostKart()) continue;
-
-        const unsigned int num_transforms = std::min(m_max_frames,
-                                                     m_count_transforms[k]);
-
-        fprintf(fd, "size:     %d\n", num_transforms);
-
-        for (unsigned int i = 0; i < num_transforms; i++)
-        {
-            const TransformEvent *p  = &(m_transform_events[k][i]);
-            const PhysicInfo *q      = &(m_physic_info[k][i]);
-            const BonusInfo *b      = &(m_bonus_info[k][i]);
-            const KartReplayEvent *r = &(m_kart_replay_event[k][i]);
-            fprintf(fd, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f %d  %d %f %d %d %d  %f %d %d %d %d %d\n",
-                    p->m_time,
-                    p->m_transform.getOrigin().getX(),
-                    p->m_transform.getOrigin().getY(),
-                    p->m_transform.getOrigin().getZ(),
-                    p->m_transform.getRotation().getX(),
-                    p->m_transform.getRotation().getY(),
-                    p->m_transform.getRotation().getZ(),
-                    p->m_transform.getRotation().getW(),
-                    q->m_speed,
-                    q->m_steer,
-                    q->m_suspension_length[0],
-                    q->m_suspension_length[1],
-                    q->m_suspension_length[2],
-                    q->m_suspension_length[3],
-                    q->m_skidding_state,
-                    b->m_attachment,
-                    b->m_nitro_amount,
-                    b->m_item_amount,
-                    b->m_item_type,
-                    b->m_special_value,
-                    r->m_distance,
-                    r->m_nitro_usage,
-                    (int)r->m_zipper_usage,
-                    r->m_skidding_effect,
-                    (int)r->m_red_skidding,
-                    (int)r->m_jumping
-                );
-        }   // for i
+        Log::error("ReplayRecorder", "Error writing '%s'.",
+                   getReplayFilename().c_str());
     }
     fclose(fd);
 }   // save
@@ -34,17 +34,8 @@ class ReplayRecorder : public ReplayBase
 private:
     std::string m_filename;
 
-    /** A separate vector of Replay Events for all transforms. */
-    std::vector< std::vector<TransformEvent> > m_transform_events;
-
-    /** A separate vector of Replay Events for all physic info. */
-    std::vector< std::vector<PhysicInfo> > m_physic_info;
-
-    /** A separate vector of Replay Events for all item/nitro info. */
-    std::vector< std::vector<BonusInfo> > m_bonus_info;
-
-    /** A separate vector of Replay Events for all other events. */
-    std::vector< std::vector<KartReplayEvent> > m_kart_replay_event;
+    /** The recorded events of each kart. */
+    std::vector<KartEvents> m_kart_events;
 
     /** Time at which a transform was saved for the last time. */
     std::vector<float> m_last_saved_time;
@@ -21,30 +21,67 @@
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
+#include "network/crypto.hpp"
 #include "race/race_manager.hpp"
 #include "tracks/arena_node.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+#include "utils/worker_pool.hpp"
+
+#include <IFileSystem.h>
+#include <IReadFile.h>
 
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <queue>
 
+namespace
+{
+    /** Header of the shortest path cache files. The version must be
+     *  increased whenever the way the paths are computed changes. */
+    struct ArenaGraphCacheHeader
+    {
+        char     m_magic[4];
+        uint32_t m_version;
+        uint32_t m_num_nodes;
+    };
+    const char     CACHE_MAGIC[4] = { 'S', 'T', 'K', 'A' };
+    const uint32_t CACHE_VERSION  = 1;
+}   // namespace
+
+
 // -----------------------------------------------------------------------------
 ArenaGraph::ArenaGraph(const std::string &navmesh, const XMLNode *node)
           : Graph()
 {
     loadNavmesh(navmesh);
-    buildGraph();
-    // Compute shortest distance from all nodes
-    for (unsigned int i = 0; i < getNumNodes(); i++)
-        computeDijkstra(i);
+    buildSpatialGrid();
+
+    // The shortest paths only depend on the navmesh, so they are cached on
+    // disk with the hash of the navmesh file as key
+    std::string cache_file;
+    if (UserConfigParams::m_cache_arena_graph)
+        cache_file = getCacheFileName(navmesh);
+    if (cache_file.empty() || !loadCache(cache_file))
+    {
+        buildGraph();
+        computeAllShortestPaths();
+        if (!cache_file.empty())
+            saveCache(cache_file);
+    }
 
     setNearbyNodesOfAllNodes();
     if (node && RaceManager::get()->getMinorMode() == RaceManager::MINOR_MODE_SOCCER)
         loadGoalNodes(node);
 
     loadBoundingBoxNodes();
+    if (UserConfigParams::m_arena_graph_half_float)
+        useHalfPrecision();
 
 }   // ArenaGraph
 
@@ -179,8 +216,8 @@ void ArenaGraph::buildGraph()
 {
     const unsigned int n_nodes = getNumNodes();
 
-    m_distance_matrix = std::vector<std::vector<float>>
-        (n_nodes, std::vector<float>(n_nodes, 9999.9f));
+    m_distance_half.clear();
+    m_distance_matrix.assign(n_nodes * n_nodes, 9999.9f);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         ArenaNode* cur_node = getNode(i);
@@ -188,22 +225,21 @@ void ArenaGraph::buildGraph()
         {
             Vec3 diff = getNode(adjacent)->getCenter() - cur_node->getCenter();
             float distance = diff.length();
-            m_distance_matrix[i][adjacent] = distance;
+            m_distance_matrix[i * n_nodes + adjacent] = distance;
         }
-        m_distance_matrix[i][i] = 0.0f;
+        m_distance_matrix[i * n_nodes + i] = 0.0f;
     }
 
     // Allocate and initialise the previous node data structure:
-    m_parent_node = std::vector<std::vector<int16_t>>
-        (n_nodes, std::vector<int16_t>(n_nodes, Graph::UNKNOWN_SECTOR));
+    m_parent_node.assign(n_nodes * n_nodes, Graph::UNKNOWN_SECTOR);
     for (unsigned int i = 0; i < n_nodes; i++)
     {
         for (unsigned int j = 0; j < n_nodes; j++)
         {
-            if (i == j || m_distance_matrix[i][j] >= 9899.9f)
-                m_parent_node[i][j] = -1;
+            if (i == j || m_distance_matrix[i * n_nodes + j] >= 9899.9f)
+                m_parent_node[i * n_nodes + j] = -1;
             else
-                m_parent_node[i][j] = i;
+                m_parent_node[i * n_nodes + j] = i;
         }   // for j
     }   // for i
 
@@ -212,10 +248,13 @@ void ArenaGraph::buildGraph()
 // ----------------------------------------------------------------------------
 /** Dijkstra shortest path computation. It computes the shortest distance from
  *  the specified node 'source' to all other nodes. At the end of the
- *  computation, m_distance_matrix[i][j] stores the shortest path distance from
- *  source to j and m_parent_node[source][j] stores the last vertex visited on
- *  the shortest path from i to j before visiting j. Suppose the shortest path
- *  from i to j is i->......->k->j  then m_parent_node[i][j] = k
+ *  computation, m_distance_matrix[source * n + j] stores the shortest path
+ *  distance from source to j and m_parent_node[source * n + j] stores the
+ *  last vertex visited on the shortest path from source to j before visiting
+ *  j. Suppose the shortest path from i to j is i->......->k->j  then
+ *  m_parent_node[i * n + j] = k.
+ *  Only the row of source is modified (the edge lengths are taken from the
+ *  node centers), so it can be called for different sources in parallel.
  */
 void ArenaGraph::computeDijkstra(int source)
 {
@@ -235,6 +274,8 @@ void ArenaGraph::computeDijkstra(int source)
     IndDistPair begin(source, 0.0f);
     queue.push(begin);
     const unsigned int n = getNumNodes();
+    float* distance = &m_distance_matrix[source * n];
+    int16_t* parent = &m_parent_node[source * n];
     std::vector<bool> visited;
     visited.resize(n, false);
     while (!queue.empty())
@@ -251,12 +292,13 @@ void ArenaGraph::computeDijkstra(int source)
             // Distance already computed, can be ignored
             if (visited[adjacent]) continue;
 
-            float new_dist =
-                current.second + m_distance_matrix[cur_index][adjacent];
-            if (new_dist < m_distance_matrix[source][adjacent])
+            Vec3 diff = m_all_nodes[adjacent]->getCenter() -
+                        m_all_nodes[cur_index]->getCenter();
+            float new_dist = current.second + diff.length();
+            if (new_dist < distance[adjacent])
             {
-                m_distance_matrix[source][adjacent] = new_dist;
-                m_parent_node[source][adjacent] = cur_index;
+                distance[adjacent] = new_dist;
+                parent[adjacent] = cur_index;
             }
             IndDistPair pair(adjacent, new_dist);
             queue.push(pair);
@@ -264,15 +306,25 @@ void ArenaGraph::computeDijkstra(int source)
     }
 }   // computeDijkstra
 
+// ----------------------------------------------------------------------------
+/** Computes the shortest paths from all nodes, distributing the sources over
+ *  the worker threads. buildGraph() must have been called before.
+ */
+void ArenaGraph::computeAllShortestPaths()
+{
+    WorkerPool::get()->parallelFor(getNumNodes(),
+                                   [this](unsigned i) { computeDijkstra(i); });
+}   // computeAllShortestPaths
+
 // ----------------------------------------------------------------------------
 /** THIS FUNCTION IS ONLY USED FOR UNIT-TESTING, to verify that the new
  *  Dijkstra algorithm gives the same results.
  *  computeFloydWarshall() computes the shortest distance between any two
- *  nodes. At the end of the computation, m_distance_matrix[i][j] stores the
- *  shortest path distance from i to j and m_parent_node[i][j] stores the last
- *  vertex visited on the shortest path from i to j before visiting j. Suppose
- *  the shortest path from i to j is i->......->k->j  then
- *  m_parent_node[i][j] = k
+ *  nodes. At the end of the computation, m_distance_matrix[i * n + j] stores
+ *  the shortest path distance from i to j and m_parent_node[i * n + j] stores
+ *  the last vertex visited on the shortest path from i to j before visiting
+ *  j. Suppose the shortest path from i to j is i->......->k->j  then
+ *  m_parent_node[i * n + j] = k
  */
 void ArenaGraph::computeFloydWarshall()
 {
@@ -284,12 +336,12 @@ void ArenaGraph::computeFloydWarshall()
         {
             for (unsigned int j = 0; j < n; j++)
             {
-                if ((m_distance_matrix[i][k] + m_distance_matrix[k][j]) <
-                    m_distance_matrix[i][j])
+                if ((m_distance_matrix[i * n + k] + m_distance_matrix[k * n + j]) <
+                    m_distance_matrix[i * n + j])
                 {
-                    m_distance_matrix[i][j] =
-                        m_distance_matrix[i][k] + m_distance_matrix[k][j];
-                    m_parent_node[i][j] = m_parent_node[k][j];
+                    m_distance_matrix[i * n + j] =
+                        m_distance_matrix[i * n + k] + m_distance_matrix[k * n + j];
+                    m_parent_node[i * n + j] = m_parent_node[k * n + j];
                 }
             }
         }
@@ -297,6 +349,130 @@ void ArenaGraph::computeFloydWarshall()
 
 }   // computeFloydWarshall
 
+// ----------------------------------------------------------------------------
+/** Returns the name of the shortest path cache file for the given navmesh,
+ *  which contains the sha256 hash of the navmesh file. Returns an empty
+ *  string if the navmesh can't be read.
+ */
+std::string ArenaGraph::getCacheFileName(const std::string &navmesh) const
+{
+    io::IReadFile* file =
+        file_manager->getFileSystem()->createAndOpenFile(navmesh.c_str());
+    if (!file)
+        return "";
+    std::string content;
+    content.resize(file->getSize());
+    if (!content.empty())
+        file->read(&content[0], (u32)content.size());
+    file->drop();
+
+    auto hash = Crypto::sha256(content);
+    std::string name = file_manager->getCachedDataDir() + "arena-graph-";
+    for (uint8_t c : hash)
+    {
+        char hex[3];
+        snprintf(hex, sizeof(hex), "%02x", c);
+        name += hex;
+    }
+    return name + ".bin";
+}   // getCacheFileName
+
+// ----------------------------------------------------------------------------
+/** Loads the shortest paths from a cache file written by saveCache().
+ *  \return False if the file does not exist or does not match this graph,
+ *          in which case the paths have to be computed.
+ */
+bool ArenaGraph::loadCache(const std::string &filename)
+{
+    std::ifstream f(filename, std::ios::binary);
+    if (!f.is_open())
+        return false;
+
+    const unsigned int n = getNumNodes();
+    ArenaGraphCacheHeader header;
+    if (!f.read((char*)&header, sizeof(header)) ||
+        memcmp(header.m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.m_version != CACHE_VERSION || header.m_num_nodes != n)
+    {
+        Log::warn("ArenaGraph", "Ignoring invalid cache file '%s'.",
+                  filename.c_str());
+        return false;
+    }
+
+    m_distance_half.clear();
+    m_distance_matrix.resize(n * n);
+    m_parent_node.resize(n * n);
+    bool ok = n == 0 ||
+        (f.read((char*)m_distance_matrix.data(), n * n * sizeof(float)) &&
+         f.read((char*)m_parent_node.data(), n * n * sizeof(int16_t)));
+    for (unsigned int i = 0; ok && i < n * n; i++)
+    {
+        if (m_parent_node[i] < -1 || m_parent_node[i] >= (int)n)
+            ok = false;
+    }
+    if (!ok)
+    {
+        Log::warn("ArenaGraph", "Ignoring invalid cache file '%s'.",
+                  filename.c_str());
+        return false;
+    }
+    Log::debug("ArenaGraph", "Loaded shortest paths from '%s'.",
+               filename.c_str());
+    return true;
+}   // loadCache
+
+// ----------------------------------------------------------------------------
+/** Writes the shortest paths to a cache file. The data is written to a
+ *  temporary file first, so a different process loading the same arena
+ *  never sees a partially written cache.
+ */
+void ArenaGraph::saveCache(const std::string &filename) const
+{
+    const unsigned int n = getNumNodes();
+    ArenaGraphCacheHeader header;
+    memcpy(header.m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.m_version = CACHE_VERSION;
+    header.m_num_nodes = n;
+
+    const std::string tmp_name = filename + ".tmp" +
+        StringUtils::toString(StkTime::getMonoTimeMs());
+    {
+        std::ofstream f(tmp_name, std::ios::binary);
+        if (!f.is_open())
+        {
+            Log::warn("ArenaGraph", "Can't write cache file '%s'.",
+                      tmp_name.c_str());
+            return;
+        }
+        f.write((const char*)&header, sizeof(header));
+        f.write((const char*)m_distance_matrix.data(), n * n * sizeof(float));
+        f.write((const char*)m_parent_node.data(), n * n * sizeof(int16_t));
+        if (!f)
+        {
+            f.close();
+            file_manager->removeFile(tmp_name);
+            return;
+        }
+    }
+    // rename fails on windows if the destination exists
+    file_manager->removeFile(filename);
+    if (rename(tmp_name.c_str(), filename.c_str()) != 0)
+        file_manager->removeFile(tmp_name);
+}   // saveCache
+
+// ----------------------------------------------------------------------------
+/** Converts the shortest distances to 16 bit floats, which halves the memory
+ *  used by the distance table at the cost of precision (about 3 significant
+ *  digits, which is enough for the AI).
+ */
+void ArenaGraph::useHalfPrecision()
+{
+    m_distance_half.resize(m_distance_matrix.size());
+    for (unsigned int i = 0; i < m_distance_matrix.size(); i++)
+        m_distance_half[i] = MiniGLM::toFloat16(m_distance_matrix[i]);
+    std::vector<float>().swap(m_distance_matrix);
+}   // useHalfPrecision
+
 // -----------------------------------------------------------------------------
 void ArenaGraph::loadGoalNodes(const XMLNode *node)
 {
@@ -344,12 +520,14 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
 {
     // Only save the nearby 8 nodes
     const unsigned int try_count = 8;
-    for (unsigned int i = 0; i < getNumNodes(); i++)
+    const unsigned int n = getNumNodes();
+    for (unsigned int i = 0; i < n; i++)
     {
         // Get the distance to all nodes at i
         ArenaNode* cur_node = getNode(i);
         std::vector<int> nearby_nodes;
-        std::vector<float> dist = m_distance_matrix[i];
+        std::vector<float> dist(m_distance_matrix.begin() + i * n,
+                                m_distance_matrix.begin() + (i + 1) * n);
 
         // Skip the same node
         dist[i] = 999999.0f;
@@ -371,18 +549,30 @@ void ArenaGraph::setNearbyNodesOfAllNodes()
  *  std::vector (in reverse order). Used only for unit testing.
  */
 std::vector<int16_t> ArenaGraph::getPathFromTo(int from, int to,
-                      const std::vector< std::vector< int16_t > >& parent_node)
+                                const std::vector<int16_t>& parent_node) const
 {
     std::vector<int16_t> path;
     path.push_back(to);
     while(from!=to)
     {
-        to = parent_node[from][to];
+        to = parent_node[from * getNumNodes() + to];
         path.push_back(to);
     }
     return path;
 }   // getPathFromTo
 
+// ----------------------------------------------------------------------------
+/** Returns the (approximate) memory used by this graph in bytes, which
+ *  includes the distance and parent node matrices.
+ */
+size_t ArenaGraph::getMemoryUsage() const
+{
+    return Graph::getMemoryUsage() +
+        m_distance_matrix.capacity() * sizeof(float) +
+        m_distance_half.capacity() * sizeof(short) +
+        m_parent_node.capacity() * sizeof(int16_t);
+}   // getMemoryUsage
+
 // ============================================================================
 /** Unit testing for arena graph distance and parent node computation.
  *  Instead of using hand-tuned test cases we use the tested, verified and
@@ -395,14 +585,36 @@ void ArenaGraph::unitTesting()
     Track *track = track_manager->getTrack("cave");
     std::string navmesh_file_name=track->getTrackFile("navmesh.xml");
 
-    double s = StkTime::getRealTime();
     ArenaGraph* ag = new ArenaGraph(navmesh_file_name);
+    // The constructor might have used the cache, so compute the paths again
+    ag->buildGraph();
+    double s = StkTime::getRealTime();
+    ag->computeAllShortestPaths();
     double e = StkTime::getRealTime();
     Log::error("Time", "Dijkstra       %lf", e-s);
 
     // Save the Dijkstra results
-    std::vector< std::vector< float > > distance_matrix = ag->m_distance_matrix;
-    std::vector< std::vector< int16_t > > parent_node = ag->m_parent_node;
+    std::vector<float> distance_matrix = ag->m_distance_matrix;
+    std::vector<int16_t> parent_node = ag->m_parent_node;
+
+    int error_count = 0;
+    // Check that the cache gives back exactly the same paths
+    std::string cache_file = ag->getCacheFileName(navmesh_file_name);
+    if (!cache_file.empty())
+    {
+        ag->saveCache(cache_file);
+        s = StkTime::getRealTime();
+        bool loaded = ag->loadCache(cache_file);
+        e = StkTime::getRealTime();
+        Log::error("Time", "Cache loading  %lf", e-s);
+        if (!loaded || ag->m_distance_matrix != distance_matrix ||
+            ag->m_parent_node != parent_node)
+        {
+            Log::error("ArenaGraph", "Cache file '%s' does not match.",
+                       cache_file.c_str());
+            error_count++;
+        }
+    }
     ag->buildGraph();
 
     // Now compute results with Floyd-Warshall
@@ -411,16 +623,17 @@ void ArenaGraph::unitTesting()
     e = StkTime::getRealTime();
     Log::error("Time", "Floyd-Warshall %lf", e-s);
 
-    int error_count = 0;
-    for(unsigned int i=0; i<ag->m_distance_matrix.size(); i++)
+    const unsigned int n = ag->getNumNodes();
+    for(unsigned int i=0; i<n; i++)
     {
-        for(unsigned int j=0; j<ag->m_distance_matrix[i].size(); j++)
+        for(unsigned int j=0; j<n; j++)
         {
-            if(ag->m_distance_matrix[i][j] - distance_matrix[i][j] > 0.001f)
+            const unsigned int k = i * n + j;
+            if(ag->m_distance_matrix[k] - distance_matrix[k] > 0.001f)
             {
                 Log::error("ArenaGraph",
                            "Incorrect distance %d, %d: Dijkstra: %f F.W.: %f",
-                           i, j, distance_matrix[i][j], ag->m_distance_matrix[i][j]);
+                           i, j, distance_matrix[k], ag->m_distance_matrix[k]);
                 error_count++;
             }    // if distance is too different
 
@@ -432,16 +645,16 @@ void ArenaGraph::unitTesting()
             // debugging in the feature
 #undef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
 #ifdef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
-            if(ag->m_parent_node[i][j] != parent_node[i][j])
+            if(ag->m_parent_node[k] != parent_node[k])
             {
                 error_count++;
-                std::vector<int16_t> dijkstra_path = getPathFromTo(i, j, parent_node);
-                std::vector<int16_t> floyd_path = getPathFromTo(i, j, ag->m_parent_node);
+                std::vector<int16_t> dijkstra_path = ag->getPathFromTo(i, j, parent_node);
+                std::vector<int16_t> floyd_path = ag->getPathFromTo(i, j, ag->m_parent_node);
                 if(dijkstra_path.size()!=floyd_path.size())
                 {
                     Log::error("ArenaGraph",
                                "Incorrect path length %d, %d: Dijkstra: %d F.W.: %d",
-                               i, j, parent_node[i][j], ag->m_parent_node[i][j]);
+                               i, j, parent_node[k], ag->m_parent_node[k]);
                     continue;
                 }
                 Log::error("ArenaGraph", "Path problems from %d to %d:",
@@ -22,6 +22,8 @@
 #include "tracks/graph.hpp"
 #include "utils/cpp2011.hpp"
 
+#include "mini_glm.hpp"
+
 #include <cstdint>
 #include <set>
 
@@ -35,11 +37,19 @@ class XMLNode;
 class ArenaGraph : public Graph
 {
 private:
-    /** The actual graph data structure, it is an adjacency matrix. */
-    std::vector<std::vector<float>> m_distance_matrix;
+    /** The shortest distances between all nodes, stored row by row in one
+     *  array: m_distance_matrix[i * n + j] is the distance from i to j.
+     *  Before the shortest paths are computed it is the adjacency matrix.
+     *  Empty if the distances are stored in m_distance_half. */
+    std::vector<float> m_distance_matrix;
+
+    /** The same distances as 16 bit floats, only used if
+     *  arena-graph-half-float is enabled to save memory. */
+    std::vector<short> m_distance_half;
 
-    /** The matrix that is used to store computed shortest paths. */
-    std::vector<std::vector<int16_t>> m_parent_node;
+    /** The matrix that is used to store computed shortest paths, with the
+     *  same layout as m_distance_matrix. */
+    std::vector<int16_t> m_parent_node;
 
     /** Used in soccer mode to colorize the goal lines in minimap. */
     std::set<int> m_red_node;
@@ -57,17 +67,28 @@ private:
     // ------------------------------------------------------------------------
     void computeDijkstra(int n);
     // ------------------------------------------------------------------------
+    void computeAllShortestPaths();
+    // ------------------------------------------------------------------------
     void computeFloydWarshall();
     // ------------------------------------------------------------------------
-    static std::vector<int16_t> getPathFromTo(int from, int to,
-                     const std::vector< std::vector< int16_t > >& parent_node);
+    std::string getCacheFileName(const std::string &navmesh) const;
+    // ------------------------------------------------------------------------
+    bool loadCache(const std::string &filename);
+    // ------------------------------------------------------------------------
+    void saveCache(const std::string &filename) const;
+    // ------------------------------------------------------------------------
+    void useHalfPrecision();
+    // ------------------------------------------------------------------------
+    std::vector<int16_t> getPathFromTo(int from, int to,
+                               const std::vector<int16_t>& parent_node) const;
     // ------------------------------------------------------------------------
     virtual bool hasLapLine() const OVERRIDE                  { return false; }
     // ------------------------------------------------------------------------
     virtual void differentNodeColor(int n, video::SColor* c) const OVERRIDE;
 
 public:
-    static ArenaGraph* get()     { return dynamic_cast<ArenaGraph*>(m_graph); }
+    static ArenaGraph* get()
+                           { return dynamic_cast<ArenaGraph*>(Graph::get()); }
     // ------------------------------------------------------------------------
     static void unitTesting();
     // ------------------------------------------------------------------------
@@ -75,17 +96,19 @@ public:
     // ------------------------------------------------------------------------
     virtual ~ArenaGraph() {}
     // ------------------------------------------------------------------------
+    virtual size_t getMemoryUsage() const OVERRIDE;
+    // ------------------------------------------------------------------------
     ArenaNode* getNode(unsigned int i) const;
     // ------------------------------------------------------------------------
     /** Returns the next node on the shortest path from i to j.
-     *  Note: m_parent_node[j][i] contains the parent of i on path from j to i,
+     *  Note: m_parent_node[j * n + i] contains the parent of i on path from j to i,
      *  which is the next node on the path from i to j (undirected graph)
      */
     int getNextNode(int i, int j) const
     {
         if (i == Graph::UNKNOWN_SECTOR || j == Graph::UNKNOWN_SECTOR)
             return Graph::UNKNOWN_SECTOR;
-        return (int)(m_parent_node[j][i]);
+        return (int)(m_parent_node[j * getNumNodes() + i]);
     }
     // ------------------------------------------------------------------------
     /** Returns the distance between any two nodes */
@@ -93,7 +116,10 @@ public:
     {
         if (from == Graph::UNKNOWN_SECTOR || to == Graph::UNKNOWN_SECTOR)
             return 99999.0f;
-        return m_distance_matrix[from][to];
+        const unsigned index = from * getNumNodes() + to;
+        if (!m_distance_half.empty())
+            return MiniGLM::toFloat32(m_distance_half[index]);
+        return m_distance_matrix[index];
     }
 
 };   // ArenaGraph
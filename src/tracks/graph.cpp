@@ -26,12 +26,20 @@
 #include "graphics/sp/sp_mesh.hpp"
 #include "graphics/sp/sp_mesh_buffer.hpp"
 #include "guiengine/engine.hpp"
+#include "io/file_manager.hpp"
 #include "race/race_manager.hpp"
+#include "tracks/arena_graph.hpp"
 #include "tracks/arena_node_3d.hpp"
+#include "tracks/drive_graph.hpp"
 #include "tracks/drive_node_2d.hpp"
 #include "tracks/drive_node_3d.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
 #include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 #include <ICameraSceneNode.h>
 #include <ISceneManager.h>
@@ -43,7 +51,21 @@
 const int Graph::UNKNOWN_SECTOR = -1;
 const float Graph::MIN_HEIGHT_TESTING = -1.0f;
 const float Graph::MAX_HEIGHT_TESTING = 5.0f;
-Graph *Graph::m_graph = NULL;
+std::shared_ptr<Graph> Graph::m_graph[PT_COUNT];
+std::map<std::string, std::weak_ptr<Graph> > Graph::m_shared_graphs;
+std::mutex Graph::m_shared_graphs_mutex;
+
+namespace
+{
+    /** Graphs with less nodes are tested linearly. */
+    const unsigned MIN_GRID_NODES = 16;
+    /** Maximum number of cells in each direction of the spatial grid. */
+    const float MAX_GRID_CELLS = 256.0f;
+    /** Quads are added to all cells they overlap with this margin, so that
+     *  rounding errors in pointInside can not miss a quad. */
+    const float GRID_EPSILON = 0.01f;
+}   // namespace
+
 // -----------------------------------------------------------------------------
 Graph::Graph()
 {
@@ -55,13 +77,15 @@ Graph::Graph()
     m_bb_min      = Vec3( 99999,  99999,  99999);
     m_bb_max      = Vec3(-99999, -99999, -99999);
     memset(m_bb_nodes, 0, 4 * sizeof(int));
+    m_grid_min_x = m_grid_min_z = 0.0f;
+    m_grid_cell_size = 1.0f;
+    m_grid_width = m_grid_height = 0;
 }  // Graph
 
 // -----------------------------------------------------------------------------
 Graph::~Graph()
 {
-    if (UserConfigParams::m_track_debug)
-        cleanupDebugMesh();
+    freeGraphics();
 
     for (unsigned int i = 0; i < m_all_nodes.size(); i++)
     {
@@ -70,6 +94,66 @@ Graph::~Graph()
     m_all_nodes.clear();
 }  // ~Graph
 
+// -----------------------------------------------------------------------------
+/** Frees the debug mesh and the minimap of this graph.
+ */
+void Graph::freeGraphics()
+{
+    if (UserConfigParams::m_track_debug && m_mesh)
+        cleanupDebugMesh();
+    m_render_target = nullptr;
+}   // freeGraphics
+
+// -----------------------------------------------------------------------------
+/** Lets the current process use the graph another server room added with
+ *  the same key, which must identify the graph file and all settings
+ *  changing the graph after loading.
+ *  \return True if a shared graph was found, otherwise the graph must be
+ *          loaded.
+ */
+bool Graph::useSharedGraph(const std::string& key)
+{
+    ProcessType pt = STKProcess::getType();
+    assert(m_graph[pt] == NULL);
+    std::lock_guard<std::mutex> lock(m_shared_graphs_mutex);
+    auto it = m_shared_graphs.find(key);
+    if (it == m_shared_graphs.end())
+        return false;
+    m_graph[pt] = it->second.lock();
+    return m_graph[pt] != NULL;
+}   // useSharedGraph
+
+// -----------------------------------------------------------------------------
+/** Lets other server rooms use the (completely loaded) graph of the current
+ *  process, it must not be changed anymore.
+ */
+void Graph::addSharedGraph(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(m_shared_graphs_mutex);
+    for (auto it = m_shared_graphs.begin(); it != m_shared_graphs.end();)
+    {
+        if (it->second.expired())
+            it = m_shared_graphs.erase(it);
+        else
+            it++;
+    }
+    m_shared_graphs[key] = m_graph[STKProcess::getType()];
+}   // addSharedGraph
+
+// -----------------------------------------------------------------------------
+/** Returns the (approximate) memory used by the nodes and the search grid of
+ *  this graph in bytes, each node is counted with the size of a quad. The
+ *  minimap is not included.
+ */
+size_t Graph::getMemoryUsage() const
+{
+    return m_all_nodes.size() * (sizeof(Quad*) + sizeof(Quad)) +
+        (m_grid_quads_start.capacity() + m_grid_lines_start.capacity()) *
+        sizeof(unsigned) +
+        (m_grid_quads.capacity() + m_grid_lines.capacity() +
+        m_unbounded_quads.capacity()) * sizeof(int);
+}   // getMemoryUsage
+
 // -----------------------------------------------------------------------------
 /** Creates the debug mesh to display the graph on top of the track
  *  model. */
@@ -674,6 +758,20 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
         return;
     }   // if still on same quad
 
+    if (!all_sectors && !m_grid_quads_start.empty())
+        findRoadSectorGrid(xyz, sector, ignore_vertical);
+    else
+        findRoadSectorLinear(xyz, sector, all_sectors, ignore_vertical);
+}   // findRoadSector
+
+//-----------------------------------------------------------------------------
+/** Searches the road sector by testing all quads (or all quads in
+ *  all_sectors), starting with the one after the current sector.
+ */
+void Graph::findRoadSectorLinear(const Vec3& xyz, int *sector,
+                                 std::vector<int> *all_sectors,
+                                 bool ignore_vertical) const
+{
     // Now we search through all quads, starting with
     // the current one
     int indx       = *sector;
@@ -706,7 +804,44 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
     }   // for i<m_all_nodes.size()
 
     return;
-}   // findRoadSector
+}   // findRoadSectorLinear
+
+//-----------------------------------------------------------------------------
+/** Searches the road sector by only testing the quads in the grid cell of
+ *  xyz. If several quads contain the point, the one which would be found
+ *  first by findRoadSectorLinear() is used, so the results are identical.
+ */
+void Graph::findRoadSectorGrid(const Vec3& xyz, int *sector,
+                               bool ignore_vertical) const
+{
+    const int n = (int)m_all_nodes.size();
+    // The linear search tests the quads starting after the current sector
+    const int start = *sector;
+    int best_order = n;
+    *sector = UNKNOWN_SECTOR;
+
+    auto test_quad = [&](int indx)
+    {
+        int order = (indx - start - 1 + n) % n;
+        if (order < best_order &&
+            m_all_nodes[indx]->pointInside(xyz, ignore_vertical))
+        {
+            best_order = order;
+            *sector = indx;
+        }
+    };
+
+    for (int indx : m_unbounded_quads)
+        test_quad(indx);
+
+    int cx, cz;
+    if (!getGridCell(xyz.getX(), xyz.getZ(), &cx, &cz))
+        return;
+    const int cell = cz * m_grid_width + cx;
+    for (unsigned i = m_grid_quads_start[cell];
+         i < m_grid_quads_start[cell + 1]; i++)
+        test_quad(m_grid_quads[i]);
+}   // findRoadSectorGrid
 
 //-----------------------------------------------------------------------------
 /** findOutOfRoadSector finds the sector where XYZ is, but as it name
@@ -739,6 +874,24 @@ void Graph::findRoadSector(const Vec3& xyz, int *sector,
 int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
                                std::vector<int> *all_sectors,
                                bool ignore_vertical) const
+{
+    if (!all_sectors && !m_grid_lines_start.empty() &&
+        curr_sector >= UNKNOWN_SECTOR && curr_sector < (int)getNumNodes() &&
+        std::isfinite(xyz.getX()) && std::isfinite(xyz.getZ()))
+    {
+        return findOutOfRoadSectorGrid(xyz, curr_sector, ignore_vertical);
+    }
+    return findOutOfRoadSectorLinear(xyz, curr_sector, all_sectors,
+                                     ignore_vertical);
+}   // findOutOfRoadSector
+
+//-----------------------------------------------------------------------------
+/** Finds the out of road sector by testing all quads (or all quads in
+ *  all_sectors), see findOutOfRoadSector().
+ */
+int Graph::findOutOfRoadSectorLinear(const Vec3& xyz, const int curr_sector,
+                                     std::vector<int> *all_sectors,
+                                     bool ignore_vertical) const
 {
     int count = (all_sectors!=NULL) ? (int)all_sectors->size() : getNumNodes();
     int current_sector = 0;
@@ -817,7 +970,237 @@ int Graph::findOutOfRoadSector(const Vec3& xyz, const int curr_sector,
     // We can only reach this point if min_sector==UNKNOWN_SECTOR
     Log::warn("Graph", "unknown sector found.");
     return 0;
-}   // findOutOfRoadSector
+}   // findOutOfRoadSectorLinear
+
+//-----------------------------------------------------------------------------
+/** Finds the out of road sector using the center lines stored in the grid.
+ *  The cells are searched in rings of increasing distance around xyz, till
+ *  no unsearched cell can contain a closer quad. Ties are broken in the
+ *  order findOutOfRoadSectorLinear() tests the quads, so the results are
+ *  identical.
+ */
+int Graph::findOutOfRoadSectorGrid(const Vec3& xyz, const int curr_sector,
+                                   bool ignore_vertical) const
+{
+    const int n = (int)m_all_nodes.size();
+    // The linear search starts 10 quads before the current quad
+    int start = 0;
+    if (curr_sector != UNKNOWN_SECTOR)
+    {
+        start = curr_sector - 10;
+        if (start < 0) start += n;
+    }
+
+    // Cell of xyz, which can be outside of the grid
+    float fx = (xyz.getX() - m_grid_min_x) / m_grid_cell_size;
+    float fz = (xyz.getZ() - m_grid_min_z) / m_grid_cell_size;
+    const float limit = 1000000.0f;
+    const int qx = (int)floorf(std::max(-limit, std::min(fx, limit)));
+    const int qz = (int)floorf(std::max(-limit, std::min(fz, limit)));
+
+    const int dx = qx < 0 ? -qx : std::max(qx - m_grid_width + 1, 0);
+    const int dz = qz < 0 ? -qz : std::max(qz - m_grid_height + 1, 0);
+    const int first_ring = std::max(dx, dz);
+    const int last_ring = std::max(std::max(std::abs(qx),
+                                            std::abs(m_grid_width - 1 - qx)),
+                                   std::max(std::abs(qz),
+                                            std::abs(m_grid_height - 1 - qz)));
+
+    // See findOutOfRoadSectorLinear for the two phases
+    for (int phase = 0; phase < 2; phase++)
+    {
+        int   min_sector = UNKNOWN_SECTOR;
+        // Like in the linear search only quads closer than the initial
+        // min_dist_2 are used, so no order wins a tie with it
+        int   min_order  = -1;
+        float min_dist_2 = 999999.0f*999999.0f;
+
+        auto test_cell = [&](int x, int z)
+        {
+            const int cell = z * m_grid_width + x;
+            for (unsigned i = m_grid_lines_start[cell];
+                 i < m_grid_lines_start[cell + 1]; i++)
+            {
+                const int indx = m_grid_lines[i];
+                const Quad* q = m_all_nodes[indx];
+                float dist_2 = q->getDistance2FromPoint(xyz);
+                if (!(dist_2 <= min_dist_2))
+                    continue;
+                const int order = (indx - start - 1 + n) % n;
+                if (dist_2 == min_dist_2 && order >= min_order)
+                    continue;
+                float dist = xyz.getY() - q->getMinHeight();
+                if (phase == 1 || (dist < 5.0f && dist>-1.0f) ||
+                    q->is3DQuad() || ignore_vertical)
+                {
+                    min_dist_2 = dist_2;
+                    min_order  = order;
+                    min_sector = indx;
+                }
+            }
+        };
+
+        for (int r = first_ring; r <= last_ring; r++)
+        {
+            const int z0 = std::max(qz - r, 0);
+            const int z1 = std::min(qz + r, m_grid_height - 1);
+            for (int z = z0; z <= z1; z++)
+            {
+                if (z == qz - r || z == qz + r)
+                {
+                    const int x0 = std::max(qx - r, 0);
+                    const int x1 = std::min(qx + r, m_grid_width - 1);
+                    for (int x = x0; x <= x1; x++)
+                        test_cell(x, z);
+                }
+                else
+                {
+                    if (qx - r >= 0 && qx - r < m_grid_width)
+                        test_cell(qx - r, z);
+                    if (r > 0 && qx + r >= 0 && qx + r < m_grid_width)
+                        test_cell(qx + r, z);
+                }
+            }
+            // All quads not tested yet are at least r cells away
+            float min_untested = r * m_grid_cell_size - GRID_EPSILON;
+            if (min_sector != UNKNOWN_SECTOR && min_untested > 0 &&
+                min_untested * min_untested > min_dist_2)
+                break;
+        }   // for r
+        if (min_sector != UNKNOWN_SECTOR)
+            return min_sector;
+    }   // phase
+
+    Log::warn("Graph", "unknown sector found.");
+    return 0;
+}   // findOutOfRoadSectorGrid
+
+//-----------------------------------------------------------------------------
+/** Computes the grid cell of a point.
+ *  \return False if the point is outside of the grid.
+ */
+bool Graph::getGridCell(float x, float z, int* cx, int* cz) const
+{
+    float fx = (x - m_grid_min_x) / m_grid_cell_size;
+    float fz = (z - m_grid_min_z) / m_grid_cell_size;
+    if (!(fx >= 0.0f && fx < (float)m_grid_width &&
+          fz >= 0.0f && fz < (float)m_grid_height))
+        return false;
+    *cx = std::min((int)fx, m_grid_width - 1);
+    *cz = std::min((int)fz, m_grid_height - 1);
+    return true;
+}   // getGridCell
+
+//-----------------------------------------------------------------------------
+/** Builds a uniform grid over the xz bounding box of all quads, so that
+ *  findRoadSector() and findOutOfRoadSector() only test the few quads close
+ *  to a point instead of all quads. Each cell stores the quads which can
+ *  contain a point in this cell, and the quads whose center line (used for
+ *  the distance in findOutOfRoadSector) crosses this cell. It must be called
+ *  after all quads are created.
+ */
+void Graph::buildSpatialGrid()
+{
+    m_grid_quads_start.clear();
+    m_grid_quads.clear();
+    m_grid_lines_start.clear();
+    m_grid_lines.clear();
+    m_unbounded_quads.clear();
+    m_grid_width = m_grid_height = 0;
+
+    const unsigned n = getNumNodes();
+    if (n < MIN_GRID_NODES)
+        return;
+
+    // Add a margin so that points slightly off the graph are in the grid
+    m_grid_min_x = m_bb_min.getX() - 1.0f;
+    m_grid_min_z = m_bb_min.getZ() - 1.0f;
+    const float size_x = m_bb_max.getX() - m_bb_min.getX() + 2.0f;
+    const float size_z = m_bb_max.getZ() - m_bb_min.getZ() + 2.0f;
+    // Aim for about one quad per cell
+    m_grid_cell_size = std::max(sqrtf(size_x * size_z / n), 1.0f);
+    m_grid_cell_size = std::max(m_grid_cell_size,
+                                std::max(size_x, size_z) / MAX_GRID_CELLS);
+    m_grid_width  = (int)(size_x / m_grid_cell_size) + 1;
+    m_grid_height = (int)(size_z / m_grid_cell_size) + 1;
+    const unsigned num_cells = m_grid_width * m_grid_height;
+
+    std::vector<std::vector<int> > cell_quads(num_cells);
+    std::vector<std::vector<int> > cell_lines(num_cells);
+    auto add_to_cells = [this](std::vector<std::vector<int> >* cells,
+                               int indx, const Vec3& min, const Vec3& max)
+    {
+        int x0 = 0, z0 = 0;
+        int x1 = m_grid_width - 1, z1 = m_grid_height - 1;
+        getGridCell(std::max(min.getX() - GRID_EPSILON, m_grid_min_x),
+                    std::max(min.getZ() - GRID_EPSILON, m_grid_min_z),
+                    &x0, &z0);
+        float max_x = m_grid_min_x + m_grid_width  * m_grid_cell_size;
+        float max_z = m_grid_min_z + m_grid_height * m_grid_cell_size;
+        getGridCell(std::min(max.getX() + GRID_EPSILON, max_x - GRID_EPSILON),
+                    std::min(max.getZ() + GRID_EPSILON, max_z - GRID_EPSILON),
+                    &x1, &z1);
+        for (int z = z0; z <= z1; z++)
+        {
+            for (int x = x0; x <= x1; x++)
+                (*cells)[z * m_grid_width + x].push_back(indx);
+        }
+    };
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        const Quad* q = m_all_nodes[i];
+        const Vec3 &p0 = (*q)[0], &p1 = (*q)[1], &p2 = (*q)[2], &p3 = (*q)[3];
+        if (!q->isIgnored())
+        {
+            Vec3 a = (p0 + p1) * 0.5f;
+            Vec3 b = (p2 + p3) * 0.5f;
+            Vec3 min = a, max = a;
+            min.min(b);
+            max.max(b);
+            add_to_cells(&cell_lines, i, min, max);
+        }
+
+        // Quad::pointInside tests the two triangles p0 p1 p2 and p2 p3 p0,
+        // which only stays inside the quad if both triangles are oriented
+        // correctly. Everything else (and 3d quads) is tested always.
+        Vec3 c1 = (p0 + p1 + p2) * (1.0f / 3.0f);
+        Vec3 c2 = (p2 + p3 + p0) * (1.0f / 3.0f);
+        if (q->is3DQuad() ||
+            !(c1.sideOfLine2D(p0, p2) < 0.0f &&
+              c1.sideOfLine2D(p0, p1) > 0.0f &&
+              c1.sideOfLine2D(p1, p2) > 0.0f &&
+              c2.sideOfLine2D(p0, p2) > 0.0f &&
+              c2.sideOfLine2D(p2, p3) > 0.0f &&
+              c2.sideOfLine2D(p3, p0) > 0.0f))
+        {
+            m_unbounded_quads.push_back(i);
+            continue;
+        }
+        Vec3 min = p0, max = p0;
+        min.min(p1); min.min(p2); min.min(p3);
+        max.max(p1); max.max(p2); max.max(p3);
+        add_to_cells(&cell_quads, i, min, max);
+    }
+
+    m_grid_quads_start.resize(num_cells + 1);
+    m_grid_lines_start.resize(num_cells + 1);
+    for (unsigned i = 0; i < num_cells; i++)
+    {
+        m_grid_quads_start[i] = (unsigned)m_grid_quads.size();
+        m_grid_quads.insert(m_grid_quads.end(), cell_quads[i].begin(),
+                            cell_quads[i].end());
+        m_grid_lines_start[i] = (unsigned)m_grid_lines.size();
+        m_grid_lines.insert(m_grid_lines.end(), cell_lines[i].begin(),
+                            cell_lines[i].end());
+    }
+    m_grid_quads_start[num_cells] = (unsigned)m_grid_quads.size();
+    m_grid_lines_start[num_cells] = (unsigned)m_grid_lines.size();
+
+    Log::debug("Graph", "Spatial grid %dx%d, cell size %f, %d quads always "
+               "tested.", m_grid_width, m_grid_height, m_grid_cell_size,
+               (int)m_unbounded_quads.size());
+}   // buildSpatialGrid
 
 //-----------------------------------------------------------------------------
 void Graph::loadBoundingBoxNodes()
@@ -831,3 +1214,131 @@ void Graph::loadBoundingBoxNodes()
     m_bb_nodes[3] = findOutOfRoadSector(Vec3(m_bb_max.x(), 0, m_bb_max.z()),
         -1/*curr_sector*/, NULL/*all_sectors*/, true/*ignore_vertical*/);
 }   // loadBoundingBoxNodes
+
+//-----------------------------------------------------------------------------
+/** Checks that the spatial grid gives the same results as testing all quads,
+ *  using the drive graphs and navmeshes of all tracks.
+ */
+void Graph::unitTesting()
+{
+    int error_count = 0;
+    unsigned num_tests = 0;
+    double linear_time = 0.0, grid_time = 0.0;
+
+    auto test_graph = [&](const Graph* g, const std::string& name)
+    {
+        if (g->m_grid_quads_start.empty())
+            return;
+        const int n = (int)g->getNumNodes();
+
+        std::vector<Vec3> points;
+        for (int i = 0; i < n; i++)
+        {
+            const Quad* q = g->getQuad(i);
+            const Vec3& c = q->getCenter();
+            points.push_back(c);
+            for (int j = 0; j < 4; j++)
+            {
+                // Points just inside and outside of each corner
+                points.push_back(c + ((*q)[j] - c) * 0.99f);
+                points.push_back(c + ((*q)[j] - c) * 1.01f);
+            }
+        }
+        // Test all points above and below too
+        const unsigned count = (unsigned)points.size();
+        for (unsigned i = 0; i < count; i++)
+        {
+            points.push_back(points[i] + Vec3(0.0f,  3.0f, 0.0f));
+            points.push_back(points[i] + Vec3(0.0f, -3.0f, 0.0f));
+        }
+        // And points far outside of the graph
+        points.push_back(g->m_bb_min - Vec3(100.0f, 0.0f, 100.0f));
+        points.push_back(g->m_bb_max + Vec3(100.0f, 0.0f, 100.0f));
+
+        std::vector<int> linear(points.size() * 4), grid(points.size() * 4);
+        for (int use_grid = 0; use_grid < 2; use_grid++)
+        {
+            std::vector<int>& result = use_grid ? grid : linear;
+            double start = StkTime::getRealTime();
+            for (unsigned i = 0; i < points.size(); i++)
+            {
+                // Use a different current sector for each point
+                const int curr = (int)(i % n);
+                int sector = curr;
+                if (use_grid)
+                {
+                    g->findRoadSectorGrid(points[i], &sector, false);
+                    result[i * 4] = sector;
+                    sector = UNKNOWN_SECTOR;
+                    g->findRoadSectorGrid(points[i], &sector, true);
+                    result[i * 4 + 1] = sector;
+                    result[i * 4 + 2] =
+                        g->findOutOfRoadSectorGrid(points[i], curr, false);
+                    result[i * 4 + 3] = g->findOutOfRoadSectorGrid(
+                        points[i], UNKNOWN_SECTOR, true);
+                }
+                else
+                {
+                    g->findRoadSectorLinear(points[i], &sector, NULL, false);
+                    result[i * 4] = sector;
+                    sector = UNKNOWN_SECTOR;
+                    g->findRoadSectorLinear(points[i], &sector, NULL, true);
+                    result[i * 4 + 1] = sector;
+                    result[i * 4 + 2] = g->findOutOfRoadSectorLinear(
+                        points[i], curr, NULL, false);
+                    result[i * 4 + 3] = g->findOutOfRoadSectorLinear(
+                        points[i], UNKNOWN_SECTOR, NULL, true);
+                }
+            }
+            double time = StkTime::getRealTime() - start;
+            if (use_grid)
+                grid_time += time;
+            else
+                linear_time += time;
+        }
+
+        for (unsigned i = 0; i < linear.size(); i++)
+        {
+            if (linear[i] == grid[i])
+                continue;
+            if (error_count < 20)
+            {
+                const Vec3& p = points[i / 4];
+                Log::error("Graph", "%s: test %d at %f %f %f: linear %d, "
+                           "grid %d.", name.c_str(), i % 4, p.getX(),
+                           p.getY(), p.getZ(), linear[i], grid[i]);
+            }
+            error_count++;
+        }
+        num_tests += (unsigned)linear.size();
+    };
+
+    for (unsigned i = 0; i < track_manager->getNumberOfTracks(); i++)
+    {
+        Track* track = track_manager->getTrack(i);
+        std::string quads = track->getTrackFile("quads.xml");
+        if (file_manager->fileExists(quads))
+        {
+            // The drive graph sets itself as the current graph
+            new DriveGraph(quads, track->getTrackFile("graph.xml"),
+                           false/*reverse*/);
+            test_graph(Graph::get(), track->getIdent());
+            Graph::destroy();
+        }
+        std::string navmesh = track->getTrackFile("navmesh.xml");
+        if (file_manager->fileExists(navmesh))
+        {
+            ArenaGraph* ag = new ArenaGraph(navmesh);
+            test_graph(ag, track->getIdent());
+            delete ag;
+        }
+    }
+
+    Log::info("Graph", "Tested %u sector lookups, linear %lf s, grid %lf s.",
+              num_tests, linear_time, grid_time);
+    if (error_count > 0)
+    {
+        Log::fatal("Graph", "%d sector lookups differ with the spatial grid.",
+                   error_count);
+    }
+}   // unitTesting
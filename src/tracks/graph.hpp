@@ -20,11 +20,14 @@
 #define HEADER_GRAPH_HPP
 
 #include "utils/no_copy.hpp"
+#include "utils/stk_process.hpp"
 #include "utils/vec3.hpp"
 
 #include <dimension2d.h>
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -52,7 +55,15 @@ class RenderTarget;
 class Graph : public NoCopy
 {
 protected:
-    static Graph* m_graph;
+    /** The graph of each process. Processes racing on the same track (the
+     *  child process, server rooms) share one graph, which is deleted when
+     *  the last of them destroys it. */
+    static std::shared_ptr<Graph> m_graph[PT_COUNT];
+
+    /** The graphs server rooms can share, see addSharedGraph(). */
+    static std::map<std::string, std::weak_ptr<Graph> > m_shared_graphs;
+
+    static std::mutex m_shared_graphs_mutex;
 
     std::vector<Quad*> m_all_nodes;
 
@@ -66,6 +77,8 @@ protected:
     // ------------------------------------------------------------------------
     /** Map 4 bounding box points to 4 closest graph nodes. */
     void loadBoundingBoxNodes();
+    // ------------------------------------------------------------------------
+    void buildSpatialGrid();
 
 private:
     /** The 2d bounding box, used for hashing. */
@@ -90,6 +103,31 @@ private:
     /** The render target used for drawing the minimap. */
     std::unique_ptr<RenderTarget> m_render_target;
 
+    /** A uniform grid in the xz plane starting at m_bb_min, used to find
+     *  the few quads close to a point, see buildSpatialGrid(). */
+    float m_grid_min_x, m_grid_min_z, m_grid_cell_size;
+    int m_grid_width, m_grid_height;
+
+    /** For each cell the first index in m_grid_quads, the quads of cell i
+     *  end at m_grid_quads_start[i+1]. */
+    std::vector<unsigned> m_grid_quads_start;
+
+    /** The quads which can contain a point of each cell, used by
+     *  findRoadSector(). */
+    std::vector<int> m_grid_quads;
+
+    /** Same as m_grid_quads_start for m_grid_lines. */
+    std::vector<unsigned> m_grid_lines_start;
+
+    /** The quads whose center line crosses each cell, used by
+     *  findOutOfRoadSector(). */
+    std::vector<int> m_grid_lines;
+
+    /** Quads which are not stored in m_grid_quads (3d quads, or quads for
+     *  which pointInside is not limited to the quad) and are always tested
+     *  by findRoadSector(). */
+    std::vector<int> m_unbounded_quads;
+
     // ------------------------------------------------------------------------
     void createMesh(bool show_invisible=true,
                     bool enable_transparency=false,
@@ -103,6 +141,24 @@ private:
     // ------------------------------------------------------------------------
     void cleanupDebugMesh();
     // ------------------------------------------------------------------------
+    void freeGraphics();
+    // ------------------------------------------------------------------------
+    bool getGridCell(float x, float z, int* cx, int* cz) const;
+    // ------------------------------------------------------------------------
+    void findRoadSectorLinear(const Vec3& XYZ, int *sector,
+                              std::vector<int> *all_sectors,
+                              bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
+    void findRoadSectorGrid(const Vec3& XYZ, int *sector,
+                            bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
+    int findOutOfRoadSectorLinear(const Vec3& xyz, const int curr_sector,
+                                  std::vector<int> *all_sectors,
+                                  bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
+    int findOutOfRoadSectorGrid(const Vec3& xyz, const int curr_sector,
+                                bool ignore_vertical) const;
+    // ------------------------------------------------------------------------
     virtual bool hasLapLine() const = 0;
     // ------------------------------------------------------------------------
     virtual void differentNodeColor(int n, video::SColor* c) const = 0;
@@ -116,25 +172,45 @@ public:
     /** Returns the one instance of this object. It is possible that there
      *  is no instance created (e.g. arena without navmesh) so we don't assert
      *  that an instance exist. */
-    static Graph* get() { return m_graph; }
+    static Graph* get()    { return m_graph[STKProcess::getType()].get(); }
     // ------------------------------------------------------------------------
     /** Set the graph (either drive or arena graph for now). */
     static void setGraph(Graph* graph)
     {
-        assert(m_graph == NULL);
-        m_graph = graph;
+        ProcessType pt = STKProcess::getType();
+        assert(m_graph[pt] == NULL);
+        m_graph[pt].reset(graph);
     }   // setGraph
     // ------------------------------------------------------------------------
+    /** Lets the child process use the graph of the main process. */
+    static void shareWithChild(bool share)
+                 { m_graph[PT_CHILD] = share ? m_graph[PT_MAIN] : nullptr; }
+    // ------------------------------------------------------------------------
+    static bool useSharedGraph(const std::string& key);
+    // ------------------------------------------------------------------------
+    static void addSharedGraph(const std::string& key);
+    // ------------------------------------------------------------------------
+    /** Returns true if the graph of the current process is used by other
+     *  processes (the child process or other server rooms) too. */
+    static bool isShared()
+    {
+        const std::shared_ptr<Graph>& graph = m_graph[STKProcess::getType()];
+        return graph && graph.use_count() > 1;
+    }   // isShared
+    // ------------------------------------------------------------------------
     /** Cleans up the graph. It is possible that this function is called even
      *  if no instance exists (e.g. arena without navmesh). So it is not an
-     *  error if there is no instance. */
+     *  error if there is no instance. A shared graph is only deleted by the
+     *  last process using it. */
     static void destroy()
     {
-        if (m_graph)
-        {
-            delete m_graph;
-            m_graph = NULL;
-        }
+        ProcessType pt = STKProcess::getType();
+        if (!m_graph[pt])
+            return;
+        // The minimap can only be freed in the main process
+        if (pt == PT_MAIN)
+            m_graph[pt]->freeGraphics();
+        m_graph[pt] = nullptr;
     }   // destroy
     // ------------------------------------------------------------------------
     Graph();
@@ -143,6 +219,8 @@ public:
     // ------------------------------------------------------------------------
     void createDebugMesh();
     // ------------------------------------------------------------------------
+    virtual size_t getMemoryUsage() const;
+    // ------------------------------------------------------------------------
     RenderTarget* makeMiniMap(const core::dimension2du &dimension,
                               const std::string &name,
                               const video::SColor &fill_color,
@@ -172,6 +250,8 @@ public:
     const Vec3& getBBMax() const                           { return m_bb_max; }
     // ------------------------------------------------------------------------
     const int* getBBNodes() const                        { return m_bb_nodes; }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
 
 };   // Graph
 
@@ -80,6 +80,7 @@
 #include "tracks/track_object_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
+#include "utils/profiler.hpp"
 #include "mini_glm.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
@@ -97,9 +98,15 @@
 
 #include <algorithm>
 #include <iostream>
+#include <list>
+#include <mutex>
 #include <stdexcept>
+#include <set>
 #include <sstream>
 #include <wchar.h>
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 #ifndef SERVER_ONLY
 #include <ge_main.hpp>
@@ -112,8 +119,114 @@ using namespace irr;
 
 const float Track::NOHIT               = -99999.9f;
 bool        Track::m_dont_load_navmesh = false;
+bool        Track::m_memory_report     = false;
 std::atomic<Track*> Track::m_current_track[PT_COUNT];
 
+namespace
+{
+    /** Materials files of tracks loaded by rooms of a multi room server,
+     *  which are never unloaded. */
+    std::set<std::string> g_room_material_files;
+
+    /** Meshes of the tracks last raced by rooms of a multi room server, most
+     *  recent first. They are kept in irrlicht's mesh cache so that the next
+     *  race on one of these tracks does not read and decode them again. Only
+     *  used while holding World::m_room_world_mutex. */
+    std::list<std::pair<std::string, std::vector<scene::IMesh*> > >
+        g_room_cached_meshes;
+
+    /** Number of tracks for which rooms keep the meshes. */
+    const unsigned int ROOM_CACHED_TRACKS = 4;
+
+    /** Protects Track::m_uses_scripting, tracks are checked from the lobby
+     *  thread of each room. */
+    std::mutex g_uses_scripting_mutex;
+
+    // ------------------------------------------------------------------------
+    /** Drops the references to meshes loaded by a track and removes the
+     *  meshes from irrlicht's mesh cache once no one else uses them.
+     *  Meshes loaded more than once are in the list more than once.
+     *  \param meshes The meshes, the list is cleared.
+     */
+    void dropCachedMeshes(std::vector<scene::IMesh*>* meshes)
+    {
+        for (unsigned int i = 0; i < meshes->size(); i++)
+        {
+            scene::IMesh* mesh = (*meshes)[i];
+            irr_driver->dropAllTextures(mesh);
+            // If a mesh is not in Irrlicht's texture cache, its refcount is
+            // 1 (since its scene node was removed, so the only other
+            // reference is in the list). In this case we only drop it once
+            // and don't try to remove it from the cache.
+            if (mesh->getReferenceCount() == 1)
+            {
+                mesh->drop();
+                continue;
+            }
+            mesh->drop();
+            if (mesh->getReferenceCount() == 1)
+                irr_driver->removeMeshFromCache(mesh);
+        }
+        meshes->clear();
+    }   // dropCachedMeshes
+
+    // ------------------------------------------------------------------------
+    /** Returns the resident memory of this process in bytes, or 0 if it is
+     *  not known on this platform.
+     */
+    size_t getResidentMemory()
+    {
+#ifdef __linux__
+        FILE* f = fopen("/proc/self/statm", "r");
+        if (!f)
+            return 0;
+        unsigned long size = 0, resident = 0;
+        int n = fscanf(f, "%lu %lu", &size, &resident);
+        fclose(f);
+        return n == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+        return 0;
+#endif
+    }   // getResidentMemory
+
+    // ------------------------------------------------------------------------
+    /** Returns true if a library used in the given scene or library node has
+     *  a script, which is looked up the same way as
+     *  TrackObjectPresentationLibraryNode does.
+     *  \param track The track the scene belongs to.
+     *  \param node The scene or library node to check.
+     *  \param libraries Names of libraries already checked.
+     */
+    bool librariesUseScripting(const Track* track, const XMLNode* node,
+                               std::set<std::string>* libraries)
+    {
+        for (unsigned int i = 0; i < node->getNumNodes(); i++)
+        {
+            const XMLNode* child = node->getNode(i);
+            std::string name;
+            if (child->getName() == "library" && child->get("name", &name) &&
+                libraries->insert(name).second)
+            {
+                std::string path = track->getTrackFile("library/" + name);
+                if (!file_manager->fileExists(path + "/node.xml"))
+                    path = file_manager->getAsset(FileManager::LIBRARY, name);
+                if (file_manager->fileExists(path + "/scripting.as"))
+                    return true;
+                XMLNode* library = file_manager->createXMLTree(path +
+                                                               "/node.xml");
+                bool scripted = library &&
+                    librariesUseScripting(track, library, libraries);
+                delete library;
+                if (scripted)
+                    return true;
+            }
+            if (librariesUseScripting(track, child, libraries))
+                return true;
+        }
+        return false;
+    }   // librariesUseScripting
+}   // namespace
+
 // ----------------------------------------------------------------------------
 Track::Track(const std::string &filename)
 {
@@ -123,6 +236,7 @@ Track::Track(const std::string &filename)
 
     m_minimap_invert_x_z    = false;
     m_materials_loaded      = false;
+    m_uses_scripting        = -1;
     m_filename              = filename;
     m_root                  =
         StringUtils::getPath(StringUtils::removeExtension(m_filename));
@@ -147,6 +261,8 @@ Track::Track(const std::string &filename)
     m_track_mesh            = NULL;
     m_height_map_mesh       = NULL;
     m_gfx_effect_mesh       = NULL;
+    m_uses_shared_graph     = false;
+    m_load_memory           = 0;
     m_internal              = false;
     m_enable_auto_rescue    = true;  // Below set to false in arenas
     m_enable_push_back      = true;
@@ -268,6 +384,32 @@ bool Track::isInGroup(const std::string &group_name)
         != m_groups.end();
 }   // isInGroup
 
+//-----------------------------------------------------------------------------
+/** Returns true if this track or one of the libraries it uses has a script.
+ *  Rooms of a multi room server share the process with the main server and
+ *  have no script engine (AngelScript's string factory is global), so they
+ *  can't race such tracks. The scene file is only read the first time.
+ */
+bool Track::usesScripting() const
+{
+    std::lock_guard<std::mutex> lock(g_uses_scripting_mutex);
+    if (m_uses_scripting == -1)
+    {
+        m_uses_scripting = 0;
+        if (file_manager->fileExists(getTrackFile("scripting.as")))
+            m_uses_scripting = 1;
+        else if (XMLNode* scene =
+            file_manager->createXMLTree(getTrackFile("scene.xml")))
+        {
+            std::set<std::string> libraries;
+            if (librariesUseScripting(this, scene, &libraries))
+                m_uses_scripting = 1;
+            delete scene;
+        }
+    }
+    return m_uses_scripting == 1;
+}   // usesScripting
+
 //-----------------------------------------------------------------------------
 /** Returns number of completed challenges */
 unsigned int Track::getNumOfCompletedChallenges()
@@ -320,16 +462,13 @@ void Track::reset()
  */
 void Track::cleanup()
 {
+    if (m_memory_report)
+        reportMemory();
     irr_driver->resetSceneComplexity();
     m_physical_object_uid = 0;
-#ifdef USE_RESIZE_CACHE
-    if (!UserConfigParams::m_high_definition_textures)
-    {
-        file_manager->popTextureSearchPath();
-    }
-#endif
-    file_manager->popTextureSearchPath();
-    file_manager->popModelSearchPath();
+    // Rooms remove the search paths right after loading
+    if (!STKProcess::isRoom())
+        popSearchPaths();
 
     Graph::destroy();
     m_item_manager = nullptr;
@@ -406,23 +545,33 @@ void Track::cleanup()
     // than once are in m_all_cached_mesh more than once (which is easier
     // than storing the mesh only once, but then having to test for each
     // mesh if it is already contained in the list or not).
-    for (unsigned int i = 0; i < m_all_cached_meshes.size(); i++)
-    {
-        irr_driver->dropAllTextures(m_all_cached_meshes[i]);
-        // If a mesh is not in Irrlicht's texture cache, its refcount is
-        // 1 (since its scene node was removed, so the only other reference
-        // is in m_all_cached_meshes). In this case we only drop it once
-        // and don't try to remove it from the cache.
-        if (m_all_cached_meshes[i]->getReferenceCount() == 1)
+    if (STKProcess::isRoom())
+    {
+        // Rooms keep the references of the last tracks raced, so the next
+        // race on the same track finds its meshes in the mesh cache
+        auto it = std::find_if(g_room_cached_meshes.begin(),
+            g_room_cached_meshes.end(),
+            [this](const std::pair<std::string,
+                   std::vector<scene::IMesh*> >& cached)
+            {
+                return cached.first == m_filename;
+            });
+        if (it != g_room_cached_meshes.end())
         {
-            m_all_cached_meshes[i]->drop();
-            continue;
+            // This track grabbed all these meshes again when loading
+            dropCachedMeshes(&it->second);
+            g_room_cached_meshes.erase(it);
+        }
+        g_room_cached_meshes.emplace_front(m_filename, m_all_cached_meshes);
+        m_all_cached_meshes.clear();
+        while (g_room_cached_meshes.size() > ROOM_CACHED_TRACKS)
+        {
+            dropCachedMeshes(&g_room_cached_meshes.back().second);
+            g_room_cached_meshes.pop_back();
         }
-        m_all_cached_meshes[i]->drop();
-        if (m_all_cached_meshes[i]->getReferenceCount() == 1)
-            irr_driver->removeMeshFromCache(m_all_cached_meshes[i]);
     }
-    m_all_cached_meshes.clear();
+    else
+        dropCachedMeshes(&m_all_cached_meshes);
 
     // Now free meshes that are not associated to any scene node.
     for (unsigned int i = 0; i < m_detached_cached_meshes.size(); i++)
@@ -441,7 +590,7 @@ void Track::cleanup()
     }
     m_sky_textures.clear();
 
-    if(m_cache_track)
+    if(m_cache_track || STKProcess::isRoom())
         material_manager->makeMaterialsPermanent();
     else
     {
@@ -518,11 +667,28 @@ void Track::cleanup()
 #endif
 
     m_meta_library.clear();
-    Scripting::ScriptEngine::getInstance()->cleanupCache();
+    Scripting::ScriptEngine* script_engine =
+        Scripting::ScriptEngine::getInstance();
+    if (script_engine)
+        script_engine->cleanupCache();
 
-    m_current_track[PT_MAIN] = NULL;
+    m_current_track[STKProcess::getType()] = NULL;
 }   // cleanup
 
+//-----------------------------------------------------------------------------
+/** Removes the search paths which were added when loading the track. */
+void Track::popSearchPaths()
+{
+#ifdef USE_RESIZE_CACHE
+    if (!UserConfigParams::m_high_definition_textures)
+    {
+        file_manager->popTextureSearchPath();
+    }
+#endif
+    file_manager->popTextureSearchPath();
+    file_manager->popModelSearchPath();
+}   // popSearchPaths
+
 //-----------------------------------------------------------------------------
 void Track::loadTrackInfo()
 {
@@ -759,8 +925,11 @@ void Track::loadArenaGraph(const XMLNode &node)
         }
     }
 
-    ArenaGraph* graph = new ArenaGraph(m_root+"navmesh.xml", &node);
-    Graph::setGraph(graph);
+    if (!useSharedGraph(m_root + "navmesh.xml"))
+    {
+        ArenaGraph* graph = new ArenaGraph(m_root+"navmesh.xml", &node);
+        Graph::setGraph(graph);
+    }
 
     if(Graph::get()->getNumNodes()==0)
     {
@@ -803,12 +972,19 @@ btQuaternion Track::getArenaStartRotation(const Vec3& xyz, float heading)
  */
 void Track::loadDriveGraph(unsigned int mode_id, const bool reverse)
 {
-    new DriveGraph(m_root+m_all_modes[mode_id].m_quad_name,
-        m_root+m_all_modes[mode_id].m_graph_name, reverse);
+    // The checkline requirements are computed after loading the graph
+    std::string key = m_root + m_all_modes[mode_id].m_quad_name +
+        (reverse ? " reverse" : "") +
+        (World::getWorld()->useChecklineRequirements() ? " checklines" : "");
+    if (!useSharedGraph(key))
+    {
+        new DriveGraph(m_root+m_all_modes[mode_id].m_quad_name,
+            m_root+m_all_modes[mode_id].m_graph_name, reverse);
 
-    // setGraph is done in DriveGraph constructor
-    assert(DriveGraph::get());
-    DriveGraph::get()->setupPaths();
+        // setGraph is done in DriveGraph constructor
+        assert(DriveGraph::get());
+        DriveGraph::get()->setupPaths();
+    }
 #ifdef DEBUG
     for(unsigned int i=0; i<DriveGraph::get()->getNumNodes(); i++)
     {
@@ -832,6 +1008,24 @@ void Track::loadDriveGraph(unsigned int mode_id, const bool reverse)
     }
 }   // loadDriveGraph
 
+//-----------------------------------------------------------------------------
+/** Server rooms racing on the same track share its graph, which is not
+ *  changed after loading. If another room has loaded the graph with the
+ *  given key it is used by this room.
+ *  \param key Identifies the graph file and all settings the graph
+ *         depends on.
+ *  \return True if the graph of another room is used, false if the graph
+ *          has to be loaded.
+ */
+bool Track::useSharedGraph(const std::string &key)
+{
+    if (!STKProcess::isRoom())
+        return false;
+    m_shared_graph_key = key;
+    m_uses_shared_graph = Graph::useSharedGraph(key);
+    return m_uses_shared_graph;
+}   // useSharedGraph
+
 // -----------------------------------------------------------------------------
 
 void Track::mapPoint2MiniMap(const Vec3 &xyz, Vec3 *draw_at) const
@@ -1591,8 +1785,9 @@ bool Track::loadMainTrack(const XMLNode &root)
         main_loop->renderGUI(4400, i, m_all_nodes.size());
     }
 
-    // Free the tangent (track mesh) after converting to physics
-    if (GUIEngine::isNoGraphics())
+    // Free the tangent (track mesh) after converting to physics, rooms
+    // keep it for the next race on this track (and other rooms racing on it)
+    if (GUIEngine::isNoGraphics() && !STKProcess::isRoom())
         tangent_mesh->freeMeshVertexBuffer();
 
     if (m_track_mesh == NULL)
@@ -1743,7 +1938,9 @@ void Track::update(int ticks)
     }
     float dt = stk_config->ticks2Time(ticks);
     m_check_manager->update(dt);
+    PROFILER_PUSH_CPU_MARKER("Track::update (items)", 0xa0, 0x40, 0x00);
     m_item_manager->update(ticks);
+    PROFILER_POP_CPU_MARKER();
 
     // TODO: enable onUpdate scripts if we ever find a compelling use for them
     //Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
@@ -1894,7 +2091,8 @@ static void recursiveUpdatePhysics(std::vector<TrackObject*>& tos)
  */
 void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
 {
-    assert(m_current_track[PT_MAIN].load() == NULL);
+    ProcessType type = STKProcess::getType();
+    assert(m_current_track[type].load() == NULL);
 
     // Use m_filename to also get the path, not only the identifier
     STKTexManager::getInstance()
@@ -1905,6 +2103,11 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     }
     main_loop->renderGUI(3000);
     m_check_manager = new CheckManager();
+    m_shared_graph_key.clear();
+    m_uses_shared_graph = false;
+    // Rooms load one track at a time, but other rooms can allocate while
+    // racing, so this is only approximate for them
+    size_t memory_before_load = m_memory_report ? getResidentMemory() : 0;
     assert(m_all_cached_meshes.size()==0);
     if(UserConfigParams::logMemory())
     {
@@ -1959,7 +2162,15 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     try
     {
         std::string materials_file = m_root+"materials.xml";
-        if(m_cache_track)
+        if (STKProcess::isRoom(type))
+        {
+            // Rooms of a multi room server load tracks while other rooms are
+            // racing, so the materials of each track are loaded only once
+            // and then kept
+            if (g_room_material_files.insert(materials_file).second)
+                material_manager->addSharedMaterial(materials_file);
+        }
+        else if(m_cache_track)
         {
             if(!m_materials_loaded)
                 material_manager->addSharedMaterial(materials_file);
@@ -1991,8 +2202,9 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         throw std::runtime_error(msg.str());
     }
 
-    m_current_track[PT_MAIN] = this;
-    m_current_track[PT_CHILD] = NULL;
+    m_current_track[type] = this;
+    if (type == PT_MAIN)
+        m_current_track[PT_CHILD] = NULL;
 
     // Load the graph only now: this function is called from world, after
     // the race gui was created. The race gui is needed since it stores
@@ -2031,8 +2243,10 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     }
     else
     {
-        // Seed random engine locally
-        uint32_t seed = (uint32_t)StkTime::getTimeSinceEpoch();
+        // Seed random engine locally, with the fixed seed if there is one
+        // (--seed or the race benchmark) so that races can be repeated
+        uint32_t seed = RandomGenerator::hasSeed() ?
+            RandomGenerator::getSeed() : (uint32_t)StkTime::getTimeSinceEpoch();
         ItemManager::updateRandomSeed(seed);
         m_item_manager = std::make_shared<ItemManager>();
         powerup_manager->setRandomSeed(seed);
@@ -2192,7 +2406,11 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     model_def_loader.cleanLibraryNodesAfterLoad();
     main_loop->renderGUI(5100);
 
-    Scripting::ScriptEngine::getInstance()->compileLoadedScripts();
+    // Rooms of a multi room server have no scripting engine
+    Scripting::ScriptEngine* script_engine =
+        Scripting::ScriptEngine::getInstance();
+    if (script_engine)
+        script_engine->compileLoadedScripts();
     main_loop->renderGUI(5200);
 
     // Init all track objects
@@ -2387,13 +2605,23 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
                    "texture cache %d\n", getIdent().c_str(),
                 irr_driver->getSceneManager()->getMeshCache()->getMeshCount(),
                 irr_driver->getVideoDriver()->getTextureCount());
+        // Shared data is used by all server rooms on this track
+        Log::debug("track", "[memory] Collision data of '%s': track mesh "
+                   "%zu KB (%s), effect mesh %zu KB (%s), graph %s\n",
+                   getIdent().c_str(), m_track_mesh->getMemoryUsage() / 1024,
+                   m_track_mesh->isShared() ? "shared" : "per world",
+                   m_gfx_effect_mesh->getMemoryUsage() / 1024,
+                   m_gfx_effect_mesh->isShared() ? "shared" : "per world",
+                   m_uses_shared_graph ? "shared" : "per world");
     }
 
     World *world = World::getWorld();
-    if (world->useChecklineRequirements())
+    if (world->useChecklineRequirements() && !m_uses_shared_graph)
     {
         DriveGraph::get()->computeChecklineRequirements();
     }
+    if (!m_shared_graph_key.empty() && !m_uses_shared_graph && Graph::get())
+        Graph::addSharedGraph(m_shared_graph_key);
     main_loop->renderGUI(6000);
 
     EasterEggHunt *easter_world = dynamic_cast<EasterEggHunt*>(world);
@@ -2412,8 +2640,76 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         m_spherical_harmonics_textures.clear();
     }
 #endif   // !SERVER_ONLY
+
+    // The search paths and materials are shared by all rooms, and other
+    // rooms can load or clean up tracks before this one is cleaned up
+    if (STKProcess::isRoom(type))
+    {
+        popSearchPaths();
+        material_manager->makeMaterialsPermanent();
+    }
+
+    m_load_memory = 0;
+    size_t memory_after_load = m_memory_report ? getResidentMemory() : 0;
+    if (memory_after_load > memory_before_load && memory_before_load > 0)
+        m_load_memory = memory_after_load - memory_before_load;
 }   // loadTrackModel
 
+//-----------------------------------------------------------------------------
+/** Logs the memory used for this track by the world of the current process,
+ *  called at the end of a race if --track-memory-report is given. Collision
+ *  meshes and graphs shared with other worlds (the child process or other
+ *  server rooms on the same track) are listed separately, everything else
+ *  is the footprint of this world.
+ */
+void Track::reportMemory() const
+{
+    size_t own = 0, shared = 0;
+    auto add = [&own, &shared](const TriangleMesh* mesh)
+    {
+        if (!mesh)
+            return;
+        if (mesh->isShared())
+            shared += mesh->getMemoryUsage();
+        else
+            own += mesh->getMemoryUsage();
+    };
+    add(m_track_mesh);
+    add(m_height_map_mesh);
+    add(m_gfx_effect_mesh);
+    const size_t track_meshes = own + shared;
+
+    unsigned int num_object_meshes = 0;
+    if (m_track_object_manager)
+    {
+        for (auto* to : m_track_object_manager->getObjects().m_contents_vector)
+        {
+            const PhysicalObject* po = to->getPhysicalObject();
+            if (po && po->getTriangleMesh())
+            {
+                add(po->getTriangleMesh());
+                num_object_meshes++;
+            }
+        }
+    }
+    const size_t object_meshes = own + shared - track_meshes;
+
+    size_t graph = Graph::get() ? Graph::get()->getMemoryUsage() : 0;
+    if (Graph::isShared())
+        shared += graph;
+    else
+        own += graph;
+
+    Log::info("Track", "[memory] World %u on '%s': loading added %zu KB "
+              "resident memory. Track meshes %zu KB, %u object meshes "
+              "%zu KB, graph %zu KB (%s). Own %zu KB, shared with other "
+              "worlds %zu KB.", (unsigned)STKProcess::getType(),
+              getIdent().c_str(), m_load_memory / 1024, track_meshes / 1024,
+              num_object_meshes, object_meshes / 1024, graph / 1024,
+              Graph::isShared() ? "shared" : "own", own / 1024,
+              shared / 1024);
+}   // reportMemory
+
 //-----------------------------------------------------------------------------
 
 void Track::loadObjects(const XMLNode* root, const std::string& path,
@@ -3011,6 +3307,7 @@ void Track::copyFromMainProcess()
 {
     // Clear all unneeded objects copied in main process track
     m_physical_object_uid = 0;
+    m_load_memory = 0;
     m_animated_textures.clear();
     m_animated_textures.shrink_to_fit();
     m_all_nodes.clear();
@@ -3053,11 +3350,13 @@ void Track::copyFromMainProcess()
         }
     }
 
+    // The triangles and collision shapes don't change during a race, so the
+    // child process uses the ones of the main process
     m_track_mesh = new TriangleMesh(/*can_be_transformed*/false);
     m_height_map_mesh = NULL;
     m_gfx_effect_mesh = new TriangleMesh(/*can_be_transformed*/false);
-    m_track_mesh->copyFrom(*main_track->m_track_mesh);
-    m_gfx_effect_mesh->copyFrom(*main_track->m_gfx_effect_mesh);
+    m_track_mesh->shareFrom(*main_track->m_track_mesh);
+    m_gfx_effect_mesh->shareFrom(*main_track->m_gfx_effect_mesh);
 
     // At the moment we only use network for child track
     auto nim = std::make_shared<NetworkItemManager>();
@@ -3068,6 +3367,7 @@ void Track::copyFromMainProcess()
             NULL/*mesh*/, NULL/*lowres_mesh*/, "", NULL/*owner*/));
     }
     m_item_manager = nim;
+    Graph::shareWithChild(true);
 }   // copyFromMainProcess
 
 //-----------------------------------------------------------------------------
@@ -3110,6 +3410,7 @@ void Track::cleanChildTrack()
     delete child_track->m_gfx_effect_mesh;
     delete child_track;
     m_current_track[PT_CHILD] = NULL;
+    Graph::shareWithChild(false);
 }   // cleanChildTrack
 
 //-----------------------------------------------------------------------------
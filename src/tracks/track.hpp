@@ -218,6 +218,14 @@ private:
      *  allowing the kart to drive in/partly under water), but the
      *  actual surface position is needed for the water splash effect. */
     TriangleMesh*            m_gfx_effect_mesh;
+    /** Key of the graph in the graphs shared by server rooms, empty if the
+     *  graph is not shared. */
+    std::string              m_shared_graph_key;
+    /** True if the graph was loaded by another server room. */
+    bool                     m_uses_shared_graph;
+    /** Growth of the resident memory of the process while loading this
+     *  track in bytes, 0 if not known. */
+    size_t                   m_load_memory;
     /** Minimum coordinates of this track. */
     Vec3                     m_aabb_min;
     /** Maximum coordinates of this track. */
@@ -233,6 +241,9 @@ private:
     bool                     m_has_easter_eggs;
     /** True if this track has navmesh. */
     bool                     m_has_navmesh;
+    /** 1 if this track or a library it uses has a script, 0 if not, and
+     *  -1 if this was not checked yet, see usesScripting(). */
+    mutable int              m_uses_scripting;
     /** True if this track is a soccer arena. */
     bool                     m_is_soccer;
 
@@ -414,6 +425,8 @@ private:
     void loadTrackInfo();
     void loadDriveGraph(unsigned int mode_id, const bool reverse);
     void loadArenaGraph(const XMLNode &node);
+    bool useSharedGraph(const std::string &key);
+    void reportMemory() const;
     btQuaternion getArenaStartRotation(const Vec3& xyz, float heading);
     bool loadMainTrack(const XMLNode &node);
     void loadMinimap();
@@ -424,6 +437,7 @@ private:
     void handleSky(const XMLNode &root, const std::string &filename);
     void freeCachedMeshVertexBuffer();
     void copyFromMainProcess();
+    void popSearchPaths();
     video::IImage* getSkyTexture(std::string path) const;
     scene::IMesh* getClonedMesh(const std::string& filename) const;
 public:
@@ -454,6 +468,10 @@ public:
      *  minutes(!) in debug mode to be computed. */
     static bool        m_dont_load_navmesh;
 
+    /** Flag to log the memory used by each world for its track at the end
+     *  of a race (--track-memory-report). */
+    static bool        m_memory_report;
+
     /** Static helper function to pre-upload vertex buffer in spm. */
     static void uploadNodeVertexBuffer(scene::ISceneNode *node);
 
@@ -668,6 +686,8 @@ public:
      * in the track selection screen. */
     bool isInternal() const { return m_internal; }
     // ------------------------------------------------------------------------
+    bool usesScripting() const;
+    // ------------------------------------------------------------------------
     /** Returns true if auto rescue is enabled. */
     bool isAutoRescueEnabled() const { return m_enable_auto_rescue; }
     // ------------------------------------------------------------------------
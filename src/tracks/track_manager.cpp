@@ -21,6 +21,7 @@
 #include "config/stk_config.hpp"
 #include "graphics/irr_driver.hpp"
 #include "io/file_manager.hpp"
+#include "io/manifest_cache.hpp"
 #include "tracks/track.hpp"
 
 #include <algorithm>
@@ -172,25 +173,14 @@ void TrackManager::loadTrackList()
         delete track;
     m_tracks.clear();
 
-    for(unsigned int i=0; i<m_track_search_path.size(); i++)
-    {
-        const std::string &dir = m_track_search_path[i];
-
-        // First test if the directory itself contains a track:
-        // ----------------------------------------------------
-        if(loadTrack(dir)) continue;  // track found, no more tests
-
-        // Then see if a subdir of this dir contains tracks
-        // ------------------------------------------------
-        std::set<std::string> dirs;
-        file_manager->listFiles(dirs, dir);
-        for(std::set<std::string>::iterator subdir = dirs.begin();
-            subdir != dirs.end(); subdir++)
-        {
-            if(*subdir=="." || *subdir=="..") continue;
-            loadTrack(dir+*subdir+"/");
-        }   // for dir in dirs
-    }   // for i <m_track_search_path.size()
+    // The track.xml files are found and parsed by the worker threads, only
+    // the tracks themselves are created here.
+    ManifestCache manifest("tracks");
+    std::vector<std::string> dirs =
+        manifest.findDirectories(m_track_search_path, "/", "track.xml",
+                                 { "easter_eggs.xml" });
+    for (const std::string &dir : dirs)
+        loadTrack(dir);
     updateScreenshotCache();
     onDemandLoadTrackScreenshots();
 }  // loadTrackList
@@ -390,7 +390,9 @@ void TrackObject::onWorldReady()
     {
         m_initially_visible = false;
     }
-    else if (m_visibility_condition.size() > 0)
+    // Rooms of a multi room server have no scripting engine
+    else if (m_visibility_condition.size() > 0 &&
+             Scripting::ScriptEngine::getInstance())
     {
         unsigned char result = -1;
         Scripting::ScriptEngine* script_engine = 
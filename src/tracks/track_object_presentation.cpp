@@ -217,7 +217,7 @@ TrackObjectPresentationLibraryNode::TrackObjectPresentationLibraryNode(
         {
             lib_path = track->getTrackFile("library/" + name);
             libroot = file_manager->createXMLTree(local_lib_node_path);
-            if (track != NULL)
+            if (track != NULL && Scripting::ScriptEngine::getInstance())
             {
                 Scripting::ScriptEngine::getInstance()->loadScript(local_script_file_path, false);
             }
@@ -225,7 +225,7 @@ TrackObjectPresentationLibraryNode::TrackObjectPresentationLibraryNode(
         else if (file_manager->fileExists(lib_node_path))
         {
             libroot = file_manager->createXMLTree(lib_node_path);
-            if (track != NULL)
+            if (track != NULL && Scripting::ScriptEngine::getInstance())
             {
                 Scripting::ScriptEngine::getInstance()->loadScript(lib_script_file_path, false);
             }
@@ -295,8 +295,8 @@ TrackObjectPresentationLibraryNode::TrackObjectPresentationLibraryNode(
 
 void TrackObjectPresentationLibraryNode::update(float dt)
 {
-    // Child process currently has no scripting engine
-    if (STKProcess::getType() == PT_CHILD)
+    // Only the main process has a scripting engine
+    if (STKProcess::getType() != PT_MAIN)
         return;
 
     if (!m_start_executed)
@@ -527,6 +527,15 @@ void TrackObjectPresentationMesh::init(const XMLNode* xml_node,
 
     m_mesh->grab();
     irr_driver->grabAllTextures(m_mesh);
+    // Rooms keep the meshes of a track cached after the race, see
+    // Track::cleanup
+    Track* current_track = Track::getCurrentTrack();
+    if (STKProcess::isRoom() && current_track)
+    {
+        m_mesh->grab();
+        irr_driver->grabAllTextures(m_mesh);
+        current_track->addCachedMesh(m_mesh);
+    }
 
     if (interaction == "physicsonly")
     {
@@ -1198,7 +1207,7 @@ TrackObjectPresentationActionTrigger::TrackObjectPresentationActionTrigger(
 void TrackObjectPresentationActionTrigger::onTriggerItemApproached(int kart_id)
 {
     if (m_reenable_timeout > StkTime::getMonoTimeMs() ||
-        STKProcess::getType() == PT_CHILD)
+        STKProcess::getType() != PT_MAIN)
     {
         return;
     }
@@ -0,0 +1,234 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_BOUNDED_QUEUE_HPP
+#define HEADER_BOUNDED_QUEUE_HPP
+
+#include "utils/log.hpp"
+#include "utils/no_copy.hpp"
+
+#include <assert.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/** A lock-free queue with a fixed capacity which can be used by any number
+ *  of producer and consumer threads. Each slot has a sequence number which
+ *  tells if it can be written (for the push with the same position) or read
+ *  (for the pop with the same position), so a push or pop only needs one
+ *  compare-and-swap on the write or read position, and no memory is
+ *  allocated after construction. push() fails if the queue is full, and
+ *  pop() fails if it is empty.
+ */
+template<typename T>
+class BoundedQueue : public NoCopy
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> m_sequence;
+        T                   m_data;
+    };
+
+    /** Keeps the read and write positions (which are changed by different
+     *  threads) in different cache lines. */
+    struct PaddedPosition
+    {
+        std::atomic<size_t> m_pos;
+        char                m_padding[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    Cell          *m_cells;
+
+    size_t         m_mask;
+
+    PaddedPosition m_write;
+
+    PaddedPosition m_read;
+
+public:
+    /** Creates the queue.
+     *  \param capacity Number of elements which can be stored, it is rounded
+     *         up to the next power of two. */
+    BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        m_mask = size - 1;
+        m_cells = new Cell[size];
+        for (size_t i = 0; i < size; i++)
+            m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+        m_write.m_pos.store(0, std::memory_order_relaxed);
+        m_read.m_pos.store(0, std::memory_order_relaxed);
+    }   // BoundedQueue
+    // ------------------------------------------------------------------------
+    ~BoundedQueue()
+    {
+        delete [] m_cells;
+    }   // ~BoundedQueue
+    // ------------------------------------------------------------------------
+    /** Adds an element at the end of the queue.
+     *  \return False if the queue is full. */
+    bool push(const T &data)
+    {
+        size_t pos = m_write.m_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (m_write.m_pos.compare_exchange_weak(pos, pos + 1,
+                                                     std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = m_write.m_pos.load(std::memory_order_relaxed);
+        }
+        cell->m_data = data;
+        cell->m_sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }   // push
+    // ------------------------------------------------------------------------
+    /** Removes the first element of the queue.
+     *  \return False if the queue is empty. */
+    bool pop(T *data)
+    {
+        size_t pos = m_read.m_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (m_read.m_pos.compare_exchange_weak(pos, pos + 1,
+                                                     std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = m_read.m_pos.load(std::memory_order_relaxed);
+        }
+        *data = cell->m_data;
+        cell->m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }   // pop
+    // ------------------------------------------------------------------------
+    /** Returns if the queue is empty. This is only a snapshot if other
+     *  threads use the queue at the same time. */
+    bool empty() const
+    {
+        size_t pos = m_read.m_pos.load(std::memory_order_relaxed);
+        const Cell &cell = m_cells[pos & m_mask];
+        return cell.m_sequence.load(std::memory_order_acquire) != pos + 1;
+    }   // empty
+    // ------------------------------------------------------------------------
+    /** Returns the number of elements which can be stored. */
+    size_t capacity() const { return m_mask + 1; }
+    // ------------------------------------------------------------------------
+    static void unitTesting()
+    {
+        BoundedQueue<int> small(3);
+        assert(small.capacity() == 4);
+        int v = 0;
+        if (small.pop(&v) || !small.empty())
+            Log::fatal("BoundedQueue", "New queue is not empty.");
+        for (int i = 0; i < 4; i++)
+        {
+            if (!small.push(i))
+                Log::fatal("BoundedQueue", "Push %d failed.", i);
+        }
+        if (small.push(4))
+            Log::fatal("BoundedQueue", "Push into full queue succeeded.");
+        // Wrap around a few times
+        for (int i = 0; i < 20; i++)
+        {
+            if (!small.pop(&v) || v != i)
+                Log::fatal("BoundedQueue", "Pop %d returned %d.", i, v);
+            if (!small.push(i + 4))
+                Log::fatal("BoundedQueue", "Push %d failed.", i + 4);
+        }
+
+        // Several producers and consumers: each value must arrive once,
+        // and the values of one producer in order.
+        const int producers = 3, consumers = 3, count = 20000;
+        BoundedQueue<int> queue(64);
+        std::vector<std::atomic<int> > received(producers * count);
+        for (auto &r : received)
+            r.store(0);
+        std::atomic<int> done(0);
+        std::atomic<bool> ordered(true);
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&queue, p, count]()
+                {
+                    for (int i = 0; i < count; i++)
+                    {
+                        while (!queue.push(p * count + i))
+                            std::this_thread::yield();
+                    }
+                });
+        }
+        for (int c = 0; c < consumers; c++)
+        {
+            threads.emplace_back([&]()
+                {
+                    std::vector<int> last(producers, -1);
+                    int value;
+                    while (done.load() < producers * count)
+                    {
+                        if (!queue.pop(&value))
+                        {
+                            std::this_thread::yield();
+                            continue;
+                        }
+                        received[value]++;
+                        if (value % count <= last[value / count])
+                            ordered.store(false);
+                        last[value / count] = value % count;
+                        done++;
+                    }
+                });
+        }
+        for (auto &t : threads)
+            t.join();
+        for (int i = 0; i < producers * count; i++)
+        {
+            if (received[i].load() != 1)
+            {
+                Log::fatal("BoundedQueue", "Value %d received %d times.",
+                           i, received[i].load());
+            }
+        }
+        if (!ordered.load())
+            Log::fatal("BoundedQueue", "Values of a producer out of order.");
+    }   // unitTesting
+};   // BoundedQueue
+
+#endif
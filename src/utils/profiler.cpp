@@ -26,6 +26,7 @@
 #include "graphics/irr_driver.hpp"
 #include "guiengine/scalable_font.hpp"
 #include "io/file_manager.hpp"
+#include "network/rewind_profiler.hpp"
 #include "race/race_manager.hpp"
 #include "replay/replay_play.hpp"
 #include "tracks/track.hpp"
@@ -51,6 +52,7 @@ Profiler profiler;
 
 #define MARKERS_NAMES_POS     core::rect<s32>(50,100,150,600)
 #define GPU_MARKERS_NAMES_POS core::rect<s32>(50,165,150,300)
+#define REWIND_STATS_POS      core::rect<s32>(50,300,650,360)
 
 // The width of the profiler corresponds to TIME_DRAWN_MS milliseconds
 #define TIME_DRAWN_MS 30.0f 
@@ -227,6 +229,26 @@ void Profiler::popCPUMarker()
     m_lock.unlock();
 }   // popCPUMarker
 
+//-----------------------------------------------------------------------------
+/** Returns the time (in ms) spent in the given event since the last reset,
+ *  summed over all threads.
+ */
+double Profiler::getTotalTime(const std::string& name)
+{
+    double total = 0.0;
+    m_lock.lock();
+    for (int i = 0; i < m_threads_used && i < (int)m_all_threads_data.size();
+         i++)
+    {
+        const AllEventData& aed = m_all_threads_data[i].m_all_event_data;
+        AllEventData::const_iterator it = aed.find(name);
+        if (it != aed.end())
+            total += it->second.getTotalDuration();
+    }
+    m_lock.unlock();
+    return total;
+}   // getTotalTime
+
 //-----------------------------------------------------------------------------
 /** Switches the profiler on
  */
@@ -512,6 +534,15 @@ void Profiler::draw()
             font->drawQuick(oss.str().c_str(), GPU_MARKERS_NAMES_POS,
                        video::SColor(0xFF, 0xFF, 0x00, 0x00));
         }
+
+        // Show the rollback cost in networked games
+        if (RewindProfiler::get() &&
+            RewindProfiler::get()->getRaceTotals().m_num_rewinds > 0)
+        {
+            font->drawQuick(RewindProfiler::get()->getSummary().c_str(),
+                            REWIND_STATS_POS,
+                            video::SColor(0xFF, 0x00, 0x00, 0xFF));
+        }
     }
 
     PROFILER_POP_CPU_MARKER();
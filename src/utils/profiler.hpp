@@ -173,12 +173,17 @@ private:
         /** Vector of all buffered markers. */
         std::vector<Marker> m_all_markers;
 
+        /** Duration of this event since the last reset, which (unlike the
+         *  markers) is not limited to the buffer period. */
+        double m_total_duration;
+
     public:
-        EventData() {}
+        EventData() { m_total_duration = 0; }
         EventData(video::SColor colour, int max_size)
         {
             m_all_markers.resize(max_size);
             m_colour = colour;
+            m_total_duration = 0;
         }   // EventData
         // --------------------------------------------------------------------
         /** Records the start of an event for a given frame. */
@@ -192,9 +197,13 @@ private:
         void setEnd(size_t frame, double end)
         {
             assert(frame < m_all_markers.capacity());
+            m_total_duration += end - m_all_markers[frame].getStart();
             m_all_markers[frame].setEnd(end);
         }   // setEnd
         // --------------------------------------------------------------------
+        /** Returns the duration of this event since the last reset. */
+        double getTotalDuration() const { return m_total_duration; }
+        // --------------------------------------------------------------------
         const Marker& getMarker(int n) const { return m_all_markers[n]; }
         Marker& getMarker(int n) { return m_all_markers[n]; }
         // --------------------------------------------------------------------
@@ -324,6 +333,7 @@ public:
     void     computeStableFPS();
     void     startBenchmark();
     void     writeToFile();
+    double   getTotalTime(const std::string& name);
 
     // ------------------------------------------------------------------------
     bool isFrozen() const { return m_freeze_state == FROZEN; }
@@ -18,20 +18,72 @@
 
 #include "utils/random_generator.hpp"
 
+#include "utils/log.hpp"
+
+#include <future>
+#include <thread>
+
 //std::vector<RandomGenerator*> RandomGenerator::m_all_random_generators;
 
 unsigned int RandomGenerator::m_random_value = RandomGenerator::default_seed;
+std::atomic<unsigned int> RandomGenerator::m_seed_generation(0);
 
 std::mt19937& RandomGenerator::getGenerator() {
-   static thread_local std::mt19937 generator = [] {
+   static thread_local std::mt19937 generator;
+   // Never equal to a generation, so each thread seeds its generator first
+   static thread_local unsigned int generation = -1;
+   unsigned int current = m_seed_generation.load();
+   if (generation != current)
+   {
+      generation = current;
       if (m_random_value == default_seed)
-         return std::mt19937{std::random_device{}()};
+         generator.seed(std::random_device{}());
       else
-         return std::mt19937{m_random_value};
-   }();
+         generator.seed(m_random_value);
+   }
    return generator;
 }
 
+// ----------------------------------------------------------------------------
+/** Checks that seeding again with the same seed repeats the numbers of the
+ *  generators which were already used, also in other threads. */
+void RandomGenerator::unitTesting()
+{
+    unsigned int old_seed = m_random_value;
+    auto draw = []()
+    {
+        std::vector<int> numbers;
+        RandomGenerator rg;
+        for (unsigned int i = 0; i < 100; i++)
+            numbers.push_back(rg.get(1000));
+        return numbers;
+    };
+
+    // Another thread (like the worker threads) uses its generator before
+    // and after the seed is set again
+    std::promise<void> drawn, reseeded;
+    std::vector<int> thread_first, thread_second;
+    seed(1234);
+    std::thread thread([&]()
+        {
+            thread_first = draw();
+            drawn.set_value();
+            reseeded.get_future().wait();
+            thread_second = draw();
+        });
+    drawn.get_future().wait();
+    std::vector<int> first = draw();
+    seed(1234);
+    reseeded.set_value();
+    thread.join();
+    if (draw() != first || thread_second != thread_first)
+        Log::fatal("RandomGenerator", "Same seed gave other numbers.");
+    seed(4321);
+    if (draw() == first)
+        Log::fatal("RandomGenerator", "Other seed gave the same numbers.");
+    seed(old_seed);
+}   // unitTesting
+
 // ----------------------------------------------------------------------------
 #if 0
 std::vector<int> RandomGenerator::generateAllSeeds()
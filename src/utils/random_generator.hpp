@@ -19,6 +19,7 @@
 #ifndef HEADER_RANDOM_GENERATOR_HPP
 #define HEADER_RANDOM_GENERATOR_HPP
 
+#include <atomic>
 #include <random>
 #include <vector>
 
@@ -33,6 +34,9 @@ class RandomGenerator
 {
 private:
    static unsigned int m_random_value;
+   /** Increased by each seed() call, so that the generator of each thread
+    *  is seeded again. */
+   static std::atomic<unsigned int> m_seed_generation;
    static constexpr unsigned int default_seed = 3141591;
 #ifdef NOT_USED_ATM
    unsigned int m_a = 1103515245;
@@ -50,7 +54,18 @@ public:
        std::uniform_int_distribution<int> dist(0, n - 1);
        return dist(getGenerator());
     }
-    static void seed(int s) {m_random_value = s;}
+    /** Seeds the generators of all threads (each one the next time it is
+     *  used). Without a seed they are seeded randomly. */
+    static void seed(int s)
+    {
+        m_random_value = s;
+        m_seed_generation.fetch_add(1);
+    }
+    /** Returns if a fixed seed was set (e.g. with --seed), in which case
+     *  other random values (e.g. of items) should use it too. */
+    static bool hasSeed() { return m_random_value != default_seed; }
+    static unsigned int getSeed() { return m_random_value; }
+    static void unitTesting();
 };  // RandomGenerator
 
 #endif // HEADER_RANDOM_GENERATOR_HPP
@@ -16,8 +16,20 @@
 //  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "utils/stk_process.hpp"
+#include "utils/string_utils.hpp"
 
 namespace STKProcess
 {
     thread_local ProcessType g_process_type = PT_MAIN;
+    // ------------------------------------------------------------------------
+    /** Returns the suffix which is added to the names of the threads of the
+     *  given process type, so they can be told apart in a debugger. */
+    std::string getThreadNameSuffix(ProcessType pt)
+    {
+        if (pt == PT_CHILD)
+            return "_child";
+        if (isRoom(pt))
+            return "_r" + StringUtils::toString(pt - PT_FIRST_ROOM);
+        return "";
+    }   // getThreadNameSuffix
 } // namespace STKProcess
@@ -20,11 +20,14 @@
 
 #include "utils/tls.hpp"
 
+#include <string>
+
 enum ProcessType : unsigned int
 {
     PT_MAIN = 0, // Main process
     PT_CHILD = 1, // Child process inside main (can be server or ai instance)
-    PT_COUNT = 2
+    PT_FIRST_ROOM = 2, // First room of a server hosting several lobbies
+    PT_COUNT = 66 // Allows up to 64 rooms
 };
 
 namespace STKProcess
@@ -40,6 +43,14 @@ namespace STKProcess
     // ------------------------------------------------------------------------
     /** Reset when stk is started (for android mostly). */
     inline void reset()                           { g_process_type = PT_MAIN; }
+    // ------------------------------------------------------------------------
+    /** Return true if the type is one of the rooms of a server which hosts
+     *  several lobbies in one process. */
+    inline bool isRoom(ProcessType pt)             { return pt >= PT_FIRST_ROOM; }
+    // ------------------------------------------------------------------------
+    inline bool isRoom()                      { return isRoom(g_process_type); }
+    // ------------------------------------------------------------------------
+    std::string getThreadNameSuffix(ProcessType pt);
 } // namespace STKProcess
 
 #endif
@@ -118,6 +118,17 @@ public:
         return value.count();
     }
     // ------------------------------------------------------------------------
+    /** Returns the monotonic time since the starting of stk in
+     *  microseconds, e.g. to measure short durations.
+     */
+    static uint64_t getMonoTimeUs()
+    {
+        auto duration = std::chrono::steady_clock::now() - m_mono_start;
+        auto value =
+            std::chrono::duration_cast<std::chrono::microseconds>(duration);
+        return value.count();
+    }
+    // ------------------------------------------------------------------------
     /**
      * \brief Compare two different times.
      * \return A signed integral indicating the relation between the time.
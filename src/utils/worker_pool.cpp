@@ -0,0 +1,169 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/worker_pool.hpp"
+
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/vs.hpp"
+
+#include <algorithm>
+
+WorkerPool* WorkerPool::m_worker_pool[PT_COUNT];
+std::mutex WorkerPool::m_create_mutex;
+
+// ----------------------------------------------------------------------------
+/** Returns the worker pool of the current process, creating it on first use
+ *  with one thread less than the number of cpu cores (the caller of
+ *  parallelFor is working too). All rooms of a multi room server share one
+ *  pool.
+ */
+WorkerPool* WorkerPool::get()
+{
+    ProcessType pt = STKProcess::getType();
+    if (STKProcess::isRoom(pt))
+        pt = PT_FIRST_ROOM;
+    std::lock_guard<std::mutex> lock(m_create_mutex);
+    if (!m_worker_pool[pt])
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        unsigned threads = cores > 1 ? std::min(cores - 1, 7u) : 0;
+        m_worker_pool[pt] = new WorkerPool(threads, pt);
+    }
+    return m_worker_pool[pt];
+}   // get
+
+// ----------------------------------------------------------------------------
+/** Stops the threads of all worker pools. */
+void WorkerPool::destroy()
+{
+    std::lock_guard<std::mutex> lock(m_create_mutex);
+    for (unsigned i = 0; i < PT_COUNT; i++)
+    {
+        delete m_worker_pool[i];
+        m_worker_pool[i] = NULL;
+    }
+}   // destroy
+
+// ============================================================================
+WorkerPool::WorkerPool(unsigned num_threads, ProcessType pt)
+{
+    m_job_id = 0;
+    m_job = NULL;
+    m_job_size = 0;
+    m_job_process_type = pt;
+    m_workers_busy = 0;
+    m_next_index.store(0);
+    m_exit = false;
+    for (unsigned i = 0; i < num_threads; i++)
+        m_threads.emplace_back(&WorkerPool::mainLoop, this, pt, i);
+    Log::info("WorkerPool", "Using %d worker threads.", num_threads);
+}   // WorkerPool
+
+// ----------------------------------------------------------------------------
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_work_cv.notify_all();
+    for (std::thread& t : m_threads)
+        t.join();
+}   // ~WorkerPool
+
+// ----------------------------------------------------------------------------
+void WorkerPool::mainLoop(ProcessType pt, unsigned id)
+{
+    std::string name = "Worker" + StringUtils::toString(id) +
+        STKProcess::getThreadNameSuffix(pt);
+    VS::setThreadName(name.c_str());
+
+    uint64_t last_job = 0;
+    std::unique_lock<std::mutex> ul(m_mutex);
+    while (true)
+    {
+        m_work_cv.wait(ul, [this, last_job]
+            {
+                return m_exit || m_job_id != last_job;
+            });
+        if (m_exit)
+            return;
+        last_job = m_job_id;
+        const std::function<void(unsigned)>* job = m_job;
+        unsigned size = m_job_size;
+        // Use the singletons of the process which started the job
+        STKProcess::init(m_job_process_type);
+        ul.unlock();
+        runJob(*job, size);
+        ul.lock();
+        if (--m_workers_busy == 0)
+            m_done_cv.notify_one();
+    }
+}   // mainLoop
+
+// ----------------------------------------------------------------------------
+void WorkerPool::runJob(const std::function<void(unsigned)>& job,
+                        unsigned size)
+{
+    unsigned i;
+    while ((i = m_next_index.fetch_add(1, std::memory_order_relaxed)) < size)
+        job(i);
+}   // runJob
+
+// ----------------------------------------------------------------------------
+/** Calls f(i) for all i in [0, count), distributed over all threads of this
+ *  pool. The order in which the items are done is undefined, so f must
+ *  only write data which belongs to item i. Returns after all items are
+ *  done.
+ */
+void WorkerPool::parallelFor(unsigned count,
+                             const std::function<void(unsigned)>& f)
+{
+    if (m_threads.empty() || count < 2)
+    {
+        for (unsigned i = 0; i < count; i++)
+            f(i);
+        return;
+    }
+
+    // A shared pool can be busy with the job of another room, in which case
+    // the caller does all items itself instead of waiting
+    std::unique_lock<std::mutex> job_lock(m_job_mutex, std::try_to_lock);
+    if (!job_lock.owns_lock())
+    {
+        for (unsigned i = 0; i < count; i++)
+            f(i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &f;
+        m_job_process_type = STKProcess::getType();
+        m_job_size = count;
+        m_next_index.store(0);
+        m_workers_busy = (unsigned)m_threads.size();
+        m_job_id++;
+    }
+    m_work_cv.notify_all();
+    runJob(f, count);
+
+    std::unique_lock<std::mutex> ul(m_mutex);
+    m_done_cv.wait(ul, [this] { return m_workers_busy == 0; });
+    m_job = NULL;
+}   // parallelFor
@@ -0,0 +1,99 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2024 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_WORKER_POOL_HPP
+#define HEADER_WORKER_POOL_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/stk_process.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** \ingroup utils
+ *  A small pool of worker threads to run independent work items in
+ *  parallel. The calling thread takes part in the work, and parallelFor()
+ *  only returns once all items are done, so the caller can apply the
+ *  results afterwards in a fixed order. Each ProcessType has its own pool
+ *  (except the rooms of a multi room server, which share one), and the
+ *  worker threads switch to the ProcessType of the caller for each job, so
+ *  they see the same singletons as the caller.
+ */
+class WorkerPool : public NoCopy
+{
+private:
+    static WorkerPool* m_worker_pool[PT_COUNT];
+
+    static std::mutex m_create_mutex;
+
+    std::vector<std::thread> m_threads;
+
+    /** Protects all job data below and is used by the condition
+     *  variables. */
+    std::mutex m_mutex;
+
+    std::condition_variable m_work_cv, m_done_cv;
+
+    /** Only one parallelFor can use the threads at a time. */
+    std::mutex m_job_mutex;
+
+    /** Increased for each job, so sleeping workers know there is new
+     *  work. */
+    uint64_t m_job_id;
+
+    const std::function<void(unsigned)>* m_job;
+
+    unsigned m_job_size;
+
+    /** Process type of the thread which started the current job. */
+    ProcessType m_job_process_type;
+
+    /** Number of workers which have not yet finished the current job. */
+    unsigned m_workers_busy;
+
+    /** Next item of the current job to be done. */
+    std::atomic<unsigned> m_next_index;
+
+    bool m_exit;
+
+    // ------------------------------------------------------------------------
+    void mainLoop(ProcessType pt, unsigned id);
+    // ------------------------------------------------------------------------
+    void runJob(const std::function<void(unsigned)>& job, unsigned size);
+
+public:
+    WorkerPool(unsigned num_threads, ProcessType pt);
+    ~WorkerPool();
+    // ------------------------------------------------------------------------
+    static WorkerPool* get();
+    // ------------------------------------------------------------------------
+    static void destroy();
+    // ------------------------------------------------------------------------
+    void parallelFor(unsigned count, const std::function<void(unsigned)>& f);
+    // ------------------------------------------------------------------------
+    /** Returns the number of threads doing work in parallelFor, including
+     *  the calling thread. */
+    unsigned getNumThreads() const { return (unsigned)m_threads.size() + 1; }
+};   // WorkerPool
+
+#endif